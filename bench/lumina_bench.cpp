@@ -0,0 +1,678 @@
+#include "compiler.hpp"
+#include "parser.hpp"
+#include "pass_timing.hpp"
+#include "precompilation_parser.hpp"
+#include "scaling_checks.hpp"
+#include "semantic_parser.hpp"
+#include "token.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Benchmarks each compiler stage on generated shaders. The corpora are deterministic, so allocation counts are
+// exact across commits and only timings carry noise; --output and --baseline record and compare runs.
+namespace
+{
+	constexpr std::array<const char *, 6> kStages = {
+	    "Tokenizer", "PrecompilationParser", "Parser", "SemanticParser", "Compiler", "Converter"};
+
+	// Passes of Compiler::compile that belong to the Converter.
+	constexpr std::array<const char *, 2> kConverterPasses = {"stage usage collection", "GLSL emission"};
+
+	struct Corpus
+	{
+		std::string name;
+		std::filesystem::path origin;
+		std::string source;
+		// Included files by path, resolved in memory like compileFromMemory's virtual files.
+		std::unordered_map<std::string, std::string> includes;
+
+		std::size_t bytes() const
+		{
+			std::size_t total = source.size();
+			for (const auto &[path, contents] : includes)
+			{
+				total += contents.size();
+			}
+			return total;
+		}
+	};
+
+	constexpr std::string_view kStageInterface = "Input -> VertexPass: Vector3 inPosition;\n"
+	                                             "VertexPass -> FragmentPass: Vector3 worldPosition;\n"
+	                                             "FragmentPass -> Output: Vector4 pixelColor;\n\n";
+
+	// N structs, chained eight deep through a nested member, and DataBlocks holding every one of them.
+	Corpus makeStructCorpus(std::size_t count)
+	{
+		std::ostringstream out;
+		out << kStageInterface;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			out << "struct Item" << i << "\n{\n\tVector4 color;\n\tfloat weight;\n\tVector3 offset;\n\tint index;\n";
+			if (i % 8 != 0)
+			{
+				out << "\tItem" << i - 1 << " previous;\n";
+			}
+			out << "};\n\n";
+		}
+		for (std::size_t block = 0; block * 16 < count; ++block)
+		{
+			out << "DataBlock Items" << block << "\n{\n";
+			for (std::size_t i = block * 16; i < std::min(count, block * 16 + 16); ++i)
+			{
+				out << "\tItem" << i << " item" << i << ";\n";
+			}
+			out << "};\n\n";
+		}
+		out << "VertexPass()\n{\n\tworldPosition = inPosition + Items0.item0.offset;\n"
+		    << "\tpixelPosition = Vector4(worldPosition, 1.0);\n}\n\n"
+		    << "FragmentPass()\n{\n\tpixelColor = Items0.item0.color;\n}\n";
+		return Corpus{"structs", "structs/main.lum", out.str(), {}};
+	}
+
+	// M functions, each calling the previous one, so the whole chain is reachable from the vertex stage.
+	Corpus makeFunctionCorpus(std::size_t count)
+	{
+		std::ostringstream out;
+		out << kStageInterface;
+		out << "float step0(float x, Vector3 v)\n{\n\treturn x * 0.5 + v.x;\n}\n\n";
+		for (std::size_t i = 1; i < count; ++i)
+		{
+			out << "float step" << i << "(float x, Vector3 v)\n{\n"
+			    << "\tfloat a = x * " << i << ".5 + v.x;\n"
+			    << "\tVector3 w = v * a;\n"
+			    << "\tif (a > 1.0)\n\t{\n\t\ta = a - w.y;\n\t}\n"
+			    << "\treturn step" << i - 1 << "(a, w) + w.z;\n}\n\n";
+		}
+		out << "VertexPass()\n{\n\tfloat scale = step" << count - 1 << "(inPosition.x, inPosition);\n"
+		    << "\tworldPosition = inPosition * scale;\n\tpixelPosition = Vector4(worldPosition, 1.0);\n}\n\n"
+		    << "FragmentPass()\n{\n\tpixelColor = Vector4(worldPosition, 1.0);\n}\n";
+		return Corpus{"functions", "functions/main.lum", out.str(), {}};
+	}
+
+	// Functions returning one expression nested K parentheses deep.
+	Corpus makeExpressionCorpus(std::size_t depth)
+	{
+		constexpr std::size_t kFunctions = 32;
+		constexpr std::array<std::string_view, 4> kOperators = {" + ", " * ", " - ", " / "};
+		constexpr std::array<std::string_view, 4> kOperands = {"1.5", "v.x", "x", "v.w.max(0.5)"};
+
+		std::ostringstream out;
+		out << kStageInterface;
+		for (std::size_t f = 0; f < kFunctions; ++f)
+		{
+			out << "float chain" << f << "(float x, Vector4 v)\n{\n\treturn " << std::string(depth, '(') << 'x';
+			for (std::size_t level = 0; level < depth; ++level)
+			{
+				out << kOperators[(level + f) % kOperators.size()] << kOperands[level % kOperands.size()] << ')';
+			}
+			out << ";\n}\n\n";
+		}
+		out << "VertexPass()\n{\n\tVector4 v = Vector4(inPosition, 1.0);\n\tfloat total = 0.0";
+		for (std::size_t f = 0; f < kFunctions; ++f)
+		{
+			out << " + chain" << f << "(inPosition.x, v)";
+		}
+		out << ";\n\tworldPosition = inPosition * total;\n\tpixelPosition = Vector4(worldPosition, 1.0);\n}\n\n"
+		    << "FragmentPass()\n{\n\tpixelColor = Vector4(worldPosition, 1.0);\n}\n";
+		return Corpus{"expressions", "expressions/main.lum", out.str(), {}};
+	}
+
+	// F functions returning one expression nested kDepth levels deep, mixing operators, builtin calls and
+	// conditionals, called from both stages. The depth stays fixed so the recursive stages keep within the stack;
+	// --scale adds functions.
+	Corpus makeNestingCorpus(std::size_t functions)
+	{
+		constexpr std::size_t kDepth = 1536;
+		constexpr std::array<std::pair<std::string_view, std::string_view>, 4> kLevels = {{
+		    {"(", " + 1.5)"},
+		    {"(", " * v.x)"},
+		    {"(", ").max(0.5)"},
+		    {"(x > 0.0 ? ", " : v.y)"},
+		}};
+
+		std::ostringstream out;
+		out << kStageInterface;
+		for (std::size_t f = 0; f < functions; ++f)
+		{
+			out << "float nested" << f << "(float x, Vector4 v)\n{\n\treturn ";
+			for (std::size_t level = 0; level < kDepth; ++level)
+			{
+				out << kLevels[(level + f) % kLevels.size()].first;
+			}
+			out << 'x';
+			for (std::size_t level = kDepth; level-- > 0;)
+			{
+				out << kLevels[(level + f) % kLevels.size()].second;
+			}
+			out << ";\n}\n\n";
+		}
+		// Both stages call every function, so both stages emit all of them.
+		const auto sum = [&out, functions](std::string_view position) {
+			out << "\tVector4 v = Vector4(" << position << ", 1.0);\n\tfloat total = 0.0";
+			for (std::size_t f = 0; f < functions; ++f)
+			{
+				out << " + nested" << f << "(" << position << ".x, v)";
+			}
+			out << ";\n";
+		};
+		out << "VertexPass()\n{\n";
+		sum("inPosition");
+		out << "\tworldPosition = inPosition * total;\n\tpixelPosition = Vector4(worldPosition, 1.0);\n}\n\n"
+		    << "FragmentPass()\n{\n";
+		sum("worldPosition");
+		out << "\tpixelColor = Vector4(worldPosition * total, 1.0);\n}\n";
+		return Corpus{"nesting", "nesting/main.lum", out.str(), {}};
+	}
+
+	// Lookup tables initialized from array literals of L scalars and L / 4 constructed colors.
+	Corpus makeArrayCorpus(std::size_t length)
+	{
+		constexpr std::size_t kTables = 4;
+		const std::size_t colorCount = std::max<std::size_t>(length / 4, 1);
+
+		std::ostringstream out;
+		out << kStageInterface;
+		for (std::size_t t = 0; t < kTables; ++t)
+		{
+			out << "float lookup" << t << "(int index)\n{\n\tfloat values[" << length << "] = {";
+			for (std::size_t i = 0; i < length; ++i)
+			{
+				out << (i == 0 ? " " : ", ") << i << ".25";
+			}
+			out << " };\n\treturn values[index];\n}\n\n";
+
+			out << "Color palette" << t << "(int index)\n{\n\tColor colors[" << colorCount << "] = {";
+			for (std::size_t i = 0; i < colorCount; ++i)
+			{
+				out << (i == 0 ? " " : ", ") << "Color(0." << i % 10 << ", 0.5, 1.0, 1.0)";
+			}
+			out << " };\n\treturn colors[index];\n}\n\n";
+		}
+		out << "VertexPass()\n{\n\tfloat scale = 0.0";
+		for (std::size_t t = 0; t < kTables; ++t)
+		{
+			out << " + lookup" << t << "(" << t << ")";
+		}
+		out << ";\n\tworldPosition = inPosition * scale;\n\tpixelPosition = Vector4(worldPosition, 1.0);\n}\n\n"
+		    << "FragmentPass()\n{\n\tColor color = palette0(0)";
+		for (std::size_t t = 1; t < kTables; ++t)
+		{
+			out << " + palette" << t << "(" << t << ")";
+		}
+		out << ";\n\tpixelColor = Vector4(color.r, color.g, color.b, color.a);\n}\n";
+		return Corpus{"arrays", "arrays/main.lum", out.str(), {}};
+	}
+
+	// A root including W group files, each including eight leaf files that declare a struct and a function.
+	Corpus makeIncludeCorpus(std::size_t width)
+	{
+		constexpr std::size_t kPartsPerGroup = 8;
+
+		Corpus corpus{"includes", "includes/main.lum", {}, {}};
+		std::ostringstream root;
+		for (std::size_t g = 0; g < width; ++g)
+		{
+			std::ostringstream group;
+			for (std::size_t p = 0; p < kPartsPerGroup; ++p)
+			{
+				const std::string part = std::to_string(g) + "_" + std::to_string(p);
+				group << "#include \"part" << part << ".lum\"\n";
+
+				std::ostringstream leaf;
+				leaf << "namespace lib\n{\n\tstruct Part" << part << "\n\t{\n\t\tVector4 value;\n\t\tfloat scale;\n\t};\n\n"
+				     << "\tfloat part" << part << "(float x)\n\t{\n\t\treturn x * " << p << ".5 + " << g << ".0;\n\t}\n}\n";
+				corpus.includes["includes/part" + part + ".lum"] = leaf.str();
+			}
+			group << "\nnamespace lib\n{\n\tfloat group" << g << "(float x)\n\t{\n\t\treturn 0.0";
+			for (std::size_t p = 0; p < kPartsPerGroup; ++p)
+			{
+				group << " + lib::part" << g << "_" << p << "(x)";
+			}
+			group << ";\n\t}\n}\n";
+			corpus.includes["includes/group" + std::to_string(g) + ".lum"] = group.str();
+			root << "#include \"group" << g << ".lum\"\n";
+		}
+
+		root << '\n' << kStageInterface << "DataBlock Parts\n{\n";
+		for (std::size_t g = 0; g < width; ++g)
+		{
+			root << "\tlib::Part" << g << "_0 part" << g << ";\n";
+		}
+		root << "};\n\nVertexPass()\n{\n\tfloat scale = 0.0";
+		for (std::size_t g = 0; g < width; ++g)
+		{
+			root << " + lib::group" << g << "(inPosition.x)";
+		}
+		root << ";\n\tworldPosition = inPosition * scale;\n\tpixelPosition = Vector4(worldPosition, 1.0);\n}\n\n"
+		     << "FragmentPass()\n{\n\tpixelColor = Parts.part0.value;\n}\n";
+		corpus.source = root.str();
+		return corpus;
+	}
+
+	std::vector<Corpus> makeCorpora(std::size_t scale)
+	{
+		std::vector<Corpus> corpora;
+		corpora.push_back(makeStructCorpus(512 * scale));
+		corpora.push_back(makeFunctionCorpus(512 * scale));
+		corpora.push_back(makeExpressionCorpus(256 * scale));
+		corpora.push_back(makeNestingCorpus(4 * scale));
+		corpora.push_back(makeArrayCorpus(2048 * scale));
+		corpora.push_back(makeIncludeCorpus(32 * scale));
+		return corpora;
+	}
+
+	struct StageSample
+	{
+		double wallSeconds = 0.0;
+		std::uint64_t allocations = 0;
+		std::uint64_t peakBytes = 0;
+	};
+
+	using IterationSamples = std::array<StageSample, kStages.size()>;
+
+	struct StageResult
+	{
+		std::string corpus;
+		std::string stage;
+		double bestMs = 0.0;
+		double medianMs = 0.0;
+		double megabytesPerSecond = 0.0;
+		std::uint64_t allocations = 0;
+		std::uint64_t peakBytes = 0;
+	};
+
+	// Runs the whole pipeline once, timing each stage on its own.
+	IterationSamples runIteration(const Corpus &corpus)
+	{
+		const IncludeReader reader = [&corpus](const std::filesystem::path &path) -> std::optional<std::string> {
+			const auto it = corpus.includes.find(path.generic_string());
+			return it == corpus.includes.end() ? std::nullopt : std::optional<std::string>(it->second);
+		};
+
+		PassTimingReport report;
+		{
+			PassTimingScope scope(report);
+
+			std::vector<Token> tokens;
+			{
+				PassTimer timer("Tokenizer");
+				tokens = Tokenizer()(corpus.origin, corpus.source);
+			}
+
+			PrecompilationParser precompilationParser({}, reader);
+			{
+				PassTimer timer("PrecompilationParser");
+				precompilationParser(tokens);
+			}
+
+			Parser parser;
+			std::vector<std::unique_ptr<Instruction>> instructions;
+			{
+				PassTimer timer("Parser");
+				instructions = parser(std::move(tokens));
+			}
+
+			SemanticParser semanticParser;
+			SemanticParseResult semantic;
+			{
+				PassTimer timer("SemanticParser");
+				semantic = semanticParser(std::move(instructions));
+			}
+
+			Compiler compiler;
+			ShaderArtifact artifact;
+			{
+				PassTimer timer("Compiler");
+				artifact = compiler.compile(semantic);
+			}
+		}
+
+		IterationSamples samples{};
+		std::optional<std::size_t> compilerIndex;
+		for (std::size_t index = 0; index < report.passes.size(); ++index)
+		{
+			const PassTiming &pass = report.passes[index];
+			if (pass.parent != PassTiming::kNoParent)
+			{
+				continue;
+			}
+			const auto stage = std::find(kStages.begin(), kStages.end(), pass.name);
+			StageSample &sample = samples[static_cast<std::size_t>(stage - kStages.begin())];
+			sample = StageSample{pass.wallSeconds, pass.allocations, pass.peakBytes};
+			if (pass.name == "Compiler")
+			{
+				compilerIndex = index;
+			}
+		}
+
+		// The Converter runs inside Compiler::compile; its passes are moved out of the Compiler's share.
+		StageSample &compilerSample = samples[4];
+		StageSample &converterSample = samples[5];
+		for (const PassTiming &pass : report.passes)
+		{
+			if (pass.parent != compilerIndex ||
+			    std::find(kConverterPasses.begin(), kConverterPasses.end(), pass.name) == kConverterPasses.end())
+			{
+				continue;
+			}
+			converterSample.wallSeconds += pass.wallSeconds;
+			converterSample.allocations += pass.allocations;
+			converterSample.peakBytes = std::max(converterSample.peakBytes, pass.peakBytes);
+			compilerSample.wallSeconds -= pass.wallSeconds;
+			compilerSample.allocations -= pass.allocations;
+		}
+		return samples;
+	}
+
+	std::vector<StageResult> benchmarkCorpus(const Corpus &corpus, std::size_t iterations)
+	{
+		// The warm-up run also checks that the generated shader compiles cleanly.
+		std::ostringstream log;
+		DiagnosticScope diagnostics(log);
+		resetErrorCount();
+		runIteration(corpus);
+		if (getErrorCount() != 0)
+		{
+			throw std::runtime_error("corpus '" + corpus.name + "' does not compile:\n" + log.str());
+		}
+
+		std::vector<IterationSamples> runs;
+		runs.reserve(iterations);
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			runs.push_back(runIteration(corpus));
+		}
+
+		std::vector<StageResult> results;
+		for (std::size_t stage = 0; stage < kStages.size(); ++stage)
+		{
+			std::vector<double> times;
+			times.reserve(runs.size());
+			for (const IterationSamples &run : runs)
+			{
+				times.push_back(run[stage].wallSeconds);
+			}
+			std::sort(times.begin(), times.end());
+
+			StageResult result;
+			result.corpus = corpus.name;
+			result.stage = kStages[stage];
+			result.bestMs = times.front() * 1000.0;
+			result.medianMs = times[times.size() / 2] * 1000.0;
+			result.megabytesPerSecond =
+			    times.front() > 0.0 ? static_cast<double>(corpus.bytes()) / (1024.0 * 1024.0) / times.front() : 0.0;
+			result.allocations = runs.back()[stage].allocations;
+			result.peakBytes = runs.back()[stage].peakBytes;
+			results.push_back(std::move(result));
+		}
+		return results;
+	}
+
+	void printResults(const std::vector<StageResult> &results, std::ostream &stream)
+	{
+		const std::ios::fmtflags flags = stream.flags();
+		stream << std::left << std::setw(13) << "Corpus" << std::setw(22) << "Stage" << std::right << std::setw(10)
+		       << "Best ms" << std::setw(11) << "Median ms" << std::setw(10) << "MiB/s" << std::setw(10) << "Allocs"
+		       << std::setw(11) << "Peak KiB" << '\n';
+		stream << std::fixed;
+		for (const StageResult &result : results)
+		{
+			stream << std::left << std::setw(13) << result.corpus << std::setw(22) << result.stage << std::right
+			       << std::setprecision(3) << std::setw(10) << result.bestMs << std::setw(11) << result.medianMs
+			       << std::setprecision(1) << std::setw(10) << result.megabytesPerSecond << std::setw(10)
+			       << result.allocations << std::setw(11) << static_cast<double>(result.peakBytes) / 1024.0 << '\n';
+		}
+		stream.flags(flags);
+	}
+
+	// One tab-separated line per corpus and stage: corpus, stage, best ms, median ms, allocations, peak bytes.
+	void writeResults(const std::vector<StageResult> &results, const std::filesystem::path &path)
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			throw std::runtime_error("cannot open output: " + path.string());
+		}
+		file << "# corpus\tstage\tbest_ms\tmedian_ms\tallocations\tpeak_bytes\n" << std::setprecision(6);
+		for (const StageResult &result : results)
+		{
+			file << result.corpus << '\t' << result.stage << '\t' << result.bestMs << '\t' << result.medianMs << '\t'
+			     << result.allocations << '\t' << result.peakBytes << '\n';
+		}
+	}
+
+	std::map<std::pair<std::string, std::string>, StageResult> readResults(const std::filesystem::path &path)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			throw std::runtime_error("cannot open baseline: " + path.string());
+		}
+
+		std::map<std::pair<std::string, std::string>, StageResult> results;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			std::istringstream fields(line);
+			StageResult result;
+			std::getline(fields, result.corpus, '\t');
+			std::getline(fields, result.stage, '\t');
+			if (!(fields >> result.bestMs >> result.medianMs >> result.allocations >> result.peakBytes))
+			{
+				throw std::runtime_error("malformed baseline line: " + line);
+			}
+			results[{result.corpus, result.stage}] = std::move(result);
+		}
+		return results;
+	}
+
+	// Prints the change against the baseline. A stage regresses when its best time grows by more than
+	// thresholdPercent or when it allocates more; returns whether any did.
+	bool compareResults(const std::vector<StageResult> &results,
+	    const std::map<std::pair<std::string, std::string>, StageResult> &baseline, double thresholdPercent,
+	    std::ostream &stream)
+	{
+		bool regressed = false;
+		const std::ios::fmtflags flags = stream.flags();
+		stream << '\n'
+		       << std::left << std::setw(13) << "Corpus" << std::setw(22) << "Stage" << std::right << std::setw(10)
+		       << "Time" << std::setw(12) << "Allocs" << '\n';
+		stream << std::fixed << std::setprecision(1);
+		for (const StageResult &result : results)
+		{
+			const auto it = baseline.find({result.corpus, result.stage});
+			if (it == baseline.end())
+			{
+				continue;
+			}
+			const StageResult &base = it->second;
+			const double timeChange = base.bestMs > 0.0 ? (result.bestMs / base.bestMs - 1.0) * 100.0 : 0.0;
+			const auto allocationChange =
+			    static_cast<std::int64_t>(result.allocations) - static_cast<std::int64_t>(base.allocations);
+			const bool stageRegressed = timeChange > thresholdPercent || allocationChange > 0;
+			regressed = regressed || stageRegressed;
+
+			stream << std::left << std::setw(13) << result.corpus << std::setw(22) << result.stage << std::right
+			       << std::setw(9) << std::showpos << timeChange << '%' << std::setw(12) << allocationChange
+			       << std::noshowpos << (stageRegressed ? "  REGRESSED" : "") << '\n';
+		}
+		stream.flags(flags);
+		return regressed;
+	}
+
+	void dumpCorpus(const Corpus &corpus, const std::filesystem::path &directory)
+	{
+		const auto write = [&](const std::filesystem::path &relative, const std::string &contents) {
+			const std::filesystem::path target = directory / relative;
+			std::filesystem::create_directories(target.parent_path());
+			std::ofstream file(target, std::ios::binary);
+			file << contents;
+			if (!file)
+			{
+				throw std::runtime_error("cannot write " + target.string());
+			}
+		};
+		write(corpus.origin, corpus.source);
+		for (const auto &[path, contents] : corpus.includes)
+		{
+			write(path, contents);
+		}
+	}
+
+	std::size_t parseCount(std::string_view option, std::string_view value)
+	{
+		if (value.empty() || value.find_first_not_of("0123456789") != std::string_view::npos ||
+		    std::stoul(std::string(value)) == 0)
+		{
+			throw std::invalid_argument("'" + std::string(option) + "' expects a positive number");
+		}
+		return std::stoul(std::string(value));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		std::size_t iterations = 10;
+		std::size_t scale = 1;
+		double thresholdPercent = 10.0;
+		std::optional<std::string> corpusFilter;
+		std::optional<std::filesystem::path> outputPath;
+		std::optional<std::filesystem::path> baselinePath;
+		std::optional<std::filesystem::path> dumpDirectory;
+		bool scaling = false;
+		ScalingOptions scalingOptions;
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view arg = argv[i];
+			if (arg == "--scaling")
+			{
+				scaling = true;
+				continue;
+			}
+			if (i + 1 >= argc)
+			{
+				std::cerr << "usage: lumina_bench [--iterations <n>] [--scale <n>] [--corpus <name>] "
+				             "[--output <results.tsv>]\n"
+				             "                    [--baseline <results.tsv>] [--threshold <percent>] [--dump <dir>]\n"
+				             "       lumina_bench --scaling [--scale <n>] [--dimension <name>] [--max-exponent <x>]\n";
+				return 2;
+			}
+			const std::string_view value = argv[++i];
+			if (arg == "--max-exponent")
+			{
+				scalingOptions.maxExponent = std::stod(std::string(value));
+			}
+			else if (arg == "--dimension")
+			{
+				scalingOptions.dimension = std::string(value);
+			}
+			else if (arg == "--iterations")
+			{
+				iterations = parseCount(arg, value);
+			}
+			else if (arg == "--scale")
+			{
+				scale = parseCount(arg, value);
+			}
+			else if (arg == "--threshold")
+			{
+				thresholdPercent = static_cast<double>(parseCount(arg, value));
+			}
+			else if (arg == "--corpus")
+			{
+				corpusFilter = std::string(value);
+			}
+			else if (arg == "--output" || arg == "--baseline" || arg == "--dump")
+			{
+				std::optional<std::filesystem::path> &target =
+				    arg == "--output" ? outputPath : (arg == "--baseline" ? baselinePath : dumpDirectory);
+				target = std::filesystem::path(value);
+			}
+			else
+			{
+				std::cerr << "unknown option '" << arg << "'\n";
+				return 2;
+			}
+		}
+
+		if (scaling)
+		{
+			scalingOptions.scale = scale;
+			return runScalingChecks(scalingOptions, std::cout);
+		}
+
+		std::vector<Corpus> corpora = makeCorpora(scale);
+		if (corpusFilter)
+		{
+			std::erase_if(corpora, [&](const Corpus &corpus) { return corpus.name != *corpusFilter; });
+			if (corpora.empty())
+			{
+				std::cerr << "unknown corpus '" << *corpusFilter << "'\n";
+				return 2;
+			}
+		}
+
+		if (dumpDirectory)
+		{
+			for (const Corpus &corpus : corpora)
+			{
+				dumpCorpus(corpus, *dumpDirectory);
+			}
+			std::cout << "Corpora written to " << dumpDirectory->string() << "\n";
+			return 0;
+		}
+
+#ifndef NDEBUG
+		std::cerr << "warning: lumina_bench was built without NDEBUG; use a Release build for meaningful numbers\n";
+#endif
+
+		std::vector<StageResult> results;
+		for (const Corpus &corpus : corpora)
+		{
+			std::cout << corpus.name << ": " << 1 + corpus.includes.size() << " files, " << corpus.bytes() << " bytes\n"
+			          << std::flush;
+			std::vector<StageResult> corpusResults = benchmarkCorpus(corpus, iterations);
+			results.insert(results.end(), corpusResults.begin(), corpusResults.end());
+		}
+		std::cout << '\n';
+		printResults(results, std::cout);
+
+		if (outputPath)
+		{
+			writeResults(results, *outputPath);
+		}
+		if (baselinePath && compareResults(results, readResults(*baselinePath), thresholdPercent, std::cout))
+		{
+			return 1;
+		}
+		return 0;
+	} catch (const std::exception &e)
+	{
+		std::cerr << "error: " << e.what() << "\n";
+		return 1;
+	}
+}
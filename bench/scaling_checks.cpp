@@ -0,0 +1,289 @@
+#include "scaling_checks.hpp"
+
+#include "pipeline.hpp"
+#include "precompilation_parser.hpp"
+#include "token.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr std::array<std::size_t, 4> kMultipliers = {1, 2, 4, 8};
+	constexpr std::size_t kRuns = 5;
+
+	constexpr std::string_view kStageInterface = "Input -> VertexPass: Vector3 inPosition;\n"
+	                                             "VertexPass -> FragmentPass: Vector3 worldPosition;\n"
+	                                             "FragmentPass -> Output: Vector4 pixelColor;\n\n";
+
+	constexpr std::string_view kFragmentStage = "FragmentPass()\n{\n\tpixelColor = Vector4(worldPosition, 1.0);\n}\n";
+
+	// Main file first, then the files it includes, by name relative to the main file.
+	using GeneratedShader = std::vector<std::pair<std::string, std::string>>;
+
+	std::string vertexStage(std::string_view scaleExpression)
+	{
+		return "VertexPass()\n{\n\tfloat scale = " + std::string(scaleExpression) +
+		       ";\n\tworldPosition = inPosition * scale;\n\tpixelPosition = Vector4(worldPosition, 1.0);\n}\n\n";
+	}
+
+	// Eight functions returning an expression nested `size` parentheses deep.
+	GeneratedShader nestingShader(std::size_t size)
+	{
+		constexpr std::size_t kFunctions = 8;
+		std::ostringstream out;
+		out << kStageInterface;
+		for (std::size_t f = 0; f < kFunctions; ++f)
+		{
+			out << "float nested" << f << "(float x)\n{\n\treturn " << std::string(size, '(') << 'x';
+			for (std::size_t level = 0; level < size; ++level)
+			{
+				out << (level % 2 == 0 ? " + 1.5)" : " * x)");
+			}
+			out << ";\n}\n\n";
+		}
+		std::string sum = "0.0";
+		for (std::size_t f = 0; f < kFunctions; ++f)
+		{
+			sum += " + nested" + std::to_string(f) + "(inPosition.x)";
+		}
+		out << vertexStage(sum) << kFragmentStage;
+		return {{"main.lum", out.str()}};
+	}
+
+	// `size` overloads of one function, told apart by their parameter struct, each called once.
+	GeneratedShader overloadShader(std::size_t size)
+	{
+		std::ostringstream out;
+		out << kStageInterface;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			out << "struct Tag" << i << "\n{\n\tfloat value;\n};\n\n"
+			    << "float pick(Tag" << i << " tag)\n{\n\treturn tag.value * " << i << ".5;\n}\n\n";
+		}
+		out << "float pickAll()\n{\n\tfloat total = 0.0;\n";
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			out << "\tTag" << i << " tag" << i << ";\n\ttotal += pick(tag" << i << ");\n";
+		}
+		out << "\treturn total;\n}\n\n" << vertexStage("pickAll()") << kFragmentStage;
+		return {{"main.lum", out.str()}};
+	}
+
+	// A chain of `size` files, each including the next one.
+	GeneratedShader includeShader(std::size_t size)
+	{
+		GeneratedShader files;
+		std::ostringstream main;
+		main << "#include \"level0.lum\"\n\n" << kStageInterface << vertexStage("level0(inPosition.x)") << kFragmentStage;
+		files.emplace_back("main.lum", main.str());
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			std::ostringstream level;
+			if (i + 1 < size)
+			{
+				level << "#include \"level" << i + 1 << ".lum\"\n\n";
+			}
+			level << "float level" << i << "(float x)\n{\n\treturn ";
+			level << (i + 1 < size ? "level" + std::to_string(i + 1) + "(x)" : std::string("x")) << " + " << i
+			      << ".5;\n}\n";
+			files.emplace_back("level" + std::to_string(i) + ".lum", level.str());
+		}
+		return files;
+	}
+
+	// A chain of `size` macros, each expanding to the previous one, used 32 times.
+	GeneratedShader macroShader(std::size_t size)
+	{
+		constexpr std::size_t kUses = 32;
+		std::ostringstream out;
+		out << "#define CHAIN0 1.5\n";
+		for (std::size_t i = 1; i < size; ++i)
+		{
+			out << "#define CHAIN" << i << " CHAIN" << i - 1 << "\n";
+		}
+		out << '\n' << kStageInterface;
+		std::string sum = "0.0";
+		for (std::size_t use = 0; use < kUses; ++use)
+		{
+			sum += " + CHAIN" + std::to_string(size - 1);
+		}
+		out << vertexStage(sum) << kFragmentStage;
+		return {{"main.lum", out.str()}};
+	}
+
+	// `size` functions that each return an undeclared identifier.
+	GeneratedShader errorShader(std::size_t size)
+	{
+		std::ostringstream out;
+		out << kStageInterface;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			out << "float broken" << i << "(float x)\n{\n\treturn x + undeclared" << i << ";\n}\n\n";
+		}
+		out << vertexStage("1.0") << kFragmentStage;
+		return {{"main.lum", out.str()}};
+	}
+
+	struct Dimension
+	{
+		const char *name;
+		std::size_t baseSize;
+		bool expectsErrors;
+		GeneratedShader (*generate)(std::size_t);
+	};
+
+	constexpr std::array<Dimension, 5> kDimensions = {{
+	    {"nesting", 64, false, nestingShader},
+	    {"overloads", 64, false, overloadShader},
+	    {"include-depth", 32, false, includeShader},
+	    {"macro-chain", 64, false, macroShader},
+	    {"errors", 64, true, errorShader},
+	}};
+
+	std::filesystem::path writeShader(const GeneratedShader &shader, const std::filesystem::path &directory)
+	{
+		std::filesystem::create_directories(directory);
+		for (const auto &[name, contents] : shader)
+		{
+			std::ofstream file(directory / name, std::ios::binary);
+			file << contents;
+			if (!file)
+			{
+				throw std::runtime_error("cannot write " + (directory / name).string());
+			}
+		}
+		return directory / shader.front().first;
+	}
+
+	// Compiles from disk like the command line does, so diagnostics quote their source lines as they would there.
+	double compileSeconds(const Dimension &dimension, const std::filesystem::path &path)
+	{
+		std::ostringstream log;
+		DiagnosticScope diagnostics(log);
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<Token> tokens = Tokenizer()(path);
+		PrecompilationParser()(tokens);
+		ShaderArtifact artifact;
+		const int status = compileTokens(std::move(tokens), CompileOptions{}, log, artifact);
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if ((status != 0) != dimension.expectsErrors)
+		{
+			throw std::runtime_error(std::string("scaling input for '") + dimension.name + "' " +
+			                         (dimension.expectsErrors ? "compiled without errors" : "failed:\n" + log.str()));
+		}
+		return seconds;
+	}
+
+	std::filesystem::path scratchDirectory()
+	{
+#if defined(_WIN32)
+		const int pid = _getpid();
+#else
+		const int pid = static_cast<int>(getpid());
+#endif
+		return std::filesystem::temp_directory_path() / ("lumina_scaling_" + std::to_string(pid));
+	}
+}
+
+int runScalingChecks(const ScalingOptions &p_options, std::ostream &p_out)
+{
+	const std::filesystem::path scratch = scratchDirectory();
+	struct ScratchCleanup
+	{
+		const std::filesystem::path &path;
+		~ScratchCleanup()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(path, error);
+		}
+	} cleanup{scratch};
+
+	bool anyDimension = false;
+	bool withinBounds = true;
+	const std::ios::fmtflags flags = p_out.flags();
+	p_out << std::left << std::setw(15) << "Dimension" << std::right;
+	for (const std::size_t multiplier : kMultipliers)
+	{
+		p_out << std::setw(11) << (std::to_string(multiplier) + "N ms");
+	}
+	p_out << std::setw(10) << "Exponent" << '\n' << std::fixed;
+
+	for (const Dimension &dimension : kDimensions)
+	{
+		if (p_options.dimension && *p_options.dimension != dimension.name)
+		{
+			continue;
+		}
+		anyDimension = true;
+
+		std::vector<double> times;
+		for (const std::size_t multiplier : kMultipliers)
+		{
+			const std::size_t size = dimension.baseSize * p_options.scale * multiplier;
+			const std::filesystem::path path =
+			    writeShader(dimension.generate(size), scratch / dimension.name / std::to_string(size));
+			double best = compileSeconds(dimension, path);
+			for (std::size_t run = 1; run < kRuns; ++run)
+			{
+				best = std::min(best, compileSeconds(dimension, path));
+			}
+			times.push_back(best);
+		}
+
+		// Growth as the exponent of a power law, 1 linear and 2 quadratic: the least-squares slope of log time
+		// against log size over every doubling, so one noisy measurement cannot decide the check alone.
+		double meanSize = 0.0;
+		double meanTime = 0.0;
+		for (std::size_t i = 0; i < times.size(); ++i)
+		{
+			meanSize += std::log2(static_cast<double>(kMultipliers[i])) / times.size();
+			meanTime += std::log2(times[i]) / times.size();
+		}
+		double covariance = 0.0;
+		double variance = 0.0;
+		for (std::size_t i = 0; i < times.size(); ++i)
+		{
+			const double size = std::log2(static_cast<double>(kMultipliers[i])) - meanSize;
+			covariance += size * (std::log2(times[i]) - meanTime);
+			variance += size * size;
+		}
+		const double exponent = covariance / variance;
+		const bool ok = exponent <= p_options.maxExponent;
+		withinBounds = withinBounds && ok;
+
+		p_out << std::left << std::setw(15) << dimension.name << std::right << std::setprecision(3);
+		for (const double seconds : times)
+		{
+			p_out << std::setw(11) << seconds * 1000.0;
+		}
+		p_out << std::setprecision(2) << std::setw(10) << exponent << (ok ? "" : "  TOO STEEP") << '\n';
+	}
+	p_out.flags(flags);
+
+	if (!anyDimension)
+	{
+		throw std::invalid_argument("unknown scaling dimension '" + *p_options.dimension + "'");
+	}
+	return withinBounds ? 0 : 1;
+}
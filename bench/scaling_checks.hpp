@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <optional>
+#include <string>
+
+struct ScalingOptions
+{
+	// Multiplies the base size of every dimension.
+	std::size_t scale = 1;
+	// Largest accepted growth exponent: from N to 8N, compile time may grow at most like size^maxExponent.
+	double maxExponent = 1.5;
+	std::optional<std::string> dimension;
+};
+
+// Compiles inputs of size N, 2N, 4N and 8N along each dimension (expression nesting, overload count, include
+// depth, macro chain length, error count) and reports how compile time grows. Returns 0 when every dimension
+// stays within the bound, 1 otherwise.
+int runScalingChecks(const ScalingOptions &p_options, std::ostream &p_out);
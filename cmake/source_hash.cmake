@@ -0,0 +1,18 @@
+# Writes OUTPUT, a header defining LUMINA_SOURCE_HASH as the SHA-256 of every compiler source under SOURCE_ROOT.
+# Run as a build step, so the compile cache keys change by themselves whenever the compiler does.
+file(GLOB_RECURSE LUMINA_HASHED_FILES
+    ${SOURCE_ROOT}/includes/*.hpp
+    ${SOURCE_ROOT}/includes/*.h
+    ${SOURCE_ROOT}/srcs/*.cpp
+)
+list(SORT LUMINA_HASHED_FILES)
+
+set(LUMINA_HASHED_CONTENT "")
+foreach(LUMINA_HASHED_FILE ${LUMINA_HASHED_FILES})
+    file(SHA256 ${LUMINA_HASHED_FILE} LUMINA_FILE_HASH)
+    file(RELATIVE_PATH LUMINA_FILE_NAME ${SOURCE_ROOT} ${LUMINA_HASHED_FILE})
+    string(APPEND LUMINA_HASHED_CONTENT "${LUMINA_FILE_NAME} ${LUMINA_FILE_HASH}\n")
+endforeach()
+string(SHA256 LUMINA_SOURCE_HASH "${LUMINA_HASHED_CONTENT}")
+
+file(WRITE ${OUTPUT} "#pragma once\n\n// Generated by cmake/source_hash.cmake.\n#define LUMINA_SOURCE_HASH \"${LUMINA_SOURCE_HASH}\"\n")
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "converter.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+struct BlockMember
+{
+	std::string name;
+	std::string kind = "Element";
+	// Lumina type of the member, or of one element for arrays.
+	std::string typeName;
+	int offset = 0;
+	int size = 0;
+	int elementSize = 0;
+	int elementCount = 0;
+	std::vector<BlockMember> members;
+	// Set on members the compiler added to a block: the Lumina expression the host computes them from.
+	std::string derivedExpression;
+};
+
+struct DynamicArrayLayout
+{
+	std::string name;
+	std::string typeName;
+	std::string sizeAttributeName;
+	int offset = 0;
+	int elementStride = 0;
+	int elementPadding = 0;
+	std::vector<BlockMember> members;
+};
+
+struct BlockDefinition
+{
+	std::string name;
+	std::string type;
+	int size = 0;
+	std::vector<BlockMember> members;
+	std::optional<DynamicArrayLayout> dynamicArray;
+};
+
+struct StructDefinition
+{
+	std::string name;
+	int size = 0;
+	int alignment = 1;
+	std::vector<BlockMember> members;
+};
+
+// Size of a struct or block before and after `--reorder-members`.
+struct MemberReorderReport
+{
+	std::string name;
+	int declaredSize = 0;
+	int reorderedSize = 0;
+};
+
+// Everything produced for one shader. The JSON document and the generated C++ header are views of it.
+struct ShaderArtifact
+{
+	std::string vertexSource;
+	std::string fragmentSource;
+	std::vector<StageIO> layouts;
+	// VertexPass -> FragmentPass values, at the locations and components both stages declare them.
+	std::vector<StageIO> varyings;
+	std::vector<StageIO> framebuffers;
+	std::vector<TextureBinding> textures;
+	std::vector<BlockDefinition> constants;
+	std::vector<BlockDefinition> attributes;
+	// Layout of every user struct, in declaration order.
+	std::vector<StructDefinition> structures;
+	// Every type laid out under `--reorder-members`. Reported to the user, not written to the artifact.
+	std::vector<MemberReorderReport> memberReorders;
+	// Every member `--hoist-uniform-expressions` added, also listed among the block members. Reported to the user.
+	std::vector<DerivedBlockField> derivedFields;
+	// Every varying `--move-to-vertex` added, also listed among the varyings. Reported to the user.
+	std::vector<MovedVarying> movedVaryings;
+};
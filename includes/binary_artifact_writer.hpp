@@ -0,0 +1,13 @@
+#pragma once
+
+#include "artifact.hpp"
+#include "output_sink.hpp"
+
+#include <string>
+
+// Serializes an artifact into the binary format read by lumina_artifact_reader.hpp.
+struct BinaryArtifactWriter
+{
+	void operator()(const ShaderArtifact &p_artifact, OutputSink &p_sink) const;
+	std::string operator()(const ShaderArtifact &p_artifact) const;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Appends generated source text to one growing buffer. Tracks the indentation level and writes it, as tabs, in
+// front of the first character of every non-empty line, so emitters never build intermediate strings.
+class CodeWriter
+{
+public:
+	CodeWriter &operator<<(std::string_view p_text);
+	CodeWriter &operator<<(char p_character);
+
+	template <typename TInteger,
+	    typename = std::enable_if_t<std::is_integral_v<TInteger> && !std::is_same_v<TInteger, bool>>>
+	CodeWriter &operator<<(TInteger p_value)
+	{
+		char digits[24];
+		const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), p_value);
+		return *this << std::string_view(digits, static_cast<std::size_t>(result.ptr - digits));
+	}
+
+	void indent()
+	{
+		++m_indent;
+	}
+	void dedent()
+	{
+		if (m_indent > 0)
+		{
+			--m_indent;
+		}
+	}
+
+	std::size_t size() const
+	{
+		return m_buffer.size();
+	}
+	std::string str() &&
+	{
+		return std::move(m_buffer);
+	}
+
+private:
+	std::string m_buffer;
+	int m_indent = 0;
+	bool m_lineStart = true;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "token.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Content-addressed store of finished outputs. Entries are keyed by the preprocessed token stream, the compiler
+// version and every option that changes the output, so a hit can skip parsing, semantic analysis and codegen.
+struct CompileCache
+{
+	// LUMINA_CACHE_DIR, or nothing when caching is disabled.
+	static std::optional<std::filesystem::path> directoryFromEnvironment();
+
+	static std::string computeKey(const std::vector<Token> &p_tokens, std::string_view p_configuration);
+
+	explicit CompileCache(std::filesystem::path p_directory);
+
+	// Copies the cached entry to p_destination; false on a miss.
+	bool restore(const std::string &p_key, std::string_view p_kind, const std::filesystem::path &p_destination) const;
+	// Best effort: a cache that cannot be written never fails the compilation.
+	void store(const std::string &p_key, std::string_view p_kind, const std::filesystem::path &p_source) const;
+
+	// In-memory variants, for callers that hand outputs back without writing them to disk.
+	std::optional<std::string> loadContent(const std::string &p_key, std::string_view p_kind) const;
+	void storeContent(const std::string &p_key, std::string_view p_kind, std::string_view p_content) const;
+
+private:
+	std::filesystem::path entryPath(const std::string &p_key, std::string_view p_kind) const;
+	template <typename WriteTemporary>
+	void commit(const std::string &p_key, std::string_view p_kind, WriteTemporary &&p_writeTemporary) const;
+
+	std::filesystem::path m_directory;
+};
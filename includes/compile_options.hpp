@@ -0,0 +1,28 @@
+#pragma once
+
+// Options of one compilation, shared by the command line, the in-memory API, the Compiler and the Converter.
+struct CompileOptions
+{
+	// Prints the tokens, the syntax tree, the generated sources and each optimization report.
+	bool debug = false;
+	// Reorders struct and DataBlock fields to minimize padding. Declaration order is kept when it is already optimal.
+	bool reorderMembers = false;
+	// Lowers free functions and stage entry points to the IR, runs its passes and emits GLSL from it.
+	bool useIr = false;
+	// Evaluates a chain of matrix products ending in a vector right to left, as matrix-vector products.
+	bool reassociateMatrices = true;
+	// Moves stage subexpressions that only read fields of one UBO DataBlock into derived members of that block.
+	bool hoistUniformExpressions = false;
+	// Computes fragment expressions affine in the smooth varyings per vertex, and interpolates them as new varyings.
+	bool moveAffineToVertex = false;
+	// The fragment stage reads TriangleID from a flat varying the vertex stage computes as gl_VertexID / 3, instead
+	// of from gl_PrimitiveID. Only right for non-indexed draws starting at vertex 0.
+	bool triangleIndexFromVertex = false;
+	// Shares vec4 locations between varyings of the same scalar type and interpolation, through component
+	// qualifiers.
+	bool packVaryings = false;
+	// Writes the artifact in the binary format instead of JSON.
+	bool binaryOutput = false;
+	// Consult LUMINA_CACHE_DIR when it is set. Debug runs never do.
+	bool useCompileCache = true;
+};
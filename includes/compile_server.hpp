@@ -0,0 +1,28 @@
+#pragma once
+
+#include "pipeline.hpp"
+
+#include <filesystem>
+#include <iosfwd>
+
+// Long-running compiler for editors and build systems. Requests share the process-wide source, include and
+// compile caches, so a shader whose inputs did not change costs a cache lookup instead of a cold start.
+//
+// Request:  one header line, `compile <input>`, `compile-source <origin> <byteCount>` followed by exactly
+//           byteCount bytes of source, or `quit`. Fields may be double-quoted.
+// Response: a header line `<status> <artifactBytes> <diagnosticBytes>`, then the artifact, then the diagnostics.
+//           Status is 0 on success and otherwise uses the command-line exit codes.
+struct CompileServer
+{
+	explicit CompileServer(CompileOptions p_options);
+
+	// Answers requests until the input ends or a `quit` request; returns true in the latter case.
+	bool serve(std::istream &p_input, std::ostream &p_output) const;
+
+	// POSIX only. Serves every client of a Unix domain socket on its own thread until one of them sends `quit`.
+	// Returns the process exit code.
+	int listen(const std::filesystem::path &p_socketPath) const;
+
+private:
+	CompileOptions m_options;
+};
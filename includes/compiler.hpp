@@ -1,5 +1,8 @@
 #pragma once
 
+#include "artifact.hpp"
+#include "compile_options.hpp"
+#include "output_sink.hpp"
 #include "semantic_parser.hpp"
 
 #include <memory>
@@ -8,10 +11,14 @@
 
 struct Compiler
 {
-	explicit Compiler(bool enableDebugOutput = false);
+	explicit Compiler(CompileOptions p_options = {});
 
+	ShaderArtifact compile(const SemanticParseResult &result) const;
 	std::string operator()(const SemanticParseResult &result) const;
 
+	static std::string emitJson(const ShaderArtifact &artifact);
+	static void emitJson(const ShaderArtifact &artifact, OutputSink &sink);
+
 private:
-	bool debugEnabled = false;
+	CompileOptions options;
 };
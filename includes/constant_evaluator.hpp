@@ -0,0 +1,66 @@
+#pragma once
+
+// Compile-time evaluation of GLSL scalar, vector and matrix expressions. Every function follows the GLSL 4.50 rules
+// for its operation, including implicit int to uint to float conversions, and returns nothing when the operation is
+// ill-typed or its result is undefined or not representable (division by zero, out-of-range shifts, domain errors),
+// so a caller only ever replaces an expression by a value the GPU would have computed.
+
+#include "ast.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+struct ConstantValue
+{
+	enum class Scalar
+	{
+		Bool,
+		Int,
+		UInt,
+		Float
+	};
+
+	enum class Shape
+	{
+		Scalar,
+		Vector,
+		Matrix
+	};
+
+	Scalar scalar = Scalar::Float;
+	Shape shape = Shape::Scalar;
+	// Components of a vector; columns of a matrix.
+	int columns = 1;
+	// Rows of a matrix, 1 otherwise.
+	int rows = 1;
+	// Column-major. Floats are held rounded to single precision, integers and booleans exactly.
+	std::vector<double> components;
+
+	static ConstantValue makeScalar(Scalar p_scalar, double p_value);
+
+	// GLSL type name: "float", "ivec3", "mat4", "mat2x3".
+	std::string glslType() const;
+	// Shortest GLSL expression producing the value, or nothing when GLSL has no literal for it (infinities, NaN,
+	// the most negative int).
+	std::optional<std::string> glsl() const;
+	// The same expression in Lumina syntax, with p_typeName ("Vector3", "Color", "Matrix4x4") as the constructor.
+	std::optional<std::string> lumina(const std::string &p_typeName) const;
+
+	bool operator==(const ConstantValue &p_other) const = default;
+};
+
+// Integer, float and boolean literals as written in Lumina ("3", "0x1F", "2.5f", "true").
+std::optional<ConstantValue> parseConstantLiteral(const std::string &p_text);
+
+std::optional<ConstantValue> foldUnary(UnaryOperator p_operator, const ConstantValue &p_operand);
+std::optional<ConstantValue> foldBinary(
+    BinaryOperator p_operator, const ConstantValue &p_left, const ConstantValue &p_right);
+// Constructor or conversion to the GLSL type p_type ("vec3", "int", "mat4").
+std::optional<ConstantValue> foldConstruct(const std::string &p_type, const std::vector<ConstantValue> &p_arguments);
+// GLSL builtin function call ("sin", "dot", "normalize", ...).
+std::optional<ConstantValue> foldBuiltin(const std::string &p_name, const std::vector<ConstantValue> &p_arguments);
+// Swizzle of a scalar or vector (".x", ".zyx", ".rgb").
+std::optional<ConstantValue> foldSwizzle(const ConstantValue &p_value, const std::string &p_swizzle);
+// Component of a vector or column of a matrix.
+std::optional<ConstantValue> foldIndex(const ConstantValue &p_value, const ConstantValue &p_index);
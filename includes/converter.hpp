@@ -1,13 +1,17 @@
 #pragma once
 
+#include "compile_options.hpp"
 #include "semantic_parser.hpp"
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 struct StageIO
 {
 	int location = 0;
+	// First component the value takes in its location, when it shares the location with others.
+	int component = 0;
 	std::string type;
 	std::string name;
 	bool flat = false;
@@ -22,6 +26,28 @@ struct TextureBinding
 	TextureBindingScope scope = TextureBindingScope::Constant;
 };
 
+// DataBlock member the converter adds to hold an expression computed only from fields of that block. The host
+// evaluates the expression whenever it updates the block, instead of every vertex or fragment computing it.
+struct DerivedBlockField
+{
+	// Qualified name of the block.
+	std::string block;
+	std::string name;
+	// Lumina type of the member.
+	std::string typeName;
+	// Lumina expression, naming block fields as "<block>.<field>".
+	std::string expression;
+};
+
+// Varying the converter adds to carry a fragment expression that is affine in the other varyings. The vertex stage
+// computes it, and interpolation gives every fragment the value it would have computed itself.
+struct MovedVarying
+{
+	StageIO varying;
+	// Lumina expression the fragment stage no longer computes.
+	std::string expression;
+};
+
 struct ConverterInput
 {
 	const SemanticParseResult &semantic;
@@ -29,12 +55,23 @@ struct ConverterInput
 	std::vector<StageIO> stageVaryings;
 	std::vector<StageIO> fragmentOutputs;
 	std::vector<TextureBinding> textures;
+	// Field order to emit, by qualified aggregate name. Aggregates without an entry keep declaration order.
+	std::unordered_map<std::string, std::vector<std::string>> memberOrders;
+	CompileOptions options;
 };
 
 struct ShaderSources
 {
 	std::string vertex;
 	std::string fragment;
+	std::string vertexIr;
+	std::string fragmentIr;
+	// Members to append to their blocks, in the order the GLSL declares them.
+	std::vector<DerivedBlockField> derivedFields;
+	// Varyings added after the live stageVaryings, in location order.
+	std::vector<MovedVarying> movedVaryings;
+	// Varyings the two stages declare, in location and component order.
+	std::vector<StageIO> varyings;
 };
 
 struct Converter
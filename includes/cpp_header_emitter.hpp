@@ -0,0 +1,21 @@
+#pragma once
+
+#include "artifact.hpp"
+
+#include <filesystem>
+#include <string>
+
+// Writes a C++17 header that mirrors every struct and DataBlock of an artifact with explicit padding, so host
+// code can fill mapped buffers directly. Each offset and size is checked with a static_assert.
+struct CppHeaderEmitter
+{
+	explicit CppHeaderEmitter(std::string p_namespaceName);
+
+	std::string operator()(const ShaderArtifact &p_artifact) const;
+
+	// "lumina::<stem>" for the given shader source.
+	static std::string namespaceFor(const std::filesystem::path &p_source);
+
+private:
+	std::string m_namespaceName;
+};
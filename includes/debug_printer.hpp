@@ -0,0 +1,11 @@
+#pragma once
+
+#include "ast.hpp"
+#include "token.hpp"
+
+#include <memory>
+#include <vector>
+
+// Human-readable dumps written to std::cout by `--debug`.
+void printTokens(const std::vector<Token> &p_tokens);
+void printInstructions(const std::vector<std::unique_ptr<Instruction>> &p_instructions);
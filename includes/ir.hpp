@@ -0,0 +1,273 @@
+#pragma once
+
+// Mid-level intermediate representation the converter can generate GLSL from. Values are in SSA form: every
+// instruction producing a value defines it exactly once, and operands always refer to instructions that come
+// before them in the same block or in an enclosing one. Variables live in memory and are only reached through
+// explicit Address, Load and Store instructions. Control flow stays structured: If, Loop and Scope instructions
+// own the blocks they run, so the IR maps back onto GLSL statements without reconstructing loops.
+
+#include "ast.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class IrScalar
+{
+	None,
+	Bool,
+	Int,
+	UInt,
+	Float
+};
+
+// Types are interned by their module: two values have the same type exactly when their IrType pointers are equal.
+struct IrType
+{
+	enum class Kind
+	{
+		Void,
+		Scalar,
+		Vector,
+		Matrix,
+		Aggregate,
+		Texture
+	};
+
+	Kind kind = Kind::Aggregate;
+	IrScalar scalar = IrScalar::None;
+	// Components of a vector; columns and rows of a matrix.
+	int columns = 1;
+	int rows = 1;
+	// GLSL spelling, without the array suffix.
+	std::string glsl;
+	bool isArray = false;
+	std::optional<std::size_t> arraySize;
+
+	bool isVoid() const
+	{
+		return kind == Kind::Void;
+	}
+	// GLSL spelling with the array suffix, as used in constructors ("float[3]").
+	std::string spelling() const;
+};
+
+class IrTypeTable
+{
+public:
+	const IrType *get(const std::string &p_glsl, bool p_isArray = false, std::optional<std::size_t> p_arraySize = {});
+
+private:
+	std::unordered_map<std::string, std::unique_ptr<IrType>> m_types;
+};
+
+struct IrVariable
+{
+	enum class Storage
+	{
+		Local,
+		Parameter,
+		Input,
+		Output,
+		Global,
+		Block,
+		Texture
+	};
+
+	Storage storage = Storage::Local;
+	// GLSL name.
+	std::string name;
+	const IrType *type = nullptr;
+	// Nothing in the shader can write it, so reading it never conflicts with a store or a call.
+	bool readOnly = false;
+	// inout and const parameters.
+	bool isReference = false;
+	bool isConst = false;
+};
+
+enum class IrOpcode
+{
+	// Values without memory effects.
+	Constant,
+	Address,
+	Unary,
+	Binary,
+	Select,
+	Construct,
+	Extract,
+	CallBuiltin,
+	// Memory.
+	Load,
+	Store,
+	Declare,
+	Increment,
+	Call,
+	// GLSL text the IR does not model, written as is. May read and write anything.
+	Opaque,
+	// Structured control flow.
+	Scope,
+	If,
+	Loop,
+	BreakUnless,
+	Return,
+	Break,
+	Continue,
+	Discard
+};
+
+// One step of an Address or Extract: a member or swizzle, or an index taken from the next operand.
+struct IrAccess
+{
+	std::string member;
+	bool isIndex = false;
+};
+
+struct IrBlock;
+
+struct IrInstruction
+{
+	IrOpcode opcode = IrOpcode::Opaque;
+	// Void for instructions that produce no value.
+	const IrType *type = nullptr;
+	std::vector<IrInstruction *> operands;
+	// Constant literal, callee of Construct, CallBuiltin and Call, or Opaque GLSL.
+	std::string text;
+	// Root of an Address; variable of a Declare.
+	IrVariable *variable = nullptr;
+	std::vector<IrAccess> accesses;
+	BinaryOperator binaryOperator = BinaryOperator::Add;
+	UnaryOperator unaryOperator = UnaryOperator::Negate;
+	// Increment: x++ or x-- rather than ++x or --x, and -- rather than ++.
+	bool isPostfix = false;
+	bool isDecrement = false;
+	// Loop whose header runs after the body (do-while).
+	bool isPostTest = false;
+	// Scope: body. If: then, else. Loop: header, body, continue.
+	std::vector<std::unique_ptr<IrBlock>> blocks;
+
+	bool producesValue() const
+	{
+		return type && !type->isVoid();
+	}
+};
+
+struct IrBlock
+{
+	std::vector<std::unique_ptr<IrInstruction>> instructions;
+};
+
+struct IrFunction
+{
+	std::string name;
+	const IrType *returnType = nullptr;
+	std::vector<IrVariable *> parameters;
+	// Parameters and locals.
+	std::vector<std::unique_ptr<IrVariable>> variables;
+	IrBlock body;
+};
+
+struct IrModule
+{
+	IrTypeTable types;
+	std::vector<std::unique_ptr<IrVariable>> globals;
+	std::unordered_map<std::string, IrVariable *> globalLookup;
+	std::vector<std::unique_ptr<IrFunction>> functions;
+
+	// The module-level variable with this GLSL name, created on first use.
+	IrVariable *global(const std::string &p_name, IrVariable::Storage p_storage, const IrType *p_type, bool p_readOnly);
+};
+
+// Appends instructions to one block at a time.
+class IrBuilder
+{
+public:
+	IrBuilder(IrModule &p_module, IrBlock &p_block) : m_module(p_module), m_block(&p_block) {}
+
+	IrModule &module() const
+	{
+		return m_module;
+	}
+	IrBlock &block() const
+	{
+		return *m_block;
+	}
+	void setBlock(IrBlock &p_block)
+	{
+		m_block = &p_block;
+	}
+
+	IrInstruction *append(IrOpcode p_opcode, const IrType *p_type, std::vector<IrInstruction *> p_operands = {});
+	IrInstruction *constant(const IrType *p_type, std::string p_text);
+	// Typed as the value it points at.
+	IrInstruction *address(IrVariable &p_variable, const IrType *p_type, std::vector<IrAccess> p_accesses = {},
+	    std::vector<IrInstruction *> p_indices = {});
+	IrInstruction *load(IrInstruction *p_address);
+	void store(IrInstruction *p_address, IrInstruction *p_value);
+	IrInstruction *binary(BinaryOperator p_operator, const IrType *p_type, IrInstruction *p_left, IrInstruction *p_right);
+	// Appends a control flow instruction with p_blockCount empty blocks.
+	IrInstruction *structured(IrOpcode p_opcode, std::size_t p_blockCount, std::vector<IrInstruction *> p_operands = {});
+
+	const IrType *voidType() const
+	{
+		return m_module.types.get("void");
+	}
+
+private:
+	IrModule &m_module;
+	IrBlock *m_block;
+};
+
+// Variables an instruction may read or write. Reads of read-only variables are left out, since nothing can write
+// them.
+struct IrMemoryEffects
+{
+	bool readsAnything = false;
+	bool writesAnything = false;
+	// Any module-level variable: what a call may touch besides the places passed to it.
+	bool readsGlobals = false;
+	bool writesGlobals = false;
+	// May leave the enclosing block (return, break, continue, discard).
+	bool exits = false;
+	std::vector<const IrVariable *> reads;
+	std::vector<const IrVariable *> writes;
+
+	bool empty() const
+	{
+		return !readsAnything && !writesAnything && !readsGlobals && !writesGlobals && !exits && reads.empty() &&
+		       writes.empty();
+	}
+	bool hasWrites() const
+	{
+		return writesAnything || writesGlobals || !writes.empty();
+	}
+	void merge(const IrMemoryEffects &p_other);
+	// Whether running the two in the other order could change what either observes.
+	bool conflictsWith(const IrMemoryEffects &p_other) const;
+};
+
+// Effects of the instruction itself, or of everything it runs for structured control flow.
+IrMemoryEffects irMemoryEffects(const IrInstruction &p_instruction);
+// Whether the instruction can be dropped when its value is unused.
+bool irIsRemovable(const IrInstruction &p_instruction);
+// Return, Break, Continue and Discard: nothing after them in their block runs.
+bool irIsTerminator(const IrInstruction &p_instruction);
+
+void irForEachInstruction(IrBlock &p_block, const std::function<void(IrInstruction &)> &p_visitor);
+void irForEachInstruction(const IrBlock &p_block, const std::function<void(const IrInstruction &)> &p_visitor);
+std::unordered_map<const IrInstruction *, std::size_t> irUseCounts(const IrFunction &p_function);
+void irReplaceAllUses(IrFunction &p_function, const IrInstruction *p_from, IrInstruction *p_to);
+
+const char *irBinarySymbol(BinaryOperator p_operator);
+const char *irUnarySymbol(UnaryOperator p_operator);
+// The value written as a single GLSL expression, every operand inlined, for reports.
+std::string irExpressionText(const IrInstruction &p_value);
+
+// Readable dump, one instruction per line, for `--debug`.
+void printIr(const IrModule &p_module, std::ostream &p_stream);
+// Throws std::runtime_error naming the first broken rule when the module is not well-formed.
+void verifyIr(const IrModule &p_module);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "code_writer.hpp"
+#include "ir.hpp"
+
+// Writes one IR function as GLSL. A value used once is written inside the expression that uses it whenever moving
+// it there cannot change what anything computes; other values are held in temporaries.
+void emitIrFunction(const IrFunction &p_function, CodeWriter &p_out);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Rewrites one function in place, appends a line per change worth reporting to the remarks, and returns whether it
+// changed anything.
+using IrFunctionPass = std::function<bool(IrFunction &, std::vector<std::string> &)>;
+
+// Runs function passes, in the order they were added, over every function of a module. Each pass is timed under its
+// own name, and the module is verified after every pass that changed it so a broken rewrite is reported where it
+// happened.
+class IrPassManager
+{
+public:
+	void add(const char *p_name, IrFunctionPass p_pass);
+	// Returns the remarks of every pass, each as "pass: function: remark".
+	std::vector<std::string> run(IrModule &p_module) const;
+
+private:
+	struct Entry
+	{
+		const char *name;
+		IrFunctionPass pass;
+	};
+
+	std::vector<Entry> m_passes;
+};
+
+// Replaces a value by an identical one computed earlier on every path to it: arithmetic, swizzles, constructors,
+// builtin calls and loads, the latter only while no store, increment, call or opaque code in between may have written
+// what they read. Values cheaper to recompute than to hold (constants, addresses, whole-variable loads, and any read
+// of a DataBlock, uniform or input) are left in place. The replaced values lose their uses, for dead code elimination to remove.
+struct IrCommonSubexpressionElimination
+{
+	bool operator()(IrFunction &p_function, std::vector<std::string> &p_remarks) const;
+};
+
+// Removes values nothing uses and that have no side effects, instructions after a return, break, continue or
+// discard, and locals that are only ever written.
+struct IrDeadCodeElimination
+{
+	bool operator()(IrFunction &p_function, std::vector<std::string> &p_remarks) const;
+};
+
+// The passes `--ir` runs.
+IrPassManager defaultIrPipeline();
@@ -0,0 +1,418 @@
+#pragma once
+
+// Header-only reader for the binary artifact written by `Lumina --format binary`.
+// The file is read in place: every accessor returns views into the mapped bytes, nothing is parsed or allocated.
+// Only needs C++17 and is meant to be copied into engine code as-is.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lumina
+{
+	namespace artifact
+	{
+		// File layout. All integers are little-endian uint32, all tables are 4-byte aligned.
+		inline constexpr char kMagic[4] = {'L', 'M', 'N', 'A'};
+		inline constexpr std::uint32_t kVersion = 3;
+
+		// Byte range inside the string pool.
+		struct StringRef
+		{
+			std::uint32_t offset;
+			std::uint32_t length;
+		};
+
+		// Byte offset of a table from the start of the file, and its element count.
+		struct TableRef
+		{
+			std::uint32_t offset;
+			std::uint32_t count;
+		};
+
+		// Contiguous run of records inside the member table.
+		struct IndexRange
+		{
+			std::uint32_t first;
+			std::uint32_t count;
+		};
+
+		enum StageIOFlags : std::uint32_t
+		{
+			StageIOFlat = 1u << 0
+		};
+
+		enum class TextureScope : std::uint32_t
+		{
+			Constant = 0,
+			Attribute = 1
+		};
+
+		enum class BlockKind : std::uint32_t
+		{
+			UBO = 0,
+			SSBO = 1
+		};
+
+		enum class MemberKind : std::uint32_t
+		{
+			Element = 0,
+			Array = 1
+		};
+
+		struct FileHeader
+		{
+			char magic[4];
+			std::uint32_t version;
+			std::uint32_t fileSize;
+			std::uint32_t reserved;
+			TableRef strings;
+			StringRef vertexSource;
+			StringRef fragmentSource;
+			TableRef layouts;
+			TableRef varyings;
+			TableRef framebuffers;
+			TableRef textures;
+			TableRef constants;
+			TableRef attributes;
+			TableRef members;
+		};
+
+		struct StageIORecord
+		{
+			std::uint32_t location;
+			// Nonzero for varyings packed into a location they share with others.
+			std::uint32_t component;
+			std::uint32_t flags;
+			StringRef type;
+			StringRef name;
+		};
+
+		struct TextureRecord
+		{
+			std::uint32_t location;
+			TextureScope scope;
+			StringRef luminaName;
+			StringRef glslName;
+			StringRef type;
+		};
+
+		struct MemberRecord
+		{
+			StringRef name;
+			StringRef typeName;
+			MemberKind kind;
+			std::uint32_t offset;
+			std::uint32_t size;
+			std::uint32_t elementSize;
+			std::uint32_t elementCount;
+			IndexRange members;
+			// Empty unless the compiler added the member: the Lumina expression the host computes it from.
+			StringRef derivedExpression;
+		};
+
+		struct DynamicArrayRecord
+		{
+			StringRef name;
+			StringRef typeName;
+			StringRef sizeAttributeName;
+			std::uint32_t offset;
+			std::uint32_t elementStride;
+			std::uint32_t elementPadding;
+			IndexRange members;
+		};
+
+		struct BlockRecord
+		{
+			StringRef name;
+			BlockKind kind;
+			std::uint32_t size;
+			IndexRange members;
+			std::uint32_t hasDynamicArray;
+			DynamicArrayRecord dynamicArray;
+		};
+
+		static_assert(sizeof(FileHeader) == 96, "FileHeader must not contain padding");
+		static_assert(sizeof(StageIORecord) == 28, "StageIORecord must not contain padding");
+		static_assert(sizeof(TextureRecord) == 32, "TextureRecord must not contain padding");
+		static_assert(sizeof(MemberRecord) == 52, "MemberRecord must not contain padding");
+		static_assert(sizeof(DynamicArrayRecord) == 44, "DynamicArrayRecord must not contain padding");
+		static_assert(sizeof(BlockRecord) == 72, "BlockRecord must not contain padding");
+	}
+
+	template <typename T>
+	class RecordRange
+	{
+	public:
+		RecordRange() = default;
+		RecordRange(const T *data, std::size_t count) : m_data(data), m_count(count) {}
+
+		const T *begin() const { return m_data; }
+		const T *end() const { return m_data + m_count; }
+		std::size_t size() const { return m_count; }
+		bool empty() const { return m_count == 0; }
+		const T &operator[](std::size_t index) const { return m_data[index]; }
+
+	private:
+		const T *m_data = nullptr;
+		std::size_t m_count = 0;
+	};
+
+	// Non-owning view over artifact bytes. The bytes must stay alive and 4-byte aligned while the view is used.
+	class ArtifactView
+	{
+	public:
+		ArtifactView() = default;
+
+		// Validates the header and every table bound once; accessors do not re-check them.
+		bool open(const void *data, std::size_t size)
+		{
+			*this = ArtifactView();
+			if (!data || size < sizeof(artifact::FileHeader) || reinterpret_cast<std::uintptr_t>(data) % 4 != 0)
+			{
+				return false;
+			}
+
+			const auto *header = static_cast<const artifact::FileHeader *>(data);
+			if (std::memcmp(header->magic, artifact::kMagic, sizeof(artifact::kMagic)) != 0 ||
+			    header->version != artifact::kVersion || header->fileSize != size)
+			{
+				return false;
+			}
+
+			m_bytes = static_cast<const unsigned char *>(data);
+			m_size = size;
+			m_header = header;
+
+			const bool tablesFit = fits(header->strings, 1) && fits(header->layouts, sizeof(artifact::StageIORecord)) &&
+			                       fits(header->varyings, sizeof(artifact::StageIORecord)) &&
+			                       fits(header->framebuffers, sizeof(artifact::StageIORecord)) &&
+			                       fits(header->textures, sizeof(artifact::TextureRecord)) &&
+			                       fits(header->constants, sizeof(artifact::BlockRecord)) &&
+			                       fits(header->attributes, sizeof(artifact::BlockRecord)) &&
+			                       fits(header->members, sizeof(artifact::MemberRecord));
+			if (!tablesFit || !rangesFit(constants()) || !rangesFit(attributes()) || !rangesFit(allMembers()))
+			{
+				*this = ArtifactView();
+				return false;
+			}
+			return true;
+		}
+
+		bool valid() const { return m_header != nullptr; }
+		std::uint32_t version() const { return m_header->version; }
+
+		// Out-of-range references resolve to an empty string.
+		std::string_view string(artifact::StringRef ref) const
+		{
+			const artifact::TableRef &pool = m_header->strings;
+			if (ref.offset > pool.count || ref.length > pool.count - ref.offset)
+			{
+				return {};
+			}
+			return std::string_view(reinterpret_cast<const char *>(m_bytes + pool.offset + ref.offset), ref.length);
+		}
+
+		std::string_view vertexSource() const { return string(m_header->vertexSource); }
+		std::string_view fragmentSource() const { return string(m_header->fragmentSource); }
+
+		RecordRange<artifact::StageIORecord> layouts() const { return table<artifact::StageIORecord>(m_header->layouts); }
+		RecordRange<artifact::StageIORecord> varyings() const { return table<artifact::StageIORecord>(m_header->varyings); }
+		RecordRange<artifact::StageIORecord> framebuffers() const
+		{
+			return table<artifact::StageIORecord>(m_header->framebuffers);
+		}
+		RecordRange<artifact::TextureRecord> textures() const { return table<artifact::TextureRecord>(m_header->textures); }
+		RecordRange<artifact::BlockRecord> constants() const { return table<artifact::BlockRecord>(m_header->constants); }
+		RecordRange<artifact::BlockRecord> attributes() const { return table<artifact::BlockRecord>(m_header->attributes); }
+
+		RecordRange<artifact::MemberRecord> members(artifact::IndexRange range) const
+		{
+			return RecordRange<artifact::MemberRecord>(allMembers().begin() + range.first, range.count);
+		}
+		RecordRange<artifact::MemberRecord> members(const artifact::BlockRecord &block) const
+		{
+			return members(block.members);
+		}
+		RecordRange<artifact::MemberRecord> members(const artifact::MemberRecord &member) const
+		{
+			return members(member.members);
+		}
+
+	private:
+		const unsigned char *m_bytes = nullptr;
+		std::size_t m_size = 0;
+		const artifact::FileHeader *m_header = nullptr;
+
+		bool fits(const artifact::TableRef &ref, std::size_t recordSize) const
+		{
+			if (ref.offset % 4 != 0 || ref.offset > m_size)
+			{
+				return false;
+			}
+			return ref.count <= (m_size - ref.offset) / recordSize;
+		}
+
+		bool rangeFits(const artifact::IndexRange &range) const
+		{
+			const std::uint32_t total = m_header->members.count;
+			return range.first <= total && range.count <= total - range.first;
+		}
+
+		template <typename Records>
+		bool rangesFit(const Records &records) const
+		{
+			for (const auto &record : records)
+			{
+				if (!rangeFits(record.members))
+				{
+					return false;
+				}
+				if constexpr (std::is_same_v<std::decay_t<decltype(record)>, artifact::BlockRecord>)
+				{
+					if (record.hasDynamicArray && !rangeFits(record.dynamicArray.members))
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		RecordRange<artifact::MemberRecord> allMembers() const { return table<artifact::MemberRecord>(m_header->members); }
+
+		template <typename T>
+		RecordRange<T> table(const artifact::TableRef &ref) const
+		{
+			return RecordRange<T>(reinterpret_cast<const T *>(m_bytes + ref.offset), ref.count);
+		}
+	};
+
+	// Read-only memory mapping of an artifact file.
+	class MappedArtifact
+	{
+	public:
+		MappedArtifact() = default;
+		MappedArtifact(const MappedArtifact &) = delete;
+		MappedArtifact &operator=(const MappedArtifact &) = delete;
+
+		MappedArtifact(MappedArtifact &&other) noexcept { swap(other); }
+		MappedArtifact &operator=(MappedArtifact &&other) noexcept
+		{
+			if (this != &other)
+			{
+				close();
+				swap(other);
+			}
+			return *this;
+		}
+
+		~MappedArtifact() { close(); }
+
+		bool open(const char *path)
+		{
+			close();
+#if defined(_WIN32)
+			HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				CloseHandle(file);
+				return false;
+			}
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (!mapping)
+			{
+				return false;
+			}
+			void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (!data)
+			{
+				return false;
+			}
+			m_data = data;
+			m_size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+			const int fd = ::open(path, O_RDONLY);
+			if (fd < 0)
+			{
+				return false;
+			}
+			struct stat info;
+			if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+			{
+				::close(fd);
+				return false;
+			}
+			void *data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (data == MAP_FAILED)
+			{
+				return false;
+			}
+			m_data = data;
+			m_size = static_cast<std::size_t>(info.st_size);
+#endif
+			if (!m_view.open(m_data, m_size))
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+			if (m_data)
+			{
+#if defined(_WIN32)
+				UnmapViewOfFile(m_data);
+#else
+				::munmap(m_data, m_size);
+#endif
+			}
+			m_data = nullptr;
+			m_size = 0;
+			m_view = ArtifactView();
+		}
+
+		const ArtifactView &view() const { return m_view; }
+		bool valid() const { return m_view.valid(); }
+
+	private:
+		void *m_data = nullptr;
+		std::size_t m_size = 0;
+		ArtifactView m_view;
+
+		void swap(MappedArtifact &other) noexcept
+		{
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+			std::swap(m_view, other.m_view);
+		}
+	};
+}
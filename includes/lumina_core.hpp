@@ -0,0 +1,46 @@
+#pragma once
+
+// In-process entry point of the lumina_core library: compiles shader source held in memory, with includes
+// served from memory, and reports the outcome as objects instead of files and console output.
+
+#include "artifact.hpp"
+#include "compile_options.hpp"
+#include "precompilation_parser.hpp"
+#include "token.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Contents of virtual files, keyed by their lexically normalized generic path ("shaders/common.lum").
+using VirtualFiles = std::unordered_map<std::string, std::string>;
+
+struct InMemoryCompileOptions
+{
+	// Code generation options, as on the command line. The output format and the compile cache do not apply.
+	CompileOptions compile;
+	// Name the source is compiled under: reported in diagnostics and used to resolve its relative includes.
+	std::filesystem::path origin = "<memory>";
+	// Searched after the including file's directory.
+	std::vector<std::filesystem::path> includeDirectories;
+	// Asked for includes missing from the virtual files.
+	IncludeReader readFile;
+	// Lets includes nothing else provides come from disk, also searching LUMINA_INCLUDE_PATH.
+	bool diskFallback = true;
+};
+
+struct CompileResult
+{
+	// Set when compilation succeeded.
+	std::optional<ShaderArtifact> artifact;
+	std::vector<Diagnostic> diagnostics;
+	// Diagnostics as the command line prints them, with source excerpts and notes.
+	std::string log;
+};
+
+// Thread-safe; concurrent calls do not share diagnostics.
+CompileResult compileFromMemory(std::string_view p_source, const VirtualFiles &p_virtualFiles = {},
+    const InMemoryCompileOptions &p_options = {});
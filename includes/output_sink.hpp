@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Buffered byte sink the artifact writers stream into, so large outputs are never assembled in memory first.
+class OutputSink
+{
+public:
+	OutputSink() = default;
+	OutputSink(const OutputSink &) = delete;
+	OutputSink &operator=(const OutputSink &) = delete;
+	virtual ~OutputSink() = default;
+
+	void write(const char *p_data, std::size_t p_size);
+	void write(std::string_view p_bytes)
+	{
+		write(p_bytes.data(), p_bytes.size());
+	}
+	void put(char p_c)
+	{
+		if (m_used == m_buffer.size())
+		{
+			flush();
+		}
+		m_buffer[m_used++] = p_c;
+	}
+	void flush();
+
+	OutputSink &operator<<(std::string_view p_text)
+	{
+		write(p_text);
+		return *this;
+	}
+	OutputSink &operator<<(const char *p_text)
+	{
+		write(std::string_view(p_text));
+		return *this;
+	}
+	OutputSink &operator<<(char p_c)
+	{
+		put(p_c);
+		return *this;
+	}
+	template <typename Integer, std::enable_if_t<std::is_integral_v<Integer> && !std::is_same_v<Integer, char>, int> = 0>
+	OutputSink &operator<<(Integer p_value)
+	{
+		writeInteger(static_cast<long long>(p_value));
+		return *this;
+	}
+
+protected:
+	virtual void commit(const char *p_data, std::size_t p_size) = 0;
+
+private:
+	void writeInteger(long long p_value);
+
+	std::array<char, 64 * 1024> m_buffer;
+	std::size_t m_used = 0;
+};
+
+class StringOutputSink final : public OutputSink
+{
+public:
+	explicit StringOutputSink(std::string &p_target) : m_target(p_target) {}
+	~StringOutputSink() override
+	{
+		flush();
+	}
+
+protected:
+	void commit(const char *p_data, std::size_t p_size) override
+	{
+		m_target.append(p_data, p_size);
+	}
+
+private:
+	std::string &m_target;
+};
+
+class FileOutputSink final : public OutputSink
+{
+public:
+	explicit FileOutputSink(const std::filesystem::path &p_path);
+	~FileOutputSink() override;
+
+	bool isOpen() const;
+	// Flushes and closes the file; false when any write failed.
+	bool close();
+
+protected:
+	void commit(const char *p_data, std::size_t p_size) override;
+
+private:
+	std::ofstream m_stream;
+	bool m_failed = false;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "trace.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <vector>
+
+struct PassTiming
+{
+	static constexpr std::size_t kNoParent = std::numeric_limits<std::size_t>::max();
+
+	std::string name;
+	// Pass that was running when this one started.
+	std::size_t parent = kNoParent;
+	std::size_t depth = 0;
+	std::uint64_t calls = 0;
+	double wallSeconds = 0.0;
+	double cpuSeconds = 0.0;
+	std::uint64_t allocations = 0;
+	// Highest number of live heap bytes above the level the pass started at.
+	std::uint64_t peakBytes = 0;
+};
+
+// Cost of every pass of one compilation, in the order the passes first started.
+struct PassTimingReport
+{
+	std::vector<PassTiming> passes;
+	// Whether the process installs the counting allocator. The allocation columns are left out otherwise.
+	bool countsAllocations = true;
+
+	void printTable(std::ostream &p_stream) const;
+	void printJson(std::ostream &p_stream) const;
+};
+
+// Collects the PassTimers of the calling thread into p_report until destroyed.
+struct PassTimingScope
+{
+	explicit PassTimingScope(PassTimingReport &p_report);
+	~PassTimingScope();
+
+	PassTimingScope(const PassTimingScope &) = delete;
+	PassTimingScope &operator=(const PassTimingScope &) = delete;
+};
+
+// Carries the calling thread's report over to a helper thread. Passes the helper times are collected apart and
+// nested under the pass that was running when the handoff was created. Does nothing when no report is being
+// collected.
+struct PassTimingHandoff
+{
+	PassTimingHandoff();
+
+	PassTimingHandoff(const PassTimingHandoff &) = delete;
+	PassTimingHandoff &operator=(const PassTimingHandoff &) = delete;
+
+	// Collects the PassTimers of the helper thread until destroyed.
+	struct Scope
+	{
+		explicit Scope(PassTimingHandoff &p_handoff);
+		~Scope();
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	private:
+		bool m_active;
+	};
+
+	// Adds what the helper timed to the original report. Call on the creating thread once the helper has finished.
+	void merge();
+
+private:
+	PassTimingReport *m_target;
+	std::size_t m_parent;
+	PassTimingReport m_helperReport;
+};
+
+// Times the enclosing block. Repeated passes with the same name and parent are accumulated into one entry. Costs a
+// thread-local check when no report is being collected. The pass also shows up as a span in an active trace.
+struct PassTimer
+{
+	explicit PassTimer(const char *p_name);
+	~PassTimer();
+
+	PassTimer(const PassTimer &) = delete;
+	PassTimer &operator=(const PassTimer &) = delete;
+
+	// Names the file the pass works on in the trace.
+	void setTraceFile(const std::filesystem::path &p_file)
+	{
+		m_span.setFile(p_file);
+	}
+
+private:
+	TraceSpan m_span;
+	PassTimingReport *m_report;
+	std::size_t m_index = 0;
+	std::size_t m_previousParent = 0;
+	double m_wallStart = 0.0;
+	double m_cpuStart = 0.0;
+	std::uint64_t m_allocationsStart = 0;
+	std::int64_t m_liveStart = 0;
+	std::int64_t m_outerPeak = 0;
+};
+
+// Heap accounting fed by the counting allocator's replacement operator new/delete. Processes that do not link it
+// report zero allocations.
+void recordAllocation(std::size_t p_bytes);
+void recordDeallocation(std::size_t p_bytes);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "artifact.hpp"
+#include "compile_options.hpp"
+#include "token.hpp"
+
+#include <filesystem>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct CompileJob
+{
+	std::filesystem::path inputPath;
+	std::filesystem::path outputPath;
+	std::optional<std::filesystem::path> cppHeaderPath;
+};
+
+// Exit status of a compilation stopped by errors reported through emitError.
+inline constexpr int kStageErrorExit = 5;
+
+// Parses, checks and generates code for preprocessed tokens. Returns 0 and fills p_artifact, or the exit status
+// to report once the errors have been written.
+int compileTokens(
+    std::vector<Token> p_tokens, const CompileOptions &p_options, std::ostream &p_err, ShaderArtifact &p_artifact);
+
+// Compiles one shader from disk and writes its outputs, going through the compile cache when it is enabled.
+// Progress goes to p_out and failures to p_err; returns 0 or the exit code to report.
+int compileShader(const CompileJob &p_job, const CompileOptions &p_options, std::ostream &p_out, std::ostream &p_err);
+
+// The reports the options ask for (member reordering, hoisting, motion), as compileTokens prints them. A cache hit
+// replays the copy stored under kReportKind, so warm and cold runs print the same diagnostics.
+std::string compileReport(const ShaderArtifact &p_artifact, const CompileOptions &p_options);
+inline constexpr const char *kReportKind = "log";
+
+// Cache entry kind of the artifact, and the options that take part in its cache key.
+const char *artifactKind(const CompileOptions &p_options);
+std::string cacheConfiguration(const CompileOptions &p_options, const std::optional<std::string> &p_headerNamespace);
+
+// The artifact in the format selected by p_options.
+std::string serializeArtifact(const ShaderArtifact &p_artifact, const CompileOptions &p_options);
@@ -3,15 +3,28 @@
 #include "token.hpp"
 
 #include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
 #include <vector>
 
+// Replaces the disk when resolving #include targets: returns the contents of p_path, or nothing when it does not
+// exist. Candidates are tried in the usual order (including file's directory, include directories, PATH).
+using IncludeReader = std::function<std::optional<std::string>(const std::filesystem::path &p_path)>;
+
 struct PrecompilationParser
 {
 	PrecompilationParser();
 	explicit PrecompilationParser(std::vector<std::filesystem::path> p_includeDirs);
+	PrecompilationParser(std::vector<std::filesystem::path> p_includeDirs, IncludeReader p_includeReader);
 
 	void operator()(std::vector<Token> &p_rawTokens);
 
+	// Every file pulled in through #include during the last run, in first-seen order.
+	const std::vector<std::filesystem::path> &includedFiles() const;
+
 private:
 	std::vector<std::filesystem::path> m_includeDirectories;
+	IncludeReader m_includeReader;
+	std::vector<std::filesystem::path> m_includedFiles;
 };
@@ -2,14 +2,33 @@
 
 #include "token.hpp"
 
+#include <cstddef>
 #include <filesystem>
+#include <memory>
+#include <string_view>
 #include <vector>
 
 struct SourceManager
 {
-	static const std::vector<Token> &loadFile(const std::filesystem::path &p_path);
+	// Thread-safe. Concurrent loads of the same file share a single tokenization, and entries are
+	// reloaded whenever the file or one of its includes changes on disk.
+	static std::shared_ptr<const std::vector<Token>> loadFile(const std::filesystem::path &p_path);
+
+	// Tokenizes and preprocesses source that is not on disk, as if it were stored at p_origin. The source itself is
+	// not cached, but the files it includes go through the same shared caches as loadFile.
+	static std::vector<Token> loadSource(const std::filesystem::path &p_origin, std::string_view p_source);
+
+	// Raw, not yet preprocessed tokens of an included file. Shared by every file including it, so a header is
+	// tokenized once per process however many shaders pull it in. Counted against the cache capacity. Thread-safe.
+	static std::shared_ptr<const std::vector<Token>> loadIncludedTokens(const std::filesystem::path &p_path);
 
 	static void setIncludeDirectories(std::vector<std::filesystem::path> p_dirs);
 	static void addIncludeDirectory(const std::filesystem::path &p_dir);
-	static const std::vector<std::filesystem::path> &getIncludeDirectories();
+	static std::vector<std::filesystem::path> getIncludeDirectories();
+
+	// Upper bound, in bytes, on the token data kept alive by the cache, loaded and included files alike. Least
+	// recently used files are evicted first. Defaults to LUMINA_SOURCE_CACHE_BYTES when set; 0 disables the limit.
+	static void setCacheCapacity(std::size_t p_bytes);
+	static std::size_t getCacheCapacity();
+	static void clearCache();
 };
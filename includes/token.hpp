@@ -2,8 +2,10 @@
 
 #include <cstddef>
 #include <filesystem>
+#include <iosfwd>
 #include <string>
 #include <string_view>
+#include <vector>
 
 struct Token
 {
@@ -114,9 +116,36 @@ struct Token
 	Location end;
 };
 
+struct Diagnostic
+{
+	std::filesystem::path origin;
+	// 1-based; both are 0 when the error has no source location.
+	size_t line = 0;
+	size_t column = 0;
+	std::string message;
+};
+
 void emitError(const std::string &p_message, const Token &p_token);
 
+// Diagnostics are per thread: the error count and the stream they are written to (std::cout by default).
 void resetErrorCount();
 int getErrorCount();
+std::ostream &diagnosticStream();
+
+// Redirects the calling thread's diagnostics to p_stream and starts a fresh error count until destroyed. Every
+// emitError is also appended to p_records when given.
+struct DiagnosticScope
+{
+	explicit DiagnosticScope(std::ostream &p_stream, std::vector<Diagnostic> *p_records = nullptr);
+	~DiagnosticScope();
+
+	DiagnosticScope(const DiagnosticScope &) = delete;
+	DiagnosticScope &operator=(const DiagnosticScope &) = delete;
+
+private:
+	std::ostream *m_previousStream;
+	std::vector<Diagnostic> *m_previousRecords;
+	int m_previousCount;
+};
 
 std::string_view tokenTypeToString(Token::Type p_type);
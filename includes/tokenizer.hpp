@@ -3,6 +3,7 @@
 #include "token.hpp"
 
 #include <filesystem>
+#include <string_view>
 #include <vector>
 
 struct Tokenizer
@@ -10,4 +11,6 @@ struct Tokenizer
 	Tokenizer();
 
 	std::vector<Token> operator()(const std::filesystem::path &p_path) const;
+	// Tokenizes source that is not on disk; p_origin is recorded on every token.
+	std::vector<Token> operator()(const std::filesystem::path &p_origin, std::string_view p_source) const;
 };
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct Instruction;
+
+// Chrome trace-event recorder, readable by chrome://tracing and Perfetto. While a session is alive, the TraceSpans
+// of every thread are recorded as complete events tagged with their thread.
+class TraceSession
+{
+public:
+	TraceSession();
+	~TraceSession();
+
+	TraceSession(const TraceSession &) = delete;
+	TraceSession &operator=(const TraceSession &) = delete;
+
+	void write(std::ostream &p_stream) const;
+	bool writeFile(const std::filesystem::path &p_path) const;
+
+private:
+	friend struct TraceSpan;
+	friend void nameTraceThread(std::string_view p_name);
+
+	struct Event
+	{
+		std::string name;
+		const char *category;
+		double startMicroseconds;
+		double durationMicroseconds;
+		std::size_t thread;
+	};
+
+	mutable std::mutex m_mutex;
+	std::vector<Event> m_events;
+	std::unordered_map<std::size_t, std::string> m_threadNames;
+};
+
+// Records the enclosing block in the active session. Costs one atomic load when no session is recording.
+struct TraceSpan
+{
+	TraceSpan(const char *p_category, std::string_view p_name, std::string_view p_detail = {});
+	~TraceSpan();
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+
+	// Whether this span is being recorded; lets callers skip building details nobody will read.
+	bool active() const
+	{
+		return m_session != nullptr;
+	}
+	void setDetail(std::string_view p_detail);
+	void setFile(const std::filesystem::path &p_file);
+
+private:
+	TraceSession *m_session;
+	const char *m_category;
+	std::string m_name;
+	double m_start = 0.0;
+};
+
+// Labels the calling thread in the active session, if any.
+void nameTraceThread(std::string_view p_name);
+
+// "struct Foo", "function bar", "VertexPass()"... for span details.
+std::string traceName(const Instruction &p_instruction);
@@ -27,5 +27,10 @@ void advanceCursor(Cursor &cursor, char c);
 
 std::optional<Token::Type> lookupKeyword(std::string_view word);
 
+std::optional<std::string> readEnvironmentVariable(const char *p_envName);
+
 std::vector<std::filesystem::path> splitPathList(const std::string &p_list);
 std::vector<std::filesystem::path> readPathListFromEnv(const char *p_envName);
+
+// Splits on whitespace; double quotes keep a field containing spaces together. Throws on an unterminated quote.
+std::vector<std::string> splitQuotedFields(std::string_view p_line);
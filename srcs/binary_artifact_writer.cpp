@@ -0,0 +1,243 @@
+#include "binary_artifact_writer.hpp"
+
+#include "lumina_artifact_reader.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	static_assert(std::endian::native == std::endian::little, "The binary artifact is written in host byte order");
+
+	using namespace lumina::artifact;
+
+	std::uint32_t checkedU32(std::size_t value, const char *what)
+	{
+		if (value > std::numeric_limits<std::uint32_t>::max())
+		{
+			throw std::runtime_error(std::string("Binary artifact overflow: ") + what + " exceeds 4 GiB");
+		}
+		return static_cast<std::uint32_t>(value);
+	}
+
+	std::uint32_t unsignedField(int value)
+	{
+		return value < 0 ? 0u : static_cast<std::uint32_t>(value);
+	}
+
+	// Refers to the artifact's strings instead of copying them; the pool is only materialized in the sink.
+	class StringPool
+	{
+	public:
+		StringRef add(std::string_view text)
+		{
+			const auto it = offsets.find(text);
+			if (it != offsets.end())
+			{
+				return it->second;
+			}
+
+			const StringRef ref{checkedU32(byteSize, "string pool"), checkedU32(text.size(), "string")};
+			pieces.push_back(text);
+			// Each piece is followed by a terminator so C APIs (glShaderSource, ...) can take the views directly.
+			byteSize += text.size() + 1;
+			offsets.emplace(text, ref);
+			return ref;
+		}
+
+		std::size_t size() const
+		{
+			return byteSize;
+		}
+
+		void write(OutputSink &sink) const
+		{
+			for (std::string_view piece : pieces)
+			{
+				sink.write(piece);
+				sink.put('\0');
+			}
+		}
+
+	private:
+		std::vector<std::string_view> pieces;
+		std::size_t byteSize = 0;
+		std::unordered_map<std::string_view, StringRef> offsets;
+	};
+
+	class ArtifactEncoder
+	{
+	public:
+		explicit ArtifactEncoder(const ShaderArtifact &artifact) : artifact(artifact) {}
+
+		void encode(OutputSink &sink)
+		{
+			FileHeader header{};
+			std::memcpy(header.magic, kMagic, sizeof(kMagic));
+			header.version = kVersion;
+			header.vertexSource = strings.add(artifact.vertexSource);
+			header.fragmentSource = strings.add(artifact.fragmentSource);
+
+			const std::vector<StageIORecord> layouts = encodeStageIO(artifact.layouts);
+			const std::vector<StageIORecord> varyings = encodeStageIO(artifact.varyings);
+			const std::vector<StageIORecord> framebuffers = encodeStageIO(artifact.framebuffers);
+			const std::vector<TextureRecord> textures = encodeTextures();
+			const std::vector<BlockRecord> constants = encodeBlocks(artifact.constants);
+			const std::vector<BlockRecord> attributes = encodeBlocks(artifact.attributes);
+
+			std::size_t offset = sizeof(FileHeader);
+			header.layouts = placeTable(offset, layouts);
+			header.varyings = placeTable(offset, varyings);
+			header.framebuffers = placeTable(offset, framebuffers);
+			header.textures = placeTable(offset, textures);
+			header.constants = placeTable(offset, constants);
+			header.attributes = placeTable(offset, attributes);
+			header.members = placeTable(offset, members);
+			header.strings.offset = checkedU32(offset, "artifact");
+			header.strings.count = checkedU32(strings.size(), "string pool");
+			const std::size_t padding = (4 - (offset + strings.size()) % 4) % 4;
+			header.fileSize = checkedU32(offset + strings.size() + padding, "artifact");
+
+			sink.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			writeTable(sink, layouts);
+			writeTable(sink, varyings);
+			writeTable(sink, framebuffers);
+			writeTable(sink, textures);
+			writeTable(sink, constants);
+			writeTable(sink, attributes);
+			writeTable(sink, members);
+			strings.write(sink);
+			for (std::size_t i = 0; i < padding; ++i)
+			{
+				sink.put('\0');
+			}
+			sink.flush();
+		}
+
+	private:
+		const ShaderArtifact &artifact;
+		StringPool strings;
+		std::vector<MemberRecord> members;
+
+		template <typename Record>
+		static TableRef placeTable(std::size_t &offset, const std::vector<Record> &records)
+		{
+			const TableRef ref{checkedU32(offset, "artifact"), checkedU32(records.size(), "table")};
+			offset += records.size() * sizeof(Record);
+			return ref;
+		}
+
+		template <typename Record>
+		static void writeTable(OutputSink &sink, const std::vector<Record> &records)
+		{
+			sink.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(Record));
+		}
+
+		std::vector<StageIORecord> encodeStageIO(const std::vector<StageIO> &entries)
+		{
+			std::vector<StageIORecord> records;
+			records.reserve(entries.size());
+			for (const StageIO &entry : entries)
+			{
+				StageIORecord record{};
+				record.location = unsignedField(entry.location);
+				record.component = unsignedField(entry.component);
+				record.flags = entry.flat ? StageIOFlat : 0u;
+				record.type = strings.add(entry.type);
+				record.name = strings.add(entry.name);
+				records.push_back(record);
+			}
+			return records;
+		}
+
+		std::vector<TextureRecord> encodeTextures()
+		{
+			std::vector<TextureRecord> records;
+			records.reserve(artifact.textures.size());
+			for (const TextureBinding &texture : artifact.textures)
+			{
+				TextureRecord record{};
+				record.location = unsignedField(texture.location);
+				record.scope = (texture.scope == TextureBindingScope::Attribute) ? TextureScope::Attribute :
+				                                                                  TextureScope::Constant;
+				record.luminaName = strings.add(texture.luminaName);
+				record.glslName = strings.add(texture.glslName);
+				record.type = strings.add(texture.type);
+				records.push_back(record);
+			}
+			return records;
+		}
+
+		// Siblings are stored contiguously so a parent only needs a first index and a count.
+		IndexRange encodeMembers(const std::vector<BlockMember> &source)
+		{
+			const IndexRange range{checkedU32(members.size(), "member table"), checkedU32(source.size(), "member table")};
+			members.resize(members.size() + source.size());
+			for (std::size_t i = 0; i < source.size(); ++i)
+			{
+				const BlockMember &member = source[i];
+				MemberRecord record{};
+				record.name = strings.add(member.name);
+				record.typeName = strings.add(member.typeName);
+				record.kind = (member.kind == "Array") ? MemberKind::Array : MemberKind::Element;
+				record.offset = unsignedField(member.offset);
+				record.size = unsignedField(member.size);
+				record.elementSize = unsignedField(member.elementSize);
+				record.elementCount = unsignedField(member.elementCount);
+				record.members = encodeMembers(member.members);
+				record.derivedExpression = strings.add(member.derivedExpression);
+				members[range.first + i] = record;
+			}
+			return range;
+		}
+
+		std::vector<BlockRecord> encodeBlocks(const std::vector<BlockDefinition> &blocks)
+		{
+			std::vector<BlockRecord> records;
+			records.reserve(blocks.size());
+			for (const BlockDefinition &block : blocks)
+			{
+				BlockRecord record{};
+				record.name = strings.add(block.name);
+				record.kind = (block.type == "SSBO") ? BlockKind::SSBO : BlockKind::UBO;
+				record.size = unsignedField(block.size);
+				record.members = encodeMembers(block.members);
+				if (block.dynamicArray)
+				{
+					const DynamicArrayLayout &layout = *block.dynamicArray;
+					record.hasDynamicArray = 1;
+					record.dynamicArray.name = strings.add(layout.name);
+					record.dynamicArray.typeName = strings.add(layout.typeName);
+					record.dynamicArray.sizeAttributeName = strings.add(layout.sizeAttributeName);
+					record.dynamicArray.offset = unsignedField(layout.offset);
+					record.dynamicArray.elementStride = unsignedField(layout.elementStride);
+					record.dynamicArray.elementPadding = unsignedField(layout.elementPadding);
+					record.dynamicArray.members = encodeMembers(layout.members);
+				}
+				records.push_back(record);
+			}
+			return records;
+		}
+	};
+}
+
+void BinaryArtifactWriter::operator()(const ShaderArtifact &p_artifact, OutputSink &p_sink) const
+{
+	ArtifactEncoder encoder(p_artifact);
+	encoder.encode(p_sink);
+}
+
+std::string BinaryArtifactWriter::operator()(const ShaderArtifact &p_artifact) const
+{
+	std::string bytes;
+	StringOutputSink sink(bytes);
+	(*this)(p_artifact, sink);
+	return bytes;
+}
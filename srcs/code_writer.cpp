@@ -0,0 +1,28 @@
+#include "code_writer.hpp"
+
+CodeWriter &CodeWriter::operator<<(std::string_view p_text)
+{
+	while (!p_text.empty())
+	{
+		if (m_lineStart && p_text.front() != '\n')
+		{
+			m_buffer.append(static_cast<std::size_t>(m_indent), '\t');
+			m_lineStart = false;
+		}
+		const std::size_t newline = p_text.find('\n');
+		if (newline == std::string_view::npos)
+		{
+			m_buffer.append(p_text);
+			return *this;
+		}
+		m_buffer.append(p_text.substr(0, newline + 1));
+		m_lineStart = true;
+		p_text.remove_prefix(newline + 1);
+	}
+	return *this;
+}
+
+CodeWriter &CodeWriter::operator<<(char p_character)
+{
+	return *this << std::string_view(&p_character, 1);
+}
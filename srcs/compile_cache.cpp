@@ -0,0 +1,261 @@
+#include "compile_cache.hpp"
+
+#include "utils.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+#include <utility>
+
+#if __has_include("lumina_source_hash.hpp")
+#include "lumina_source_hash.hpp"
+#endif
+
+#ifndef LUMINA_VERSION
+#define LUMINA_VERSION "unknown"
+#endif
+
+#ifndef LUMINA_SOURCE_HASH
+#define LUMINA_SOURCE_HASH "unknown"
+#endif
+
+namespace
+{
+	std::string toHex(std::uint64_t value)
+	{
+		static constexpr char kDigits[] = "0123456789abcdef";
+		std::string text(16, '0');
+		for (int i = 15; i >= 0; --i)
+		{
+			text[static_cast<std::size_t>(i)] = kDigits[value & 0xF];
+			value >>= 4;
+		}
+		return text;
+	}
+
+	// SHA-256, so that two different inputs never share an entry in practice.
+	struct Sha256
+	{
+		static constexpr std::array<std::uint32_t, 64> kRoundConstants = {0x428a2f98, 0x71374491, 0xb5c0fbcf,
+		    0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+		    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+		    0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+		    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e,
+		    0x92722c85, 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3, 0x748f82ee,
+		    0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+		std::array<std::uint32_t, 8> state = {
+		    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+		std::array<unsigned char, 64> block{};
+		std::size_t blockSize = 0;
+		std::uint64_t length = 0;
+
+		static std::uint32_t rotateRight(std::uint32_t value, int count)
+		{
+			return (value >> count) | (value << (32 - count));
+		}
+
+		void compress()
+		{
+			std::array<std::uint32_t, 64> schedule{};
+			for (std::size_t i = 0; i < 16; ++i)
+			{
+				schedule[i] = (std::uint32_t{block[i * 4]} << 24) | (std::uint32_t{block[i * 4 + 1]} << 16) |
+				              (std::uint32_t{block[i * 4 + 2]} << 8) | std::uint32_t{block[i * 4 + 3]};
+			}
+			for (std::size_t i = 16; i < 64; ++i)
+			{
+				const std::uint32_t s0 =
+				    rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+				const std::uint32_t s1 =
+				    rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+				schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+			}
+
+			std::array<std::uint32_t, 8> work = state;
+			for (std::size_t i = 0; i < 64; ++i)
+			{
+				const std::uint32_t s1 = rotateRight(work[4], 6) ^ rotateRight(work[4], 11) ^ rotateRight(work[4], 25);
+				const std::uint32_t choice = (work[4] & work[5]) ^ (~work[4] & work[6]);
+				const std::uint32_t first = work[7] + s1 + choice + kRoundConstants[i] + schedule[i];
+				const std::uint32_t s0 = rotateRight(work[0], 2) ^ rotateRight(work[0], 13) ^ rotateRight(work[0], 22);
+				const std::uint32_t majority = (work[0] & work[1]) ^ (work[0] & work[2]) ^ (work[1] & work[2]);
+				const std::uint32_t second = s0 + majority;
+				work = {first + second, work[0], work[1], work[2], work[3] + first, work[4], work[5], work[6]};
+			}
+			for (std::size_t i = 0; i < 8; ++i)
+			{
+				state[i] += work[i];
+			}
+		}
+
+		void update(const void *data, std::size_t size)
+		{
+			const auto *bytes = static_cast<const unsigned char *>(data);
+			length += size;
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				block[blockSize++] = bytes[i];
+				if (blockSize == block.size())
+				{
+					compress();
+					blockSize = 0;
+				}
+			}
+		}
+
+		void update(std::string_view text)
+		{
+			// Length prefix so that adjacent strings cannot run into each other.
+			const std::uint64_t size = text.size();
+			update(&size, sizeof(size));
+			update(text.data(), text.size());
+		}
+
+		std::string hexDigest()
+		{
+			const std::uint64_t bitLength = length * 8;
+			const unsigned char padding = 0x80;
+			update(&padding, 1);
+			const unsigned char zero = 0;
+			while (blockSize != 56)
+			{
+				update(&zero, 1);
+			}
+			std::array<unsigned char, 8> encodedLength{};
+			for (std::size_t i = 0; i < 8; ++i)
+			{
+				encodedLength[i] = static_cast<unsigned char>(bitLength >> (56 - 8 * i));
+			}
+			update(encodedLength.data(), encodedLength.size());
+
+			std::string digest;
+			for (const std::uint32_t word : state)
+			{
+				digest += toHex(word).substr(8);
+			}
+			return digest;
+		}
+	};
+
+	// Unique per process and call, so concurrent writers of one entry never share a temporary file.
+	std::string temporarySuffix()
+	{
+		static const std::uint64_t processTag = (std::uint64_t{std::random_device{}()} << 32) ^ std::random_device{}();
+		static std::atomic<std::uint64_t> counter{0};
+		return ".tmp" + toHex(processTag) + toHex(counter++);
+	}
+}
+
+std::optional<std::filesystem::path> CompileCache::directoryFromEnvironment()
+{
+	const std::optional<std::string> value = readEnvironmentVariable("LUMINA_CACHE_DIR");
+	if (!value || value->empty())
+	{
+		return std::nullopt;
+	}
+	return std::filesystem::path(*value);
+}
+
+std::string CompileCache::computeKey(const std::vector<Token> &p_tokens, std::string_view p_configuration)
+{
+	Sha256 hash;
+	// A compiler built from other sources may produce other outputs, so it gets its own entries.
+	hash.update(LUMINA_VERSION);
+	hash.update(LUMINA_SOURCE_HASH);
+	hash.update(p_configuration);
+
+	// Positions and origins only matter for diagnostics, and a cached compilation never produced any.
+	for (const Token &token : p_tokens)
+	{
+		const auto type = static_cast<std::uint32_t>(token.type);
+		hash.update(&type, sizeof(type));
+		hash.update(token.content);
+	}
+
+	return hash.hexDigest();
+}
+
+CompileCache::CompileCache(std::filesystem::path p_directory) : m_directory(std::move(p_directory)) {}
+
+std::filesystem::path CompileCache::entryPath(const std::string &p_key, std::string_view p_kind) const
+{
+	return m_directory / p_key.substr(0, 2) / (p_key + "." + std::string(p_kind));
+}
+
+bool CompileCache::restore(
+    const std::string &p_key, std::string_view p_kind, const std::filesystem::path &p_destination) const
+{
+	const std::filesystem::path entry = entryPath(p_key, p_kind);
+	std::error_code ec;
+	if (!std::filesystem::is_regular_file(entry, ec))
+	{
+		return false;
+	}
+	std::filesystem::copy_file(entry, p_destination, std::filesystem::copy_options::overwrite_existing, ec);
+	return !ec;
+}
+
+template <typename WriteTemporary>
+void CompileCache::commit(const std::string &p_key, std::string_view p_kind, WriteTemporary &&p_writeTemporary) const
+{
+	const std::filesystem::path entry = entryPath(p_key, p_kind);
+	std::error_code ec;
+	std::filesystem::create_directories(entry.parent_path(), ec);
+	if (ec)
+	{
+		return;
+	}
+
+	// Write then rename, so concurrent compilers never observe a partially written entry.
+	std::filesystem::path temporary = entry;
+	temporary += temporarySuffix();
+	if (p_writeTemporary(temporary))
+	{
+		std::filesystem::rename(temporary, entry, ec);
+		if (!ec)
+		{
+			return;
+		}
+	}
+	std::filesystem::remove(temporary, ec);
+}
+
+void CompileCache::store(const std::string &p_key, std::string_view p_kind, const std::filesystem::path &p_source) const
+{
+	commit(p_key, p_kind, [&](const std::filesystem::path &temporary) {
+		std::error_code ec;
+		std::filesystem::copy_file(p_source, temporary, std::filesystem::copy_options::overwrite_existing, ec);
+		return !ec;
+	});
+}
+
+std::optional<std::string> CompileCache::loadContent(const std::string &p_key, std::string_view p_kind) const
+{
+	std::ifstream file(entryPath(p_key, p_kind), std::ios::binary);
+	if (!file)
+	{
+		return std::nullopt;
+	}
+	std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (file.bad())
+	{
+		return std::nullopt;
+	}
+	return content;
+}
+
+void CompileCache::storeContent(const std::string &p_key, std::string_view p_kind, std::string_view p_content) const
+{
+	commit(p_key, p_kind, [&](const std::filesystem::path &temporary) {
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(p_content.data(), static_cast<std::streamsize>(p_content.size()));
+		file.close();
+		return !file.fail();
+	});
+}
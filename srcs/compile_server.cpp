@@ -0,0 +1,375 @@
+#include "compile_server.hpp"
+
+#include "compile_cache.hpp"
+#include "source_manager.hpp"
+#include "token.hpp"
+#include "utils.hpp"
+
+#include <array>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <unordered_set>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr int kMalformedRequestExit = 2;
+
+	struct Response
+	{
+		int status = 0;
+		std::string artifact;
+		std::string diagnostics;
+	};
+
+	// Compiles the file at origin, or the request payload as if it were stored there.
+	int compileRequest(const CompileOptions &options, const std::filesystem::path &origin,
+	    const std::optional<std::string> &source, std::string &artifact, std::ostream &diagnostics)
+	{
+		std::vector<Token> tokens = source ? SourceManager::loadSource(origin, *source) : *SourceManager::loadFile(origin);
+		if (getErrorCount() > 0)
+		{
+			diagnostics << "Compilation aborted after lexing due to errors.\n";
+			return kStageErrorExit;
+		}
+
+		std::optional<CompileCache> cache;
+		std::string cacheKey;
+		if (const std::optional<std::filesystem::path> cacheDirectory = CompileCache::directoryFromEnvironment())
+		{
+			cache.emplace(*cacheDirectory);
+			cacheKey = CompileCache::computeKey(tokens, cacheConfiguration(options, std::nullopt));
+			const std::optional<std::string> report = cache->loadContent(cacheKey, kReportKind);
+			std::optional<std::string> cached = report ? cache->loadContent(cacheKey, artifactKind(options)) : std::nullopt;
+			if (cached)
+			{
+				diagnostics << *report;
+				artifact = std::move(*cached);
+				return 0;
+			}
+		}
+
+		ShaderArtifact compiled;
+		if (const int status = compileTokens(std::move(tokens), options, diagnostics, compiled); status != 0)
+		{
+			return status;
+		}
+
+		artifact = serializeArtifact(compiled, options);
+		if (cache)
+		{
+			cache->storeContent(cacheKey, kReportKind, compileReport(compiled, options));
+			cache->storeContent(cacheKey, artifactKind(options), artifact);
+		}
+		return 0;
+	}
+
+	Response handleCompile(const CompileOptions &options, const std::filesystem::path &origin,
+	    const std::optional<std::string> &source)
+	{
+		Response response;
+		std::ostringstream diagnostics;
+		{
+			DiagnosticScope scope(diagnostics);
+			try
+			{
+				response.status = compileRequest(options, origin, source, response.artifact, diagnostics);
+			} catch (const std::exception &e)
+			{
+				diagnostics << "error: " << e.what() << "\n";
+				response.status = 1;
+			}
+		}
+		if (response.status != 0)
+		{
+			response.artifact.clear();
+		}
+		response.diagnostics = diagnostics.str();
+		return response;
+	}
+
+	Response malformed(const std::string &message)
+	{
+		Response response;
+		response.status = kMalformedRequestExit;
+		response.diagnostics = "malformed request: " + message + "\n";
+		return response;
+	}
+
+	void writeResponse(std::ostream &output, const Response &response)
+	{
+		output << response.status << ' ' << response.artifact.size() << ' ' << response.diagnostics.size() << '\n';
+		output.write(response.artifact.data(), static_cast<std::streamsize>(response.artifact.size()));
+		output.write(response.diagnostics.data(), static_cast<std::streamsize>(response.diagnostics.size()));
+		output.flush();
+	}
+
+	std::optional<std::size_t> parseByteCount(const std::string &text)
+	{
+		if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 18)
+		{
+			return std::nullopt;
+		}
+		return static_cast<std::size_t>(std::stoull(text));
+	}
+
+#if !defined(_WIN32)
+	// Blocking iostream buffer over a connected socket.
+	class SocketStreamBuffer : public std::streambuf
+	{
+	public:
+		explicit SocketStreamBuffer(int p_socket) : m_socket(p_socket)
+		{
+			setg(m_input.data(), m_input.data(), m_input.data());
+			setp(m_output.data(), m_output.data() + m_output.size());
+		}
+
+		~SocketStreamBuffer() override
+		{
+			sync();
+			::close(m_socket);
+		}
+
+	protected:
+		int_type underflow() override
+		{
+			ssize_t received;
+			do
+			{
+				received = ::read(m_socket, m_input.data(), m_input.size());
+			} while (received < 0 && errno == EINTR);
+
+			if (received <= 0)
+			{
+				return traits_type::eof();
+			}
+			setg(m_input.data(), m_input.data(), m_input.data() + received);
+			return traits_type::to_int_type(*gptr());
+		}
+
+		int_type overflow(int_type p_c) override
+		{
+			if (!flushOutput())
+			{
+				return traits_type::eof();
+			}
+			if (!traits_type::eq_int_type(p_c, traits_type::eof()))
+			{
+				*pptr() = traits_type::to_char_type(p_c);
+				pbump(1);
+			}
+			return traits_type::not_eof(p_c);
+		}
+
+		int sync() override
+		{
+			return flushOutput() ? 0 : -1;
+		}
+
+	private:
+		bool flushOutput()
+		{
+			const char *data = pbase();
+			std::size_t remaining = static_cast<std::size_t>(pptr() - pbase());
+			setp(m_output.data(), m_output.data() + m_output.size());
+			while (remaining > 0)
+			{
+				const ssize_t sent = ::write(m_socket, data, remaining);
+				if (sent < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (sent <= 0)
+				{
+					return false;
+				}
+				data += sent;
+				remaining -= static_cast<std::size_t>(sent);
+			}
+			return true;
+		}
+
+		int m_socket;
+		std::array<char, 64 * 1024> m_input;
+		std::array<char, 64 * 1024> m_output;
+	};
+#endif
+}
+
+CompileServer::CompileServer(CompileOptions p_options) : m_options(p_options) {}
+
+bool CompileServer::serve(std::istream &p_input, std::ostream &p_output) const
+{
+	std::string header;
+	while (std::getline(p_input, header))
+	{
+		if (!header.empty() && header.back() == '\r')
+		{
+			header.pop_back();
+		}
+
+		std::vector<std::string> fields;
+		try
+		{
+			fields = splitQuotedFields(header);
+		} catch (const std::exception &e)
+		{
+			writeResponse(p_output, malformed(e.what()));
+			continue;
+		}
+
+		if (fields.empty())
+		{
+			continue;
+		}
+
+		const std::string &command = fields[0];
+		if (command == "quit" && fields.size() == 1)
+		{
+			return true;
+		}
+
+		if (command == "compile" && fields.size() == 2)
+		{
+			writeResponse(p_output, handleCompile(m_options, fields[1], std::nullopt));
+			continue;
+		}
+
+		if (command == "compile-source")
+		{
+			const std::optional<std::size_t> byteCount =
+			    fields.size() == 3 ? parseByteCount(fields[2]) : std::optional<std::size_t>();
+			if (!byteCount)
+			{
+				// The payload length is unknown, so the stream cannot be resynchronized.
+				writeResponse(p_output, malformed("expected 'compile-source <origin> <byteCount>'"));
+				return false;
+			}
+
+			std::string source(*byteCount, '\0');
+			if (!p_input.read(source.data(), static_cast<std::streamsize>(source.size())))
+			{
+				return false;
+			}
+			writeResponse(p_output, handleCompile(m_options, fields[1], std::move(source)));
+			continue;
+		}
+
+		writeResponse(p_output, malformed("unknown command '" + header + "'"));
+	}
+	return false;
+}
+
+int CompileServer::listen(const std::filesystem::path &p_socketPath) const
+{
+#if defined(_WIN32)
+	(void)p_socketPath;
+	std::cerr << "Unix domain sockets are not supported on this platform; use --server without --socket\n";
+	return 2;
+#else
+	const std::string path = p_socketPath.string();
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(address.sun_path))
+	{
+		std::cerr << "invalid socket path: " << path << "\n";
+		return 2;
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	// A socket left behind by a previous server is replaced; any other file is not.
+	std::error_code ec;
+	if (std::filesystem::is_socket(p_socketPath, ec))
+	{
+		std::filesystem::remove(p_socketPath, ec);
+	}
+
+	const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || ::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+	    ::listen(listener, SOMAXCONN) != 0)
+	{
+		std::cerr << "cannot listen on " << path << ": " << std::strerror(errno) << "\n";
+		if (listener >= 0)
+		{
+			::close(listener);
+		}
+		return 3;
+	}
+
+	// Clients that disconnect mid-response must not terminate the server.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	std::atomic<bool> stopping{false};
+	std::mutex clientsMutex;
+	std::condition_variable clientsDone;
+	// Sockets of the clients being served. A thread removes its socket before closing it, so the descriptors
+	// here are never reused by another file.
+	std::unordered_set<int> clients;
+
+	while (!stopping)
+	{
+		const int client = ::accept(listener, nullptr, nullptr);
+		if (client < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+			break;
+		}
+
+		{
+			std::lock_guard lock(clientsMutex);
+			clients.insert(client);
+		}
+		std::thread([&, client]() {
+			SocketStreamBuffer buffer(client);
+			std::iostream stream(&buffer);
+			const bool quit = serve(stream, stream);
+			if (quit && !stopping.exchange(true))
+			{
+				// Wakes the blocking accept() of the main loop.
+				::shutdown(listener, SHUT_RDWR);
+			}
+
+			std::lock_guard lock(clientsMutex);
+			clients.erase(client);
+			clientsDone.notify_all();
+		}).detach();
+	}
+
+	{
+		// Idle clients would otherwise wait for their next request forever. Closing the read side ends their
+		// input, while a request being compiled still gets its response.
+		std::unique_lock lock(clientsMutex);
+		for (const int client : clients)
+		{
+			::shutdown(client, SHUT_RD);
+		}
+		clientsDone.wait(lock, [&]() { return clients.empty(); });
+	}
+	::close(listener);
+	std::filesystem::remove(p_socketPath, ec);
+	return 0;
+#endif
+}
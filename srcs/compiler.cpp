@@ -1,16 +1,23 @@
 #include "compiler.hpp"
 
+#include "constant_evaluator.hpp"
 #include "converter.hpp"
+#include "output_sink.hpp"
+#include "pass_timing.hpp"
+#include "trace.hpp"
 
 #include <algorithm>
 #include <cctype>
 #include <cstddef>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <numeric>
 #include <optional>
-#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -41,6 +48,20 @@ namespace
 		return text;
 	}
 
+	// Enclosing namespaces of a qualified name: "A::B::Block" gives {"A", "B"}.
+	std::vector<std::string> namespaceOf(const std::string &qualifiedName)
+	{
+		std::vector<std::string> path;
+		std::size_t start = 0;
+		for (std::size_t separator = qualifiedName.find("::"); separator != std::string::npos;
+		     separator = qualifiedName.find("::", start))
+		{
+			path.push_back(qualifiedName.substr(start, separator - start));
+			start = separator + 2;
+		}
+		return path;
+	}
+
 	std::string formatTypeName(const TypeName &type)
 	{
 		std::string text;
@@ -56,17 +77,6 @@ namespace
 	using FramebufferEntry = StageIO;
 	using TextureEntry = TextureBinding;
 
-struct BlockMember
-{
-	std::string name;
-	std::string kind = "Element";
-	int offset = 0;
-	int size = 0;
-	int elementSize = 0;
-	int elementCount = 0;
-	std::vector<BlockMember> members;
-};
-
 enum class MemoryLayout
 {
 	Std140,
@@ -80,6 +90,22 @@ struct TypeLayoutInfo
 	std::vector<BlockMember> members;
 };
 
+struct LayoutCacheKey
+{
+	std::string typeName;
+	MemoryLayout layout = MemoryLayout::Std430;
+
+	bool operator==(const LayoutCacheKey &other) const = default;
+};
+
+struct LayoutCacheKeyHash
+{
+	std::size_t operator()(const LayoutCacheKey &key) const
+	{
+		return std::hash<std::string>{}(key.typeName) * 31u + static_cast<std::size_t>(key.layout);
+	}
+};
+
 struct FieldLayoutInfo
 {
 	BlockMember member;
@@ -97,6 +123,95 @@ int roundUp(int value, int alignment)
 	return remainder == 0 ? value : value + alignment - remainder;
 }
 
+// Offset reached by placing the fields in the given order, rounded up to the enclosing alignment.
+int measureFieldOrder(const std::vector<FieldLayoutInfo> &fields, const std::vector<std::size_t> &order, int trailingAlignment)
+{
+	int offset = 0;
+	int alignment = trailingAlignment;
+	for (std::size_t index : order)
+	{
+		offset = roundUp(offset, fields[index].alignment) + fields[index].size;
+		alignment = std::max(alignment, fields[index].alignment);
+	}
+	return roundUp(offset, alignment);
+}
+
+// Returns declaration order unless another candidate is strictly smaller. The last `pinned` fields keep their place.
+std::vector<std::size_t> minimizePadding(const std::vector<FieldLayoutInfo> &fields, std::size_t pinned, int trailingAlignment)
+{
+	const std::size_t movable = fields.size() - std::min(pinned, fields.size());
+	std::vector<std::size_t> declared(fields.size());
+	std::iota(declared.begin(), declared.end(), std::size_t{0});
+
+	std::vector<std::size_t> byAlignment = declared;
+	std::stable_sort(byAlignment.begin(),
+	    byAlignment.begin() + static_cast<std::ptrdiff_t>(movable),
+	    [&](std::size_t lhs, std::size_t rhs) { return fields[lhs].alignment > fields[rhs].alignment; });
+
+	// Greedy fill: place whichever field needs the least padding at the current offset, widest first on ties.
+	std::vector<std::size_t> greedy;
+	std::vector<bool> placed(movable, false);
+	int offset = 0;
+	for (std::size_t step = 0; step < movable; ++step)
+	{
+		std::size_t best = movable;
+		int bestPadding = 0;
+		for (std::size_t i = 0; i < movable; ++i)
+		{
+			if (placed[i])
+			{
+				continue;
+			}
+			const int padding = roundUp(offset, fields[i].alignment) - offset;
+			if (best == movable || padding < bestPadding ||
+			    (padding == bestPadding && fields[i].alignment > fields[best].alignment))
+			{
+				best = i;
+				bestPadding = padding;
+			}
+		}
+		placed[best] = true;
+		greedy.push_back(best);
+		offset = roundUp(offset, fields[best].alignment) + fields[best].size;
+	}
+	for (std::size_t i = movable; i < fields.size(); ++i)
+	{
+		greedy.push_back(i);
+	}
+
+	std::vector<std::size_t> bestOrder = declared;
+	int bestSize = measureFieldOrder(fields, declared, trailingAlignment);
+	for (const std::vector<std::size_t> *candidate : {&byAlignment, &greedy})
+	{
+		const int size = measureFieldOrder(fields, *candidate, trailingAlignment);
+		if (size < bestSize)
+		{
+			bestSize = size;
+			bestOrder = *candidate;
+		}
+	}
+	return bestOrder;
+}
+
+// Lays the fields out in the given order after currentOffset.
+void placeFields(std::vector<FieldLayoutInfo> &fields,
+    const std::vector<std::size_t> &order,
+    std::vector<BlockMember> &members,
+    int &currentOffset,
+    int &maxAlign)
+{
+	for (std::size_t index : order)
+	{
+		FieldLayoutInfo &field = fields[index];
+		const int alignedOffset = roundUp(currentOffset, field.alignment);
+		field.member.offset = alignedOffset;
+		field.member.size = field.size;
+		currentOffset = alignedOffset + field.size;
+		maxAlign = std::max(maxAlign, field.alignment);
+		members.push_back(std::move(field.member));
+	}
+}
+
 bool isScalarType(const std::string &typeName)
 {
 	return typeName == "bool" || typeName == "int" || typeName == "uint" || typeName == "float";
@@ -163,190 +278,65 @@ std::string sanitizeIdentifier(const std::string &name)
 	return sanitized;
 }
 
-	struct DynamicArrayLayout
+void writeIndent(OutputSink &oss, int indent)
 	{
-		std::string name;
-		std::string sizeAttributeName;
-		int offset = 0;
-		int elementStride = 0;
-		int elementPadding = 0;
-		std::vector<BlockMember> members;
-	};
+		for (int i = 0; i < indent; ++i)
+		{
+			oss.put(' ');
+		}
+	}
 
-	struct BlockDefinition
+	// Escapes in place: runs of plain characters are forwarded to the sink as-is, without an escaped copy.
+	void writeJsonString(OutputSink &oss, std::string_view text)
 	{
-		std::string name;
-		std::string type;
-		int size = 0;
-		std::vector<BlockMember> members;
-		std::optional<DynamicArrayLayout> dynamicArray;
-	};
+		static constexpr char kHexDigits[] = "0123456789ABCDEF";
 
-std::string jsonEscape(const std::string &value)
-	{
-		std::string escaped;
-		escaped.reserve(value.size() + 8);
-		for (char c : value)
+		oss.put('"');
+		std::size_t runStart = 0;
+		for (std::size_t i = 0; i < text.size(); ++i)
 		{
-			switch (c)
+			const unsigned char uc = static_cast<unsigned char>(text[i]);
+			if (uc >= 0x20 && uc != '"' && uc != '\\')
+			{
+				continue;
+			}
+
+			oss.write(text.substr(runStart, i - runStart));
+			runStart = i + 1;
+			switch (uc)
 			{
 				case '\\':
-					escaped += "\\\\";
+					oss << "\\\\";
 					break;
 				case '"':
-					escaped += "\\\"";
+					oss << "\\\"";
 					break;
 				case '\b':
-					escaped += "\\b";
+					oss << "\\b";
 					break;
 				case '\f':
-					escaped += "\\f";
+					oss << "\\f";
 					break;
 				case '\n':
-					escaped += "\\n";
+					oss << "\\n";
 					break;
 				case '\r':
-					escaped += "\\r";
+					oss << "\\r";
 					break;
 				case '\t':
-					escaped += "\\t";
+					oss << "\\t";
 					break;
 				default:
-				{
-					const unsigned char uc = static_cast<unsigned char>(c);
-					if (uc < 0x20)
-					{
-						const char *digits = "0123456789ABCDEF";
-						escaped += "\\u00";
-						escaped.push_back(digits[uc >> 4]);
-						escaped.push_back(digits[uc & 0x0F]);
-					}
-					else
-					{
-						escaped.push_back(c);
-					}
+					oss << "\\u00" << kHexDigits[uc >> 4] << kHexDigits[uc & 0x0F];
 					break;
-				}
-			}
-		}
-		return escaped;
-	}
-
-	std::optional<int> evaluateIntegralExpression(const Expression &expression)
-	{
-		switch (expression.kind)
-		{
-			case Expression::Kind::Literal:
-			{
-				const auto &literal = static_cast<const LiteralExpression &>(expression);
-				try
-				{
-					long long value = std::stoll(literal.literal.content, nullptr, 0);
-					if (value > std::numeric_limits<int>::max() || value < std::numeric_limits<int>::min())
-					{
-						return std::nullopt;
-					}
-					return static_cast<int>(value);
-				}
-				catch (...)
-				{
-					return std::nullopt;
-				}
-			}
-			case Expression::Kind::Unary:
-			{
-				const auto &unary = static_cast<const UnaryExpression &>(expression);
-				if (!unary.operand)
-				{
-					return std::nullopt;
-				}
-				auto operand = evaluateIntegralExpression(*unary.operand);
-				if (!operand)
-				{
-					return std::nullopt;
-				}
-				switch (unary.op)
-				{
-					case UnaryOperator::Positive:
-						return *operand;
-					case UnaryOperator::Negate:
-						return -*operand;
-					case UnaryOperator::BitwiseNot:
-						return ~*operand;
-					default:
-						return std::nullopt;
-				}
 			}
-			case Expression::Kind::Binary:
-			{
-				const auto &binary = static_cast<const BinaryExpression &>(expression);
-				if (!binary.left || !binary.right)
-				{
-					return std::nullopt;
-				}
-				auto left = evaluateIntegralExpression(*binary.left);
-				auto right = evaluateIntegralExpression(*binary.right);
-				if (!left || !right)
-				{
-					return std::nullopt;
-				}
-				switch (binary.op)
-				{
-					case BinaryOperator::Add:
-						return *left + *right;
-					case BinaryOperator::Subtract:
-						return *left - *right;
-					case BinaryOperator::Multiply:
-						return *left * *right;
-					case BinaryOperator::Divide:
-						return (*right == 0) ? std::nullopt : std::optional<int>(*left / *right);
-					case BinaryOperator::Modulo:
-						return (*right == 0) ? std::nullopt : std::optional<int>(*left % *right);
-					case BinaryOperator::BitwiseAnd:
-						return *left & *right;
-					case BinaryOperator::BitwiseOr:
-						return *left | *right;
-					case BinaryOperator::BitwiseXor:
-						return *left ^ *right;
-					case BinaryOperator::ShiftLeft:
-						return *left << *right;
-					case BinaryOperator::ShiftRight:
-						return *left >> *right;
-					default:
-						return std::nullopt;
-				}
-			}
-			case Expression::Kind::ArrayLiteral:
-				return std::nullopt;
-			default:
-				return std::nullopt;
-		}
-	}
-
-	std::optional<int> evaluateArrayLength(const VariableDeclarator &declarator)
-	{
-		if (!declarator.hasArraySuffix || !declarator.hasArraySize || !declarator.arraySize)
-		{
-			return std::nullopt;
-		}
-		return evaluateIntegralExpression(*declarator.arraySize);
-}
-
-void writeIndent(std::ostringstream &oss, int indent)
-	{
-		for (int i = 0; i < indent; ++i)
-		{
-			oss.put(' ');
 		}
-	}
-
-	void writeJsonString(std::ostringstream &oss, const std::string &text)
-	{
-		oss << '"' << jsonEscape(text) << '"';
+		oss.write(text.substr(runStart));
+		oss.put('"');
 	}
 
 	template <typename Collection, typename Writer>
-	void writeJsonArray(std::ostringstream &oss, int indent, const Collection &items, Writer writer)
+	void writeJsonArray(OutputSink &oss, int indent, const Collection &items, Writer writer)
 	{
 		oss << "[";
 		if (items.empty())
@@ -372,9 +362,9 @@ void writeIndent(std::ostringstream &oss, int indent)
 		oss << "]";
 	}
 
-	void writeBlockMembers(std::ostringstream &oss, const std::vector<BlockMember> &members, int indent);
+	void writeBlockMembers(OutputSink &oss, const std::vector<BlockMember> &members, int indent);
 
-	void writeBlockMember(std::ostringstream &oss, const BlockMember &member, int indent)
+	void writeBlockMember(OutputSink &oss, const BlockMember &member, int indent)
 	{
 		writeIndent(oss, indent);
 		oss << "{\n";
@@ -399,8 +389,18 @@ void writeIndent(std::ostringstream &oss, int indent)
 		writeJsonString(oss, "size");
 		bool hasArrayInfo = (member.kind == "Array");
 		bool hasNested = !member.members.empty();
+		bool isDerived = !member.derivedExpression.empty();
 		oss << ": " << member.size;
-		oss << (hasArrayInfo || hasNested ? ",\n" : "\n");
+		oss << (hasArrayInfo || hasNested || isDerived ? ",\n" : "\n");
+
+		if (isDerived)
+		{
+			writeIndent(oss, indent + 2);
+			writeJsonString(oss, "derivedExpression");
+			oss << ": ";
+			writeJsonString(oss, member.derivedExpression);
+			oss << (hasArrayInfo || hasNested ? ",\n" : "\n");
+		}
 
 		if (hasArrayInfo)
 		{
@@ -427,7 +427,7 @@ void writeIndent(std::ostringstream &oss, int indent)
 		oss << "}";
 	}
 
-	void writeBlockMembers(std::ostringstream &oss, const std::vector<BlockMember> &members, int indent)
+	void writeBlockMembers(OutputSink &oss, const std::vector<BlockMember> &members, int indent)
 	{
 		writeJsonArray(
 		    oss,
@@ -439,7 +439,7 @@ void writeIndent(std::ostringstream &oss, int indent)
 		    });
 	}
 
-	void writeDynamicArray(std::ostringstream &oss, const DynamicArrayLayout &layout, int indent)
+	void writeDynamicArray(OutputSink &oss, const DynamicArrayLayout &layout, int indent)
 	{
 		writeIndent(oss, indent);
 		oss << "{\n";
@@ -491,20 +491,30 @@ void writeIndent(std::ostringstream &oss, int indent)
 		std::vector<TextureEntry> textures;
 		std::vector<BlockDefinition> constants;
 		std::vector<BlockDefinition> attributes;
-		std::string vertexSource;
-		std::string fragmentSource;
-		bool hasVertexStage = false;
-		bool hasFragmentStage = false;
 
 		std::unordered_map<std::string, const AggregateInstruction *> structLookup;
+		std::vector<std::string> structOrder;
+		// Const globals by qualified name, so array sizes can be written in terms of them.
+		std::unordered_map<std::string, std::pair<const VariableInstruction *, const VariableDeclarator *>> constGlobals;
+		mutable std::unordered_map<const VariableDeclarator *, std::optional<ConstantValue>> constGlobalValues;
 		std::vector<std::string> namespaceStack;
 
+		// Type layouts are shared by every block of the compilation, so each distinct type is laid out once.
+		mutable std::unordered_map<LayoutCacheKey, TypeLayoutInfo, LayoutCacheKeyHash> layoutCache;
+		mutable std::deque<TypeLayoutInfo> uncachedLayouts;
+		mutable std::vector<std::string> layoutStack;
+		mutable bool layoutCycleDetected = false;
+
+		bool reorderMembers = false;
+		mutable std::unordered_map<std::string, std::vector<std::string>> memberOrders;
+		mutable std::vector<MemberReorderReport> reorderReports;
+
 		int nextLayoutLocation = 0;
 		int nextVaryingLocation = 0;
 		int nextFramebufferLocation = 0;
 		int nextTextureLocation = 0;
 
-		void collectStructs(const std::vector<std::unique_ptr<Instruction>> &instructions)
+		void collectDeclarations(const std::vector<std::unique_ptr<Instruction>> &instructions)
 		{
 			for (const std::unique_ptr<Instruction> &instruction : instructions)
 			{
@@ -521,7 +531,23 @@ void writeIndent(std::ostringstream &oss, int indent)
 						if (aggregate.kind == AggregateInstruction::Kind::Struct)
 						{
 							const std::string qualified = qualify(aggregate.name);
-							structLookup.emplace(qualified, &aggregate);
+							if (structLookup.emplace(qualified, &aggregate).second)
+							{
+								structOrder.push_back(qualified);
+							}
+						}
+						break;
+					}
+					case Instruction::Type::Variable:
+					{
+						const auto &variable = static_cast<const VariableInstruction &>(*instruction);
+						if (!variable.declaration.type.isConst)
+						{
+							break;
+						}
+						for (const VariableDeclarator &declarator : variable.declaration.declarators)
+						{
+							constGlobals.emplace(qualify(declarator.name), std::make_pair(&variable, &declarator));
 						}
 						break;
 					}
@@ -529,7 +555,7 @@ void writeIndent(std::ostringstream &oss, int indent)
 					{
 						const auto &ns = static_cast<const NamespaceInstruction &>(*instruction);
 						pushNamespace(ns.name);
-						collectStructs(ns.instructions);
+						collectDeclarations(ns.instructions);
 						popNamespace();
 						break;
 					}
@@ -559,9 +585,6 @@ void writeIndent(std::ostringstream &oss, int indent)
 					case Instruction::Type::Aggregate:
 						handleAggregate(static_cast<const AggregateInstruction &>(*instruction));
 						break;
-					case Instruction::Type::StageFunction:
-						handleStageFunction(static_cast<const StageFunctionInstruction &>(*instruction));
-						break;
 					case Instruction::Type::Namespace:
 					{
 						const auto &ns = static_cast<const NamespaceInstruction &>(*instruction);
@@ -643,25 +666,6 @@ void writeIndent(std::ostringstream &oss, int indent)
 			}
 		}
 
-		void handleStageFunction(const StageFunctionInstruction &stageFunction)
-		{
-			const std::string label = safeTokenContent(stageFunction.stageToken);
-			const std::string placeholder = "// TODO: emit GLSL for " + label + "\n";
-			switch (stageFunction.stage)
-			{
-				case Stage::VertexPass:
-					hasVertexStage = true;
-					vertexSource = placeholder;
-					break;
-				case Stage::FragmentPass:
-					hasFragmentStage = true;
-					fragmentSource = placeholder;
-					break;
-				default:
-					break;
-			}
-		}
-
 		BlockDefinition makeBlockDefinition(const AggregateInstruction &aggregate)
 		{
 			BlockDefinition block;
@@ -669,10 +673,8 @@ void writeIndent(std::ostringstream &oss, int indent)
 			block.type = aggregateHasUnsizedArray(aggregate) ? "SSBO" : "UBO";
 			block.size = 0;
 
-			std::vector<std::string> recursion;
-			recursion.push_back(block.name);
-			block.members = buildMembers(aggregate, recursion, block);
-			recursion.pop_back();
+			TraceSpan span("layout", "block", block.name);
+			block.members = buildMembers(aggregate, block);
 
 			return block;
 		}
@@ -681,7 +683,6 @@ void writeIndent(std::ostringstream &oss, int indent)
 		    BlockDefinition &block,
 		    const TypeName &elementType,
 		    const VariableDeclarator &declarator,
-		    std::vector<std::string> &recursion,
 		    MemoryLayout layout,
 		    int &currentOffset,
 		    int &maxAlign)
@@ -693,7 +694,7 @@ void writeIndent(std::ostringstream &oss, int indent)
 				    block.dynamicArray->name + "', new '" + safeTokenContent(declarator.name) + "')");
 			}
 
-			TypeLayoutInfo elementLayout = layoutType(elementType, layout, recursion);
+			const TypeLayoutInfo &elementLayout = layoutType(elementType, layout);
 			block.type = "SSBO";
 
 			int arrayAlignment = elementLayout.alignment;
@@ -706,6 +707,7 @@ void writeIndent(std::ostringstream &oss, int indent)
 
 			DynamicArrayLayout dynamicLayout;
 			dynamicLayout.name = safeTokenContent(declarator.name);
+			dynamicLayout.typeName = formatName(elementType.name);
 			dynamicLayout.sizeAttributeName =
 			    "spk_" + sanitizeIdentifier(block.name) + "_" + sanitizeIdentifier(dynamicLayout.name) + "_size";
 			dynamicLayout.offset = alignedOffset;
@@ -718,7 +720,7 @@ void writeIndent(std::ostringstream &oss, int indent)
 			{
 				dynamicLayout.elementStride = roundUp(elementLayout.size, elementLayout.alignment);
 			}
-			dynamicLayout.members = std::move(elementLayout.members);
+			dynamicLayout.members = elementLayout.members;
 			block.dynamicArray = std::move(dynamicLayout);
 
 			currentOffset = alignedOffset;
@@ -726,13 +728,12 @@ void writeIndent(std::ostringstream &oss, int indent)
 		}
 
 		std::vector<BlockMember> buildMembers(
-		    const AggregateInstruction &aggregate, std::vector<std::string> &recursion, BlockDefinition &block)
+		    const AggregateInstruction &aggregate, BlockDefinition &block)
 		{
 			const MemoryLayout layout = MemoryLayout::Std430;
-			std::vector<BlockMember> members;
-			int currentOffset = 0;
-			int maxAlign = 1;
-			bool hasDynamicArray = false;
+			std::vector<FieldLayoutInfo> fields;
+			const FieldMember *unsizedField = nullptr;
+			const VariableDeclarator *unsizedDeclarator = nullptr;
 
 			for (const std::unique_ptr<StructMember> &member : aggregate.members)
 			{
@@ -744,46 +745,50 @@ void writeIndent(std::ostringstream &oss, int indent)
 				const auto &field = static_cast<const FieldMember &>(*member);
 				for (const VariableDeclarator &declarator : field.declaration.declarators)
 				{
-					const bool hasArray = declarator.hasArraySuffix;
-					const bool hasSize = declarator.hasArraySize;
-					if (hasArray && !hasSize)
+					if (declarator.hasArraySuffix && !declarator.hasArraySize)
 					{
-						const std::string blockName = sanitizeIdentifier(block.name);
-						const std::string arrayName = sanitizeIdentifier(safeTokenContent(declarator.name));
-						const std::string sizeName = "spk_" + blockName + "_" + arrayName + "_size";
-						const int sizeAlignment = 4;
-						const int sizeOffset = roundUp(currentOffset, sizeAlignment);
-						BlockMember sizeMember;
-						sizeMember.name = sizeName;
-						sizeMember.kind = "Element";
-						sizeMember.offset = sizeOffset;
-						sizeMember.size = 4;
-						sizeMember.elementSize = 0;
-						sizeMember.elementCount = 0;
-						currentOffset = sizeOffset + sizeMember.size;
-						maxAlign = std::max(maxAlign, sizeAlignment);
-						members.push_back(std::move(sizeMember));
-
-						assignDynamicArray(block, field.declaration.type, declarator, recursion, layout, currentOffset, maxAlign);
-						hasDynamicArray = true;
+						unsizedField = &field;
+						unsizedDeclarator = &declarator;
 						break;
 					}
-
-					FieldLayoutInfo info = layoutField(field.declaration.type, declarator, layout, recursion);
-					const int alignedOffset = roundUp(currentOffset, info.alignment);
-					info.member.offset = alignedOffset;
-					info.member.size = info.size;
-					currentOffset = alignedOffset + info.size;
-					maxAlign = std::max(maxAlign, info.alignment);
-					members.push_back(std::move(info.member));
+					fields.push_back(layoutField(block.name, field.declaration.type, declarator, layout));
 				}
 
-				if (hasDynamicArray)
+				if (unsizedDeclarator)
 				{
 					break;
 				}
 			}
 
+			// The element count and the runtime-sized array always close the block.
+			std::size_t pinned = 0;
+			int trailingAlignment = 1;
+			if (unsizedDeclarator)
+			{
+				const std::string blockName = sanitizeIdentifier(block.name);
+				const std::string arrayName = sanitizeIdentifier(safeTokenContent(unsizedDeclarator->name));
+				FieldLayoutInfo sizeField;
+				sizeField.member.name = "spk_" + blockName + "_" + arrayName + "_size";
+				sizeField.member.kind = "Element";
+				sizeField.member.typeName = "uint";
+				sizeField.size = 4;
+				sizeField.alignment = 4;
+				fields.push_back(std::move(sizeField));
+				pinned = 1;
+				trailingAlignment = layoutType(unsizedField->declaration.type, layout).alignment;
+			}
+
+			std::vector<BlockMember> members;
+			int currentOffset = 0;
+			int maxAlign = 1;
+			const std::vector<std::size_t> order = arrangeFields(block.name, fields, pinned, trailingAlignment);
+			placeFields(fields, order, members, currentOffset, maxAlign);
+
+			if (unsizedDeclarator)
+			{
+				assignDynamicArray(block, unsizedField->declaration.type, *unsizedDeclarator, layout, currentOffset, maxAlign);
+			}
+
 			int blockAlignment = maxAlign;
 			if (layout == MemoryLayout::Std140)
 			{
@@ -802,6 +807,43 @@ void writeIndent(std::ostringstream &oss, int indent)
 			return members;
 		}
 
+		// Places a member the converter derived after the last one, as std430 does for the member GLSL declares
+		// last.
+		void appendDerivedMember(BlockDefinition &block, const DerivedBlockField &field) const
+		{
+			const MemoryLayout layout = MemoryLayout::Std430;
+			int end = 0;
+			int blockAlignment = 1;
+			for (const BlockMember &member : block.members)
+			{
+				end = std::max(end, member.offset + member.size);
+				blockAlignment = std::max(blockAlignment, layoutType(member.typeName, layout).alignment);
+			}
+
+			const TypeLayoutInfo &typeLayout = layoutType(field.typeName, layout);
+			BlockMember member;
+			member.name = field.name;
+			member.typeName = field.typeName;
+			member.offset = roundUp(end, typeLayout.alignment);
+			member.size = typeLayout.size;
+			member.derivedExpression = field.expression;
+			block.size = roundUp(member.offset + member.size, std::max(blockAlignment, typeLayout.alignment));
+			block.members.push_back(std::move(member));
+		}
+
+		std::vector<StructDefinition> describeStructs() const
+		{
+			const MemoryLayout layout = MemoryLayout::Std430;
+			std::vector<StructDefinition> structures;
+			structures.reserve(structOrder.size());
+			for (const std::string &name : structOrder)
+			{
+				const TypeLayoutInfo &info = layoutType(name, layout);
+				structures.push_back(StructDefinition{name, info.size, info.alignment, info.members});
+			}
+			return structures;
+		}
+
 		std::string qualify(const Token &name) const
 		{
 			std::string qualified;
@@ -836,33 +878,40 @@ void writeIndent(std::ostringstream &oss, int indent)
 		}
 
 	private:
-		FieldLayoutInfo layoutField(
+		FieldLayoutInfo layoutField(const std::string &ownerName,
 		    const TypeName &type,
 		    const VariableDeclarator &declarator,
-		    MemoryLayout layout,
-		    std::vector<std::string> &recursion) const;
+		    MemoryLayout layout) const;
 
-		TypeLayoutInfo layoutType(const TypeName &type, MemoryLayout layout, std::vector<std::string> &recursion) const;
+		// Size of a sized array member of p_ownerName, evaluated in the namespace the owner is declared in.
+		int evaluateArrayLength(const std::string &ownerName, const VariableDeclarator &declarator) const;
+		std::optional<ConstantValue> evaluateConstant(
+		    const Expression &expression, const std::vector<std::string> &scope) const;
+		std::optional<ConstantValue> constGlobalValue(const Name &name, const std::vector<std::string> &scope) const;
+
+		const TypeLayoutInfo &layoutType(const TypeName &type, MemoryLayout layout) const;
+		const TypeLayoutInfo &layoutType(const std::string &typeName, MemoryLayout layout) const;
 
 		TypeLayoutInfo layoutAggregateType(
-		    const AggregateInstruction &aggregate,
-		    MemoryLayout layout,
-		    std::vector<std::string> &recursion) const;
+		    const std::string &qualifiedName, const AggregateInstruction &aggregate, MemoryLayout layout) const;
+
+		std::vector<std::size_t> arrangeFields(const std::string &aggregateName,
+		    const std::vector<FieldLayoutInfo> &fields,
+		    std::size_t pinned,
+		    int trailingAlignment) const;
 
 		bool aggregateHasUnsizedArray(const AggregateInstruction &aggregate) const;
 	};
 
 	FieldLayoutInfo CompilerContext::layoutField(
-	    const TypeName &type,
-	    const VariableDeclarator &declarator,
-	    MemoryLayout layout,
-	    std::vector<std::string> &recursion) const
+	    const std::string &ownerName, const TypeName &type, const VariableDeclarator &declarator, MemoryLayout layout) const
 	{
 		FieldLayoutInfo result;
 		result.member.name = safeTokenContent(declarator.name);
 		result.member.kind = "Element";
+		result.member.typeName = formatName(type.name);
 
-		TypeLayoutInfo typeLayout = layoutType(type, layout, recursion);
+		const TypeLayoutInfo &typeLayout = layoutType(type, layout);
 		result.member.members = typeLayout.members;
 		result.size = typeLayout.size;
 		result.alignment = typeLayout.alignment;
@@ -887,8 +936,7 @@ void writeIndent(std::ostringstream &oss, int indent)
 			}
 
 			result.member.elementSize = stride;
-			const std::optional<int> count = evaluateArrayLength(declarator);
-			result.member.elementCount = count.value_or(0);
+			result.member.elementCount = evaluateArrayLength(ownerName, declarator);
 			result.alignment = arrayAlignment;
 			result.size = stride * result.member.elementCount;
 		}
@@ -897,43 +945,195 @@ void writeIndent(std::ostringstream &oss, int indent)
 		return result;
 	}
 
-	TypeLayoutInfo CompilerContext::layoutType(
-	    const TypeName &type, MemoryLayout layout, std::vector<std::string> &recursion) const
+	int CompilerContext::evaluateArrayLength(const std::string &ownerName, const VariableDeclarator &declarator) const
 	{
-		TypeLayoutInfo info;
-		const std::string typeName = formatName(type.name);
-		if (typeName.empty())
+		const std::string arrayName = safeTokenContent(declarator.name);
+		if (!declarator.hasArraySize || !declarator.arraySize)
 		{
-			info.size = 0;
-			info.alignment = 4;
-			return info;
+			return 0;
+		}
+
+		const std::optional<ConstantValue> value = evaluateConstant(*declarator.arraySize, namespaceOf(ownerName));
+		if (!value || value->shape != ConstantValue::Shape::Scalar ||
+		    (value->scalar != ConstantValue::Scalar::Int && value->scalar != ConstantValue::Scalar::UInt))
+		{
+			throw std::runtime_error("Size of array '" + arrayName + "' in '" + ownerName +
+			                         "' is not a constant integer expression");
+		}
+		const double length = value->components.front();
+		if (length <= 0 || length > static_cast<double>(std::numeric_limits<int>::max()))
+		{
+			throw std::runtime_error("Size of array '" + arrayName + "' in '" + ownerName + "' is out of range");
 		}
+		return static_cast<int>(length);
+	}
 
+	std::optional<ConstantValue> CompilerContext::evaluateConstant(
+	    const Expression &expression, const std::vector<std::string> &scope) const
+	{
+		switch (expression.kind)
+		{
+			case Expression::Kind::Literal:
+				return parseConstantLiteral(static_cast<const LiteralExpression &>(expression).literal.content);
+			case Expression::Kind::Identifier:
+				return constGlobalValue(static_cast<const IdentifierExpression &>(expression).name, scope);
+			case Expression::Kind::Unary:
+			{
+				const auto &unary = static_cast<const UnaryExpression &>(expression);
+				if (!unary.operand)
+				{
+					return std::nullopt;
+				}
+				const std::optional<ConstantValue> operand = evaluateConstant(*unary.operand, scope);
+				return operand ? foldUnary(unary.op, *operand) : std::nullopt;
+			}
+			case Expression::Kind::Binary:
+			{
+				const auto &binary = static_cast<const BinaryExpression &>(expression);
+				if (!binary.left || !binary.right)
+				{
+					return std::nullopt;
+				}
+				const std::optional<ConstantValue> left = evaluateConstant(*binary.left, scope);
+				const std::optional<ConstantValue> right = evaluateConstant(*binary.right, scope);
+				return left && right ? foldBinary(binary.op, *left, *right) : std::nullopt;
+			}
+			case Expression::Kind::Conditional:
+			{
+				const auto &conditional = static_cast<const ConditionalExpression &>(expression);
+				if (!conditional.condition || !conditional.thenBranch || !conditional.elseBranch)
+				{
+					return std::nullopt;
+				}
+				const std::optional<ConstantValue> condition = evaluateConstant(*conditional.condition, scope);
+				if (!condition || condition->shape != ConstantValue::Shape::Scalar ||
+				    condition->scalar != ConstantValue::Scalar::Bool)
+				{
+					return std::nullopt;
+				}
+				const std::optional<ConstantValue> thenValue = evaluateConstant(*conditional.thenBranch, scope);
+				const std::optional<ConstantValue> elseValue = evaluateConstant(*conditional.elseBranch, scope);
+				if (!thenValue || !elseValue || thenValue->glslType() != elseValue->glslType())
+				{
+					return std::nullopt;
+				}
+				return condition->components.front() != 0.0 ? thenValue : elseValue;
+			}
+			case Expression::Kind::Call:
+			{
+				// Scalar conversions such as uint(N); other constructors cannot size an array.
+				const auto &call = static_cast<const CallExpression &>(expression);
+				const auto *callee = dynamic_cast<const IdentifierExpression *>(call.callee.get());
+				if (!callee || !isScalarType(formatName(callee->name)))
+				{
+					return std::nullopt;
+				}
+				std::vector<ConstantValue> arguments;
+				for (const std::unique_ptr<Expression> &argument : call.arguments)
+				{
+					std::optional<ConstantValue> value = argument ? evaluateConstant(*argument, scope) : std::nullopt;
+					if (!value)
+					{
+						return std::nullopt;
+					}
+					arguments.push_back(std::move(*value));
+				}
+				return foldConstruct(formatName(callee->name), arguments);
+			}
+			default:
+				return std::nullopt;
+		}
+	}
+
+	// Resolved like the converter resolves names: from the innermost enclosing namespace outwards.
+	std::optional<ConstantValue> CompilerContext::constGlobalValue(
+	    const Name &name, const std::vector<std::string> &scope) const
+	{
+		const std::string text = formatName(name);
+		auto global = constGlobals.end();
+		if (name.parts.size() == 1)
+		{
+			for (std::size_t depth = scope.size(); depth > 0 && global == constGlobals.end(); --depth)
+			{
+				std::string qualified;
+				for (std::size_t i = 0; i < depth; ++i)
+				{
+					qualified += scope[i] + "::";
+				}
+				global = constGlobals.find(qualified + text);
+			}
+		}
+		if (global == constGlobals.end())
+		{
+			global = constGlobals.find(text);
+		}
+		if (global == constGlobals.end())
+		{
+			return std::nullopt;
+		}
+
+		const auto &[variable, declarator] = global->second;
+		if (const auto known = constGlobalValues.find(declarator); known != constGlobalValues.end())
+		{
+			return known->second;
+		}
+		// Also what a global whose initializer refers back to itself evaluates to.
+		constGlobalValues[declarator] = std::nullopt;
+		if (declarator->hasArraySuffix || !declarator->initializer)
+		{
+			return std::nullopt;
+		}
+
+		std::optional<ConstantValue> value = evaluateConstant(*declarator->initializer, namespaceOf(global->first));
+		if (value && value->glslType() != formatName(variable->declaration.type.name))
+		{
+			value.reset();
+		}
+		constGlobalValues[declarator] = value;
+		return value;
+	}
+
+	const TypeLayoutInfo &CompilerContext::layoutType(const TypeName &type, MemoryLayout layout) const
+	{
+		return layoutType(formatName(type.name), layout);
+	}
+
+	const TypeLayoutInfo &CompilerContext::layoutType(const std::string &typeName, MemoryLayout layout) const
+	{
+		static const TypeLayoutInfo kUnnamedLayout{0, 4, {}};
+		static const TypeLayoutInfo kUnresolvedLayout{0, 16, {}};
+
+		LayoutCacheKey key{typeName, layout};
+		if (key.typeName.empty())
+		{
+			return kUnnamedLayout;
+		}
+
+		if (const auto cached = layoutCache.find(key); cached != layoutCache.end())
+		{
+			return cached->second;
+		}
+
+		TypeLayoutInfo info;
+		int components = 0;
+		int columns = 0;
+		int rows = 0;
 		if (isScalarType(typeName))
 		{
 			info.size = 4;
 			info.alignment = 4;
-			return info;
 		}
-
-		if (isColorType(typeName))
+		else if (isColorType(typeName))
 		{
 			info.size = 16;
 			info.alignment = 16;
-			return info;
 		}
-
-		int components = 0;
-		if (tryParseVector(typeName, components))
+		else if (tryParseVector(typeName, components))
 		{
 			info.size = components * 4;
 			info.alignment = (components == 2) ? 8 : 16;
-			return info;
 		}
-
-		int columns = 0;
-		int rows = 0;
-		if (tryParseMatrix(typeName, columns, rows))
+		else if (tryParseMatrix(typeName, columns, rows))
 		{
 			int columnAlignment = (rows == 2) ? 8 : 16;
 			if (layout == MemoryLayout::Std140)
@@ -943,70 +1143,113 @@ void writeIndent(std::ostringstream &oss, int indent)
 			const int stride = roundUp(rows * 4, (layout == MemoryLayout::Std140) ? 16 : columnAlignment);
 			info.size = stride * columns;
 			info.alignment = columnAlignment;
-			return info;
 		}
-
-		const auto structIt = structLookup.find(typeName);
-		if (structIt == structLookup.end())
+		else
 		{
-			info.size = 0;
-			info.alignment = 16;
-			return info;
-		}
+			const auto structIt = structLookup.find(typeName);
+			if (structIt == structLookup.end())
+			{
+				return kUnresolvedLayout;
+			}
 
-		if (std::find(recursion.begin(), recursion.end(), typeName) != recursion.end())
-		{
-			info.size = 0;
-			info.alignment = 16;
-			return info;
+			if (std::find(layoutStack.begin(), layoutStack.end(), typeName) != layoutStack.end())
+			{
+				layoutCycleDetected = true;
+				return kUnresolvedLayout;
+			}
+
+			const bool outerCycleDetected = layoutCycleDetected;
+			layoutCycleDetected = false;
+			layoutStack.push_back(typeName);
+			info = layoutAggregateType(typeName, *structIt->second, layout);
+			layoutStack.pop_back();
+
+			// A layout computed while a recursive type was cut short depends on where the walk started.
+			const bool cycleDetected = layoutCycleDetected;
+			layoutCycleDetected = outerCycleDetected || cycleDetected;
+			if (cycleDetected)
+			{
+				uncachedLayouts.push_back(std::move(info));
+				return uncachedLayouts.back();
+			}
 		}
 
-		recursion.push_back(typeName);
-		info = layoutAggregateType(*structIt->second, layout, recursion);
-		recursion.pop_back();
-		return info;
+		return layoutCache.emplace(std::move(key), std::move(info)).first->second;
 	}
 
 TypeLayoutInfo CompilerContext::layoutAggregateType(
-    const AggregateInstruction &aggregate,
-    MemoryLayout layout,
-    std::vector<std::string> &recursion) const
+    const std::string &qualifiedName, const AggregateInstruction &aggregate, MemoryLayout layout) const
 {
-		TypeLayoutInfo info;
-		int currentOffset = 0;
-		int maxAlign = 1;
-
-		for (const std::unique_ptr<StructMember> &member : aggregate.members)
+	std::vector<FieldLayoutInfo> fields;
+	for (const std::unique_ptr<StructMember> &member : aggregate.members)
+	{
+		if (!member || member->kind != StructMember::Kind::Field)
 		{
-			if (!member || member->kind != StructMember::Kind::Field)
-			{
-				continue;
-			}
-
-			const auto &field = static_cast<const FieldMember &>(*member);
-			for (const VariableDeclarator &declarator : field.declaration.declarators)
-			{
-				FieldLayoutInfo fieldLayout = layoutField(field.declaration.type, declarator, layout, recursion);
-				const int alignedOffset = roundUp(currentOffset, fieldLayout.alignment);
-				fieldLayout.member.offset = alignedOffset;
-				fieldLayout.member.size = fieldLayout.size;
-				currentOffset = alignedOffset + fieldLayout.size;
-				maxAlign = std::max(maxAlign, fieldLayout.alignment);
-				info.members.push_back(std::move(fieldLayout.member));
-			}
+			continue;
 		}
 
-		int structAlignment = maxAlign;
-		if (layout == MemoryLayout::Std140)
+		const auto &field = static_cast<const FieldMember &>(*member);
+		for (const VariableDeclarator &declarator : field.declaration.declarators)
 		{
-			structAlignment = roundUp(structAlignment, 16);
+			fields.push_back(layoutField(qualifiedName, field.declaration.type, declarator, layout));
 		}
+	}
+
+	TypeLayoutInfo info;
+	int currentOffset = 0;
+	int maxAlign = 1;
+	const std::vector<std::size_t> order = arrangeFields(qualifiedName, fields, 0, 1);
+	placeFields(fields, order, info.members, currentOffset, maxAlign);
+
+	int structAlignment = maxAlign;
+	if (layout == MemoryLayout::Std140)
+	{
+		structAlignment = roundUp(structAlignment, 16);
+	}
 
 	info.size = roundUp(currentOffset, structAlignment);
 	info.alignment = structAlignment;
 	return info;
 }
 
+std::vector<std::size_t> CompilerContext::arrangeFields(const std::string &aggregateName,
+    const std::vector<FieldLayoutInfo> &fields,
+    std::size_t pinned,
+    int trailingAlignment) const
+{
+	std::vector<std::size_t> declared(fields.size());
+	std::iota(declared.begin(), declared.end(), std::size_t{0});
+	if (!reorderMembers)
+	{
+		return declared;
+	}
+
+	std::vector<std::size_t> order = minimizePadding(fields, pinned, trailingAlignment);
+	const bool alreadyReported = std::any_of(reorderReports.begin(),
+	    reorderReports.end(),
+	    [&](const MemberReorderReport &report) { return report.name == aggregateName; });
+	if (alreadyReported)
+	{
+		return order;
+	}
+
+	MemberReorderReport report;
+	report.name = aggregateName;
+	report.declaredSize = measureFieldOrder(fields, declared, trailingAlignment);
+	report.reorderedSize = measureFieldOrder(fields, order, trailingAlignment);
+	reorderReports.push_back(std::move(report));
+
+	if (order != declared)
+	{
+		std::vector<std::string> &names = memberOrders[aggregateName];
+		for (std::size_t index : order)
+		{
+			names.push_back(fields[index].member.name);
+		}
+	}
+	return order;
+}
+
 bool CompilerContext::aggregateHasUnsizedArray(const AggregateInstruction &aggregate) const
 {
 	for (const std::unique_ptr<StructMember> &member : aggregate.members)
@@ -1028,10 +1271,10 @@ bool CompilerContext::aggregateHasUnsizedArray(const AggregateInstruction &aggre
 
 	return false;
 }
+}
 
-std::string emitJson(const CompilerContext &context)
+void Compiler::emitJson(const ShaderArtifact &artifact, OutputSink &oss)
 {
-	std::ostringstream oss;
 	oss << "{\n";
 
 		writeIndent(oss, 2);
@@ -1045,27 +1288,13 @@ std::string emitJson(const CompilerContext &context)
 		writeIndent(oss, 6);
 		writeJsonString(oss, "vertex");
 		oss << ": ";
-		if (context.hasVertexStage)
-		{
-			writeJsonString(oss, context.vertexSource);
-		}
-		else
-		{
-			writeJsonString(oss, "");
-		}
+		writeJsonString(oss, artifact.vertexSource);
 		oss << ",\n";
 
 		writeIndent(oss, 6);
 		writeJsonString(oss, "fragment");
 		oss << ": ";
-		if (context.hasFragmentStage)
-		{
-			writeJsonString(oss, context.fragmentSource);
-		}
-		else
-		{
-			writeJsonString(oss, "");
-		}
+		writeJsonString(oss, artifact.fragmentSource);
 		oss << "\n";
 
 		writeIndent(oss, 4);
@@ -1080,7 +1309,7 @@ std::string emitJson(const CompilerContext &context)
 		writeJsonArray(
 		    oss,
 		    2,
-		    context.layouts,
+		    artifact.layouts,
 		    [&](const LayoutEntry &entry, int entryIndent)
 		    {
 			    writeIndent(oss, entryIndent);
@@ -1107,13 +1336,54 @@ std::string emitJson(const CompilerContext &context)
 		    });
 		oss << ",\n";
 
+		writeIndent(oss, 2);
+		writeJsonString(oss, "varyings");
+		oss << ": ";
+		writeJsonArray(
+		    oss,
+		    2,
+		    artifact.varyings,
+		    [&](const StageIO &entry, int entryIndent)
+		    {
+			    writeIndent(oss, entryIndent);
+			    oss << "{\n";
+
+			    writeIndent(oss, entryIndent + 2);
+			    writeJsonString(oss, "location");
+			    oss << ": " << entry.location << ",\n";
+
+			    writeIndent(oss, entryIndent + 2);
+			    writeJsonString(oss, "component");
+			    oss << ": " << entry.component << ",\n";
+
+			    writeIndent(oss, entryIndent + 2);
+			    writeJsonString(oss, "type");
+			    oss << ": ";
+			    writeJsonString(oss, entry.type);
+			    oss << ",\n";
+
+			    writeIndent(oss, entryIndent + 2);
+			    writeJsonString(oss, "name");
+			    oss << ": ";
+			    writeJsonString(oss, entry.name);
+			    oss << ",\n";
+
+			    writeIndent(oss, entryIndent + 2);
+			    writeJsonString(oss, "flat");
+			    oss << ": " << (entry.flat ? "true" : "false") << "\n";
+
+			    writeIndent(oss, entryIndent);
+			    oss << "}";
+		    });
+		oss << ",\n";
+
 		writeIndent(oss, 2);
 		writeJsonString(oss, "framebuffers");
 		oss << ": ";
 		writeJsonArray(
 		    oss,
 		    2,
-		    context.framebuffers,
+		    artifact.framebuffers,
 		    [&](const FramebufferEntry &entry, int entryIndent)
 		    {
 			    writeIndent(oss, entryIndent);
@@ -1146,7 +1416,7 @@ std::string emitJson(const CompilerContext &context)
 		writeJsonArray(
 		    oss,
 		    2,
-		    context.textures,
+		    artifact.textures,
 		    [&](const TextureEntry &entry, int entryIndent)
 		    {
 			    writeIndent(oss, entryIndent);
@@ -1186,7 +1456,7 @@ std::string emitJson(const CompilerContext &context)
 		writeJsonArray(
 		    oss,
 		    2,
-		    context.constants,
+		    artifact.constants,
 		    [&](const BlockDefinition &block, int blockIndent)
 		    {
 			    writeIndent(oss, blockIndent);
@@ -1238,7 +1508,7 @@ std::string emitJson(const CompilerContext &context)
 		writeJsonArray(
 		    oss,
 		    2,
-		    context.attributes,
+		    artifact.attributes,
 		    [&](const BlockDefinition &block, int blockIndent)
 		    {
 			    writeIndent(oss, blockIndent);
@@ -1285,23 +1555,25 @@ std::string emitJson(const CompilerContext &context)
 		oss << "\n";
 
 		oss << "}\n";
-		return oss.str();
+		oss.flush();
 	}
+
+std::string Compiler::emitJson(const ShaderArtifact &artifact)
+{
+	std::string json;
+	StringOutputSink sink(json);
+	emitJson(artifact, sink);
+	return json;
 }
 
-Compiler::Compiler(bool enableDebugOutput) : debugEnabled(enableDebugOutput) {}
+Compiler::Compiler(CompileOptions p_options) : options(p_options) {}
 
-std::string Compiler::operator()(const SemanticParseResult &result) const
+ShaderArtifact Compiler::compile(const SemanticParseResult &result) const
 {
+	std::optional<PassTimer> layoutTimer(std::in_place, "layout");
 	CompilerContext context;
-	StageIO triangleIndex;
-	triangleIndex.location = 0;
-	triangleIndex.type = "uint";
-	triangleIndex.name = "triangleIndex";
-	triangleIndex.flat = true;
-	context.varyings.push_back(std::move(triangleIndex));
-	context.nextVaryingLocation = 1;
-	context.collectStructs(result.instructions);
+	context.reorderMembers = options.reorderMembers;
+	context.collectDeclarations(result.instructions);
 	context.namespaceStack.clear();
 	context.process(result.instructions);
 	// Reassign locations to keep them sequential starting at zero.
@@ -1310,6 +1582,9 @@ std::string Compiler::operator()(const SemanticParseResult &result) const
 		context.framebuffers[i].location = static_cast<int>(i);
 	}
 	context.nextFramebufferLocation = static_cast<int>(context.framebuffers.size());
+	// Structs no block refers to are laid out here, before their member order is handed to the converter.
+	std::vector<StructDefinition> structures = context.describeStructs();
+	layoutTimer.reset();
 
 	ConverterInput converterInput{
 	    .semantic = result,
@@ -1317,13 +1592,33 @@ std::string Compiler::operator()(const SemanticParseResult &result) const
 	    .stageVaryings = context.varyings,
 	    .fragmentOutputs = context.framebuffers,
 	    .textures = context.textures,
+	    .memberOrders = context.memberOrders,
+	    .options = options,
 	};
 
 	Converter converter;
 	ShaderSources sources = converter(converterInput);
 
-	if (debugEnabled)
+	for (const DerivedBlockField &field : sources.derivedFields)
+	{
+		for (std::vector<BlockDefinition> *blocks : {&context.constants, &context.attributes})
+		{
+			for (BlockDefinition &block : *blocks)
+			{
+				if (block.name == field.block)
+				{
+					context.appendDerivedMember(block, field);
+				}
+			}
+		}
+	}
+
+	if (options.debug)
 	{
+		if (options.useIr)
+		{
+			std::cout << "\n=== Vertex IR ===\n" << sources.vertexIr << "\n=== Fragment IR ===\n" << sources.fragmentIr;
+		}
 		if (!sources.vertex.empty())
 		{
 			std::cout << "\n=== Vertex Shader ===\n" << sources.vertex << "\n";
@@ -1343,10 +1638,23 @@ std::string Compiler::operator()(const SemanticParseResult &result) const
 		}
 	}
 
-	context.hasVertexStage = !sources.vertex.empty();
-	context.vertexSource = std::move(sources.vertex);
-	context.hasFragmentStage = !sources.fragment.empty();
-	context.fragmentSource = std::move(sources.fragment);
+	ShaderArtifact artifact;
+	artifact.vertexSource = std::move(sources.vertex);
+	artifact.fragmentSource = std::move(sources.fragment);
+	artifact.layouts = std::move(context.layouts);
+	artifact.varyings = std::move(sources.varyings);
+	artifact.framebuffers = std::move(context.framebuffers);
+	artifact.textures = std::move(context.textures);
+	artifact.constants = std::move(context.constants);
+	artifact.attributes = std::move(context.attributes);
+	artifact.structures = std::move(structures);
+	artifact.memberReorders = std::move(context.reorderReports);
+	artifact.derivedFields = std::move(sources.derivedFields);
+	artifact.movedVaryings = std::move(sources.movedVaryings);
+	return artifact;
+}
 
-	return emitJson(context);
+std::string Compiler::operator()(const SemanticParseResult &result) const
+{
+	return emitJson(compile(result));
 }
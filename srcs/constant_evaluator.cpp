@@ -0,0 +1,1204 @@
+#include "constant_evaluator.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+	using Scalar = ConstantValue::Scalar;
+	using Shape = ConstantValue::Shape;
+
+	constexpr double kIntMin = std::numeric_limits<std::int32_t>::min();
+	constexpr double kIntMax = std::numeric_limits<std::int32_t>::max();
+	constexpr double kUIntMax = std::numeric_limits<std::uint32_t>::max();
+
+	double wrapInt(std::int64_t value)
+	{
+		return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+	}
+
+	double wrapUInt(std::uint64_t value)
+	{
+		return static_cast<std::uint32_t>(value);
+	}
+
+	// Nothing when the value does not survive rounding to single precision.
+	std::optional<double> toFloat(double value)
+	{
+		if (!std::isfinite(value) || std::fabs(value) > std::numeric_limits<float>::max())
+		{
+			return std::nullopt;
+		}
+		return static_cast<float>(value);
+	}
+
+	ConstantValue withShapeOf(const ConstantValue &shape, Scalar scalar)
+	{
+		ConstantValue result;
+		result.scalar = scalar;
+		result.shape = shape.shape;
+		result.columns = shape.columns;
+		result.rows = shape.rows;
+		return result;
+	}
+
+	bool sameShape(const ConstantValue &left, const ConstantValue &right)
+	{
+		return left.shape == right.shape && left.columns == right.columns && left.rows == right.rows;
+	}
+
+	bool isInteger(Scalar scalar)
+	{
+		return scalar == Scalar::Int || scalar == Scalar::UInt;
+	}
+
+	// GLSL constructor conversion of one component.
+	std::optional<double> convertComponent(double value, Scalar from, Scalar to)
+	{
+		if (from == to)
+		{
+			return value;
+		}
+		switch (to)
+		{
+			case Scalar::Bool:
+				return value != 0.0 ? 1.0 : 0.0;
+			case Scalar::Float:
+				return toFloat(value);
+			case Scalar::Int:
+				if (from == Scalar::UInt)
+				{
+					return wrapInt(static_cast<std::int64_t>(value));
+				}
+				value = std::trunc(value);
+				if (value < kIntMin || value > kIntMax)
+				{
+					return std::nullopt;
+				}
+				return value;
+			case Scalar::UInt:
+				if (from == Scalar::Int)
+				{
+					return wrapUInt(static_cast<std::uint64_t>(static_cast<std::int64_t>(value)));
+				}
+				value = std::trunc(value);
+				if (value < 0.0 || value > kUIntMax)
+				{
+					return std::nullopt;
+				}
+				return value;
+		}
+		return std::nullopt;
+	}
+
+	std::optional<ConstantValue> convert(const ConstantValue &value, Scalar to)
+	{
+		if (value.scalar == to)
+		{
+			return value;
+		}
+		ConstantValue result = withShapeOf(value, to);
+		for (double component : value.components)
+		{
+			const std::optional<double> converted = convertComponent(component, value.scalar, to);
+			if (!converted)
+			{
+				return std::nullopt;
+			}
+			result.components.push_back(*converted);
+		}
+		return result;
+	}
+
+	// Implicit conversions only ever go from int to uint to float.
+	std::optional<Scalar> commonScalar(Scalar left, Scalar right)
+	{
+		if (left == right)
+		{
+			return left;
+		}
+		if (left == Scalar::Bool || right == Scalar::Bool)
+		{
+			return std::nullopt;
+		}
+		return std::max(left, right);
+	}
+
+	std::optional<std::vector<ConstantValue>> promoteAll(const std::vector<ConstantValue> &values, bool floatOnly)
+	{
+		if (values.empty())
+		{
+			return std::nullopt;
+		}
+		std::optional<Scalar> scalar = values.front().scalar;
+		for (const ConstantValue &value : values)
+		{
+			scalar = commonScalar(*scalar, value.scalar);
+			if (!scalar)
+			{
+				return std::nullopt;
+			}
+		}
+		if (floatOnly)
+		{
+			if (*scalar == Scalar::Bool)
+			{
+				return std::nullopt;
+			}
+			scalar = Scalar::Float;
+		}
+		std::vector<ConstantValue> promoted;
+		for (const ConstantValue &value : values)
+		{
+			std::optional<ConstantValue> converted = convert(value, *scalar);
+			if (!converted)
+			{
+				return std::nullopt;
+			}
+			promoted.push_back(std::move(*converted));
+		}
+		return promoted;
+	}
+
+	using ComponentFunction = std::function<std::optional<double>(const std::vector<double> &)>;
+
+	// Applies p_function per component. Arguments whose bit is set in scalarMask may be scalars applied to every
+	// component; the others must all have the shape of the result.
+	std::optional<ConstantValue> mapComponents(
+	    const std::vector<ConstantValue> &arguments, unsigned scalarMask, Scalar resultScalar, const ComponentFunction &function)
+	{
+		const ConstantValue *shape = nullptr;
+		for (std::size_t i = 0; i < arguments.size(); ++i)
+		{
+			if ((scalarMask & (1u << i)) == 0)
+			{
+				shape = &arguments[i];
+				break;
+			}
+		}
+		if (!shape)
+		{
+			shape = &arguments.front();
+		}
+		if (shape->shape == Shape::Matrix)
+		{
+			return std::nullopt;
+		}
+		for (std::size_t i = 0; i < arguments.size(); ++i)
+		{
+			const bool broadcast = (scalarMask & (1u << i)) != 0 && arguments[i].shape == Shape::Scalar;
+			if (!broadcast && !sameShape(arguments[i], *shape))
+			{
+				return std::nullopt;
+			}
+		}
+
+		ConstantValue result = withShapeOf(*shape, resultScalar);
+		std::vector<double> operands(arguments.size());
+		for (std::size_t component = 0; component < shape->components.size(); ++component)
+		{
+			for (std::size_t i = 0; i < arguments.size(); ++i)
+			{
+				operands[i] = arguments[i].components.size() == 1 ? arguments[i].components.front()
+				                                                    : arguments[i].components[component];
+			}
+			std::optional<double> value = function(operands);
+			if (!value)
+			{
+				return std::nullopt;
+			}
+			if (resultScalar == Scalar::Float)
+			{
+				value = toFloat(*value);
+			}
+			else if (resultScalar == Scalar::Int && (*value < kIntMin || *value > kIntMax))
+			{
+				value.reset();
+			}
+			if (!value)
+			{
+				return std::nullopt;
+			}
+			result.components.push_back(*value);
+		}
+		return result;
+	}
+
+	std::optional<double> arithmetic(BinaryOperator op, Scalar scalar, double left, double right)
+	{
+		if (scalar == Scalar::Float)
+		{
+			const float x = static_cast<float>(left);
+			const float y = static_cast<float>(right);
+			float value = 0.0f;
+			switch (op)
+			{
+				case BinaryOperator::Add:
+					value = x + y;
+					break;
+				case BinaryOperator::Subtract:
+					value = x - y;
+					break;
+				case BinaryOperator::Multiply:
+					value = x * y;
+					break;
+				case BinaryOperator::Divide:
+					value = x / y;
+					break;
+				default:
+					return std::nullopt;
+			}
+			if (!std::isfinite(value))
+			{
+				return std::nullopt;
+			}
+			return value;
+		}
+
+		if (scalar == Scalar::Int)
+		{
+			const auto x = static_cast<std::int64_t>(left);
+			const auto y = static_cast<std::int64_t>(right);
+			switch (op)
+			{
+				case BinaryOperator::Add:
+					return wrapInt(x + y);
+				case BinaryOperator::Subtract:
+					return wrapInt(x - y);
+				case BinaryOperator::Multiply:
+					return wrapInt(x * y);
+				case BinaryOperator::Divide:
+					if (y == 0 || (x == kIntMin && y == -1))
+					{
+						return std::nullopt;
+					}
+					return static_cast<double>(x / y);
+				case BinaryOperator::Modulo:
+					// Undefined in GLSL for negative operands.
+					if (x < 0 || y <= 0)
+					{
+						return std::nullopt;
+					}
+					return static_cast<double>(x % y);
+				case BinaryOperator::BitwiseAnd:
+					return wrapInt(x & y);
+				case BinaryOperator::BitwiseOr:
+					return wrapInt(x | y);
+				case BinaryOperator::BitwiseXor:
+					return wrapInt(x ^ y);
+				default:
+					return std::nullopt;
+			}
+		}
+
+		if (scalar == Scalar::UInt)
+		{
+			const auto x = static_cast<std::uint64_t>(left);
+			const auto y = static_cast<std::uint64_t>(right);
+			switch (op)
+			{
+				case BinaryOperator::Add:
+					return wrapUInt(x + y);
+				case BinaryOperator::Subtract:
+					return wrapUInt(x - y);
+				case BinaryOperator::Multiply:
+					return wrapUInt(x * y);
+				case BinaryOperator::Divide:
+					return y == 0 ? std::nullopt : std::optional<double>(static_cast<double>(x / y));
+				case BinaryOperator::Modulo:
+					return y == 0 ? std::nullopt : std::optional<double>(static_cast<double>(x % y));
+				case BinaryOperator::BitwiseAnd:
+					return wrapUInt(x & y);
+				case BinaryOperator::BitwiseOr:
+					return wrapUInt(x | y);
+				case BinaryOperator::BitwiseXor:
+					return wrapUInt(x ^ y);
+				default:
+					return std::nullopt;
+			}
+		}
+		return std::nullopt;
+	}
+
+	std::optional<double> shift(BinaryOperator op, Scalar scalar, double left, double amount)
+	{
+		if (amount < 0.0 || amount > 31.0)
+		{
+			return std::nullopt;
+		}
+		const int bits = static_cast<int>(amount);
+		if (scalar == Scalar::Int)
+		{
+			const auto x = static_cast<std::int64_t>(left);
+			return op == BinaryOperator::ShiftLeft ? wrapInt(x << bits) : static_cast<double>(x >> bits);
+		}
+		const auto x = static_cast<std::uint64_t>(left);
+		return op == BinaryOperator::ShiftLeft ? wrapUInt(x << bits) : static_cast<double>(x >> bits);
+	}
+
+	double matrixAt(const ConstantValue &matrix, int column, int row)
+	{
+		return matrix.components[static_cast<std::size_t>(column * matrix.rows + row)];
+	}
+
+	// Linear-algebra product of matrices and vectors, accumulated in single precision like the GPU does.
+	std::optional<ConstantValue> linearMultiply(const ConstantValue &left, const ConstantValue &right)
+	{
+		const auto dotProduct = [](auto &&leftAt, auto &&rightAt, int count) -> std::optional<double> {
+			float sum = 0.0f;
+			for (int k = 0; k < count; ++k)
+			{
+				sum += static_cast<float>(leftAt(k)) * static_cast<float>(rightAt(k));
+			}
+			if (!std::isfinite(sum))
+			{
+				return std::nullopt;
+			}
+			return sum;
+		};
+
+		ConstantValue result;
+		result.scalar = Scalar::Float;
+		if (left.shape == Shape::Matrix && right.shape == Shape::Matrix)
+		{
+			if (right.rows != left.columns)
+			{
+				return std::nullopt;
+			}
+			result.shape = Shape::Matrix;
+			result.columns = right.columns;
+			result.rows = left.rows;
+			for (int column = 0; column < result.columns; ++column)
+			{
+				for (int row = 0; row < result.rows; ++row)
+				{
+					const std::optional<double> value =
+					    dotProduct([&](int k) { return matrixAt(left, k, row); },
+					        [&](int k) { return matrixAt(right, column, k); }, left.columns);
+					if (!value)
+					{
+						return std::nullopt;
+					}
+					result.components.push_back(*value);
+				}
+			}
+			return result;
+		}
+
+		result.shape = Shape::Vector;
+		if (left.shape == Shape::Matrix)
+		{
+			if (right.columns != left.columns)
+			{
+				return std::nullopt;
+			}
+			result.columns = left.rows;
+			for (int row = 0; row < left.rows; ++row)
+			{
+				const std::optional<double> value =
+				    dotProduct([&](int k) { return matrixAt(left, k, row); },
+				        [&](int k) { return right.components[static_cast<std::size_t>(k)]; }, left.columns);
+				if (!value)
+				{
+					return std::nullopt;
+				}
+				result.components.push_back(*value);
+			}
+			return result;
+		}
+
+		if (left.columns != right.rows)
+		{
+			return std::nullopt;
+		}
+		result.columns = right.columns;
+		for (int column = 0; column < right.columns; ++column)
+		{
+			const std::optional<double> value =
+			    dotProduct([&](int k) { return left.components[static_cast<std::size_t>(k)]; },
+			        [&](int k) { return matrixAt(right, column, k); }, right.rows);
+			if (!value)
+			{
+				return std::nullopt;
+			}
+			result.components.push_back(*value);
+		}
+		return result;
+	}
+
+	struct TypeShape
+	{
+		Scalar scalar = Scalar::Float;
+		Shape shape = Shape::Scalar;
+		int columns = 1;
+		int rows = 1;
+	};
+
+	std::optional<TypeShape> parseGlslType(const std::string &name)
+	{
+		if (name == "float" || name == "int" || name == "uint" || name == "bool")
+		{
+			const Scalar scalar = name == "float" ? Scalar::Float
+			                      : name == "int" ? Scalar::Int
+			                      : name == "uint" ? Scalar::UInt
+			                                       : Scalar::Bool;
+			return TypeShape{scalar};
+		}
+		const auto dimension = [](char c) { return c >= '2' && c <= '4' ? c - '0' : 0; };
+		if (name.size() == 4 && name.compare(0, 3, "mat") == 0 && dimension(name[3]))
+		{
+			return TypeShape{Scalar::Float, Shape::Matrix, dimension(name[3]), dimension(name[3])};
+		}
+		if (name.size() == 6 && name.compare(0, 3, "mat") == 0 && name[4] == 'x' && dimension(name[3]) &&
+		    dimension(name[5]))
+		{
+			return TypeShape{Scalar::Float, Shape::Matrix, dimension(name[3]), dimension(name[5])};
+		}
+		std::size_t prefix = 0;
+		Scalar scalar = Scalar::Float;
+		if (!name.empty() && (name[0] == 'i' || name[0] == 'u' || name[0] == 'b'))
+		{
+			prefix = 1;
+			scalar = name[0] == 'i' ? Scalar::Int : name[0] == 'u' ? Scalar::UInt : Scalar::Bool;
+		}
+		if (name.size() == prefix + 4 && name.compare(prefix, 3, "vec") == 0 && dimension(name.back()))
+		{
+			return TypeShape{scalar, Shape::Vector, dimension(name.back()), 1};
+		}
+		return std::nullopt;
+	}
+
+	std::string formatComponent(Scalar scalar, double value)
+	{
+		switch (scalar)
+		{
+			case Scalar::Bool:
+				return value != 0.0 ? "true" : "false";
+			case Scalar::Int:
+				return std::to_string(static_cast<std::int64_t>(value));
+			case Scalar::UInt:
+				return std::to_string(static_cast<std::uint64_t>(value)) + "u";
+			case Scalar::Float:
+				break;
+		}
+		char buffer[32];
+		const std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<float>(value));
+		std::string text(buffer, written.ptr);
+		if (text.find_first_of(".e") == std::string::npos)
+		{
+			text += ".0";
+		}
+		return text;
+	}
+
+	std::optional<double> floatFunction(const std::string &name, double x)
+	{
+		static const std::unordered_map<std::string, double (*)(double)> functions = {
+		    {"abs", [](double v) { return std::fabs(v); }},
+		    {"sign", [](double v) { return v > 0.0 ? 1.0 : v < 0.0 ? -1.0 : 0.0; }},
+		    {"floor", [](double v) { return std::floor(v); }}, {"ceil", [](double v) { return std::ceil(v); }},
+		    {"fract", [](double v) { return v - std::floor(v); }}, {"exp", [](double v) { return std::exp(v); }},
+		    {"log", [](double v) { return std::log(v); }}, {"exp2", [](double v) { return std::exp2(v); }},
+		    {"log2", [](double v) { return std::log2(v); }}, {"sqrt", [](double v) { return std::sqrt(v); }},
+		    {"inversesqrt", [](double v) { return 1.0 / std::sqrt(v); }}, {"sin", [](double v) { return std::sin(v); }},
+		    {"cos", [](double v) { return std::cos(v); }}, {"tan", [](double v) { return std::tan(v); }},
+		    {"asin", [](double v) { return std::asin(v); }}, {"acos", [](double v) { return std::acos(v); }},
+		    {"atan", [](double v) { return std::atan(v); }}};
+
+		// GLSL leaves these undefined outside their domain.
+		if (((name == "log" || name == "log2" || name == "inversesqrt") && x <= 0.0) || (name == "sqrt" && x < 0.0) ||
+		    ((name == "asin" || name == "acos") && std::fabs(x) > 1.0))
+		{
+			return std::nullopt;
+		}
+		const auto it = functions.find(name);
+		if (it == functions.end())
+		{
+			return std::nullopt;
+		}
+		return it->second(x);
+	}
+
+	std::optional<double> dot(const ConstantValue &left, const ConstantValue &right)
+	{
+		double sum = 0.0;
+		for (std::size_t i = 0; i < left.components.size(); ++i)
+		{
+			sum += left.components[i] * right.components[i];
+		}
+		return toFloat(sum);
+	}
+
+	bool isGenType(const ConstantValue &value)
+	{
+		return value.shape != Shape::Matrix;
+	}
+
+	// length, distance, normalize, dot, cross and reflect.
+	std::optional<ConstantValue> foldGeometric(const std::string &name, const std::vector<ConstantValue> &arguments)
+	{
+		for (const ConstantValue &argument : arguments)
+		{
+			if (!isGenType(argument) || !sameShape(argument, arguments.front()))
+			{
+				return std::nullopt;
+			}
+		}
+		const ConstantValue &first = arguments.front();
+		if (name == "length" && arguments.size() == 1)
+		{
+			const std::optional<double> squared = dot(first, first);
+			if (!squared)
+			{
+				return std::nullopt;
+			}
+			return ConstantValue::makeScalar(Scalar::Float, static_cast<float>(std::sqrt(*squared)));
+		}
+		if (name == "distance" && arguments.size() == 2)
+		{
+			double squared = 0.0;
+			for (std::size_t i = 0; i < first.components.size(); ++i)
+			{
+				const double delta = first.components[i] - arguments[1].components[i];
+				squared += delta * delta;
+			}
+			const std::optional<double> length = toFloat(std::sqrt(squared));
+			return length ? std::optional<ConstantValue>(ConstantValue::makeScalar(Scalar::Float, *length)) : std::nullopt;
+		}
+		if (name == "dot" && arguments.size() == 2)
+		{
+			const std::optional<double> value = dot(first, arguments[1]);
+			return value ? std::optional<ConstantValue>(ConstantValue::makeScalar(Scalar::Float, *value)) : std::nullopt;
+		}
+		if (name == "normalize" && arguments.size() == 1)
+		{
+			const std::optional<double> squared = dot(first, first);
+			if (!squared || *squared == 0.0)
+			{
+				return std::nullopt;
+			}
+			const double length = std::sqrt(*squared);
+			return mapComponents(arguments, 0, Scalar::Float,
+			    [length](const std::vector<double> &x) -> std::optional<double> { return x[0] / length; });
+		}
+		if (name == "cross" && arguments.size() == 2 && first.shape == Shape::Vector && first.columns == 3)
+		{
+			const std::vector<double> &a = first.components;
+			const std::vector<double> &b = arguments[1].components;
+			ConstantValue result = withShapeOf(first, Scalar::Float);
+			for (double component : {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]})
+			{
+				const std::optional<double> rounded = toFloat(component);
+				if (!rounded)
+				{
+					return std::nullopt;
+				}
+				result.components.push_back(*rounded);
+			}
+			return result;
+		}
+		if (name == "reflect" && arguments.size() == 2)
+		{
+			const std::optional<double> projection = dot(arguments[1], first);
+			if (!projection)
+			{
+				return std::nullopt;
+			}
+			const double scale = 2.0 * *projection;
+			return mapComponents(arguments, 0, Scalar::Float,
+			    [scale](const std::vector<double> &x) -> std::optional<double> { return x[0] - scale * x[1]; });
+		}
+		return std::nullopt;
+	}
+}
+
+ConstantValue ConstantValue::makeScalar(Scalar p_scalar, double p_value)
+{
+	ConstantValue value;
+	value.scalar = p_scalar;
+	value.components.push_back(p_value);
+	return value;
+}
+
+std::string ConstantValue::glslType() const
+{
+	if (shape == Shape::Matrix)
+	{
+		return columns == rows ? "mat" + std::to_string(columns)
+		                       : "mat" + std::to_string(columns) + "x" + std::to_string(rows);
+	}
+	if (shape == Shape::Vector)
+	{
+		const char *prefix = scalar == Scalar::Int ? "i" : scalar == Scalar::UInt ? "u" : scalar == Scalar::Bool ? "b" : "";
+		return prefix + std::string("vec") + std::to_string(columns);
+	}
+	switch (scalar)
+	{
+		case Scalar::Bool:
+			return "bool";
+		case Scalar::Int:
+			return "int";
+		case Scalar::UInt:
+			return "uint";
+		case Scalar::Float:
+			break;
+	}
+	return "float";
+}
+
+std::optional<std::string> ConstantValue::glsl() const
+{
+	return lumina(glslType());
+}
+
+std::optional<std::string> ConstantValue::lumina(const std::string &p_typeName) const
+{
+	for (double component : components)
+	{
+		if (!std::isfinite(component) || (scalar == Scalar::Int && component == kIntMin))
+		{
+			return std::nullopt;
+		}
+	}
+	if (shape == Shape::Scalar)
+	{
+		return formatComponent(scalar, components.front());
+	}
+
+	bool uniform = std::all_of(components.begin(), components.end(),
+	    [&](double component) { return component == components.front(); });
+	if (shape == Shape::Matrix && columns == rows)
+	{
+		// A scalar matrix constructor fills the diagonal and zeroes the rest.
+		uniform = true;
+		for (int column = 0; column < columns && uniform; ++column)
+		{
+			for (int row = 0; row < rows; ++row)
+			{
+				const double expected = column == row ? components.front() : 0.0;
+				if (matrixAt(*this, column, row) != expected)
+				{
+					uniform = false;
+					break;
+				}
+			}
+		}
+	}
+	else if (shape == Shape::Matrix)
+	{
+		uniform = false;
+	}
+
+	std::string text = p_typeName + "(";
+	const std::size_t count = uniform ? 1 : components.size();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		if (i > 0)
+		{
+			text += ", ";
+		}
+		text += formatComponent(scalar, components[i]);
+	}
+	return text + ")";
+}
+
+std::optional<ConstantValue> parseConstantLiteral(const std::string &p_text)
+{
+	if (p_text == "true" || p_text == "false")
+	{
+		return ConstantValue::makeScalar(Scalar::Bool, p_text == "true" ? 1.0 : 0.0);
+	}
+	if (p_text.empty() || p_text.find('"') != std::string::npos)
+	{
+		return std::nullopt;
+	}
+
+	std::string text = p_text;
+	const bool isHex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+	const bool isFloat = !isHex && (text.find_first_of(".eE") != std::string::npos || text.back() == 'f' ||
+	                                   text.back() == 'F');
+	if (isFloat)
+	{
+		if (text.back() == 'f' || text.back() == 'F')
+		{
+			text.pop_back();
+		}
+		double value = 0.0;
+		const char *end = text.data() + text.size();
+		const std::from_chars_result parsed = std::from_chars(text.data(), end, value);
+		if (parsed.ec != std::errc() || parsed.ptr != end)
+		{
+			return std::nullopt;
+		}
+		const std::optional<double> rounded = toFloat(value);
+		return rounded ? std::optional<ConstantValue>(ConstantValue::makeScalar(Scalar::Float, *rounded)) : std::nullopt;
+	}
+
+	const bool isUnsigned = text.back() == 'u' || text.back() == 'U';
+	if (isUnsigned)
+	{
+		text.pop_back();
+	}
+	std::uint64_t value = 0;
+	const char *begin = text.data() + (isHex ? 2 : 0);
+	const char *end = text.data() + text.size();
+	const std::from_chars_result parsed = std::from_chars(begin, end, value, isHex ? 16 : 10);
+	if (parsed.ec != std::errc() || parsed.ptr != end || value > (isUnsigned || isHex ? kUIntMax : kIntMax))
+	{
+		return std::nullopt;
+	}
+	if (isUnsigned)
+	{
+		return ConstantValue::makeScalar(Scalar::UInt, static_cast<double>(value));
+	}
+	// A hexadecimal int literal spells the bit pattern, so 0xFFFFFFFF is -1.
+	return ConstantValue::makeScalar(Scalar::Int, wrapInt(static_cast<std::int64_t>(value)));
+}
+
+std::optional<ConstantValue> foldUnary(UnaryOperator p_operator, const ConstantValue &p_operand)
+{
+	const Scalar scalar = p_operand.scalar;
+	ComponentFunction function;
+	switch (p_operator)
+	{
+		case UnaryOperator::Positive:
+			if (scalar == Scalar::Bool)
+			{
+				return std::nullopt;
+			}
+			return p_operand;
+		case UnaryOperator::Negate:
+			if (scalar == Scalar::Bool)
+			{
+				return std::nullopt;
+			}
+			function = [scalar](const std::vector<double> &x) -> std::optional<double> {
+				if (scalar == Scalar::Int)
+				{
+					return wrapInt(-static_cast<std::int64_t>(x[0]));
+				}
+				if (scalar == Scalar::UInt)
+				{
+					return wrapUInt(0u - static_cast<std::uint64_t>(x[0]));
+				}
+				return -x[0];
+			};
+			break;
+		case UnaryOperator::LogicalNot:
+			if (scalar != Scalar::Bool || p_operand.shape != Shape::Scalar)
+			{
+				return std::nullopt;
+			}
+			return ConstantValue::makeScalar(Scalar::Bool, p_operand.components.front() != 0.0 ? 0.0 : 1.0);
+		case UnaryOperator::BitwiseNot:
+			if (!isInteger(scalar))
+			{
+				return std::nullopt;
+			}
+			function = [scalar](const std::vector<double> &x) -> std::optional<double> {
+				if (scalar == Scalar::Int)
+				{
+					return wrapInt(~static_cast<std::int64_t>(x[0]));
+				}
+				return wrapUInt(~static_cast<std::uint64_t>(x[0]));
+			};
+			break;
+		case UnaryOperator::PreIncrement:
+		case UnaryOperator::PreDecrement:
+			return std::nullopt;
+	}
+
+	ConstantValue result = withShapeOf(p_operand, scalar);
+	for (double component : p_operand.components)
+	{
+		const std::optional<double> value = function({component});
+		if (!value)
+		{
+			return std::nullopt;
+		}
+		result.components.push_back(*value);
+	}
+	return result;
+}
+
+std::optional<ConstantValue> foldBinary(
+    BinaryOperator p_operator, const ConstantValue &p_left, const ConstantValue &p_right)
+{
+	const auto booleanResult = [](bool value) { return ConstantValue::makeScalar(Scalar::Bool, value ? 1.0 : 0.0); };
+
+	switch (p_operator)
+	{
+		case BinaryOperator::LogicalAnd:
+		case BinaryOperator::LogicalOr:
+		{
+			if (p_left.scalar != Scalar::Bool || p_right.scalar != Scalar::Bool || p_left.shape != Shape::Scalar ||
+			    p_right.shape != Shape::Scalar)
+			{
+				return std::nullopt;
+			}
+			const bool left = p_left.components.front() != 0.0;
+			const bool right = p_right.components.front() != 0.0;
+			return booleanResult(p_operator == BinaryOperator::LogicalAnd ? left && right : left || right);
+		}
+		case BinaryOperator::ShiftLeft:
+		case BinaryOperator::ShiftRight:
+		{
+			if (!isInteger(p_left.scalar) || !isInteger(p_right.scalar))
+			{
+				return std::nullopt;
+			}
+			const Scalar scalar = p_left.scalar;
+			return mapComponents({p_left, p_right}, 0b10, scalar,
+			    [p_operator, scalar](const std::vector<double> &x) { return shift(p_operator, scalar, x[0], x[1]); });
+		}
+		default:
+			break;
+	}
+
+	const std::optional<std::vector<ConstantValue>> operands = promoteAll({p_left, p_right}, false);
+	if (!operands)
+	{
+		return std::nullopt;
+	}
+	const ConstantValue &left = (*operands)[0];
+	const ConstantValue &right = (*operands)[1];
+	const Scalar scalar = left.scalar;
+
+	switch (p_operator)
+	{
+		case BinaryOperator::Equal:
+		case BinaryOperator::NotEqual:
+			if (!sameShape(left, right))
+			{
+				return std::nullopt;
+			}
+			return booleanResult((left.components == right.components) == (p_operator == BinaryOperator::Equal));
+		case BinaryOperator::Less:
+		case BinaryOperator::LessEqual:
+		case BinaryOperator::Greater:
+		case BinaryOperator::GreaterEqual:
+		{
+			if (scalar == Scalar::Bool || left.shape != Shape::Scalar || right.shape != Shape::Scalar)
+			{
+				return std::nullopt;
+			}
+			const double x = left.components.front();
+			const double y = right.components.front();
+			switch (p_operator)
+			{
+				case BinaryOperator::Less:
+					return booleanResult(x < y);
+				case BinaryOperator::LessEqual:
+					return booleanResult(x <= y);
+				case BinaryOperator::Greater:
+					return booleanResult(x > y);
+				default:
+					return booleanResult(x >= y);
+			}
+		}
+		case BinaryOperator::Modulo:
+		case BinaryOperator::BitwiseAnd:
+		case BinaryOperator::BitwiseOr:
+		case BinaryOperator::BitwiseXor:
+			if (!isInteger(scalar))
+			{
+				return std::nullopt;
+			}
+			break;
+		default:
+			if (scalar == Scalar::Bool)
+			{
+				return std::nullopt;
+			}
+			break;
+	}
+
+	if (p_operator == BinaryOperator::Multiply && left.shape != Shape::Scalar && right.shape != Shape::Scalar &&
+	    (left.shape == Shape::Matrix || right.shape == Shape::Matrix))
+	{
+		return linearMultiply(left, right);
+	}
+
+	// Scalars apply to every component of the other side; otherwise both sides have the same shape, matrices
+	// included.
+	const ConstantValue &shape = left.shape == Shape::Scalar ? right : left;
+	if (left.shape != Shape::Scalar && right.shape != Shape::Scalar && !sameShape(left, right))
+	{
+		return std::nullopt;
+	}
+	ConstantValue result = withShapeOf(shape, scalar);
+	for (std::size_t i = 0; i < shape.components.size(); ++i)
+	{
+		const double x = left.components.size() == 1 ? left.components.front() : left.components[i];
+		const double y = right.components.size() == 1 ? right.components.front() : right.components[i];
+		const std::optional<double> value = arithmetic(p_operator, scalar, x, y);
+		if (!value)
+		{
+			return std::nullopt;
+		}
+		result.components.push_back(*value);
+	}
+	return result;
+}
+
+std::optional<ConstantValue> foldConstruct(const std::string &p_type, const std::vector<ConstantValue> &p_arguments)
+{
+	const std::optional<TypeShape> type = parseGlslType(p_type);
+	if (!type || p_arguments.empty())
+	{
+		return std::nullopt;
+	}
+
+	ConstantValue result;
+	result.scalar = type->scalar;
+	result.shape = type->shape;
+	result.columns = type->columns;
+	result.rows = type->rows;
+	const std::size_t size = static_cast<std::size_t>(type->columns * type->rows);
+	const ConstantValue &first = p_arguments.front();
+
+	if (type->shape == Shape::Scalar)
+	{
+		if (p_arguments.size() != 1)
+		{
+			return std::nullopt;
+		}
+		const std::optional<double> value = convertComponent(first.components.front(), first.scalar, type->scalar);
+		return value ? std::optional<ConstantValue>(ConstantValue::makeScalar(type->scalar, *value)) : std::nullopt;
+	}
+
+	if (p_arguments.size() == 1 && first.shape == Shape::Scalar)
+	{
+		const std::optional<double> value = convertComponent(first.components.front(), first.scalar, type->scalar);
+		if (!value)
+		{
+			return std::nullopt;
+		}
+		for (int column = 0; column < type->columns; ++column)
+		{
+			for (int row = 0; row < type->rows; ++row)
+			{
+				const bool filled = type->shape == Shape::Vector || column == row;
+				result.components.push_back(filled ? *value : 0.0);
+			}
+		}
+		return result;
+	}
+
+	if (type->shape == Shape::Matrix && p_arguments.size() == 1 && first.shape == Shape::Matrix)
+	{
+		for (int column = 0; column < type->columns; ++column)
+		{
+			for (int row = 0; row < type->rows; ++row)
+			{
+				const bool inside = column < first.columns && row < first.rows;
+				result.components.push_back(inside ? matrixAt(first, column, row) : column == row ? 1.0 : 0.0);
+			}
+		}
+		return result;
+	}
+
+	// Components are taken in order from every argument. Each argument has to contribute at least one, and a
+	// matrix is only built from exactly as many as it has.
+	for (const ConstantValue &argument : p_arguments)
+	{
+		if (argument.shape == Shape::Matrix || result.components.size() >= size)
+		{
+			return std::nullopt;
+		}
+		for (double component : argument.components)
+		{
+			if (result.components.size() == size)
+			{
+				break;
+			}
+			const std::optional<double> value = convertComponent(component, argument.scalar, type->scalar);
+			if (!value)
+			{
+				return std::nullopt;
+			}
+			result.components.push_back(*value);
+		}
+	}
+	std::size_t provided = 0;
+	for (const ConstantValue &argument : p_arguments)
+	{
+		provided += argument.components.size();
+	}
+	if (result.components.size() != size || (type->shape == Shape::Matrix && provided != size))
+	{
+		return std::nullopt;
+	}
+	return result;
+}
+
+std::optional<ConstantValue> foldBuiltin(const std::string &p_name, const std::vector<ConstantValue> &p_arguments)
+{
+	if (p_arguments.empty())
+	{
+		return std::nullopt;
+	}
+	const std::size_t count = p_arguments.size();
+	const bool integerOverload = (p_name == "abs" || p_name == "sign" || p_name == "min" || p_name == "max" ||
+	                                 p_name == "clamp") &&
+	                             std::all_of(p_arguments.begin(), p_arguments.end(),
+	                                 [](const ConstantValue &argument) { return isInteger(argument.scalar); });
+	const std::optional<std::vector<ConstantValue>> arguments = promoteAll(p_arguments, !integerOverload);
+	if (!arguments)
+	{
+		return std::nullopt;
+	}
+	const Scalar scalar = arguments->front().scalar;
+	if ((p_name == "abs" || p_name == "sign") && scalar == Scalar::UInt)
+	{
+		return std::nullopt;
+	}
+
+	if (count == 1 && (p_name != "length" && p_name != "normalize"))
+	{
+		return mapComponents(*arguments, 0, scalar,
+		    [&p_name](const std::vector<double> &x) { return floatFunction(p_name, x[0]); });
+	}
+	if (p_name == "length" || p_name == "normalize" || p_name == "distance" || p_name == "dot" || p_name == "cross" ||
+	    p_name == "reflect")
+	{
+		return foldGeometric(p_name, *arguments);
+	}
+
+	if (count == 2 && (p_name == "min" || p_name == "max"))
+	{
+		const bool isMin = p_name == "min";
+		return mapComponents(*arguments, 0b10, scalar, [isMin](const std::vector<double> &x) -> std::optional<double> {
+			return isMin ? std::min(x[0], x[1]) : std::max(x[0], x[1]);
+		});
+	}
+	if (count == 3 && p_name == "clamp")
+	{
+		return mapComponents(*arguments, 0b110, scalar, [](const std::vector<double> &x) -> std::optional<double> {
+			if (x[1] > x[2])
+			{
+				return std::nullopt;
+			}
+			return std::min(std::max(x[0], x[1]), x[2]);
+		});
+	}
+	if (count == 2 && p_name == "mod")
+	{
+		return mapComponents(*arguments, 0b10, scalar, [](const std::vector<double> &x) -> std::optional<double> {
+			if (x[1] == 0.0)
+			{
+				return std::nullopt;
+			}
+			return x[0] - x[1] * std::floor(x[0] / x[1]);
+		});
+	}
+	if (count == 2 && p_name == "pow")
+	{
+		return mapComponents(*arguments, 0, scalar, [](const std::vector<double> &x) -> std::optional<double> {
+			if (x[0] < 0.0 || (x[0] == 0.0 && x[1] <= 0.0))
+			{
+				return std::nullopt;
+			}
+			return std::pow(x[0], x[1]);
+		});
+	}
+	if (count == 2 && p_name == "atan")
+	{
+		return mapComponents(*arguments, 0, scalar, [](const std::vector<double> &x) -> std::optional<double> {
+			if (x[0] == 0.0 && x[1] == 0.0)
+			{
+				return std::nullopt;
+			}
+			return std::atan2(x[0], x[1]);
+		});
+	}
+	if (count == 2 && p_name == "step")
+	{
+		return mapComponents(*arguments, 0b01, scalar,
+		    [](const std::vector<double> &x) -> std::optional<double> { return x[1] < x[0] ? 0.0 : 1.0; });
+	}
+	if (count == 3 && p_name == "smoothstep")
+	{
+		return mapComponents(*arguments, 0b011, scalar, [](const std::vector<double> &x) -> std::optional<double> {
+			if (x[0] >= x[1])
+			{
+				return std::nullopt;
+			}
+			const double t = std::clamp((x[2] - x[0]) / (x[1] - x[0]), 0.0, 1.0);
+			return t * t * (3.0 - 2.0 * t);
+		});
+	}
+	if (count == 3 && p_name == "mix")
+	{
+		return mapComponents(*arguments, 0b100, scalar, [](const std::vector<double> &x) -> std::optional<double> {
+			return x[0] * (1.0 - x[2]) + x[1] * x[2];
+		});
+	}
+	return std::nullopt;
+}
+
+std::optional<ConstantValue> foldSwizzle(const ConstantValue &p_value, const std::string &p_swizzle)
+{
+	if (p_value.shape == Shape::Matrix || p_swizzle.empty() || p_swizzle.size() > 4)
+	{
+		return std::nullopt;
+	}
+	static const char *const kSets[] = {"xyzw", "rgba", "stpq"};
+	for (const char *set : kSets)
+	{
+		const std::string letters(set);
+		if (letters.find(p_swizzle.front()) == std::string::npos)
+		{
+			continue;
+		}
+		ConstantValue result;
+		result.scalar = p_value.scalar;
+		for (char letter : p_swizzle)
+		{
+			const std::size_t index = letters.find(letter);
+			if (index == std::string::npos || index >= p_value.components.size())
+			{
+				return std::nullopt;
+			}
+			result.components.push_back(p_value.components[index]);
+		}
+		if (result.components.size() > 1)
+		{
+			result.shape = Shape::Vector;
+			result.columns = static_cast<int>(result.components.size());
+		}
+		return result;
+	}
+	return std::nullopt;
+}
+
+std::optional<ConstantValue> foldIndex(const ConstantValue &p_value, const ConstantValue &p_index)
+{
+	if (p_value.shape == Shape::Scalar || p_index.shape != Shape::Scalar || !isInteger(p_index.scalar))
+	{
+		return std::nullopt;
+	}
+	const double index = p_index.components.front();
+	if (index < 0.0 || index >= p_value.columns)
+	{
+		return std::nullopt;
+	}
+	const auto column = static_cast<std::size_t>(index);
+	if (p_value.shape == Shape::Vector)
+	{
+		return ConstantValue::makeScalar(p_value.scalar, p_value.components[column]);
+	}
+	ConstantValue result;
+	result.scalar = p_value.scalar;
+	result.shape = Shape::Vector;
+	result.columns = p_value.rows;
+	const auto rows = static_cast<std::size_t>(p_value.rows);
+	result.components.assign(p_value.components.begin() + static_cast<std::ptrdiff_t>(column * rows),
+	    p_value.components.begin() + static_cast<std::ptrdiff_t>((column + 1) * rows));
+	return result;
+}
@@ -1,12 +1,23 @@
 #include "converter.hpp"
 
 #include "ast.hpp"
+#include "code_writer.hpp"
+#include "constant_evaluator.hpp"
+#include "ir.hpp"
+#include "ir_glsl_emitter.hpp"
+#include "ir_passes.hpp"
+#include "pass_timing.hpp"
+#include "trace.hpp"
 
 #include <algorithm>
+#include <functional>
+#include <future>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -98,6 +109,11 @@ bool isColorTypeName(const std::string &typeName)
 	return typeName == "Color";
 }
 
+bool isMatrixTypeName(const std::string &typeName)
+{
+	return typeName == "Matrix2x2" || typeName == "Matrix3x3" || typeName == "Matrix4x4";
+}
+
 	std::string binaryOperatorSymbol(BinaryOperator op)
 	{
 		switch (op)
@@ -172,12 +188,253 @@ bool isColorTypeName(const std::string &typeName)
 		return "=";
 	}
 
-	void writeIndent(std::ostringstream &oss, int indent)
+	std::optional<BinaryOperator> compoundAssignmentOperator(AssignmentOperator op)
+	{
+		switch (op)
+		{
+			case AssignmentOperator::Assign:
+				return std::nullopt;
+			case AssignmentOperator::AddAssign:
+				return BinaryOperator::Add;
+			case AssignmentOperator::SubtractAssign:
+				return BinaryOperator::Subtract;
+			case AssignmentOperator::MultiplyAssign:
+				return BinaryOperator::Multiply;
+			case AssignmentOperator::DivideAssign:
+				return BinaryOperator::Divide;
+			case AssignmentOperator::ModuloAssign:
+				return BinaryOperator::Modulo;
+			case AssignmentOperator::BitwiseAndAssign:
+				return BinaryOperator::BitwiseAnd;
+			case AssignmentOperator::BitwiseOrAssign:
+				return BinaryOperator::BitwiseOr;
+			case AssignmentOperator::BitwiseXorAssign:
+				return BinaryOperator::BitwiseXor;
+			case AssignmentOperator::ShiftLeftAssign:
+				return BinaryOperator::ShiftLeft;
+			case AssignmentOperator::ShiftRightAssign:
+				return BinaryOperator::ShiftRight;
+		}
+		return std::nullopt;
+	}
+
+	// Lumina types whose constructors map onto GLSL constructors.
+	bool isBuiltinTypeName(const std::string &name)
+	{
+		return name == "float" || name == "int" || name == "uint" || name == "bool" || convertLuminaType(name) != name;
+	}
+
+	// Free functions the semantic parser resolves as builtins; GLSL has them under the same name.
+	bool isBuiltinFunctionName(const std::string &name)
+	{
+		static const std::unordered_set<std::string> names = {"abs", "sign", "floor", "ceil", "fract", "exp", "log",
+		    "exp2", "log2", "sqrt", "inversesqrt", "sin", "cos", "tan", "asin", "acos", "atan", "mod", "min", "max",
+		    "pow", "step", "clamp", "smoothstep", "mix", "dot", "length", "distance", "normalize", "cross", "reflect"};
+		return names.find(name) != names.end();
+	}
+
+	// Variable an assignment or increment used as a whole statement writes, through member accesses, and the value
+	// an assignment stores.
+	const IdentifierExpression *statementWriteTarget(const Expression &expression, const Expression **value)
+	{
+		const Expression *target = nullptr;
+		*value = nullptr;
+		if (expression.kind == Expression::Kind::Assignment)
+		{
+			const auto &assignment = static_cast<const AssignmentExpression &>(expression);
+			target = assignment.target.get();
+			*value = assignment.value.get();
+		}
+		else if (expression.kind == Expression::Kind::Postfix)
+		{
+			target = static_cast<const PostfixExpression &>(expression).operand.get();
+		}
+		else if (expression.kind == Expression::Kind::Unary)
+		{
+			const auto &unary = static_cast<const UnaryExpression &>(expression);
+			if (unary.op == UnaryOperator::PreIncrement || unary.op == UnaryOperator::PreDecrement)
+			{
+				target = unary.operand.get();
+			}
+		}
+		while (target && target->kind == Expression::Kind::MemberAccess)
+		{
+			target = static_cast<const MemberExpression *>(target)->object.get();
+		}
+		if (!target || target->kind != Expression::Kind::Identifier)
+		{
+			return nullptr;
+		}
+		const auto *identifier = static_cast<const IdentifierExpression *>(target);
+		return identifier->name.parts.size() == 1 ? identifier : nullptr;
+	}
+
+	// How a varying of a GLSL type fills interpolant locations. Scalars and vectors have a scalar kind ('f', 'i' or
+	// 'u') and take some of the four components of one location; anything else takes whole locations.
+	struct VaryingShape
+	{
+		char scalar = 0;
+		int components = 0;
+		int locations = 1;
+	};
+
+	VaryingShape varyingShape(const std::string &glslType)
+	{
+		VaryingShape shape;
+		if (glslType == "float" || glslType == "int" || glslType == "uint")
+		{
+			shape.scalar = glslType[0];
+			shape.components = 1;
+			return shape;
+		}
+		const std::size_t vec = glslType.find("vec");
+		if (vec != std::string::npos && vec + 4 == glslType.size() &&
+		    (vec == 0 || (vec == 1 && (glslType[0] == 'i' || glslType[0] == 'u'))))
+		{
+			shape.scalar = vec == 0 ? 'f' : glslType[0];
+			shape.components = glslType.back() - '0';
+			return shape;
+		}
+		if (glslType.size() == 4 && glslType.compare(0, 3, "mat") == 0)
+		{
+			shape.locations = glslType.back() - '0';
+		}
+		return shape;
+	}
+
+	// Thrown while lowering a function to IR when it uses something the IR cannot express; that function is then
+	// emitted from the AST.
+	struct IrUnsupported
+	{
+	};
+
+	// GLSL function a builtin method call maps to, written as function(object, arguments...).
+	struct BuiltinCall
+	{
+		std::string function;
+		// The object is passed after the arguments (step, smoothstep).
+		bool objectLast = false;
+		// Constant arguments appended after the others.
+		const char *trailing = "";
+	};
+
+	std::optional<BuiltinCall> floatBuiltinCall(const std::string &method, std::size_t argumentCount)
+	{
+		const auto hasArgs = [&](std::size_t expected) { return argumentCount == expected; };
+
+		if (method == "abs" || method == "sign" || method == "floor" || method == "ceil" || method == "fract" ||
+		    method == "exp" || method == "log" || method == "exp2" || method == "log2" || method == "sqrt" ||
+		    method == "inversesqrt" || method == "sin" || method == "cos" || method == "tan" || method == "asin" ||
+		    method == "acos" || method == "atan")
+		{
+			if (hasArgs(0))
+			{
+				return BuiltinCall{method};
+			}
+			return std::nullopt;
+		}
+
+		if ((method == "mod" || method == "min" || method == "max" || method == "pow") && hasArgs(1))
+		{
+			return BuiltinCall{method};
+		}
+
+		if ((method == "clamp" || method == "mix") && hasArgs(2))
+		{
+			return BuiltinCall{method};
+		}
+
+		if (method == "step" && hasArgs(1))
+		{
+			return BuiltinCall{"step", true};
+		}
+
+		if (method == "smoothstep" && hasArgs(2))
+		{
+			return BuiltinCall{"smoothstep", true};
+		}
+
+		return std::nullopt;
+	}
+
+	std::optional<BuiltinCall> vectorBuiltinCall(
+	    const std::string &typeName, const std::string &method, std::size_t argumentCount)
 	{
-		for (int i = 0; i < indent; ++i)
+		const auto hasArgs = [&](std::size_t expected) { return argumentCount == expected; };
+
+		if ((method == "dot" || method == "distance" || method == "reflect") && hasArgs(1))
+		{
+			return BuiltinCall{method};
+		}
+		if ((method == "length" || method == "normalize") && hasArgs(0))
+		{
+			return BuiltinCall{method};
+		}
+		if (method == "cross" && typeName == "Vector3" && hasArgs(1))
+		{
+			return BuiltinCall{"cross"};
+		}
+		if ((method == "abs" || method == "floor" || method == "ceil" || method == "fract" || method == "exp" ||
+		        method == "log" || method == "exp2" || method == "log2" || method == "sqrt" || method == "inversesqrt" ||
+		        method == "sin" || method == "cos" || method == "tan" || method == "asin" || method == "acos" ||
+		        method == "atan") &&
+		    hasArgs(0))
+		{
+			return BuiltinCall{method};
+		}
+		if ((method == "mod" || method == "min" || method == "max" || method == "pow") && hasArgs(1))
+		{
+			return BuiltinCall{method};
+		}
+		if (method == "clamp" && hasArgs(2))
+		{
+			return BuiltinCall{"clamp"};
+		}
+		if (method == "lerp" && hasArgs(2))
+		{
+			return BuiltinCall{"mix"};
+		}
+		if (method == "step" && hasArgs(1))
+		{
+			return BuiltinCall{"step", true};
+		}
+		if (method == "smoothstep" && hasArgs(2))
+		{
+			return BuiltinCall{"smoothstep", true};
+		}
+		if (method == "saturate" && isColorTypeName(typeName) && hasArgs(0))
 		{
-			oss << '\t';
+			return BuiltinCall{"clamp", false, ", 0.0, 1.0"};
 		}
+
+		return std::nullopt;
+	}
+	// Below this many analysed expressions, starting a thread costs more than emitting a stage.
+	constexpr std::size_t kParallelEmissionThreshold = 2048;
+	// Vertex output locations every implementation provides: GL_MAX_VERTEX_OUTPUT_COMPONENTS is at least 64.
+	constexpr int kMaxVaryingLocations = 16;
+
+	// Runs the vertex task on a helper thread and the fragment task on the caller when parallel, both on the caller
+	// otherwise. An exception from either task reaches the caller. Passes timed by the helper are reported under the
+	// caller's running pass.
+	template <typename TVertexTask, typename TFragmentTask>
+	void runStageTasks(bool parallel, TVertexTask &&vertexTask, TFragmentTask &&fragmentTask)
+	{
+		if (!parallel)
+		{
+			vertexTask();
+			fragmentTask();
+			return;
+		}
+		PassTimingHandoff timing;
+		std::future<void> vertex = std::async(std::launch::async, [&vertexTask, &timing]() {
+			nameTraceThread("vertex stage");
+			const PassTimingHandoff::Scope timingScope(timing);
+			vertexTask();
+		});
+		fragmentTask();
+		vertex.get();
+		timing.merge();
 	}
 }
 
@@ -209,6 +466,13 @@ private:
 		std::vector<MethodHelper> methods;
 	};
 
+	struct FieldSlot
+	{
+		const FieldMember *field = nullptr;
+		const VariableDeclarator *declarator = nullptr;
+		std::size_t declarationIndex = 0;
+	};
+
 	struct StageUsage
 	{
 		std::unordered_set<const FunctionInstruction *> functions;
@@ -218,6 +482,33 @@ private:
 		std::unordered_set<std::string> methodHelpers;
 	};
 
+	// Output and mutable state of one stage's emission. Everything else the emitters read is shared and read-only,
+	// so the two stages can be emitted at the same time.
+	struct EmissionContext
+	{
+		CodeWriter out;
+		std::vector<std::string> thisAliasStack;
+		const AggregateInfo *currentMethodAggregate = nullptr;
+		std::unordered_set<std::string> currentMethodParameters;
+		std::vector<std::unordered_set<std::string>> methodLocalNameStack;
+		std::vector<std::vector<std::string>> namespaceStack;
+		std::string currentMethodSelfName;
+		bool currentMethodUsesSelfParameter = false;
+		// Stage lowered to IR (`--ir`): the functions that could be lowered, emitted from it instead of the AST.
+		std::unique_ptr<IrModule> irModule;
+		std::unordered_map<const FunctionInstruction *, const IrFunction *> irFunctions;
+		const IrFunction *irStage = nullptr;
+		// Fragment stage: moved expressions are read from the varyings carrying them.
+		bool readsMovedVaryings = false;
+		// Emitting the vertex stage body: writes to varyings nothing reads are left out.
+		bool dropsDeadVaryingWrites = false;
+
+		bool isMethodLocalName(const std::string &name) const;
+		void pushNamespace(const std::vector<std::string> &ns);
+		void popNamespace();
+		const std::vector<std::string> &currentNamespace() const;
+	};
+
 	void collect(const std::vector<std::unique_ptr<Instruction>> &instructions);
 	void collectNamespace(const NamespaceInstruction &ns);
 	void collectAggregate(const AggregateInstruction &aggregate);
@@ -227,78 +518,109 @@ private:
 
 	std::string qualify(const Token &name) const;
 	std::string qualify(const Name &name) const;
-	std::string remapIdentifier(const Name &name) const;
+	std::string remapIdentifier(const EmissionContext &context, const Name &name) const;
 	std::string remapIdentifier(const std::string &canonical) const;
 
 	StageUsage collectStageUsage(const StageFunctionInstruction *stage) const;
+	void foldConstants();
+	// Locals in scope and call resolution while a stage body is rewritten.
+	struct StageWalker;
+	void hoistUniformExpressions();
+	void moveAffineExpressionsToVertex();
+	void eliminateDeadVaryings(const std::vector<StageIO> &varyings);
+	void packVaryings();
+	// The expression in Lumina syntax, with blocks named by their qualified name, for reports. Subexpressions found
+	// in substitutions render as the text mapped to them.
+	std::string renderLumina(const EmissionContext &context, const Expression &expression, bool nested,
+	    const std::unordered_map<const Expression *, std::string> *substitutions = nullptr) const;
 	const MethodHelper *findMethodHelper(const std::string &helperName, const AggregateInfo **aggregate) const;
 
-	void emitCommon(std::ostringstream &oss, const StageUsage &usage) const;
-	void emitStructs(std::ostringstream &oss) const;
-	void emitBlocks(std::ostringstream &oss, AggregateInstruction::Kind kind, const StageUsage &usage) const;
-	void emitBlockMembers(
-	    std::ostringstream &oss,
-	    const AggregateInstruction &aggregate,
-	    int indent,
-	    const AggregateInfo *info) const;
-	void emitStructMethods(std::ostringstream &oss, const StageUsage &usage) const;
-	void emitBlockMethods(std::ostringstream &oss, const std::vector<AggregateInfo> &aggregates, const StageUsage &usage) const;
-	void emitGlobalVariables(std::ostringstream &oss, const StageUsage &usage) const;
-	void emitTextures(std::ostringstream &oss, const StageUsage &usage) const;
-	void emitFunctions(std::ostringstream &oss, const StageUsage &usage) const;
-
-	void emitInterface(std::ostringstream &oss, const std::vector<StageIO> &entries, const char *qualifier) const;
-	void emitStage(std::ostringstream &oss, const StageFunctionInstruction *stage, Stage stageKind) const;
-	void emitBlockStatement(std::ostringstream &oss, const BlockStatement &block, int indent) const;
-	void emitStatement(std::ostringstream &oss, const Statement &statement, int indent) const;
-	void emitVariableStatement(std::ostringstream &oss, const VariableStatement &statement, int indent) const;
-	void emitIfStatement(std::ostringstream &oss, const IfStatement &statement, int indent) const;
-	void emitWhileStatement(std::ostringstream &oss, const WhileStatement &statement, int indent) const;
-	void emitDoWhileStatement(std::ostringstream &oss, const DoWhileStatement &statement, int indent) const;
-	void emitForStatement(std::ostringstream &oss, const ForStatement &statement, int indent) const;
-	void emitReturnStatement(std::ostringstream &oss, const ReturnStatement &statement, int indent) const;
-
-	std::string emitExpression(const Expression &expression) const;
-	std::string emitLiteral(const LiteralExpression &literal) const;
-	std::string emitArrayLiteral(const ArrayLiteralExpression &literal) const;
-	std::string emitIdentifier(const IdentifierExpression &identifier) const;
-	std::string emitUnary(const UnaryExpression &unary) const;
-	std::string emitBinary(const BinaryExpression &binary) const;
-	std::string emitAssignment(const AssignmentExpression &assignment) const;
-	std::string emitConditional(const ConditionalExpression &conditional) const;
-	std::string emitCall(const CallExpression &call) const;
-	std::optional<std::string> emitUserMethodCall(const MemberExpression &member, const CallExpression &call) const;
-	std::optional<std::string> emitImplicitSelfCall(const IdentifierExpression &identifier, const CallExpression &call) const;
-	std::optional<std::string> emitBuiltinMemberCall(const MemberExpression &member, const CallExpression &call) const;
-	std::optional<std::string> emitFloatBuiltinCall(
-	    const std::string &method, const std::string &objectExpr, const std::vector<std::string> &arguments) const;
-	std::optional<std::string> emitVectorBuiltinCall(const std::string &typeName,
-	    const std::string &method, const std::string &objectExpr, const std::vector<std::string> &arguments) const;
-	std::string emitMember(const MemberExpression &member) const;
-	std::string emitIndex(const IndexExpression &index) const;
-	std::string emitPostfix(const PostfixExpression &postfix) const;
-	std::optional<std::string> emitSSBOArraySizeAccess(const MemberExpression &member) const;
+	std::string emitStageSource(const StageFunctionInstruction *stage, Stage stageKind,
+	    const std::vector<StageIO> &inputs, const std::vector<StageIO> &outputs, const StageUsage &usage,
+	    std::string &irDump) const;
+	void emitCommon(EmissionContext &context, const StageUsage &usage) const;
+	void emitStructs(EmissionContext &context) const;
+	void emitBlocks(EmissionContext &context, AggregateInstruction::Kind kind, const StageUsage &usage) const;
+	void emitBlockMembers(EmissionContext &context, const AggregateInfo &info) const;
+	std::vector<FieldSlot> orderedFields(const AggregateInfo &info) const;
+	std::vector<const Expression *> constructorArguments(
+	    const EmissionContext &context, const IdentifierExpression &callee, const CallExpression &call) const;
+	void emitStructMethods(EmissionContext &context, const StageUsage &usage) const;
+	void emitBlockMethods(
+	    EmissionContext &context, const std::vector<AggregateInfo> &aggregates, const StageUsage &usage) const;
+	void emitGlobalVariables(EmissionContext &context, const StageUsage &usage) const;
+	void emitTextures(EmissionContext &context, const StageUsage &usage) const;
+	void emitFunctions(EmissionContext &context, const StageUsage &usage) const;
+
+	void emitInterface(EmissionContext &context, const std::vector<StageIO> &entries, const char *qualifier) const;
+	void emitStage(EmissionContext &context, const StageFunctionInstruction *stage, Stage stageKind) const;
+	void emitBlockStatement(EmissionContext &context, const BlockStatement &block) const;
+	void emitStatement(EmissionContext &context, const Statement &statement) const;
+	void emitVariableStatement(EmissionContext &context, const VariableStatement &statement) const;
+	void emitIfStatement(EmissionContext &context, const IfStatement &statement) const;
+	void emitWhileStatement(EmissionContext &context, const WhileStatement &statement) const;
+	void emitDoWhileStatement(EmissionContext &context, const DoWhileStatement &statement) const;
+	void emitForStatement(EmissionContext &context, const ForStatement &statement) const;
+	void emitReturnStatement(EmissionContext &context, const ReturnStatement &statement) const;
+
+	void emitExpression(EmissionContext &context, const Expression &expression) const;
+	void emitLiteral(EmissionContext &context, const LiteralExpression &literal) const;
+	void emitArrayLiteral(EmissionContext &context, const ArrayLiteralExpression &literal) const;
+	void emitIdentifier(EmissionContext &context, const IdentifierExpression &identifier) const;
+	void emitUnary(EmissionContext &context, const UnaryExpression &unary) const;
+	void emitBinary(EmissionContext &context, const BinaryExpression &binary) const;
+	std::vector<const Expression *> matrixChainFactors(const BinaryExpression &binary) const;
+	void emitAssignment(EmissionContext &context, const AssignmentExpression &assignment) const;
+	void emitConditional(EmissionContext &context, const ConditionalExpression &conditional) const;
+	void emitCall(EmissionContext &context, const CallExpression &call) const;
+	// The emitters returning bool write nothing and return false when the expression is not of their form.
+	bool emitUserMethodCall(EmissionContext &context, const MemberExpression &member, const CallExpression &call) const;
+	bool emitImplicitSelfCall(
+	    EmissionContext &context, const IdentifierExpression &identifier, const CallExpression &call) const;
+	bool emitBuiltinMemberCall(
+	    EmissionContext &context, const MemberExpression &member, const CallExpression &call) const;
+	std::optional<BuiltinCall> builtinMemberCall(const MemberExpression &member, std::size_t argumentCount) const;
+	void emitMember(EmissionContext &context, const MemberExpression &member) const;
+	void emitIndex(EmissionContext &context, const IndexExpression &index) const;
+	void emitPostfix(EmissionContext &context, const PostfixExpression &postfix) const;
+	bool emitSSBOArraySizeAccess(EmissionContext &context, const MemberExpression &member) const;
 
 	std::string typeToGLSL(const TypeName &type) const;
 	std::string typeToGLSL(const std::string &typeName) const;
 	bool aggregateHasUnsizedArray(const AggregateInstruction &aggregate) const;
 	std::string aggregateTypeName(const AggregateInfo &info) const;
-	std::optional<std::string> resolveAggregateQualifiedName(const Name &name) const;
-	void emitMethodHelper(std::ostringstream &oss, const AggregateInfo &info, const MethodHelper &helper) const;
-	void emitFunction(std::ostringstream &oss, const FunctionInstruction &function, const std::string &name) const;
-	void emitParameters(std::ostringstream &oss, const std::vector<Parameter> &params) const;
+	std::optional<std::string> resolveAggregateQualifiedName(const EmissionContext &context, const Name &name) const;
+	void emitMethodHelper(EmissionContext &context, const AggregateInfo &info, const MethodHelper &helper) const;
+	void emitFunction(EmissionContext &context, const FunctionInstruction &function, const std::string &name) const;
+	void emitParameters(EmissionContext &context, const std::vector<Parameter> &params) const;
 	std::string parameterName(const Token &token) const;
-	bool isMethodLocalName(const std::string &name) const;
 	const AggregateInfo *findAggregateInfo(const std::string &qualifiedName) const;
-	void pushEmissionNamespace(const std::vector<std::string> &ns) const;
-	void popEmissionNamespace() const;
-	const std::vector<std::string> &currentEmissionNamespace() const;
 	bool methodMutatesAggregate(const MethodMember &method, const AggregateInfo &info) const;
 	struct MethodAnalysisContext;
 	bool statementMutatesAggregate(const Statement &statement, MethodAnalysisContext &ctx, const AggregateInfo &info) const;
 	bool expressionMutatesAggregate(const Expression &expression, MethodAnalysisContext &ctx, const AggregateInfo &info) const;
 	bool expressionRefersToField(const Expression &expression, MethodAnalysisContext &ctx, const AggregateInfo &info) const;
 
+	struct IrLoweringContext;
+	void lowerStageToIr(EmissionContext &context, const StageFunctionInstruction *stage, Stage stageKind,
+	    const std::vector<StageIO> &inputs, const std::vector<StageIO> &outputs, const StageUsage &usage) const;
+	bool lowerFunctionBody(IrLoweringContext &ctx, const std::vector<Parameter> &parameters, const BlockStatement &body,
+	    std::optional<Stage> stageMain) const;
+	void lowerStatement(IrLoweringContext &ctx, const Statement &statement) const;
+	void lowerStatementInto(IrLoweringContext &ctx, IrBlock &block, const Statement &statement) const;
+	void lowerVariableStatement(IrLoweringContext &ctx, const VariableStatement &statement) const;
+	void lowerLoop(IrLoweringContext &ctx, const Expression *condition, const Statement &body,
+	    const Expression *increment, bool isPostTest) const;
+	IrInstruction *lowerExpression(IrLoweringContext &ctx, const Expression &expression) const;
+	IrInstruction *lowerAddress(IrLoweringContext &ctx, const Expression &expression) const;
+	IrInstruction *lowerArgument(IrLoweringContext &ctx, const Expression &expression) const;
+	IrInstruction *lowerAssignment(IrLoweringContext &ctx, const AssignmentExpression &assignment) const;
+	IrInstruction *lowerCall(IrLoweringContext &ctx, const CallExpression &call) const;
+	IrInstruction *lowerOpaque(IrLoweringContext &ctx, const Expression &expression) const;
+	IrVariable *irVariable(IrLoweringContext &ctx, const IdentifierExpression &identifier) const;
+	const IrType *irExpressionType(IrLoweringContext &ctx, const Expression &expression) const;
+	bool isPureExpression(const EmissionContext &context, const Expression &expression) const;
+
 	const ConverterInput &input;
 	const SemanticParseResult &semantic;
 	const std::unordered_map<const Expression *, SemanticParseResult::ExpressionInfo> &expressionInfo;
@@ -320,18 +642,44 @@ private:
 	std::unordered_map<std::string, const FunctionInstruction *> functionLookup;
 	std::unordered_map<std::string, const VariableInstruction *> globalVariableLookup;
 	std::unordered_map<std::string, AggregateInstruction::Kind> aggregateKindLookup;
+	// Value of an expression that evaluates to a constant and spells a computation, written in both languages.
+	struct FoldedConstant
+	{
+		// Replaces the expression in the generated GLSL.
+		std::string glsl;
+		// Stands for it in reports and derived member expressions.
+		std::string lumina;
+	};
+	std::unordered_map<const Expression *, FoldedConstant> foldedExpressions;
+	// Index in derivedFields of the member replacing each hoisted expression.
+	std::unordered_map<const Expression *, std::size_t> hoistedExpressions;
+	std::vector<DerivedBlockField> derivedFields;
+	// Index in movedVaryings of the varying replacing each fragment expression computed per vertex, and the
+	// expression the vertex stage writes to each of them.
+	std::unordered_map<const Expression *, std::size_t> movedExpressions;
+	std::vector<MovedVarying> movedVaryings;
+	std::vector<const Expression *> movedSources;
+	// The triangleIndex and instanceIndex varyings behind TriangleID and InstanceID, then the declared ones.
+	std::vector<StageIO> stageVaryings;
+	// Varyings the fragment stage reads, at compacted locations. The vertex stage declares the other ones it reads
+	// as plain globals, and drops the statements that only write the rest.
+	std::vector<StageIO> liveVaryings;
+	std::vector<StageIO> privateVaryings;
+	std::unordered_set<std::string> droppedVaryings;
+	// GLSL builtins each stage copies at the start of main, as `name = uint(source / divisor);`.
+	struct BuiltinCopy
+	{
+		std::string name;
+		std::string source;
+		int divisor = 1;
+	};
+	std::vector<BuiltinCopy> vertexBuiltinCopies;
+	std::vector<BuiltinCopy> fragmentBuiltinCopies;
 	struct MethodCallInfo
 	{
 		std::string helperName;
 	};
 	std::unordered_map<std::string, std::unordered_map<std::string, MethodCallInfo>> methodCallHelpers;
-	mutable std::vector<std::string> thisAliasStack;
-	mutable const AggregateInfo *currentMethodAggregate = nullptr;
-	mutable std::unordered_set<std::string> currentMethodParameters;
-	mutable std::vector<std::unordered_set<std::string>> methodLocalNameStack;
-	mutable std::vector<std::vector<std::string>> emissionNamespaceStack;
-	mutable std::string currentMethodSelfName;
-	mutable bool currentMethodUsesSelfParameter = false;
 };
 
 ConverterImpl::ConverterImpl(const ConverterInput &input)
@@ -344,6 +692,22 @@ ConverterImpl::ConverterImpl(const ConverterInput &input)
 		textureLookup[binding.luminaName] = binding;
 		remappedNames[binding.luminaName] = binding.glslName;
 	}
+	for (const char *builtin : {"triangleIndex", "instanceIndex"})
+	{
+		StageIO varying;
+		varying.type = "uint";
+		varying.name = builtin;
+		varying.flat = true;
+		stageVaryings.push_back(std::move(varying));
+	}
+	stageVaryings.insert(stageVaryings.end(), input.stageVaryings.begin(), input.stageVaryings.end());
+	for (std::size_t i = 0; i < stageVaryings.size(); ++i)
+	{
+		stageVaryings[i].location = static_cast<int>(i);
+		// GLSL only accepts integer varyings when they are not interpolated.
+		const char scalar = varyingShape(typeToGLSL(stageVaryings[i].type)).scalar;
+		stageVaryings[i].flat = stageVaryings[i].flat || scalar == 'i' || scalar == 'u';
+	}
 	collect(semantic.instructions);
 }
 
@@ -574,7 +938,7 @@ std::string ConverterImpl::qualify(const Name &name) const
 	return oss.str();
 }
 
-std::string ConverterImpl::remapIdentifier(const Name &name) const
+std::string ConverterImpl::remapIdentifier(const EmissionContext &context, const Name &name) const
 {
 	const std::string canonical = joinName(name);
 	if (canonical == "pixelPosition")
@@ -583,7 +947,7 @@ std::string ConverterImpl::remapIdentifier(const Name &name) const
 	}
 	if (canonical == "InstanceID")
 	{
-		return "gl_InstanceID";
+		return "instanceIndex";
 	}
 	if (canonical == "TriangleID")
 	{
@@ -593,10 +957,10 @@ std::string ConverterImpl::remapIdentifier(const Name &name) const
 	{
 		return it->second;
 	}
-	const std::vector<std::string> &context = currentEmissionNamespace();
-	if (!context.empty())
+	const std::vector<std::string> &scope = context.currentNamespace();
+	if (!scope.empty())
 	{
-		for (std::size_t depth = context.size(); depth > 0; --depth)
+		for (std::size_t depth = scope.size(); depth > 0; --depth)
 		{
 			std::ostringstream oss;
 			for (std::size_t i = 0; i < depth; ++i)
@@ -605,7 +969,7 @@ std::string ConverterImpl::remapIdentifier(const Name &name) const
 				{
 					oss << "::";
 				}
-				oss << context[i];
+				oss << scope[i];
 			}
 			if (!canonical.empty())
 			{
@@ -648,7 +1012,7 @@ std::string ConverterImpl::remapIdentifier(const std::string &canonical) const
 	}
 	if (canonical == "InstanceID")
 	{
-		return "gl_InstanceID";
+		return "instanceIndex";
 	}
 	if (canonical == "TriangleID")
 	{
@@ -661,7 +1025,8 @@ std::string ConverterImpl::remapIdentifier(const std::string &canonical) const
 	return canonical;
 }
 
-std::optional<std::string> ConverterImpl::resolveAggregateQualifiedName(const Name &name) const
+std::optional<std::string> ConverterImpl::resolveAggregateQualifiedName(
+    const EmissionContext &context, const Name &name) const
 {
 	const std::string base = joinName(name);
 	if (base.find("::") != std::string::npos || name.parts.size() > 1)
@@ -673,10 +1038,10 @@ std::optional<std::string> ConverterImpl::resolveAggregateQualifiedName(const Na
 		return std::nullopt;
 	}
 
-	const std::vector<std::string> &context = currentEmissionNamespace();
-	if (!context.empty())
+	const std::vector<std::string> &scope = context.currentNamespace();
+	if (!scope.empty())
 	{
-		for (std::size_t depth = context.size(); depth > 0; --depth)
+		for (std::size_t depth = scope.size(); depth > 0; --depth)
 		{
 			std::ostringstream oss;
 			for (std::size_t i = 0; i < depth; ++i)
@@ -685,7 +1050,7 @@ std::optional<std::string> ConverterImpl::resolveAggregateQualifiedName(const Na
 				{
 					oss << "::";
 				}
-				oss << context[i];
+				oss << scope[i];
 			}
 			oss << "::" << base;
 			const std::string qualified = oss.str();
@@ -935,6 +1300,13 @@ ConverterImpl::StageUsage ConverterImpl::collectStageUsage(const StageFunctionIn
 				addLocal(safeTokenContent(param.name));
 			}
 			collectStatement(stage->body.get());
+			if (stage == converter.vertexStage)
+			{
+				for (const Expression *moved : converter.movedSources)
+				{
+					collectExpression(moved);
+				}
+			}
 			popScope();
 			popNamespace();
 		}
@@ -1316,1645 +1688,4885 @@ ConverterImpl::StageUsage ConverterImpl::collectStageUsage(const StageFunctionIn
 	return usage;
 }
 
-void ConverterImpl::emitCommon(std::ostringstream &oss, const StageUsage &usage) const
-{
-	emitStructs(oss);
-	emitStructMethods(oss, usage);
-	emitBlocks(oss, AggregateInstruction::Kind::ConstantBlock, usage);
-	emitBlockMethods(oss, constantBlocks, usage);
-	emitBlocks(oss, AggregateInstruction::Kind::AttributeBlock, usage);
-	emitBlockMethods(oss, attributeBlocks, usage);
-	emitGlobalVariables(oss, usage);
-	emitFunctions(oss, usage);
-	emitTextures(oss, usage);
-}
-
-void ConverterImpl::emitStructs(std::ostringstream &oss) const
+void ConverterImpl::foldConstants()
 {
-	for (const AggregateInfo &info : structures)
+	struct ConstantFolder
 	{
-		const auto *aggregate = info.node;
-		if (!aggregate)
-		{
-			continue;
-		}
-		oss << "struct " << sanitizeIdentifier(info.qualifiedName) << "\n{\n";
-		emitBlockMembers(oss, *aggregate, 1, nullptr);
-		oss << "};\n\n";
-	}
-}
+		using Values = std::vector<ConstantValue>;
 
-void ConverterImpl::emitBlocks(std::ostringstream &oss, AggregateInstruction::Kind kind, const StageUsage &usage) const
-{
-	const std::vector<AggregateInfo> &blocks = (kind == AggregateInstruction::Kind::ConstantBlock) ? constantBlocks :
-	                                                                                                 attributeBlocks;
-	const char *bindingKeyword = (kind == AggregateInstruction::Kind::AttributeBlock) ? "ATTRIBUTE_BINDING" :
-	                                                                       "CONSTANT_BINDING";
+		ConverterImpl &converter;
+		// Names declared in each enclosing scope, with their value when they are const and initialized by a
+		// constant.
+		std::vector<std::unordered_map<std::string, std::optional<ConstantValue>>> scopes;
+		std::vector<std::string> currentNamespace;
+		const AggregateInfo *currentAggregate = nullptr;
+		std::unordered_map<const VariableDeclarator *, std::optional<ConstantValue>> globalValues;
 
-	for (const AggregateInfo &info : blocks)
-	{
-		if (usage.blocks.find(info.qualifiedName) == usage.blocks.end())
-		{
-			continue;
-		}
-		const AggregateInstruction *aggregate = info.node;
-		if (!aggregate)
+		explicit ConstantFolder(ConverterImpl &converter) : converter(converter) {}
+
+		void declare(const std::string &name, std::optional<ConstantValue> value = std::nullopt)
 		{
-			continue;
+			scopes.back()[name] = std::move(value);
 		}
-		const bool ssbo = info.isSSBO;
-		const std::string &blockName = info.glslInstanceName;
-		const std::string &blockTypeName = info.glslTypeName;
-
-		oss << "layout(binding = " << bindingKeyword << ", std430) "
-		    << (ssbo ? "buffer" : "uniform") << " " << blockTypeName << "\n{\n";
-		emitBlockMembers(oss, *aggregate, 1, &info);
-		oss << "} " << blockName << ";\n\n";
-	}
-}
 
-void ConverterImpl::emitBlockMembers(
-    std::ostringstream &oss,
-    const AggregateInstruction &aggregate,
-    int indent,
-    const AggregateInfo *info) const
-{
-	const bool addSize = info && info->isSSBO;
-	const std::string blockName = info ? info->glslInstanceName : std::string{};
-
-	for (const std::unique_ptr<StructMember> &member : aggregate.members)
-	{
-		if (!member || member->kind != StructMember::Kind::Field)
+		// Everything that has no computation left to fold away: a literal, a negated literal, a name, or a
+		// constructor of those.
+		bool isTrivial(const Expression &expression) const
 		{
-			continue;
+			switch (expression.kind)
+			{
+				case Expression::Kind::Literal:
+				case Expression::Kind::Identifier:
+					return true;
+				case Expression::Kind::Unary:
+				{
+					const auto &unary = static_cast<const UnaryExpression &>(expression);
+					return (unary.op == UnaryOperator::Negate || unary.op == UnaryOperator::Positive) && unary.operand &&
+					       unary.operand->kind == Expression::Kind::Literal;
+				}
+				case Expression::Kind::Call:
+				{
+					const auto &call = static_cast<const CallExpression &>(expression);
+					const auto *callee = dynamic_cast<const IdentifierExpression *>(call.callee.get());
+					return callee && isBuiltinTypeName(joinName(callee->name)) &&
+					       std::all_of(call.arguments.begin(), call.arguments.end(),
+					           [&](const std::unique_ptr<Expression> &argument) { return argument && isTrivial(*argument); });
+				}
+				default:
+					return false;
+			}
 		}
-		const auto &field = static_cast<const FieldMember &>(*member);
-		for (const VariableDeclarator &declarator : field.declaration.declarators)
+
+		void record(const Expression *expression, const std::optional<ConstantValue> &value)
 		{
-			writeIndent(oss, indent);
-			if (addSize && declarator.hasArraySuffix && !declarator.hasArraySize)
+			if (!expression || !value || isTrivial(*expression))
 			{
-				const std::string arrayName = sanitizeIdentifier(safeTokenContent(declarator.name));
-				oss << "uint spk_" << blockName << "_" << arrayName << "_size;\n";
-				writeIndent(oss, indent);
+				return;
 			}
-			oss << typeToGLSL(field.declaration.type) << " " << sanitizeIdentifier(safeTokenContent(declarator.name));
-			if (declarator.hasArraySuffix && declarator.arraySize)
+			const auto infoIt = converter.expressionInfo.find(expression);
+			if (infoIt == converter.expressionInfo.end() || infoIt->second.isArray ||
+			    converter.typeToGLSL(infoIt->second.typeName) != value->glslType())
 			{
-				oss << "["
-				    << emitExpression(*declarator.arraySize)
-				    << "]";
+				return;
 			}
-			else if (declarator.hasArraySuffix)
+			std::optional<std::string> glsl = value->glsl();
+			std::optional<std::string> lumina = value->lumina(infoIt->second.typeName);
+			if (glsl && lumina)
 			{
-				oss << "[]";
+				converter.foldedExpressions[expression] = FoldedConstant{std::move(*glsl), std::move(*lumina)};
 			}
-			oss << ";\n";
 		}
-	}
-}
 
-void ConverterImpl::emitStructMethods(std::ostringstream &oss, const StageUsage &usage) const
-{
-	bool emitted = false;
-	for (const AggregateInfo &info : structures)
-	{
-		for (const MethodHelper &helper : info.methods)
+		std::optional<ConstantValue> fold(const Expression *expression)
 		{
-			if (usage.methodHelpers.find(helper.helperName) == usage.methodHelpers.end())
-			{
-				continue;
-			}
-			emitMethodHelper(oss, info, helper);
-			emitted = true;
+			std::optional<ConstantValue> value = evaluate(expression);
+			record(expression, value);
+			return value;
 		}
-	}
-	if (emitted)
-	{
-		oss << "\n";
-	}
-}
 
-void ConverterImpl::emitBlockMethods(
-    std::ostringstream &oss, const std::vector<AggregateInfo> &aggregates, const StageUsage &usage) const
-{
-	bool emitted = false;
-	for (const AggregateInfo &info : aggregates)
-	{
-		for (const MethodHelper &helper : info.methods)
+		// Field array sizes are written as their value: GLSL declares the globals they may name after the blocks.
+		void foldArraySize(const Expression *size)
 		{
-			if (usage.methodHelpers.find(helper.helperName) == usage.methodHelpers.end())
+			if (!size || size->kind == Expression::Kind::Literal)
 			{
-				continue;
+				return;
+			}
+			const std::optional<ConstantValue> value = evaluate(size);
+			if (!value || value->shape != ConstantValue::Shape::Scalar ||
+			    (value->scalar != ConstantValue::Scalar::Int && value->scalar != ConstantValue::Scalar::UInt))
+			{
+				return;
+			}
+			std::optional<std::string> glsl = value->glsl();
+			std::optional<std::string> lumina = value->lumina(value->glslType());
+			if (glsl && lumina)
+			{
+				converter.foldedExpressions[size] = FoldedConstant{std::move(*glsl), std::move(*lumina)};
 			}
-			emitMethodHelper(oss, info, helper);
-			emitted = true;
 		}
-	}
-	if (emitted)
-	{
-		oss << "\n";
-	}
-}
 
-void ConverterImpl::emitGlobalVariables(std::ostringstream &oss, const StageUsage &usage) const
-{
-	for (const VariableInstruction *variable : globalVariables)
-	{
-		if (!variable)
-		{
-			continue;
-		}
-		if (usage.globals.find(variable) == usage.globals.end())
-		{
-			continue;
-		}
-		const std::string type = joinName(variable->declaration.type.name);
-		if (type == "Texture")
+		// Applies p_apply when every operand is constant; otherwise the constant operands are folded on their own.
+		std::optional<ConstantValue> combine(const std::vector<const Expression *> &operands,
+		    const std::function<std::optional<ConstantValue>(const Values &)> &apply)
 		{
-			continue;
-		}
-		for (const VariableDeclarator &declarator : variable->declaration.declarators)
-		{
-			const std::string name = remapIdentifier(qualify(declarator.name));
-			oss << (variable->declaration.type.isConst ? "const " : "");
-			oss << typeToGLSL(variable->declaration.type) << " " << name;
-			if (declarator.initializer)
+			std::vector<std::optional<ConstantValue>> values;
+			values.reserve(operands.size());
+			bool constant = true;
+			for (const Expression *operand : operands)
+			{
+				values.push_back(evaluate(operand));
+				constant = constant && values.back();
+			}
+			if (constant)
 			{
-				oss << " = " << emitExpression(*declarator.initializer);
+				Values arguments;
+				for (std::optional<ConstantValue> &value : values)
+				{
+					arguments.push_back(std::move(*value));
+				}
+				if (std::optional<ConstantValue> result = apply(arguments))
+				{
+					return result;
+				}
+				for (std::size_t i = 0; i < operands.size(); ++i)
+				{
+					values[i] = std::move(arguments[i]);
+				}
+			}
+			for (std::size_t i = 0; i < operands.size(); ++i)
+			{
+				record(operands[i], values[i]);
 			}
-			oss << ";\n";
+			return std::nullopt;
 		}
-	}
-	if (!globalVariables.empty() && !usage.globals.empty())
-	{
-		oss << "\n";
-	}
-}
 
-void ConverterImpl::emitTextures(std::ostringstream &oss, const StageUsage &usage) const
-{
-	if (input.textures.empty())
+		// Value of the expression when it is a constant. Otherwise its largest constant parts are recorded.
+		std::optional<ConstantValue> evaluate(const Expression *expression)
+		{
+			if (!expression)
+			{
+				return std::nullopt;
+			}
+			switch (expression->kind)
+			{
+				case Expression::Kind::Literal:
+					return parseConstantLiteral(static_cast<const LiteralExpression *>(expression)->literal.content);
+				case Expression::Kind::ArrayLiteral:
+					for (const std::unique_ptr<Expression> &element :
+					    static_cast<const ArrayLiteralExpression *>(expression)->elements)
+					{
+						fold(element.get());
+					}
+					return std::nullopt;
+				case Expression::Kind::Identifier:
+					return identifierValue(static_cast<const IdentifierExpression &>(*expression));
+				case Expression::Kind::Unary:
+				{
+					const auto *unary = static_cast<const UnaryExpression *>(expression);
+					if (unary->op == UnaryOperator::PreIncrement || unary->op == UnaryOperator::PreDecrement)
+					{
+						visitTarget(unary->operand.get());
+						return std::nullopt;
+					}
+					return combine({unary->operand.get()}, [&](const Values &values) { return foldUnary(unary->op, values[0]); });
+				}
+				case Expression::Kind::Binary:
+				{
+					const auto *binary = static_cast<const BinaryExpression *>(expression);
+					return combine({binary->left.get(), binary->right.get()},
+					    [&](const Values &values) { return foldBinary(binary->op, values[0], values[1]); });
+				}
+				case Expression::Kind::Assignment:
+				{
+					const auto *assignment = static_cast<const AssignmentExpression *>(expression);
+					visitTarget(assignment->target.get());
+					fold(assignment->value.get());
+					return std::nullopt;
+				}
+				case Expression::Kind::Conditional:
+				{
+					const auto *conditional = static_cast<const ConditionalExpression *>(expression);
+					return combine({conditional->condition.get(), conditional->thenBranch.get(), conditional->elseBranch.get()},
+					    [](const Values &values) -> std::optional<ConstantValue> {
+						    const ConstantValue &condition = values[0];
+						    if (condition.scalar != ConstantValue::Scalar::Bool ||
+						        condition.shape != ConstantValue::Shape::Scalar || values[1].glslType() != values[2].glslType())
+						    {
+							    return std::nullopt;
+						    }
+						    return values[condition.components.front() != 0.0 ? 1 : 2];
+					    });
+				}
+				case Expression::Kind::Call:
+					return evaluateCall(static_cast<const CallExpression &>(*expression));
+				case Expression::Kind::MemberAccess:
+				{
+					const auto *member = static_cast<const MemberExpression *>(expression);
+					const std::string swizzle = safeTokenContent(member->member);
+					return combine({member->object.get()}, [&](const Values &values) { return foldSwizzle(values[0], swizzle); });
+				}
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					return combine({index->object.get(), index->index.get()},
+					    [](const Values &values) { return foldIndex(values[0], values[1]); });
+				}
+				case Expression::Kind::Postfix:
+					visitTarget(static_cast<const PostfixExpression *>(expression)->operand.get());
+					return std::nullopt;
+			}
+			return std::nullopt;
+		}
+
+		std::optional<ConstantValue> evaluateCall(const CallExpression &call)
+		{
+			std::vector<const Expression *> arguments;
+			for (const std::unique_ptr<Expression> &argument : call.arguments)
+			{
+				arguments.push_back(argument.get());
+			}
+
+			if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
+			{
+				if (const std::optional<BuiltinCall> builtin = converter.builtinMemberCall(*member, arguments.size()))
+				{
+					arguments.insert(builtin->objectLast ? arguments.end() : arguments.begin(), member->object.get());
+					return combine(arguments, [&](const Values &values) -> std::optional<ConstantValue> {
+						Values withTrailing = values;
+						std::istringstream trailing(builtin->trailing);
+						std::string constant;
+						while (trailing >> constant)
+						{
+							if (constant.back() == ',')
+							{
+								constant.pop_back();
+							}
+							if (constant.empty())
+							{
+								continue;
+							}
+							std::optional<ConstantValue> value = parseConstantLiteral(constant);
+							if (!value)
+							{
+								return std::nullopt;
+							}
+							withTrailing.push_back(std::move(*value));
+						}
+						return foldBuiltin(builtin->function, withTrailing);
+					});
+				}
+				record(member->object.get(), evaluate(member->object.get()));
+			}
+			else if (const auto *identifier = dynamic_cast<const IdentifierExpression *>(call.callee.get()))
+			{
+				const std::string name = joinName(identifier->name);
+				if (isBuiltinTypeName(name))
+				{
+					const std::string type = converter.typeToGLSL(name);
+					return combine(arguments, [&](const Values &values) { return foldConstruct(type, values); });
+				}
+				if (isBuiltinFunctionName(name) && !callsUserCode(name))
+				{
+					return combine(arguments, [&](const Values &values) { return foldBuiltin(name, values); });
+				}
+			}
+
+			for (const Expression *argument : arguments)
+			{
+				fold(argument);
+			}
+			return std::nullopt;
+		}
+
+		// Whether a call to this simple name reaches a user function or a method of the enclosing aggregate rather
+		// than the GLSL builtin of the same name.
+		bool callsUserCode(const std::string &name) const
+		{
+			if (currentAggregate)
+			{
+				for (const MethodHelper &method : currentAggregate->methods)
+				{
+					if (safeTokenContent(method.node->name) == name)
+					{
+						return true;
+					}
+				}
+			}
+			return resolve(name, [&](const std::string &key) { return converter.functionLookup.count(key) != 0; })
+			    .has_value();
+		}
+
+		// Lvalues are never replaced, but their indices can be.
+		void visitTarget(const Expression *expression)
+		{
+			if (!expression)
+			{
+				return;
+			}
+			switch (expression->kind)
+			{
+				case Expression::Kind::Identifier:
+					return;
+				case Expression::Kind::MemberAccess:
+					visitTarget(static_cast<const MemberExpression *>(expression)->object.get());
+					return;
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					visitTarget(index->object.get());
+					fold(index->index.get());
+					return;
+				}
+				default:
+					evaluate(expression);
+					return;
+			}
+		}
+
+		// Key of the name in the most deeply nested enclosing namespace declaring it, as the emitter resolves it.
+		std::optional<std::string> resolve(
+		    const std::string &name, const std::function<bool(const std::string &)> &isDeclared) const
+		{
+			if (name.find("::") == std::string::npos)
+			{
+				for (std::size_t depth = currentNamespace.size(); depth > 0; --depth)
+				{
+					std::string qualified;
+					for (std::size_t i = 0; i < depth; ++i)
+					{
+						qualified += currentNamespace[i] + "::";
+					}
+					qualified += name;
+					if (isDeclared(qualified))
+					{
+						return qualified;
+					}
+				}
+			}
+			if (isDeclared(name))
+			{
+				return name;
+			}
+			return std::nullopt;
+		}
+
+		std::optional<ConstantValue> identifierValue(const IdentifierExpression &identifier)
+		{
+			const std::string name = joinName(identifier.name);
+			if (identifier.name.parts.size() == 1)
+			{
+				for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
+				{
+					if (const auto local = scope->find(name); local != scope->end())
+					{
+						return local->second;
+					}
+				}
+			}
+
+			const std::optional<std::string> canonical = resolve(
+			    name, [&](const std::string &key) { return converter.globalVariableLookup.count(key) != 0; });
+			if (!canonical)
+			{
+				return std::nullopt;
+			}
+			const VariableInstruction &variable = *converter.globalVariableLookup.at(*canonical);
+			if (!variable.declaration.type.isConst)
+			{
+				return std::nullopt;
+			}
+			const std::size_t separator = canonical->rfind("::");
+			const std::string simple = separator == std::string::npos ? *canonical : canonical->substr(separator + 2);
+			for (const VariableDeclarator &declarator : variable.declaration.declarators)
+			{
+				if (safeTokenContent(declarator.name) == simple)
+				{
+					return globalValue(variable, declarator, *canonical);
+				}
+			}
+			return std::nullopt;
+		}
+
+		// Evaluated in the namespace the global was declared in, without the locals of the function using it.
+		std::optional<ConstantValue> globalValue(
+		    const VariableInstruction &variable, const VariableDeclarator &declarator, const std::string &canonical)
+		{
+			if (const auto known = globalValues.find(&declarator); known != globalValues.end())
+			{
+				return known->second;
+			}
+			// Also what a global whose initializer refers back to itself evaluates to.
+			globalValues[&declarator] = std::nullopt;
+			if (declarator.hasArraySuffix || !declarator.initializer)
+			{
+				return std::nullopt;
+			}
+
+			std::vector<std::unordered_map<std::string, std::optional<ConstantValue>>> savedScopes;
+			std::swap(savedScopes, scopes);
+			std::vector<std::string> savedNamespace = namespaceOf(canonical);
+			std::swap(savedNamespace, currentNamespace);
+			const AggregateInfo *savedAggregate = std::exchange(currentAggregate, nullptr);
+
+			std::optional<ConstantValue> value = evaluate(declarator.initializer.get());
+			if (value && value->glslType() != converter.typeToGLSL(variable.declaration.type))
+			{
+				value.reset();
+			}
+
+			scopes = std::move(savedScopes);
+			currentNamespace = std::move(savedNamespace);
+			currentAggregate = savedAggregate;
+			globalValues[&declarator] = value;
+			return value;
+		}
+
+		static std::vector<std::string> namespaceOf(const std::string &canonical)
+		{
+			std::vector<std::string> path;
+			std::size_t start = 0;
+			for (std::size_t separator = canonical.find("::"); separator != std::string::npos;
+			     separator = canonical.find("::", start))
+			{
+				path.push_back(canonical.substr(start, separator - start));
+				start = separator + 2;
+			}
+			return path;
+		}
+
+		void visitStatement(const Statement *statement)
+		{
+			if (!statement)
+			{
+				return;
+			}
+			switch (statement->kind)
+			{
+				case Statement::Kind::Block:
+					scopes.emplace_back();
+					for (const std::unique_ptr<Statement> &nested : static_cast<const BlockStatement *>(statement)->statements)
+					{
+						visitStatement(nested.get());
+					}
+					scopes.pop_back();
+					break;
+				case Statement::Kind::Expression:
+					fold(static_cast<const ExpressionStatement *>(statement)->expression.get());
+					break;
+				case Statement::Kind::Variable:
+				{
+					const VariableDeclaration &declaration = static_cast<const VariableStatement *>(statement)->declaration;
+					for (const VariableDeclarator &declarator : declaration.declarators)
+					{
+						std::optional<ConstantValue> value = fold(declarator.initializer.get());
+						if (!declaration.type.isConst || declarator.hasArraySuffix ||
+						    (value && value->glslType() != converter.typeToGLSL(declaration.type)))
+						{
+							value.reset();
+						}
+						declare(safeTokenContent(declarator.name), std::move(value));
+					}
+					break;
+				}
+				case Statement::Kind::If:
+				{
+					const auto *ifStatement = static_cast<const IfStatement *>(statement);
+					fold(ifStatement->condition.get());
+					visitStatement(ifStatement->thenBranch.get());
+					visitStatement(ifStatement->elseBranch.get());
+					break;
+				}
+				case Statement::Kind::While:
+				{
+					const auto *whileStatement = static_cast<const WhileStatement *>(statement);
+					fold(whileStatement->condition.get());
+					visitStatement(whileStatement->body.get());
+					break;
+				}
+				case Statement::Kind::DoWhile:
+				{
+					const auto *doStatement = static_cast<const DoWhileStatement *>(statement);
+					visitStatement(doStatement->body.get());
+					fold(doStatement->condition.get());
+					break;
+				}
+				case Statement::Kind::For:
+				{
+					const auto *forStatement = static_cast<const ForStatement *>(statement);
+					scopes.emplace_back();
+					visitStatement(forStatement->initializer.get());
+					fold(forStatement->condition.get());
+					fold(forStatement->increment.get());
+					visitStatement(forStatement->body.get());
+					scopes.pop_back();
+					break;
+				}
+				case Statement::Kind::Return:
+					fold(static_cast<const ReturnStatement *>(statement)->value.get());
+					break;
+				case Statement::Kind::Break:
+				case Statement::Kind::Continue:
+				case Statement::Kind::Discard:
+					break;
+			}
+		}
+
+		void visitBody(const std::vector<std::string> &ns, const std::vector<Parameter> &parameters,
+		    const BlockStatement &body, const AggregateInfo *aggregate = nullptr)
+		{
+			currentNamespace = ns;
+			currentAggregate = aggregate;
+			scopes.emplace_back();
+			if (aggregate)
+			{
+				declare("this");
+				for (const std::string &field : aggregate->fieldNames)
+				{
+					declare(field);
+				}
+			}
+			for (const Parameter &parameter : parameters)
+			{
+				declare(safeTokenContent(parameter.name));
+			}
+			visitStatement(&body);
+			scopes.pop_back();
+		}
+	};
+
+	ConstantFolder folder(*this);
+	for (const auto &[canonical, variable] : globalVariableLookup)
+	{
+		const std::size_t separator = canonical.rfind("::");
+		const std::string simple = separator == std::string::npos ? canonical : canonical.substr(separator + 2);
+		for (const VariableDeclarator &declarator : variable->declaration.declarators)
+		{
+			if (safeTokenContent(declarator.name) == simple)
+			{
+				folder.currentNamespace = ConstantFolder::namespaceOf(canonical);
+				folder.fold(declarator.initializer.get());
+			}
+		}
+	}
+	for (const FunctionInstruction *function : functions)
+	{
+		if (function->body)
+		{
+			folder.visitBody(functionNamespaces[function], function->parameters, *function->body);
+		}
+	}
+	for (const StageFunctionInstruction *stage : {vertexStage, fragmentStage})
+	{
+		if (stage && stage->body)
+		{
+			folder.visitBody(stageNamespaces[stage], stage->parameters, *stage->body);
+		}
+	}
+	for (const std::vector<AggregateInfo> *aggregates : {&structures, &attributeBlocks, &constantBlocks})
+	{
+		for (const AggregateInfo &aggregate : *aggregates)
+		{
+			folder.currentNamespace = aggregate.namespacePath;
+			for (const FieldSlot &slot : orderedFields(aggregate))
+			{
+				if (slot.declarator->hasArraySuffix)
+				{
+					folder.foldArraySize(slot.declarator->arraySize.get());
+				}
+			}
+			for (const MethodHelper &method : aggregate.methods)
+			{
+				folder.visitBody(aggregate.namespacePath, method.node->parameters, *method.node->body, &aggregate);
+			}
+		}
+	}
+}
+
+struct ConverterImpl::StageWalker
+{
+	ConverterImpl &converter;
+	EmissionContext scope;
+	std::vector<std::unordered_set<std::string>> locals;
+
+	explicit StageWalker(ConverterImpl &converter) : converter(converter) {}
+
+	bool isLocal(const std::string &name) const
+	{
+		return std::any_of(locals.begin(), locals.end(),
+		    [&](const std::unordered_set<std::string> &names) { return names.count(name) != 0; });
+	}
+
+	// Whether a call to this simple name reaches a user function rather than the GLSL builtin of the same name.
+	bool callsUserFunction(const std::string &name) const
+	{
+		std::string prefix;
+		for (const std::string &part : scope.currentNamespace())
+		{
+			prefix += part + "::";
+			if (converter.functionLookup.count(prefix + name) != 0)
+			{
+				return true;
+			}
+		}
+		return converter.functionLookup.count(name) != 0;
+	}
+};
+
+void ConverterImpl::hoistUniformExpressions()
+{
+	// An expression reading nothing but literals and the fields of at most one block. It can be the block itself,
+	// which only a member access turns into a value.
+	struct Uniformity
+	{
+		const AggregateInfo *block = nullptr;
+		bool isBlockReference = false;
+		// Holds arithmetic or a builtin call, so a derived member saves work rather than only a read.
+		bool computes = false;
+	};
+
+	struct UniformHoister : StageWalker
+	{
+		// One derived member to be: every expression computing the same text from the same block, in both stages.
+		struct Field
+		{
+			const AggregateInfo *block = nullptr;
+			std::string typeName;
+			std::vector<std::string> namespacePath;
+			std::vector<const Expression *> expressions;
+			std::optional<std::size_t> index;
+		};
+
+		std::vector<Field> fields;
+		// Block qualified name and expression text to their entry in fields.
+		std::unordered_map<std::string, std::size_t> fieldIndices;
+
+		using StageWalker::StageWalker;
+
+		static bool isHoistableType(const std::string &typeName)
+		{
+			static const std::unordered_set<std::string> types = {"float", "int", "uint", "Vector2", "Vector3",
+			    "Vector4", "Vector2Int", "Vector3Int", "Vector4Int", "Vector2UInt", "Vector3UInt", "Vector4UInt", "Color",
+			    "Matrix2x2", "Matrix3x3", "Matrix4x4"};
+			return types.count(typeName) != 0;
+		}
+
+		std::optional<std::size_t> findField(const AggregateInfo &block, const Expression &expression) const
+		{
+			const auto it = fieldIndices.find(block.qualifiedName + "\n" + converter.renderLumina(scope, expression, false));
+			return it == fieldIndices.end() ? std::nullopt : std::optional<std::size_t>(it->second);
+		}
+
+		// Records the expression for a derived member when it is worth one; finish() creates the members.
+		void settle(const Expression *expression, const Uniformity &uniformity)
+		{
+			if (!uniformity.block || !uniformity.computes || uniformity.isBlockReference ||
+			    converter.foldedExpressions.count(expression) != 0)
+			{
+				return;
+			}
+			const auto infoIt = converter.expressionInfo.find(expression);
+			if (infoIt == converter.expressionInfo.end() || infoIt->second.isArray ||
+			    !isHoistableType(infoIt->second.typeName))
+			{
+				return;
+			}
+
+			const AggregateInfo &block = *uniformity.block;
+			const auto [it, inserted] = fieldIndices.emplace(
+			    block.qualifiedName + "\n" + converter.renderLumina(scope, *expression, false), fields.size());
+			if (inserted)
+			{
+				fields.push_back(Field{&block, infoIt->second.typeName, scope.currentNamespace(), {}, std::nullopt});
+			}
+			fields[it->second].expressions.push_back(expression);
+		}
+
+		// The outermost operands of the expression that another field of the block already computes.
+		void findShared(const Field &field, const Expression *expression,
+		    std::vector<std::pair<const Expression *, std::size_t>> &shared) const
+		{
+			std::vector<const Expression *> operands;
+			switch (expression->kind)
+			{
+				case Expression::Kind::Unary:
+					operands = {static_cast<const UnaryExpression *>(expression)->operand.get()};
+					break;
+				case Expression::Kind::Binary:
+				{
+					const auto *binary = static_cast<const BinaryExpression *>(expression);
+					operands = {binary->left.get(), binary->right.get()};
+					break;
+				}
+				case Expression::Kind::Conditional:
+				{
+					const auto *conditional = static_cast<const ConditionalExpression *>(expression);
+					operands = {conditional->condition.get(), conditional->thenBranch.get(), conditional->elseBranch.get()};
+					break;
+				}
+				case Expression::Kind::Call:
+				{
+					const auto *call = static_cast<const CallExpression *>(expression);
+					if (const auto *member = dynamic_cast<const MemberExpression *>(call->callee.get()))
+					{
+						operands.push_back(member->object.get());
+					}
+					for (const std::unique_ptr<Expression> &argument : call->arguments)
+					{
+						operands.push_back(argument.get());
+					}
+					break;
+				}
+				case Expression::Kind::MemberAccess:
+					operands = {static_cast<const MemberExpression *>(expression)->object.get()};
+					break;
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					operands = {index->object.get(), index->index.get()};
+					break;
+				}
+				default:
+					break;
+			}
+			for (const Expression *operand : operands)
+			{
+				if (const std::optional<std::size_t> other = findField(*field.block, *operand))
+				{
+					shared.emplace_back(operand, *other);
+				}
+				else
+				{
+					findShared(field, operand, shared);
+				}
+			}
+		}
+
+		// Creates the derived member after the members it reads, so the host computes them first.
+		void create(std::size_t fieldIndex)
+		{
+			Field &field = fields[fieldIndex];
+			if (field.index)
+			{
+				return;
+			}
+			scope.namespaceStack = {field.namespacePath};
+			std::vector<std::pair<const Expression *, std::size_t>> shared;
+			findShared(field, field.expressions.front(), shared);
+			std::unordered_map<const Expression *, std::string> substitutions;
+			for (const auto &[operand, other] : shared)
+			{
+				create(other);
+				substitutions[operand] =
+				    field.block->qualifiedName + "." + converter.derivedFields[*fields[other].index].name;
+			}
+
+			const AggregateInfo &block = *field.block;
+			std::size_t count = 0;
+			for (const DerivedBlockField &derived : converter.derivedFields)
+			{
+				count += derived.block == block.qualifiedName ? 1 : 0;
+			}
+			std::string name = "derived" + std::to_string(count);
+			while (block.fieldNames.count(name) != 0)
+			{
+				name = "derived" + std::to_string(++count);
+			}
+			scope.namespaceStack = {field.namespacePath};
+			field.index = converter.derivedFields.size();
+			converter.derivedFields.push_back(DerivedBlockField{block.qualifiedName, std::move(name), field.typeName,
+			    converter.renderLumina(scope, *field.expressions.front(), false, &substitutions)});
+			for (const Expression *expression : field.expressions)
+			{
+				converter.hoistedExpressions[expression] = *field.index;
+			}
+		}
+
+		void finish()
+		{
+			for (std::size_t i = 0; i < fields.size(); ++i)
+			{
+				create(i);
+			}
+		}
+
+		void settleAll(const Expression *expression)
+		{
+			if (const std::optional<Uniformity> uniformity = analyze(expression))
+			{
+				settle(expression, *uniformity);
+			}
+		}
+
+		// Uniform when every operand is, from the same block; otherwise the uniform operands are settled on their
+		// own.
+		std::optional<Uniformity> combine(const std::vector<const Expression *> &operands, bool computes)
+		{
+			std::vector<std::optional<Uniformity>> results;
+			results.reserve(operands.size());
+			bool uniform = true;
+			Uniformity combined;
+			combined.computes = computes;
+			for (const Expression *operand : operands)
+			{
+				results.push_back(analyze(operand));
+				const std::optional<Uniformity> &result = results.back();
+				if (!result || result->isBlockReference || (combined.block && result->block && result->block != combined.block))
+				{
+					uniform = false;
+					continue;
+				}
+				combined.block = combined.block ? combined.block : result->block;
+				combined.computes = combined.computes || result->computes;
+			}
+			if (uniform)
+			{
+				return combined;
+			}
+			for (std::size_t i = 0; i < operands.size(); ++i)
+			{
+				if (results[i])
+				{
+					settle(operands[i], *results[i]);
+				}
+			}
+			return std::nullopt;
+		}
+
+		std::optional<Uniformity> analyze(const Expression *expression)
+		{
+			if (!expression)
+			{
+				return std::nullopt;
+			}
+			switch (expression->kind)
+			{
+				case Expression::Kind::Literal:
+					return Uniformity{};
+				case Expression::Kind::ArrayLiteral:
+					for (const std::unique_ptr<Expression> &element :
+					    static_cast<const ArrayLiteralExpression *>(expression)->elements)
+					{
+						settleAll(element.get());
+					}
+					return std::nullopt;
+				case Expression::Kind::Identifier:
+				{
+					const auto &identifier = static_cast<const IdentifierExpression &>(*expression);
+					if (identifier.name.parts.size() == 1 && isLocal(joinName(identifier.name)))
+					{
+						return std::nullopt;
+					}
+					const std::optional<std::string> aggregate =
+					    converter.resolveAggregateQualifiedName(scope, identifier.name);
+					const AggregateInfo *block = aggregate ? converter.findAggregateInfo(*aggregate) : nullptr;
+					if (!block || block->isSSBO ||
+					    (block->kind != AggregateInstruction::Kind::ConstantBlock &&
+					        block->kind != AggregateInstruction::Kind::AttributeBlock))
+					{
+						return std::nullopt;
+					}
+					return Uniformity{block, true, false};
+				}
+				case Expression::Kind::Unary:
+				{
+					const auto *unary = static_cast<const UnaryExpression *>(expression);
+					if (unary->op == UnaryOperator::PreIncrement || unary->op == UnaryOperator::PreDecrement)
+					{
+						visitTarget(unary->operand.get());
+						return std::nullopt;
+					}
+					return combine({unary->operand.get()}, true);
+				}
+				case Expression::Kind::Binary:
+				{
+					const auto *binary = static_cast<const BinaryExpression *>(expression);
+					return combine({binary->left.get(), binary->right.get()}, true);
+				}
+				case Expression::Kind::Assignment:
+				{
+					const auto *assignment = static_cast<const AssignmentExpression *>(expression);
+					visitTarget(assignment->target.get());
+					settleAll(assignment->value.get());
+					return std::nullopt;
+				}
+				case Expression::Kind::Conditional:
+				{
+					const auto *conditional = static_cast<const ConditionalExpression *>(expression);
+					return combine(
+					    {conditional->condition.get(), conditional->thenBranch.get(), conditional->elseBranch.get()}, true);
+				}
+				case Expression::Kind::Call:
+					return analyzeCall(static_cast<const CallExpression &>(*expression));
+				case Expression::Kind::MemberAccess:
+				{
+					const auto *member = static_cast<const MemberExpression *>(expression);
+					std::optional<Uniformity> object = analyze(member->object.get());
+					if (!object || !object->isBlockReference)
+					{
+						return object;
+					}
+					if (object->block->fieldNames.count(safeTokenContent(member->member)) == 0)
+					{
+						return std::nullopt;
+					}
+					object->isBlockReference = false;
+					return object;
+				}
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					return combine({index->object.get(), index->index.get()}, false);
+				}
+				case Expression::Kind::Postfix:
+					visitTarget(static_cast<const PostfixExpression *>(expression)->operand.get());
+					return std::nullopt;
+			}
+			return std::nullopt;
+		}
+
+		// Constructors and builtin functions, which the host can evaluate. Method calls keep their object, which
+		// may be passed by reference.
+		std::optional<Uniformity> analyzeCall(const CallExpression &call)
+		{
+			std::vector<const Expression *> arguments;
+			for (const std::unique_ptr<Expression> &argument : call.arguments)
+			{
+				arguments.push_back(argument.get());
+			}
+			if (const auto *identifier = dynamic_cast<const IdentifierExpression *>(call.callee.get()))
+			{
+				const std::string name = joinName(identifier->name);
+				if (isBuiltinTypeName(name))
+				{
+					return combine(arguments, false);
+				}
+				if (isBuiltinFunctionName(name) && !callsUserFunction(name))
+				{
+					return combine(arguments, true);
+				}
+			}
+			else if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
+			{
+				// `direction.normalize()` is the builtin with its receiver as first operand.
+				if (converter.builtinMemberCall(*member, arguments.size()))
+				{
+					arguments.insert(arguments.begin(), member->object.get());
+					return combine(arguments, true);
+				}
+				visitTarget(member->object.get());
+			}
+			for (const Expression *argument : arguments)
+			{
+				settleAll(argument);
+			}
+			return std::nullopt;
+		}
+
+		// Lvalues are never replaced, but their indices can be.
+		void visitTarget(const Expression *expression)
+		{
+			if (!expression)
+			{
+				return;
+			}
+			switch (expression->kind)
+			{
+				case Expression::Kind::Identifier:
+					return;
+				case Expression::Kind::MemberAccess:
+					visitTarget(static_cast<const MemberExpression *>(expression)->object.get());
+					return;
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					visitTarget(index->object.get());
+					settleAll(index->index.get());
+					return;
+				}
+				default:
+					settleAll(expression);
+					return;
+			}
+		}
+
+		void visitStatement(const Statement *statement)
+		{
+			if (!statement)
+			{
+				return;
+			}
+			switch (statement->kind)
+			{
+				case Statement::Kind::Block:
+					locals.emplace_back();
+					for (const std::unique_ptr<Statement> &nested : static_cast<const BlockStatement *>(statement)->statements)
+					{
+						visitStatement(nested.get());
+					}
+					locals.pop_back();
+					break;
+				case Statement::Kind::Expression:
+					settleAll(static_cast<const ExpressionStatement *>(statement)->expression.get());
+					break;
+				case Statement::Kind::Variable:
+					for (const VariableDeclarator &declarator :
+					    static_cast<const VariableStatement *>(statement)->declaration.declarators)
+					{
+						settleAll(declarator.initializer.get());
+						locals.back().insert(safeTokenContent(declarator.name));
+					}
+					break;
+				case Statement::Kind::If:
+				{
+					const auto *ifStatement = static_cast<const IfStatement *>(statement);
+					settleAll(ifStatement->condition.get());
+					visitStatement(ifStatement->thenBranch.get());
+					visitStatement(ifStatement->elseBranch.get());
+					break;
+				}
+				case Statement::Kind::While:
+				{
+					const auto *whileStatement = static_cast<const WhileStatement *>(statement);
+					settleAll(whileStatement->condition.get());
+					visitStatement(whileStatement->body.get());
+					break;
+				}
+				case Statement::Kind::DoWhile:
+				{
+					const auto *doStatement = static_cast<const DoWhileStatement *>(statement);
+					visitStatement(doStatement->body.get());
+					settleAll(doStatement->condition.get());
+					break;
+				}
+				case Statement::Kind::For:
+				{
+					const auto *forStatement = static_cast<const ForStatement *>(statement);
+					locals.emplace_back();
+					visitStatement(forStatement->initializer.get());
+					settleAll(forStatement->condition.get());
+					settleAll(forStatement->increment.get());
+					visitStatement(forStatement->body.get());
+					locals.pop_back();
+					break;
+				}
+				case Statement::Kind::Return:
+					settleAll(static_cast<const ReturnStatement *>(statement)->value.get());
+					break;
+				case Statement::Kind::Break:
+				case Statement::Kind::Continue:
+				case Statement::Kind::Discard:
+					break;
+			}
+		}
+	};
+
+	UniformHoister hoister(*this);
+	for (const StageFunctionInstruction *stage : {vertexStage, fragmentStage})
+	{
+		if (!stage || !stage->body)
+		{
+			continue;
+		}
+		hoister.scope.namespaceStack = {stageNamespaces[stage]};
+		hoister.locals.emplace_back();
+		for (const Parameter &parameter : stage->parameters)
+		{
+			hoister.locals.back().insert(safeTokenContent(parameter.name));
+		}
+		hoister.visitStatement(stage->body.get());
+		hoister.locals.pop_back();
+	}
+	hoister.finish();
+}
+
+void ConverterImpl::moveAffineExpressionsToVertex()
+{
+	// Both stages resolve the moved expressions the same way only from the same namespace.
+	if (!vertexStage || !vertexStage->body || !fragmentStage || !fragmentStage->body ||
+	    stageNamespaces[vertexStage] != stageNamespaces[fragmentStage])
+	{
+		return;
+	}
+
+	// An expression the same for the whole draw, or affine in the smooth varyings with coefficients that are.
+	// Interpolation is a weighted sum whose weights add up to one, so it commutes with such an expression.
+	struct Affinity
+	{
+		bool varies = false;
+		// Arithmetic on a varying, so computing it per vertex saves fragment work rather than only a read.
+		bool computes = false;
+		// Set when the expression is a DataBlock itself, which only a member access turns into a value.
+		const AggregateInfo *block = nullptr;
+		// Arithmetic operations and builtin calls the fragment stage would no longer run.
+		int operations = 0;
+		// Varyings the expression reads, once per occurrence.
+		std::vector<std::string> reads;
+
+		void merge(const Affinity &other)
+		{
+			varies = varies || other.varies;
+			computes = computes || other.computes;
+			operations += other.operations;
+			reads.insert(reads.end(), other.reads.begin(), other.reads.end());
+		}
+	};
+
+	// Interpolating one more varying costs about as much as a couple of fragment operations, so an expression only
+	// gets its own varying when it saves more than that, or when the varyings it reads are left unread.
+	constexpr int kMinMovedOperations = 3;
+
+	struct AffineMover : StageWalker
+	{
+		std::unordered_map<std::string, const StageIO *> smoothVaryings;
+		// Names the vertex stage declares where it writes the moved varyings, which would shadow what they read.
+		std::unordered_set<std::string> vertexLocals;
+		// Names a new varying cannot take.
+		std::unordered_set<std::string> takenNames;
+		bool vertexReturns = false;
+		std::unordered_map<std::string, std::size_t> varyingIndices;
+		int nextLocation = 0;
+
+		// Expressions that could move, in the order they were found, and every read of each smooth varying.
+		struct Candidate
+		{
+			const Expression *expression = nullptr;
+			std::string text;
+			std::string typeName;
+			Affinity affinity;
+		};
+		std::vector<Candidate> candidates;
+		std::unordered_map<std::string, int> varyingReads;
+
+		using StageWalker::StageWalker;
+
+		static bool isVaryingType(const std::string &typeName)
+		{
+			return isFloatTypeName(typeName) || isFloatVectorTypeName(typeName);
+		}
+
+		bool readsVertexLocal(const Expression &expression) const
+		{
+			switch (expression.kind)
+			{
+				case Expression::Kind::Identifier:
+				{
+					const auto &identifier = static_cast<const IdentifierExpression &>(expression);
+					return identifier.name.parts.size() == 1 && vertexLocals.count(joinName(identifier.name)) != 0;
+				}
+				case Expression::Kind::Unary:
+					return readsVertexLocal(*static_cast<const UnaryExpression &>(expression).operand);
+				case Expression::Kind::Binary:
+				{
+					const auto &binary = static_cast<const BinaryExpression &>(expression);
+					return readsVertexLocal(*binary.left) || readsVertexLocal(*binary.right);
+				}
+				case Expression::Kind::Conditional:
+				{
+					const auto &conditional = static_cast<const ConditionalExpression &>(expression);
+					return readsVertexLocal(*conditional.condition) || readsVertexLocal(*conditional.thenBranch) ||
+					       readsVertexLocal(*conditional.elseBranch);
+				}
+				case Expression::Kind::Call:
+				{
+					const auto &call = static_cast<const CallExpression &>(expression);
+					return std::any_of(call.arguments.begin(), call.arguments.end(),
+					    [&](const std::unique_ptr<Expression> &argument) { return readsVertexLocal(*argument); });
+				}
+				case Expression::Kind::MemberAccess:
+					return readsVertexLocal(*static_cast<const MemberExpression &>(expression).object);
+				case Expression::Kind::IndexAccess:
+				{
+					const auto &index = static_cast<const IndexExpression &>(expression);
+					return readsVertexLocal(*index.object) || readsVertexLocal(*index.index);
+				}
+				default:
+					return false;
+			}
+		}
+
+		// Records the expression as a candidate for its own varying. Whether it moves is decided by commit, once
+		// every read of the varyings is known.
+		void settle(const Expression *expression, const Affinity &affinity)
+		{
+			if (!affinity.varies || !affinity.computes)
+			{
+				return;
+			}
+			const auto infoIt = converter.expressionInfo.find(expression);
+			if (infoIt == converter.expressionInfo.end() || infoIt->second.isArray ||
+			    !isVaryingType(infoIt->second.typeName) || readsVertexLocal(*expression))
+			{
+				return;
+			}
+			candidates.push_back(
+			    Candidate{expression, converter.renderLumina(scope, *expression, false), infoIt->second.typeName, affinity});
+		}
+
+		// Moves the candidates that are worth a varying. Candidates spelled the same share one. The cheap ones move
+		// together with every other cheap one reading the same varyings, and only when those varyings are then
+		// unread and the moved expressions need no more varyings than they free.
+		void commit()
+		{
+			struct Group
+			{
+				int operations = 0;
+				std::unordered_set<std::string> reads;
+				bool moves = false;
+			};
+			std::vector<Group> groups;
+			std::unordered_map<std::string, std::size_t> groupIndices;
+			std::vector<std::size_t> candidateGroups;
+			std::unordered_map<std::string, int> readsOutside = varyingReads;
+			std::unordered_map<std::string, std::vector<std::size_t>> cheapReaders;
+			for (const Candidate &candidate : candidates)
+			{
+				const auto [it, inserted] = groupIndices.emplace(candidate.text, groups.size());
+				if (inserted)
+				{
+					groups.push_back(Group{candidate.affinity.operations, {}, false});
+				}
+				candidateGroups.push_back(it->second);
+				Group &group = groups[it->second];
+				for (const std::string &name : candidate.affinity.reads)
+				{
+					--readsOutside[name];
+					group.reads.insert(name);
+				}
+			}
+			for (std::size_t i = 0; i < groups.size(); ++i)
+			{
+				groups[i].moves = groups[i].operations >= kMinMovedOperations;
+				if (!groups[i].moves)
+				{
+					for (const std::string &name : groups[i].reads)
+					{
+						cheapReaders[name].push_back(i);
+					}
+				}
+			}
+
+			std::vector<bool> visited(groups.size(), false);
+			for (std::size_t first = 0; first < groups.size(); ++first)
+			{
+				if (groups[first].moves || visited[first])
+				{
+					continue;
+				}
+				std::vector<std::size_t> component = {first};
+				std::unordered_set<std::string> freed;
+				bool varyingsDie = true;
+				visited[first] = true;
+				for (std::size_t next = 0; next < component.size(); ++next)
+				{
+					for (const std::string &name : groups[component[next]].reads)
+					{
+						if (!freed.insert(name).second)
+						{
+							continue;
+						}
+						varyingsDie = varyingsDie && readsOutside[name] == 0;
+						for (std::size_t reader : cheapReaders[name])
+						{
+							if (!visited[reader])
+							{
+								visited[reader] = true;
+								component.push_back(reader);
+							}
+						}
+					}
+				}
+				if (varyingsDie && component.size() <= freed.size())
+				{
+					for (std::size_t index : component)
+					{
+						groups[index].moves = true;
+					}
+				}
+			}
+
+			for (std::size_t i = 0; i < candidates.size(); ++i)
+			{
+				if (groups[candidateGroups[i]].moves)
+				{
+					move(candidates[i]);
+				}
+			}
+		}
+
+		void move(Candidate &candidate)
+		{
+			auto it = varyingIndices.find(candidate.text);
+			if (it == varyingIndices.end())
+			{
+				if (nextLocation >= kMaxVaryingLocations)
+				{
+					return;
+				}
+				std::size_t count = converter.movedVaryings.size();
+				std::string name = "moved" + std::to_string(count);
+				while (takenNames.count(name) != 0)
+				{
+					name = "moved" + std::to_string(++count);
+				}
+				takenNames.insert(name);
+				StageIO varying;
+				varying.location = nextLocation++;
+				varying.type = candidate.typeName;
+				varying.name = std::move(name);
+				it = varyingIndices.emplace(candidate.text, converter.movedVaryings.size()).first;
+				converter.movedVaryings.push_back(MovedVarying{std::move(varying), std::move(candidate.text)});
+				converter.movedSources.push_back(candidate.expression);
+			}
+			converter.movedExpressions[candidate.expression] = it->second;
+		}
+
+		void settleAll(const Expression *expression)
+		{
+			if (const std::optional<Affinity> affinity = analyze(expression))
+			{
+				settle(expression, *affinity);
+			}
+		}
+
+		// Settles the operands that were analyzed on their own, when their parent cannot move.
+		std::nullopt_t reject(
+		    const std::vector<const Expression *> &operands, const std::vector<std::optional<Affinity>> &results)
+		{
+			for (std::size_t i = 0; i < operands.size(); ++i)
+			{
+				if (results[i])
+				{
+					settle(operands[i], *results[i]);
+				}
+			}
+			return std::nullopt;
+		}
+
+		std::vector<std::optional<Affinity>> analyzeAll(const std::vector<const Expression *> &operands)
+		{
+			std::vector<std::optional<Affinity>> results;
+			results.reserve(operands.size());
+			for (const Expression *operand : operands)
+			{
+				results.push_back(analyze(operand));
+			}
+			return results;
+		}
+
+		// Operands combined component-wise, as by a vector constructor or a sum: affine when each of them is.
+		// Operations that are not linear only accept operands that do not vary.
+		std::optional<Affinity> combine(const std::vector<const Expression *> &operands, bool linear)
+		{
+			const std::vector<std::optional<Affinity>> results = analyzeAll(operands);
+			Affinity combined;
+			for (const std::optional<Affinity> &result : results)
+			{
+				if (!result || result->block || (result->varies && !linear))
+				{
+					return reject(operands, results);
+				}
+				combined.merge(*result);
+			}
+			return combined;
+		}
+
+		std::optional<Affinity> analyzeBinary(const BinaryExpression &binary)
+		{
+			const std::vector<const Expression *> operands = {binary.left.get(), binary.right.get()};
+			const std::vector<std::optional<Affinity>> results = analyzeAll(operands);
+			const std::optional<Affinity> &left = results[0];
+			const std::optional<Affinity> &right = results[1];
+			if (!left || !right || left->block || right->block)
+			{
+				return reject(operands, results);
+			}
+			bool affine = false;
+			switch (binary.op)
+			{
+				case BinaryOperator::Add:
+				case BinaryOperator::Subtract:
+					affine = true;
+					break;
+				case BinaryOperator::Multiply:
+					affine = !(left->varies && right->varies);
+					break;
+				case BinaryOperator::Divide:
+					affine = !right->varies;
+					break;
+				default:
+					affine = !left->varies && !right->varies;
+					break;
+			}
+			if (!affine)
+			{
+				return reject(operands, results);
+			}
+			Affinity result = *left;
+			result.merge(*right);
+			result.computes = result.varies;
+			++result.operations;
+			return result;
+		}
+
+		std::optional<Affinity> analyze(const Expression *expression)
+		{
+			if (!expression)
+			{
+				return std::nullopt;
+			}
+			if (converter.foldedExpressions.count(expression) != 0 || converter.hoistedExpressions.count(expression) != 0)
+			{
+				return Affinity{};
+			}
+			switch (expression->kind)
+			{
+				case Expression::Kind::Literal:
+					return Affinity{};
+				case Expression::Kind::ArrayLiteral:
+					for (const std::unique_ptr<Expression> &element :
+					    static_cast<const ArrayLiteralExpression *>(expression)->elements)
+					{
+						settleAll(element.get());
+					}
+					return std::nullopt;
+				case Expression::Kind::Identifier:
+				{
+					const auto &identifier = static_cast<const IdentifierExpression &>(*expression);
+					const std::string name = joinName(identifier.name);
+					if (identifier.name.parts.size() == 1 && isLocal(name))
+					{
+						return std::nullopt;
+					}
+					if (const auto varying = smoothVaryings.find(name); varying != smoothVaryings.end())
+					{
+						++varyingReads[name];
+						return Affinity{true, false, nullptr, 0, {name}};
+					}
+					const std::optional<std::string> aggregate =
+					    converter.resolveAggregateQualifiedName(scope, identifier.name);
+					const AggregateInfo *block = aggregate ? converter.findAggregateInfo(*aggregate) : nullptr;
+					if (!block || block->isSSBO ||
+					    (block->kind != AggregateInstruction::Kind::ConstantBlock &&
+					        block->kind != AggregateInstruction::Kind::AttributeBlock))
+					{
+						return std::nullopt;
+					}
+					return Affinity{false, false, block, 0, {}};
+				}
+				case Expression::Kind::Unary:
+				{
+					const auto *unary = static_cast<const UnaryExpression *>(expression);
+					if (unary->op == UnaryOperator::PreIncrement || unary->op == UnaryOperator::PreDecrement)
+					{
+						visitTarget(unary->operand.get());
+						return std::nullopt;
+					}
+					std::optional<Affinity> operand = combine(
+					    {unary->operand.get()}, unary->op == UnaryOperator::Negate || unary->op == UnaryOperator::Positive);
+					if (operand && unary->op == UnaryOperator::Negate)
+					{
+						operand->computes = operand->computes || operand->varies;
+						++operand->operations;
+					}
+					return operand;
+				}
+				case Expression::Kind::Binary:
+					return analyzeBinary(static_cast<const BinaryExpression &>(*expression));
+				case Expression::Kind::Assignment:
+				{
+					const auto *assignment = static_cast<const AssignmentExpression *>(expression);
+					visitTarget(assignment->target.get());
+					settleAll(assignment->value.get());
+					return std::nullopt;
+				}
+				case Expression::Kind::Conditional:
+				{
+					// A condition the same for the whole draw picks the same branch at every vertex.
+					const auto *conditional = static_cast<const ConditionalExpression *>(expression);
+					const std::vector<const Expression *> operands = {
+					    conditional->condition.get(), conditional->thenBranch.get(), conditional->elseBranch.get()};
+					const std::vector<std::optional<Affinity>> results = analyzeAll(operands);
+					if (std::any_of(results.begin(), results.end(),
+					        [](const std::optional<Affinity> &result) { return !result || result->block; }) ||
+					    results[0]->varies)
+					{
+						return reject(operands, results);
+					}
+					Affinity result = *results[0];
+					result.merge(*results[1]);
+					result.merge(*results[2]);
+					++result.operations;
+					return result;
+				}
+				case Expression::Kind::Call:
+					return analyzeCall(static_cast<const CallExpression &>(*expression));
+				case Expression::Kind::MemberAccess:
+				{
+					// A field of a block, or a swizzle.
+					const auto *member = static_cast<const MemberExpression *>(expression);
+					std::optional<Affinity> object = analyze(member->object.get());
+					if (!object || !object->block)
+					{
+						return object;
+					}
+					if (object->block->fieldNames.count(safeTokenContent(member->member)) == 0)
+					{
+						return std::nullopt;
+					}
+					return Affinity{};
+				}
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					const std::vector<const Expression *> operands = {index->object.get(), index->index.get()};
+					const std::vector<std::optional<Affinity>> results = analyzeAll(operands);
+					if (!results[0] || !results[1] || results[0]->block || results[1]->block ||
+					    results[1]->varies)
+					{
+						return reject(operands, results);
+					}
+					Affinity result = *results[0];
+					result.merge(*results[1]);
+					return result;
+				}
+				case Expression::Kind::Postfix:
+					visitTarget(static_cast<const PostfixExpression *>(expression)->operand.get());
+					return std::nullopt;
+			}
+			return std::nullopt;
+		}
+
+		// Float and vector constructors are affine in their arguments. Other constructors and builtin functions
+		// only keep values that do not vary.
+		std::optional<Affinity> analyzeCall(const CallExpression &call)
+		{
+			std::vector<const Expression *> arguments;
+			for (const std::unique_ptr<Expression> &argument : call.arguments)
+			{
+				arguments.push_back(argument.get());
+			}
+			if (const auto *identifier = dynamic_cast<const IdentifierExpression *>(call.callee.get()))
+			{
+				const std::string name = joinName(identifier->name);
+				if (isBuiltinTypeName(name))
+				{
+					return combine(arguments, isVaryingType(name));
+				}
+				if (isBuiltinFunctionName(name) && !callsUserFunction(name))
+				{
+					std::optional<Affinity> result = combine(arguments, false);
+					if (result)
+					{
+						++result->operations;
+					}
+					return result;
+				}
+			}
+			else if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
+			{
+				// The method form of a builtin, with its receiver as first operand.
+				if (converter.builtinMemberCall(*member, arguments.size()))
+				{
+					arguments.insert(arguments.begin(), member->object.get());
+					std::optional<Affinity> result = combine(arguments, false);
+					if (result)
+					{
+						++result->operations;
+					}
+					return result;
+				}
+				visitTarget(member->object.get());
+			}
+			for (const Expression *argument : arguments)
+			{
+				settleAll(argument);
+			}
+			return std::nullopt;
+		}
+
+		// Lvalues are never replaced, but their indices can be.
+		void visitTarget(const Expression *expression)
+		{
+			if (!expression)
+			{
+				return;
+			}
+			switch (expression->kind)
+			{
+				case Expression::Kind::Identifier:
+					return;
+				case Expression::Kind::MemberAccess:
+					visitTarget(static_cast<const MemberExpression *>(expression)->object.get());
+					return;
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					visitTarget(index->object.get());
+					settleAll(index->index.get());
+					return;
+				}
+				default:
+					settleAll(expression);
+					return;
+			}
+		}
+
+		void visitStatement(const Statement *statement)
+		{
+			if (!statement)
+			{
+				return;
+			}
+			switch (statement->kind)
+			{
+				case Statement::Kind::Block:
+					locals.emplace_back();
+					for (const std::unique_ptr<Statement> &nested : static_cast<const BlockStatement *>(statement)->statements)
+					{
+						visitStatement(nested.get());
+					}
+					locals.pop_back();
+					break;
+				case Statement::Kind::Expression:
+					settleAll(static_cast<const ExpressionStatement *>(statement)->expression.get());
+					break;
+				case Statement::Kind::Variable:
+					for (const VariableDeclarator &declarator :
+					    static_cast<const VariableStatement *>(statement)->declaration.declarators)
+					{
+						settleAll(declarator.initializer.get());
+						locals.back().insert(safeTokenContent(declarator.name));
+					}
+					break;
+				case Statement::Kind::If:
+				{
+					const auto *ifStatement = static_cast<const IfStatement *>(statement);
+					settleAll(ifStatement->condition.get());
+					visitStatement(ifStatement->thenBranch.get());
+					visitStatement(ifStatement->elseBranch.get());
+					break;
+				}
+				case Statement::Kind::While:
+				{
+					const auto *whileStatement = static_cast<const WhileStatement *>(statement);
+					settleAll(whileStatement->condition.get());
+					visitStatement(whileStatement->body.get());
+					break;
+				}
+				case Statement::Kind::DoWhile:
+				{
+					const auto *doStatement = static_cast<const DoWhileStatement *>(statement);
+					visitStatement(doStatement->body.get());
+					settleAll(doStatement->condition.get());
+					break;
+				}
+				case Statement::Kind::For:
+				{
+					const auto *forStatement = static_cast<const ForStatement *>(statement);
+					locals.emplace_back();
+					visitStatement(forStatement->initializer.get());
+					settleAll(forStatement->condition.get());
+					settleAll(forStatement->increment.get());
+					visitStatement(forStatement->body.get());
+					locals.pop_back();
+					break;
+				}
+				case Statement::Kind::Return:
+					settleAll(static_cast<const ReturnStatement *>(statement)->value.get());
+					break;
+				case Statement::Kind::Break:
+				case Statement::Kind::Continue:
+				case Statement::Kind::Discard:
+					break;
+			}
+		}
+
+		// Every name the stage declares, and whether it can leave before its end, where the moved varyings are
+		// written.
+		void scanDeclarations(const Statement *statement)
+		{
+			if (!statement)
+			{
+				return;
+			}
+			switch (statement->kind)
+			{
+				case Statement::Kind::Block:
+					for (const std::unique_ptr<Statement> &nested : static_cast<const BlockStatement *>(statement)->statements)
+					{
+						scanDeclarations(nested.get());
+					}
+					break;
+				case Statement::Kind::Variable:
+					for (const VariableDeclarator &declarator :
+					    static_cast<const VariableStatement *>(statement)->declaration.declarators)
+					{
+						takenNames.insert(safeTokenContent(declarator.name));
+					}
+					break;
+				case Statement::Kind::If:
+				{
+					const auto *ifStatement = static_cast<const IfStatement *>(statement);
+					scanDeclarations(ifStatement->thenBranch.get());
+					scanDeclarations(ifStatement->elseBranch.get());
+					break;
+				}
+				case Statement::Kind::While:
+					scanDeclarations(static_cast<const WhileStatement *>(statement)->body.get());
+					break;
+				case Statement::Kind::DoWhile:
+					scanDeclarations(static_cast<const DoWhileStatement *>(statement)->body.get());
+					break;
+				case Statement::Kind::For:
+				{
+					const auto *forStatement = static_cast<const ForStatement *>(statement);
+					scanDeclarations(forStatement->initializer.get());
+					scanDeclarations(forStatement->body.get());
+					break;
+				}
+				case Statement::Kind::Return:
+					vertexReturns = true;
+					break;
+				default:
+					break;
+			}
+		}
+	};
+
+	AffineMover mover(*this);
+	int lastLocation = -1;
+	for (const std::vector<StageIO> *entries :
+	    {&input.vertexInputs, &std::as_const(stageVaryings), &input.fragmentOutputs})
+	{
+		for (const StageIO &entry : *entries)
+		{
+			mover.takenNames.insert(entry.name);
+		}
+	}
+	for (const StageIO &varying : stageVaryings)
+	{
+		lastLocation = std::max(lastLocation, varying.location);
+		if (!varying.flat && AffineMover::isVaryingType(varying.type))
+		{
+			mover.smoothVaryings.emplace(varying.name, &varying);
+		}
+	}
+	mover.nextLocation = lastLocation + 1;
+	for (const auto &[luminaName, glslName] : remappedNames)
+	{
+		mover.takenNames.insert(luminaName);
+		mover.takenNames.insert(glslName);
+	}
+	for (const std::vector<AggregateInfo> *blocks : {&constantBlocks, &attributeBlocks})
+	{
+		for (const AggregateInfo &block : *blocks)
+		{
+			mover.takenNames.insert(block.glslInstanceName);
+		}
+	}
+
+	mover.scanDeclarations(fragmentStage->body.get());
+	mover.scanDeclarations(vertexStage->body.get());
+	if (mover.vertexReturns)
+	{
+		return;
+	}
+	for (const Parameter &parameter : vertexStage->parameters)
+	{
+		mover.vertexLocals.insert(safeTokenContent(parameter.name));
+	}
+	for (const std::unique_ptr<Statement> &statement : vertexStage->body->statements)
+	{
+		if (statement && statement->kind == Statement::Kind::Variable)
+		{
+			for (const VariableDeclarator &declarator :
+			    static_cast<const VariableStatement &>(*statement).declaration.declarators)
+			{
+				mover.vertexLocals.insert(safeTokenContent(declarator.name));
+			}
+		}
+	}
+
+	mover.scope.namespaceStack = {stageNamespaces[fragmentStage]};
+	mover.locals.emplace_back();
+	for (const Parameter &parameter : fragmentStage->parameters)
+	{
+		mover.locals.back().insert(safeTokenContent(parameter.name));
+	}
+	mover.visitStatement(fragmentStage->body.get());
+	mover.commit();
+}
+
+void ConverterImpl::eliminateDeadVaryings(const std::vector<StageIO> &varyings)
+{
+	// Varyings a stage body reads. In the vertex stage, the variable an assignment statement writes is not read by
+	// it, so a varying only ever assigned there is not read.
+	struct VaryingReader
+	{
+		const ConverterImpl &converter;
+		std::unordered_set<std::string> names;
+		std::unordered_set<std::string> reads;
+		std::vector<std::unordered_set<std::string>> locals;
+		bool skipsWriteTargets = false;
+		// Fragment stage: a moved expression reads its own varying rather than what it is computed from.
+		bool readsMovedVaryings = false;
+
+		explicit VaryingReader(const ConverterImpl &converter) : converter(converter) {}
+
+		bool isLocal(const std::string &name) const
+		{
+			return std::any_of(locals.begin(), locals.end(),
+			    [&](const std::unordered_set<std::string> &scope) { return scope.count(name) != 0; });
+		}
+
+		void visitExpression(const Expression *expression)
+		{
+			if (!expression)
+			{
+				return;
+			}
+			if (const auto moved = converter.movedExpressions.find(expression);
+			    readsMovedVaryings && moved != converter.movedExpressions.end())
+			{
+				reads.insert(converter.movedVaryings[moved->second].varying.name);
+				return;
+			}
+			switch (expression->kind)
+			{
+				case Expression::Kind::Literal:
+					break;
+				case Expression::Kind::ArrayLiteral:
+					for (const std::unique_ptr<Expression> &element :
+					    static_cast<const ArrayLiteralExpression *>(expression)->elements)
+					{
+						visitExpression(element.get());
+					}
+					break;
+				case Expression::Kind::Identifier:
+				{
+					const auto &identifier = static_cast<const IdentifierExpression &>(*expression);
+					const std::string name = joinName(identifier.name);
+					if (identifier.name.parts.size() == 1 && !isLocal(name))
+					{
+						const std::string glslName = converter.remapIdentifier(name);
+						if (names.count(glslName) != 0)
+						{
+							reads.insert(glslName);
+						}
+					}
+					break;
+				}
+				case Expression::Kind::Unary:
+					visitExpression(static_cast<const UnaryExpression *>(expression)->operand.get());
+					break;
+				case Expression::Kind::Binary:
+				{
+					const auto *binary = static_cast<const BinaryExpression *>(expression);
+					visitExpression(binary->left.get());
+					visitExpression(binary->right.get());
+					break;
+				}
+				case Expression::Kind::Assignment:
+				{
+					const auto *assignment = static_cast<const AssignmentExpression *>(expression);
+					visitExpression(assignment->target.get());
+					visitExpression(assignment->value.get());
+					break;
+				}
+				case Expression::Kind::Conditional:
+				{
+					const auto *conditional = static_cast<const ConditionalExpression *>(expression);
+					visitExpression(conditional->condition.get());
+					visitExpression(conditional->thenBranch.get());
+					visitExpression(conditional->elseBranch.get());
+					break;
+				}
+				case Expression::Kind::Call:
+				{
+					const auto *call = static_cast<const CallExpression *>(expression);
+					visitExpression(call->callee.get());
+					for (const std::unique_ptr<Expression> &argument : call->arguments)
+					{
+						visitExpression(argument.get());
+					}
+					break;
+				}
+				case Expression::Kind::MemberAccess:
+					visitExpression(static_cast<const MemberExpression *>(expression)->object.get());
+					break;
+				case Expression::Kind::IndexAccess:
+				{
+					const auto *index = static_cast<const IndexExpression *>(expression);
+					visitExpression(index->object.get());
+					visitExpression(index->index.get());
+					break;
+				}
+				case Expression::Kind::Postfix:
+					visitExpression(static_cast<const PostfixExpression *>(expression)->operand.get());
+					break;
+			}
+		}
+
+		void visitStatement(const Statement *statement)
+		{
+			if (!statement)
+			{
+				return;
+			}
+			switch (statement->kind)
+			{
+				case Statement::Kind::Block:
+					locals.emplace_back();
+					for (const std::unique_ptr<Statement> &nested : static_cast<const BlockStatement *>(statement)->statements)
+					{
+						visitStatement(nested.get());
+					}
+					locals.pop_back();
+					break;
+				case Statement::Kind::Expression:
+				{
+					const Expression *expression = static_cast<const ExpressionStatement *>(statement)->expression.get();
+					const Expression *value = nullptr;
+					if (expression && skipsWriteTargets && statementWriteTarget(*expression, &value))
+					{
+						visitExpression(value);
+					}
+					else
+					{
+						visitExpression(expression);
+					}
+					break;
+				}
+				case Statement::Kind::Variable:
+					for (const VariableDeclarator &declarator :
+					    static_cast<const VariableStatement *>(statement)->declaration.declarators)
+					{
+						visitExpression(declarator.arraySize.get());
+						visitExpression(declarator.initializer.get());
+						locals.back().insert(safeTokenContent(declarator.name));
+					}
+					break;
+				case Statement::Kind::If:
+				{
+					const auto *ifStatement = static_cast<const IfStatement *>(statement);
+					visitExpression(ifStatement->condition.get());
+					visitStatement(ifStatement->thenBranch.get());
+					visitStatement(ifStatement->elseBranch.get());
+					break;
+				}
+				case Statement::Kind::While:
+				{
+					const auto *whileStatement = static_cast<const WhileStatement *>(statement);
+					visitExpression(whileStatement->condition.get());
+					visitStatement(whileStatement->body.get());
+					break;
+				}
+				case Statement::Kind::DoWhile:
+				{
+					const auto *doStatement = static_cast<const DoWhileStatement *>(statement);
+					visitStatement(doStatement->body.get());
+					visitExpression(doStatement->condition.get());
+					break;
+				}
+				case Statement::Kind::For:
+				{
+					const auto *forStatement = static_cast<const ForStatement *>(statement);
+					locals.emplace_back();
+					visitStatement(forStatement->initializer.get());
+					visitExpression(forStatement->condition.get());
+					visitExpression(forStatement->increment.get());
+					visitStatement(forStatement->body.get());
+					locals.pop_back();
+					break;
+				}
+				case Statement::Kind::Return:
+					visitExpression(static_cast<const ReturnStatement *>(statement)->value.get());
+					break;
+				case Statement::Kind::Break:
+				case Statement::Kind::Continue:
+				case Statement::Kind::Discard:
+					break;
+			}
+		}
+
+		void visitStage(const StageFunctionInstruction *stage)
+		{
+			if (!stage || !stage->body)
+			{
+				return;
+			}
+			locals.emplace_back();
+			for (const Parameter &parameter : stage->parameters)
+			{
+				locals.back().insert(safeTokenContent(parameter.name));
+			}
+			visitStatement(stage->body.get());
+			locals.pop_back();
+		}
+	};
+
+	VaryingReader fragmentReader(*this);
+	VaryingReader vertexReader(*this);
+	for (const StageIO &varying : varyings)
+	{
+		fragmentReader.names.insert(varying.name);
+		vertexReader.names.insert(varying.name);
+	}
+	fragmentReader.readsMovedVaryings = true;
+	fragmentReader.visitStage(fragmentStage);
+	vertexReader.skipsWriteTargets = true;
+	vertexReader.visitStage(vertexStage);
+	for (const Expression *moved : movedSources)
+	{
+		vertexReader.visitExpression(moved);
+	}
+	// The fragment stage has its own triangle index, right for indexed draws too.
+	if (!input.options.triangleIndexFromVertex && fragmentReader.reads.erase("triangleIndex") != 0)
+	{
+		fragmentBuiltinCopies.push_back(BuiltinCopy{"triangleIndex", "gl_PrimitiveID"});
+	}
+
+	int nextLocation = 0;
+	for (const StageIO &varying : varyings)
+	{
+		if (fragmentReader.reads.count(varying.name) != 0)
+		{
+			liveVaryings.push_back(varying);
+			liveVaryings.back().location = nextLocation;
+			nextLocation += varyingShape(typeToGLSL(varying.type)).locations;
+		}
+		else if (vertexReader.reads.count(varying.name) != 0)
+		{
+			privateVaryings.push_back(varying);
+		}
+		else
+		{
+			droppedVaryings.insert(varying.name);
+		}
+	}
+	if (droppedVaryings.count("triangleIndex") == 0)
+	{
+		vertexBuiltinCopies.push_back(BuiltinCopy{"triangleIndex", "gl_VertexID", 3});
+	}
+	if (droppedVaryings.count("instanceIndex") == 0)
+	{
+		vertexBuiltinCopies.push_back(BuiltinCopy{"instanceIndex", "gl_InstanceID"});
+	}
+}
+
+void ConverterImpl::packVaryings()
+{
+	// A location the packed varyings of one scalar kind and interpolation share, and the components they fill.
+	struct Slot
+	{
+		int location = 0;
+		char scalar = 0;
+		bool flat = false;
+		int used = 0;
+	};
+
+	// First fit, widest first, so the components vec3s and vec2s leave free are what scalars fill.
+	std::vector<StageIO *> order;
+	for (StageIO &varying : liveVaryings)
+	{
+		order.push_back(&varying);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](const StageIO *left, const StageIO *right) {
+		return varyingShape(typeToGLSL(left->type)).components > varyingShape(typeToGLSL(right->type)).components;
+	});
+
+	std::vector<Slot> slots;
+	int nextLocation = 0;
+	for (StageIO *varying : order)
+	{
+		const VaryingShape shape = varyingShape(typeToGLSL(varying->type));
+		varying->component = 0;
+		if (shape.components == 0)
+		{
+			varying->location = nextLocation;
+			nextLocation += shape.locations;
+			continue;
+		}
+		auto slot = std::find_if(slots.begin(), slots.end(), [&](const Slot &candidate) {
+			return candidate.scalar == shape.scalar && candidate.flat == varying->flat &&
+			       candidate.used + shape.components <= 4;
+		});
+		if (slot == slots.end())
+		{
+			slots.push_back(Slot{nextLocation++, shape.scalar, varying->flat, 0});
+			slot = slots.end() - 1;
+		}
+		varying->location = slot->location;
+		varying->component = slot->used;
+		slot->used += shape.components;
+	}
+	std::sort(liveVaryings.begin(), liveVaryings.end(), [](const StageIO &left, const StageIO &right) {
+		return std::tie(left.location, left.component) < std::tie(right.location, right.component);
+	});
+}
+
+std::string ConverterImpl::renderLumina(const EmissionContext &context, const Expression &expression, bool nested,
+    const std::unordered_map<const Expression *, std::string> *substitutions) const
+{
+	if (substitutions)
+	{
+		if (const auto substitution = substitutions->find(&expression); substitution != substitutions->end())
+		{
+			return substitution->second;
+		}
+	}
+	if (const auto folded = foldedExpressions.find(&expression); folded != foldedExpressions.end())
+	{
+		return folded->second.lumina;
+	}
+	const auto wrap = [&](const std::string &text) { return nested ? "(" + text + ")" : text; };
+	switch (expression.kind)
+	{
+		case Expression::Kind::Literal:
+			return static_cast<const LiteralExpression &>(expression).literal.content;
+		case Expression::Kind::Identifier:
+		{
+			const auto &identifier = static_cast<const IdentifierExpression &>(expression);
+			return resolveAggregateQualifiedName(context, identifier.name).value_or(joinName(identifier.name));
+		}
+		case Expression::Kind::Unary:
+		{
+			const auto &unary = static_cast<const UnaryExpression &>(expression);
+			return wrap(irUnarySymbol(unary.op) + renderLumina(context, *unary.operand, true, substitutions));
+		}
+		case Expression::Kind::Binary:
+		{
+			const auto &binary = static_cast<const BinaryExpression &>(expression);
+			return wrap(renderLumina(context, *binary.left, true, substitutions) + " " + irBinarySymbol(binary.op) + " " +
+			            renderLumina(context, *binary.right, true, substitutions));
+		}
+		case Expression::Kind::Conditional:
+		{
+			const auto &conditional = static_cast<const ConditionalExpression &>(expression);
+			return wrap(renderLumina(context, *conditional.condition, true, substitutions) + " ? " +
+			            renderLumina(context, *conditional.thenBranch, true, substitutions) + " : " +
+			            renderLumina(context, *conditional.elseBranch, true, substitutions));
+		}
+		case Expression::Kind::Call:
+		{
+			const auto &call = static_cast<const CallExpression &>(expression);
+			std::string text = renderLumina(context, *call.callee, true, substitutions) + "(";
+			for (std::size_t i = 0; i < call.arguments.size(); ++i)
+			{
+				text += (i > 0 ? ", " : "") + renderLumina(context, *call.arguments[i], false, substitutions);
+			}
+			return text + ")";
+		}
+		case Expression::Kind::MemberAccess:
+		{
+			const auto &member = static_cast<const MemberExpression &>(expression);
+			return renderLumina(context, *member.object, true, substitutions) + "." + safeTokenContent(member.member);
+		}
+		case Expression::Kind::IndexAccess:
+		{
+			const auto &index = static_cast<const IndexExpression &>(expression);
+			return renderLumina(context, *index.object, true, substitutions) + "[" + renderLumina(context, *index.index, false, substitutions) + "]";
+		}
+		default:
+			return {};
+	}
+}
+
+void ConverterImpl::emitCommon(EmissionContext &context, const StageUsage &usage) const
+{
+	emitStructs(context);
+	emitStructMethods(context, usage);
+	emitBlocks(context, AggregateInstruction::Kind::ConstantBlock, usage);
+	emitBlockMethods(context, constantBlocks, usage);
+	emitBlocks(context, AggregateInstruction::Kind::AttributeBlock, usage);
+	emitBlockMethods(context, attributeBlocks, usage);
+	emitGlobalVariables(context, usage);
+	emitFunctions(context, usage);
+	emitTextures(context, usage);
+}
+
+void ConverterImpl::emitStructs(EmissionContext &context) const
+{
+	for (const AggregateInfo &info : structures)
+	{
+		const auto *aggregate = info.node;
+		if (!aggregate)
+		{
+			continue;
+		}
+		context.out << "struct " << sanitizeIdentifier(info.qualifiedName) << "\n{\n";
+		context.out.indent();
+		emitBlockMembers(context, info);
+		context.out.dedent();
+		context.out << "};\n\n";
+	}
+}
+
+void ConverterImpl::emitBlocks(EmissionContext &context, AggregateInstruction::Kind kind, const StageUsage &usage) const
+{
+	const std::vector<AggregateInfo> &blocks = (kind == AggregateInstruction::Kind::ConstantBlock) ? constantBlocks :
+	                                                                                                 attributeBlocks;
+	const char *bindingKeyword = (kind == AggregateInstruction::Kind::AttributeBlock) ? "ATTRIBUTE_BINDING" :
+	                                                                       "CONSTANT_BINDING";
+
+	for (const AggregateInfo &info : blocks)
+	{
+		if (usage.blocks.find(info.qualifiedName) == usage.blocks.end())
+		{
+			continue;
+		}
+		const AggregateInstruction *aggregate = info.node;
+		if (!aggregate)
+		{
+			continue;
+		}
+		const bool ssbo = info.isSSBO;
+		const std::string &blockName = info.glslInstanceName;
+		const std::string &blockTypeName = info.glslTypeName;
+
+		context.out << "layout(binding = " << bindingKeyword << ", std430) "
+		    << (ssbo ? "buffer" : "uniform") << " " << blockTypeName << "\n{\n";
+		context.out.indent();
+		emitBlockMembers(context, info);
+		context.out.dedent();
+		context.out << "} " << blockName << ";\n\n";
+	}
+}
+
+void ConverterImpl::emitBlockMembers(EmissionContext &context, const AggregateInfo &info) const
+{
+	const bool addSize = info.kind != AggregateInstruction::Kind::Struct && info.isSSBO;
+	const std::string &blockName = info.glslInstanceName;
+
+	for (const FieldSlot &slot : orderedFields(info))
+	{
+		const VariableDeclarator &declarator = *slot.declarator;
+		if (addSize && declarator.hasArraySuffix && !declarator.hasArraySize)
+		{
+			const std::string arrayName = sanitizeIdentifier(safeTokenContent(declarator.name));
+			context.out << "uint spk_" << blockName << "_" << arrayName << "_size;\n";
+		}
+		context.out << typeToGLSL(slot.field->declaration.type) << " "
+		            << sanitizeIdentifier(safeTokenContent(declarator.name));
+		if (declarator.hasArraySuffix && declarator.arraySize)
+		{
+			context.out << "[";
+			emitExpression(context, *declarator.arraySize);
+			context.out << "]";
+		}
+		else if (declarator.hasArraySuffix)
+		{
+			context.out << "[]";
+		}
+		context.out << ";\n";
+	}
+	for (const DerivedBlockField &field : derivedFields)
+	{
+		if (field.block == info.qualifiedName)
+		{
+			context.out << typeToGLSL(field.typeName) << " " << field.name << ";\n";
+		}
+	}
+}
+
+std::vector<ConverterImpl::FieldSlot> ConverterImpl::orderedFields(const AggregateInfo &info) const
+{
+	std::vector<FieldSlot> slots;
+	if (!info.node)
+	{
+		return slots;
+	}
+
+	for (const std::unique_ptr<StructMember> &member : info.node->members)
+	{
+		if (!member || member->kind != StructMember::Kind::Field)
+		{
+			continue;
+		}
+		const auto &field = static_cast<const FieldMember &>(*member);
+		for (const VariableDeclarator &declarator : field.declaration.declarators)
+		{
+			slots.push_back(FieldSlot{&field, &declarator, slots.size()});
+		}
+	}
+
+	const auto orderIt = input.memberOrders.find(info.qualifiedName);
+	if (orderIt == input.memberOrders.end())
+	{
+		return slots;
+	}
+
+	// Fields missing from the order (the runtime-sized array, anything after it) keep their relative place at the end.
+	std::vector<FieldSlot> ordered;
+	std::vector<bool> used(slots.size(), false);
+	for (const std::string &name : orderIt->second)
+	{
+		for (std::size_t i = 0; i < slots.size(); ++i)
+		{
+			if (!used[i] && safeTokenContent(slots[i].declarator->name) == name)
+			{
+				used[i] = true;
+				ordered.push_back(slots[i]);
+				break;
+			}
+		}
+	}
+	for (std::size_t i = 0; i < slots.size(); ++i)
+	{
+		if (!used[i])
+		{
+			ordered.push_back(slots[i]);
+		}
+	}
+	return ordered;
+}
+
+std::vector<const Expression *> ConverterImpl::constructorArguments(
+    const EmissionContext &context, const IdentifierExpression &callee, const CallExpression &call) const
+{
+	std::vector<const Expression *> arguments;
+	arguments.reserve(call.arguments.size());
+	for (const std::unique_ptr<Expression> &argument : call.arguments)
+	{
+		arguments.push_back(argument.get());
+	}
+
+	// Positional struct constructors follow the declaration order, so they must follow reordered fields too.
+	const std::optional<std::string> aggregateName = resolveAggregateQualifiedName(context, callee.name);
+	if (!aggregateName || input.memberOrders.find(*aggregateName) == input.memberOrders.end())
+	{
+		return arguments;
+	}
+	const AggregateInfo *info = findAggregateInfo(*aggregateName);
+	if (!info || info->kind != AggregateInstruction::Kind::Struct)
+	{
+		return arguments;
+	}
+
+	const std::vector<FieldSlot> slots = orderedFields(*info);
+	if (slots.size() != arguments.size())
+	{
+		return arguments;
+	}
+
+	std::vector<const Expression *> permuted;
+	permuted.reserve(slots.size());
+	for (const FieldSlot &slot : slots)
+	{
+		permuted.push_back(arguments[slot.declarationIndex]);
+	}
+	return permuted;
+}
+
+void ConverterImpl::emitStructMethods(EmissionContext &context, const StageUsage &usage) const
+{
+	bool emitted = false;
+	for (const AggregateInfo &info : structures)
+	{
+		for (const MethodHelper &helper : info.methods)
+		{
+			if (usage.methodHelpers.find(helper.helperName) == usage.methodHelpers.end())
+			{
+				continue;
+			}
+			emitMethodHelper(context, info, helper);
+			emitted = true;
+		}
+	}
+	if (emitted)
+	{
+		context.out << "\n";
+	}
+}
+
+void ConverterImpl::emitBlockMethods(
+    EmissionContext &context, const std::vector<AggregateInfo> &aggregates, const StageUsage &usage) const
+{
+	bool emitted = false;
+	for (const AggregateInfo &info : aggregates)
+	{
+		for (const MethodHelper &helper : info.methods)
+		{
+			if (usage.methodHelpers.find(helper.helperName) == usage.methodHelpers.end())
+			{
+				continue;
+			}
+			emitMethodHelper(context, info, helper);
+			emitted = true;
+		}
+	}
+	if (emitted)
+	{
+		context.out << "\n";
+	}
+}
+
+void ConverterImpl::emitGlobalVariables(EmissionContext &context, const StageUsage &usage) const
+{
+	for (const VariableInstruction *variable : globalVariables)
+	{
+		if (!variable)
+		{
+			continue;
+		}
+		if (usage.globals.find(variable) == usage.globals.end())
+		{
+			continue;
+		}
+		const std::string type = joinName(variable->declaration.type.name);
+		if (type == "Texture")
+		{
+			continue;
+		}
+		for (const VariableDeclarator &declarator : variable->declaration.declarators)
+		{
+			const std::string name = remapIdentifier(qualify(declarator.name));
+			context.out << (variable->declaration.type.isConst ? "const " : "");
+			context.out << typeToGLSL(variable->declaration.type) << " " << name;
+			if (declarator.initializer)
+			{
+				context.out << " = ";
+				emitExpression(context, *declarator.initializer);
+			}
+			context.out << ";\n";
+		}
+	}
+	if (!globalVariables.empty() && !usage.globals.empty())
+	{
+		context.out << "\n";
+	}
+}
+
+void ConverterImpl::emitTextures(EmissionContext &context, const StageUsage &usage) const
+{
+	if (input.textures.empty())
+	{
+		return;
+	}
+
+	std::vector<TextureBinding> bindings = input.textures;
+	std::sort(bindings.begin(), bindings.end(), [](const TextureBinding &a, const TextureBinding &b) {
+		return a.location < b.location;
+	});
+
+	for (const TextureBinding &binding : bindings)
+	{
+		if (usage.textures.find(binding.luminaName) == usage.textures.end())
+		{
+			continue;
+		}
+		context.out << "layout(binding = " << binding.location << ") uniform " << binding.type << " " << binding.glslName
+		    << ";\n";
+	}
+	if (!usage.textures.empty())
+	{
+		context.out << "\n";
+	}
+}
+
+void ConverterImpl::emitFunctions(EmissionContext &context, const StageUsage &usage) const
+{
+	bool emitted = false;
+	for (const FunctionInstruction *function : functions)
+	{
+		if (!function || !function->body)
+		{
+			continue;
+		}
+		if (usage.functions.find(function) == usage.functions.end())
+		{
+			continue;
+		}
+		const auto it = functionNames.find(function);
+		if (it == functionNames.end())
+		{
+			continue;
+		}
+		emitFunction(context, *function, it->second);
+		emitted = true;
+	}
+	if (emitted)
+	{
+		context.out << "\n";
+	}
+}
+
+void ConverterImpl::emitFunction(
+    EmissionContext &context, const FunctionInstruction &function, const std::string &name) const
+{
+	if (const auto irIt = context.irFunctions.find(&function); irIt != context.irFunctions.end())
+	{
+		emitIrFunction(*irIt->second, context.out);
+		context.out << "\n";
+		return;
+	}
+	context.out << typeToGLSL(function.returnType) << " " << name << "(";
+	emitParameters(context, function.parameters);
+	context.out << ")\n";
+	if (function.body)
+	{
+		auto nsIt = functionNamespaces.find(&function);
+		if (nsIt != functionNamespaces.end())
+		{
+			context.pushNamespace(nsIt->second);
+		}
+		context.out << "{\n";
+		context.out.indent();
+		emitBlockStatement(context, *function.body);
+		context.out.dedent();
+		context.out << "}\n";
+		if (nsIt != functionNamespaces.end())
+		{
+			context.popNamespace();
+		}
+	}
+	else
 	{
-		return;
+		context.out << "{ }\n";
 	}
+	context.out << "\n";
+}
 
-	std::vector<TextureBinding> bindings = input.textures;
-	std::sort(bindings.begin(), bindings.end(), [](const TextureBinding &a, const TextureBinding &b) {
-		return a.location < b.location;
-	});
+void ConverterImpl::emitParameters(EmissionContext &context, const std::vector<Parameter> &params) const
+{
+	for (std::size_t i = 0; i < params.size(); ++i)
+	{
+		if (i > 0)
+		{
+			context.out << ", ";
+		}
+		const Parameter &param = params[i];
+		if (param.isReference)
+		{
+			context.out << "inout ";
+		}
+		else if (param.type.isConst)
+		{
+			context.out << "const ";
+		}
+		context.out << typeToGLSL(param.type) << " " << parameterName(param.name);
+	}
+}
 
-	for (const TextureBinding &binding : bindings)
+std::string ConverterImpl::parameterName(const Token &token) const
+{
+	return sanitizeIdentifier(safeTokenContent(token));
+}
+
+bool ConverterImpl::EmissionContext::isMethodLocalName(const std::string &name) const
+{
+	for (auto it = methodLocalNameStack.rbegin(); it != methodLocalNameStack.rend(); ++it)
 	{
-		if (usage.textures.find(binding.luminaName) == usage.textures.end())
+		if (it->find(name) != it->end())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+const ConverterImpl::AggregateInfo *ConverterImpl::findAggregateInfo(const std::string &qualifiedName) const
+{
+	const auto finder = [&qualifiedName](const std::vector<AggregateInfo> &collection) -> const AggregateInfo * {
+		for (const AggregateInfo &info : collection)
+		{
+			if (info.qualifiedName == qualifiedName)
+			{
+				return &info;
+			}
+		}
+		return nullptr;
+	};
+
+	if (const AggregateInfo *info = finder(structures))
+	{
+		return info;
+	}
+	if (const AggregateInfo *info = finder(attributeBlocks))
+	{
+		return info;
+	}
+	if (const AggregateInfo *info = finder(constantBlocks))
+	{
+		return info;
+	}
+	return nullptr;
+}
+
+const ConverterImpl::MethodHelper *ConverterImpl::findMethodHelper(
+    const std::string &helperName, const AggregateInfo **aggregate) const
+{
+	const auto finder = [&helperName, aggregate](const std::vector<AggregateInfo> &collection) -> const MethodHelper * {
+		for (const AggregateInfo &info : collection)
+		{
+			for (const MethodHelper &helper : info.methods)
+			{
+				if (helper.helperName == helperName)
+				{
+					if (aggregate)
+					{
+						*aggregate = &info;
+					}
+					return &helper;
+				}
+			}
+		}
+		return nullptr;
+	};
+
+	if (const MethodHelper *helper = finder(structures))
+	{
+		return helper;
+	}
+	if (const MethodHelper *helper = finder(attributeBlocks))
+	{
+		return helper;
+	}
+	if (const MethodHelper *helper = finder(constantBlocks))
+	{
+		return helper;
+	}
+	if (aggregate)
+	{
+		*aggregate = nullptr;
+	}
+	return nullptr;
+}
+
+void ConverterImpl::EmissionContext::pushNamespace(const std::vector<std::string> &ns)
+{
+	namespaceStack.push_back(ns);
+}
+
+void ConverterImpl::EmissionContext::popNamespace()
+{
+	if (!namespaceStack.empty())
+	{
+		namespaceStack.pop_back();
+	}
+}
+
+const std::vector<std::string> &ConverterImpl::EmissionContext::currentNamespace() const
+{
+	static const std::vector<std::string> kEmptyNamespace;
+	if (namespaceStack.empty())
+	{
+		return kEmptyNamespace;
+	}
+	return namespaceStack.back();
+}
+
+struct ConverterImpl::MethodAnalysisContext
+{
+	MethodAnalysisContext()
+	{
+		scopes.emplace_back();
+	}
+
+	void pushScope()
+	{
+		scopes.emplace_back();
+	}
+
+	void popScope()
+	{
+		if (!scopes.empty())
+		{
+			scopes.pop_back();
+		}
+	}
+
+	void addName(const std::string &rawName)
+	{
+		if (scopes.empty())
+		{
+			scopes.emplace_back();
+		}
+		scopes.back().insert(sanitizeIdentifier(rawName));
+	}
+
+	bool isShadowed(const std::string &rawName) const
+	{
+		const std::string sanitized = sanitizeIdentifier(rawName);
+		for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+		{
+			if (it->find(sanitized) != it->end())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::vector<std::unordered_set<std::string>> scopes;
+};
+
+bool ConverterImpl::methodMutatesAggregate(const MethodMember &method, const AggregateInfo &info) const
+{
+	if (!method.body)
+	{
+		return false;
+	}
+
+	MethodAnalysisContext ctx;
+	for (const Parameter &param : method.parameters)
+	{
+		ctx.addName(safeTokenContent(param.name));
+	}
+	return statementMutatesAggregate(*method.body, ctx, info);
+}
+
+bool ConverterImpl::statementMutatesAggregate(
+    const Statement &statement, MethodAnalysisContext &ctx, const AggregateInfo &info) const
+{
+	switch (statement.kind)
+	{
+		case Statement::Kind::Block:
+		{
+			const auto &block = static_cast<const BlockStatement &>(statement);
+			ctx.pushScope();
+			for (const std::unique_ptr<Statement> &stmt : block.statements)
+			{
+				if (stmt && statementMutatesAggregate(*stmt, ctx, info))
+				{
+					ctx.popScope();
+					return true;
+				}
+			}
+			ctx.popScope();
+			return false;
+		}
+		case Statement::Kind::Expression:
+		{
+			const auto &expr = static_cast<const ExpressionStatement &>(statement);
+			return expr.expression && expressionMutatesAggregate(*expr.expression, ctx, info);
+		}
+		case Statement::Kind::Variable:
+		{
+			const auto &var = static_cast<const VariableStatement &>(statement);
+			for (const VariableDeclarator &decl : var.declaration.declarators)
+			{
+				if (decl.initializer && expressionMutatesAggregate(*decl.initializer, ctx, info))
+				{
+					return true;
+				}
+				ctx.addName(safeTokenContent(decl.name));
+			}
+			return false;
+		}
+		case Statement::Kind::If:
+		{
+			const auto &ifStmt = static_cast<const IfStatement &>(statement);
+			if (ifStmt.condition && expressionMutatesAggregate(*ifStmt.condition, ctx, info))
+			{
+				return true;
+			}
+			if (ifStmt.thenBranch && statementMutatesAggregate(*ifStmt.thenBranch, ctx, info))
+			{
+				return true;
+			}
+			if (ifStmt.elseBranch && statementMutatesAggregate(*ifStmt.elseBranch, ctx, info))
+			{
+				return true;
+			}
+			return false;
+		}
+		case Statement::Kind::While:
+		{
+			const auto &whileStmt = static_cast<const WhileStatement &>(statement);
+			if (whileStmt.condition && expressionMutatesAggregate(*whileStmt.condition, ctx, info))
+			{
+				return true;
+			}
+			return whileStmt.body && statementMutatesAggregate(*whileStmt.body, ctx, info);
+		}
+		case Statement::Kind::DoWhile:
+		{
+			const auto &doStmt = static_cast<const DoWhileStatement &>(statement);
+			if (doStmt.body && statementMutatesAggregate(*doStmt.body, ctx, info))
+			{
+				return true;
+			}
+			return doStmt.condition && expressionMutatesAggregate(*doStmt.condition, ctx, info);
+		}
+		case Statement::Kind::For:
 		{
-			continue;
+			const auto &forStmt = static_cast<const ForStatement &>(statement);
+			ctx.pushScope();
+			if (forStmt.initializer && statementMutatesAggregate(*forStmt.initializer, ctx, info))
+			{
+				ctx.popScope();
+				return true;
+			}
+			if (forStmt.condition && expressionMutatesAggregate(*forStmt.condition, ctx, info))
+			{
+				ctx.popScope();
+				return true;
+			}
+			if (forStmt.increment && expressionMutatesAggregate(*forStmt.increment, ctx, info))
+			{
+				ctx.popScope();
+				return true;
+			}
+			const bool bodyResult = forStmt.body && statementMutatesAggregate(*forStmt.body, ctx, info);
+			ctx.popScope();
+			return bodyResult;
 		}
-		oss << "layout(binding = " << binding.location << ") uniform " << binding.type << " " << binding.glslName
-		    << ";\n";
-	}
-	if (!usage.textures.empty())
-	{
-		oss << "\n";
+		case Statement::Kind::Return:
+		{
+			const auto &ret = static_cast<const ReturnStatement &>(statement);
+			return ret.value && expressionMutatesAggregate(*ret.value, ctx, info);
+		}
+		case Statement::Kind::Break:
+		case Statement::Kind::Continue:
+		case Statement::Kind::Discard:
+			return false;
 	}
+	return false;
 }
 
-void ConverterImpl::emitFunctions(std::ostringstream &oss, const StageUsage &usage) const
+bool ConverterImpl::expressionMutatesAggregate(
+    const Expression &expression, MethodAnalysisContext &ctx, const AggregateInfo &info) const
 {
-	bool emitted = false;
-	for (const FunctionInstruction *function : functions)
+	switch (expression.kind)
 	{
-		if (!function || !function->body)
+		case Expression::Kind::Literal:
+			return false;
+		case Expression::Kind::ArrayLiteral:
 		{
-			continue;
+			const auto &literal = static_cast<const ArrayLiteralExpression &>(expression);
+			for (const std::unique_ptr<Expression> &element : literal.elements)
+			{
+				if (element && expressionMutatesAggregate(*element, ctx, info))
+				{
+					return true;
+				}
+			}
+			return false;
 		}
-		if (usage.functions.find(function) == usage.functions.end())
+		case Expression::Kind::Identifier:
+			return false;
+		case Expression::Kind::Unary:
 		{
-			continue;
+			const auto &unary = static_cast<const UnaryExpression &>(expression);
+			if (unary.op == UnaryOperator::PreIncrement || unary.op == UnaryOperator::PreDecrement)
+			{
+				if (unary.operand && expressionRefersToField(*unary.operand, ctx, info))
+				{
+					return true;
+				}
+			}
+			return unary.operand && expressionMutatesAggregate(*unary.operand, ctx, info);
 		}
-		const auto it = functionNames.find(function);
-		if (it == functionNames.end())
+		case Expression::Kind::Binary:
 		{
-			continue;
+			const auto &binary = static_cast<const BinaryExpression &>(expression);
+			return (binary.left && expressionMutatesAggregate(*binary.left, ctx, info)) ||
+			       (binary.right && expressionMutatesAggregate(*binary.right, ctx, info));
 		}
-		emitFunction(oss, *function, it->second);
-		emitted = true;
-	}
-	if (emitted)
-	{
-		oss << "\n";
-	}
-}
-
-void ConverterImpl::emitFunction(std::ostringstream &oss, const FunctionInstruction &function, const std::string &name) const
-{
-	oss << typeToGLSL(function.returnType) << " " << name << "(";
-	emitParameters(oss, function.parameters);
-	oss << ")\n";
-	if (function.body)
-	{
-		auto nsIt = functionNamespaces.find(&function);
-		if (nsIt != functionNamespaces.end())
+		case Expression::Kind::Assignment:
 		{
-			pushEmissionNamespace(nsIt->second);
+			const auto &assign = static_cast<const AssignmentExpression &>(expression);
+			if (assign.target && expressionRefersToField(*assign.target, ctx, info))
+			{
+				return true;
+			}
+			return assign.value && expressionMutatesAggregate(*assign.value, ctx, info);
 		}
-		oss << "{\n";
-		emitBlockStatement(oss, *function.body, 1);
-		oss << "}\n";
-		if (nsIt != functionNamespaces.end())
+		case Expression::Kind::Conditional:
 		{
-			popEmissionNamespace();
+			const auto &conditional = static_cast<const ConditionalExpression &>(expression);
+			return (conditional.condition && expressionMutatesAggregate(*conditional.condition, ctx, info)) ||
+			       (conditional.thenBranch && expressionMutatesAggregate(*conditional.thenBranch, ctx, info)) ||
+			       (conditional.elseBranch && expressionMutatesAggregate(*conditional.elseBranch, ctx, info));
 		}
-	}
-	else
-	{
-		oss << "{ }\n";
-	}
-	oss << "\n";
-}
-
-void ConverterImpl::emitParameters(std::ostringstream &oss, const std::vector<Parameter> &params) const
-{
-	for (std::size_t i = 0; i < params.size(); ++i)
-	{
-		if (i > 0)
+		case Expression::Kind::Call:
 		{
-			oss << ", ";
+			const auto &call = static_cast<const CallExpression &>(expression);
+			if (call.callee && expressionMutatesAggregate(*call.callee, ctx, info))
+			{
+				return true;
+			}
+			for (const std::unique_ptr<Expression> &arg : call.arguments)
+			{
+				if (arg && expressionMutatesAggregate(*arg, ctx, info))
+				{
+					return true;
+				}
+			}
+			return false;
 		}
-		const Parameter &param = params[i];
-		if (param.isReference)
+		case Expression::Kind::MemberAccess:
 		{
-			oss << "inout ";
+			const auto &member = static_cast<const MemberExpression &>(expression);
+			return member.object && expressionMutatesAggregate(*member.object, ctx, info);
 		}
-		else if (param.type.isConst)
+		case Expression::Kind::IndexAccess:
 		{
-			oss << "const ";
+			const auto &index = static_cast<const IndexExpression &>(expression);
+			return (index.object && expressionMutatesAggregate(*index.object, ctx, info)) ||
+			       (index.index && expressionMutatesAggregate(*index.index, ctx, info));
 		}
-		oss << typeToGLSL(param.type) << " " << parameterName(param.name);
-	}
-}
-
-std::string ConverterImpl::parameterName(const Token &token) const
-{
-	return sanitizeIdentifier(safeTokenContent(token));
-}
-
-bool ConverterImpl::isMethodLocalName(const std::string &name) const
-{
-	for (auto it = methodLocalNameStack.rbegin(); it != methodLocalNameStack.rend(); ++it)
-	{
-		if (it->find(name) != it->end())
+		case Expression::Kind::Postfix:
 		{
-			return true;
+			const auto &postfix = static_cast<const PostfixExpression &>(expression);
+			if (postfix.operand && expressionRefersToField(*postfix.operand, ctx, info))
+			{
+				return true;
+			}
+			return postfix.operand && expressionMutatesAggregate(*postfix.operand, ctx, info);
 		}
 	}
 	return false;
 }
 
-const ConverterImpl::AggregateInfo *ConverterImpl::findAggregateInfo(const std::string &qualifiedName) const
+bool ConverterImpl::expressionRefersToField(
+    const Expression &expression, MethodAnalysisContext &ctx, const AggregateInfo &info) const
 {
-	const auto finder = [&qualifiedName](const std::vector<AggregateInfo> &collection) -> const AggregateInfo * {
-		for (const AggregateInfo &info : collection)
+	switch (expression.kind)
+	{
+		case Expression::Kind::Identifier:
 		{
-			if (info.qualifiedName == qualifiedName)
+			const auto &identifier = static_cast<const IdentifierExpression &>(expression);
+			if (identifier.name.parts.size() != 1)
 			{
-				return &info;
+				return false;
+			}
+			const std::string simple = safeTokenContent(identifier.name.parts.front());
+			if (ctx.isShadowed(simple))
+			{
+				return false;
 			}
+			return info.fieldNames.find(sanitizeIdentifier(simple)) != info.fieldNames.end();
 		}
-		return nullptr;
-	};
-
-	if (const AggregateInfo *info = finder(structures))
-	{
-		return info;
-	}
-	if (const AggregateInfo *info = finder(attributeBlocks))
-	{
-		return info;
-	}
-	if (const AggregateInfo *info = finder(constantBlocks))
-	{
-		return info;
-	}
-	return nullptr;
-}
-
-const ConverterImpl::MethodHelper *ConverterImpl::findMethodHelper(
-    const std::string &helperName, const AggregateInfo **aggregate) const
-{
-	const auto finder = [&helperName, aggregate](const std::vector<AggregateInfo> &collection) -> const MethodHelper * {
-		for (const AggregateInfo &info : collection)
+		case Expression::Kind::MemberAccess:
 		{
-			for (const MethodHelper &helper : info.methods)
+			const auto &member = static_cast<const MemberExpression &>(expression);
+			if (!member.object)
 			{
-				if (helper.helperName == helperName)
-				{
-					if (aggregate)
-					{
-						*aggregate = &info;
-					}
-					return &helper;
-				}
+				return false;
+			}
+			const auto *objectIdentifier = dynamic_cast<const IdentifierExpression *>(member.object.get());
+			if (!objectIdentifier || objectIdentifier->name.parts.size() != 1)
+			{
+				return false;
+			}
+			const std::string objectName = safeTokenContent(objectIdentifier->name.parts.front());
+			if (objectName != "this")
+			{
+				return false;
 			}
+			return info.fieldNames.find(sanitizeIdentifier(safeTokenContent(member.member))) != info.fieldNames.end();
 		}
-		return nullptr;
-	};
-
-	if (const MethodHelper *helper = finder(structures))
-	{
-		return helper;
-	}
-	if (const MethodHelper *helper = finder(attributeBlocks))
-	{
-		return helper;
-	}
-	if (const MethodHelper *helper = finder(constantBlocks))
-	{
-		return helper;
-	}
-	if (aggregate)
-	{
-		*aggregate = nullptr;
+		default:
+			return false;
 	}
-	return nullptr;
-}
-
-void ConverterImpl::pushEmissionNamespace(const std::vector<std::string> &ns) const
-{
-	emissionNamespaceStack.push_back(ns);
 }
 
-void ConverterImpl::popEmissionNamespace() const
+void ConverterImpl::emitInterface(
+    EmissionContext &context, const std::vector<StageIO> &entries, const char *qualifier) const
 {
-	if (!emissionNamespaceStack.empty())
+	for (const StageIO &entry : entries)
+	{
+		context.out << "layout(location = " << entry.location;
+		if (entry.component != 0)
+		{
+			context.out << ", component = " << entry.component;
+		}
+		context.out << ") ";
+		if (entry.flat)
+		{
+			context.out << "flat ";
+		}
+		context.out << qualifier << " " << typeToGLSL(entry.type) << " " << entry.name << ";\n";
+	}
+	if (!entries.empty())
 	{
-		emissionNamespaceStack.pop_back();
+		context.out << "\n";
 	}
 }
 
-const std::vector<std::string> &ConverterImpl::currentEmissionNamespace() const
+void ConverterImpl::emitStage(EmissionContext &context, const StageFunctionInstruction *stage, Stage stageKind) const
 {
-	static const std::vector<std::string> kEmptyNamespace;
-	if (emissionNamespaceStack.empty())
+	if (!stage || !stage->body)
 	{
-		return kEmptyNamespace;
+		context.out << "void main()\n{\n}\n";
+		return;
 	}
-	return emissionNamespaceStack.back();
-}
-
-struct ConverterImpl::MethodAnalysisContext
-{
-	MethodAnalysisContext()
+	if (context.irStage)
 	{
-		scopes.emplace_back();
+		emitIrFunction(*context.irStage, context.out);
+		return;
 	}
 
-	void pushScope()
+	const auto nsIt = stageNamespaces.find(stage);
+	if (nsIt != stageNamespaces.end())
 	{
-		scopes.emplace_back();
+		context.pushNamespace(nsIt->second);
 	}
 
-	void popScope()
+	context.out << "void main()\n{\n";
+	context.out.indent();
+	for (const BuiltinCopy &copy : stageKind == Stage::VertexPass ? vertexBuiltinCopies : fragmentBuiltinCopies)
 	{
-		if (!scopes.empty())
+		context.out << copy.name << " = uint(" << copy.source;
+		if (copy.divisor != 1)
 		{
-			scopes.pop_back();
+			context.out << " / " << copy.divisor;
 		}
+		context.out << ");\n";
 	}
-
-	void addName(const std::string &rawName)
+	context.dropsDeadVaryingWrites = stageKind == Stage::VertexPass;
+	emitBlockStatement(context, *stage->body);
+	context.dropsDeadVaryingWrites = false;
+	if (stageKind == Stage::VertexPass)
 	{
-		if (scopes.empty())
+		for (std::size_t i = 0; i < movedVaryings.size(); ++i)
 		{
-			scopes.emplace_back();
+			context.out << movedVaryings[i].varying.name << " = ";
+			emitExpression(context, *movedSources[i]);
+			context.out << ";\n";
 		}
-		scopes.back().insert(sanitizeIdentifier(rawName));
 	}
+	context.out.dedent();
+	context.out << "}\n";
 
-	bool isShadowed(const std::string &rawName) const
+	if (nsIt != stageNamespaces.end())
 	{
-		const std::string sanitized = sanitizeIdentifier(rawName);
-		for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
-		{
-			if (it->find(sanitized) != it->end())
-			{
-				return true;
-			}
-		}
-		return false;
+		context.popNamespace();
 	}
+}
 
-	std::vector<std::unordered_set<std::string>> scopes;
-};
-
-bool ConverterImpl::methodMutatesAggregate(const MethodMember &method, const AggregateInfo &info) const
+void ConverterImpl::emitBlockStatement(EmissionContext &context, const BlockStatement &block) const
 {
-	if (!method.body)
+	if (context.currentMethodAggregate)
 	{
-		return false;
+		context.methodLocalNameStack.emplace_back();
 	}
-
-	MethodAnalysisContext ctx;
-	for (const Parameter &param : method.parameters)
+	for (const std::unique_ptr<Statement> &statement : block.statements)
 	{
-		ctx.addName(safeTokenContent(param.name));
+		if (statement)
+		{
+			emitStatement(context, *statement);
+		}
+	}
+	if (context.currentMethodAggregate)
+	{
+		context.methodLocalNameStack.pop_back();
 	}
-	return statementMutatesAggregate(*method.body, ctx, info);
 }
 
-bool ConverterImpl::statementMutatesAggregate(
-    const Statement &statement, MethodAnalysisContext &ctx, const AggregateInfo &info) const
+void ConverterImpl::emitStatement(EmissionContext &context, const Statement &statement) const
 {
 	switch (statement.kind)
 	{
 		case Statement::Kind::Block:
 		{
-			const auto &block = static_cast<const BlockStatement &>(statement);
-			ctx.pushScope();
-			for (const std::unique_ptr<Statement> &stmt : block.statements)
-			{
-				if (stmt && statementMutatesAggregate(*stmt, ctx, info))
-				{
-					ctx.popScope();
-					return true;
-				}
-			}
-			ctx.popScope();
-			return false;
+			context.out << "{\n";
+			context.out.indent();
+			emitBlockStatement(context, static_cast<const BlockStatement &>(statement));
+			context.out.dedent();
+			context.out << "}\n";
+			break;
 		}
 		case Statement::Kind::Expression:
 		{
 			const auto &expr = static_cast<const ExpressionStatement &>(statement);
-			return expr.expression && expressionMutatesAggregate(*expr.expression, ctx, info);
-		}
-		case Statement::Kind::Variable:
-		{
-			const auto &var = static_cast<const VariableStatement &>(statement);
-			for (const VariableDeclarator &decl : var.declaration.declarators)
+			if (!expr.expression)
 			{
-				if (decl.initializer && expressionMutatesAggregate(*decl.initializer, ctx, info))
+				break;
+			}
+			const Expression *value = nullptr;
+			const IdentifierExpression *target = context.dropsDeadVaryingWrites
+			                                         ? statementWriteTarget(*expr.expression, &value)
+			                                         : nullptr;
+			if (target && droppedVaryings.count(joinName(target->name)) != 0)
+			{
+				if (value && !isPureExpression(context, *value))
 				{
-					return true;
+					emitExpression(context, *value);
+					context.out << ";\n";
 				}
-				ctx.addName(safeTokenContent(decl.name));
+				break;
 			}
-			return false;
+			emitExpression(context, *expr.expression);
+			context.out << ";\n";
+			break;
 		}
+		case Statement::Kind::Variable:
+			emitVariableStatement(context, static_cast<const VariableStatement &>(statement));
+			break;
 		case Statement::Kind::If:
+			emitIfStatement(context, static_cast<const IfStatement &>(statement));
+			break;
+		case Statement::Kind::While:
+			emitWhileStatement(context, static_cast<const WhileStatement &>(statement));
+			break;
+		case Statement::Kind::DoWhile:
+			emitDoWhileStatement(context, static_cast<const DoWhileStatement &>(statement));
+			break;
+		case Statement::Kind::For:
+			emitForStatement(context, static_cast<const ForStatement &>(statement));
+			break;
+		case Statement::Kind::Return:
+			emitReturnStatement(context, static_cast<const ReturnStatement &>(statement));
+			break;
+		case Statement::Kind::Break:
+			context.out << "break;\n";
+			break;
+		case Statement::Kind::Continue:
+			context.out << "continue;\n";
+			break;
+		case Statement::Kind::Discard:
+			context.out << "discard;\n";
+			break;
+		default:
+			break;
+	}
+}
+
+void ConverterImpl::emitVariableStatement(EmissionContext &context, const VariableStatement &statement) const
+{
+	const std::string type = typeToGLSL(statement.declaration.type);
+	for (const VariableDeclarator &declarator : statement.declaration.declarators)
+	{
+		const std::string originalName = safeTokenContent(declarator.name);
+		const std::string varName = sanitizeIdentifier(originalName);
+		context.out << type << " " << varName;
+		if (declarator.hasArraySuffix && declarator.arraySize)
 		{
-			const auto &ifStmt = static_cast<const IfStatement &>(statement);
-			if (ifStmt.condition && expressionMutatesAggregate(*ifStmt.condition, ctx, info))
-			{
-				return true;
-			}
-			if (ifStmt.thenBranch && statementMutatesAggregate(*ifStmt.thenBranch, ctx, info))
-			{
-				return true;
-			}
-			if (ifStmt.elseBranch && statementMutatesAggregate(*ifStmt.elseBranch, ctx, info))
-			{
-				return true;
-			}
-			return false;
+			context.out << "[";
+			emitExpression(context, *declarator.arraySize);
+			context.out << "]";
 		}
-		case Statement::Kind::While:
+		else if (declarator.hasArraySuffix)
 		{
-			const auto &whileStmt = static_cast<const WhileStatement &>(statement);
-			if (whileStmt.condition && expressionMutatesAggregate(*whileStmt.condition, ctx, info))
-			{
-				return true;
-			}
-			return whileStmt.body && statementMutatesAggregate(*whileStmt.body, ctx, info);
+			context.out << "[]";
 		}
-		case Statement::Kind::DoWhile:
+		if (declarator.initializer)
 		{
-			const auto &doStmt = static_cast<const DoWhileStatement &>(statement);
-			if (doStmt.body && statementMutatesAggregate(*doStmt.body, ctx, info))
-			{
-				return true;
-			}
-			return doStmt.condition && expressionMutatesAggregate(*doStmt.condition, ctx, info);
+			context.out << " = ";
+			emitExpression(context, *declarator.initializer);
 		}
-		case Statement::Kind::For:
+		context.out << ";\n";
+
+		if (context.currentMethodAggregate && !context.methodLocalNameStack.empty())
 		{
-			const auto &forStmt = static_cast<const ForStatement &>(statement);
-			ctx.pushScope();
-			if (forStmt.initializer && statementMutatesAggregate(*forStmt.initializer, ctx, info))
-			{
-				ctx.popScope();
-				return true;
-			}
-			if (forStmt.condition && expressionMutatesAggregate(*forStmt.condition, ctx, info))
+			context.methodLocalNameStack.back().insert(originalName);
+		}
+	}
+}
+
+void ConverterImpl::emitIfStatement(EmissionContext &context, const IfStatement &statement) const
+{
+	context.out << "if (";
+	emitExpression(context, *statement.condition);
+	context.out << ")\n";
+	context.out.indent();
+	emitStatement(context, *statement.thenBranch);
+	context.out.dedent();
+	if (statement.elseBranch)
+	{
+		context.out << "else\n";
+		context.out.indent();
+		emitStatement(context, *statement.elseBranch);
+		context.out.dedent();
+	}
+}
+
+void ConverterImpl::emitWhileStatement(EmissionContext &context, const WhileStatement &statement) const
+{
+	context.out << "while (";
+	emitExpression(context, *statement.condition);
+	context.out << ")\n";
+	context.out.indent();
+	emitStatement(context, *statement.body);
+	context.out.dedent();
+}
+
+void ConverterImpl::emitDoWhileStatement(EmissionContext &context, const DoWhileStatement &statement) const
+{
+	context.out << "do\n";
+	context.out.indent();
+	emitStatement(context, *statement.body);
+	context.out.dedent();
+	context.out << "while (";
+	emitExpression(context, *statement.condition);
+	context.out << ");\n";
+}
+
+void ConverterImpl::emitForStatement(EmissionContext &context, const ForStatement &statement) const
+{
+	context.out << "for (";
+	if (statement.initializer)
+	{
+		if (statement.initializer->kind == Statement::Kind::Variable)
+		{
+			const auto &var = static_cast<const VariableStatement &>(*statement.initializer);
+			if (!var.declaration.declarators.empty())
 			{
-				ctx.popScope();
-				return true;
+				const VariableDeclarator &decl = var.declaration.declarators.front();
+				context.out << typeToGLSL(var.declaration.type) << " " << safeTokenContent(decl.name);
+				if (decl.initializer)
+				{
+					context.out << " = ";
+					emitExpression(context, *decl.initializer);
+				}
 			}
-			if (forStmt.increment && expressionMutatesAggregate(*forStmt.increment, ctx, info))
+		}
+		else if (statement.initializer->kind == Statement::Kind::Expression)
+		{
+			const auto &expr = static_cast<const ExpressionStatement &>(*statement.initializer);
+			if (expr.expression)
 			{
-				ctx.popScope();
-				return true;
+				emitExpression(context, *expr.expression);
 			}
-			const bool bodyResult = forStmt.body && statementMutatesAggregate(*forStmt.body, ctx, info);
-			ctx.popScope();
-			return bodyResult;
 		}
-		case Statement::Kind::Return:
+	}
+	context.out << "; ";
+	if (statement.condition)
+	{
+		emitExpression(context, *statement.condition);
+	}
+	context.out << "; ";
+	if (statement.increment)
+	{
+		emitExpression(context, *statement.increment);
+	}
+	context.out << ")\n";
+	context.out.indent();
+	emitStatement(context, *statement.body);
+	context.out.dedent();
+}
+
+void ConverterImpl::emitReturnStatement(EmissionContext &context, const ReturnStatement &statement) const
+{
+	context.out << "return";
+	if (statement.value)
+	{
+		context.out << " ";
+		emitExpression(context, *statement.value);
+	}
+	context.out << ";\n";
+}
+
+void ConverterImpl::emitExpression(EmissionContext &context, const Expression &expression) const
+{
+	if (const auto folded = foldedExpressions.find(&expression); folded != foldedExpressions.end())
+	{
+		context.out << folded->second.glsl;
+		return;
+	}
+	if (const auto hoisted = hoistedExpressions.find(&expression); hoisted != hoistedExpressions.end())
+	{
+		const DerivedBlockField &field = derivedFields[hoisted->second];
+		context.out << findAggregateInfo(field.block)->glslInstanceName << "." << field.name;
+		return;
+	}
+	if (const auto moved = movedExpressions.find(&expression);
+	    context.readsMovedVaryings && moved != movedExpressions.end())
+	{
+		context.out << movedVaryings[moved->second].varying.name;
+		return;
+	}
+	switch (expression.kind)
+	{
+		case Expression::Kind::Literal:
+			emitLiteral(context, static_cast<const LiteralExpression &>(expression));
+			break;
+		case Expression::Kind::ArrayLiteral:
+			emitArrayLiteral(context, static_cast<const ArrayLiteralExpression &>(expression));
+			break;
+		case Expression::Kind::Identifier:
+			emitIdentifier(context, static_cast<const IdentifierExpression &>(expression));
+			break;
+		case Expression::Kind::Unary:
+			emitUnary(context, static_cast<const UnaryExpression &>(expression));
+			break;
+		case Expression::Kind::Binary:
+			emitBinary(context, static_cast<const BinaryExpression &>(expression));
+			break;
+		case Expression::Kind::Assignment:
+			emitAssignment(context, static_cast<const AssignmentExpression &>(expression));
+			break;
+		case Expression::Kind::Conditional:
+			emitConditional(context, static_cast<const ConditionalExpression &>(expression));
+			break;
+		case Expression::Kind::Call:
+			emitCall(context, static_cast<const CallExpression &>(expression));
+			break;
+		case Expression::Kind::MemberAccess:
+			emitMember(context, static_cast<const MemberExpression &>(expression));
+			break;
+		case Expression::Kind::IndexAccess:
+			emitIndex(context, static_cast<const IndexExpression &>(expression));
+			break;
+		case Expression::Kind::Postfix:
+			emitPostfix(context, static_cast<const PostfixExpression &>(expression));
+			break;
+	}
+}
+
+void ConverterImpl::emitLiteral(EmissionContext &context, const LiteralExpression &literal) const
+{
+	context.out << literal.literal.content;
+}
+
+void ConverterImpl::emitArrayLiteral(EmissionContext &context, const ArrayLiteralExpression &literal) const
+{
+	std::string typeName;
+	std::optional<std::size_t> arraySize;
+	auto infoIt = expressionInfo.find(&literal);
+	if (infoIt != expressionInfo.end())
+	{
+		typeName = infoIt->second.typeName;
+		if (infoIt->second.hasArraySize && infoIt->second.arraySize)
 		{
-			const auto &ret = static_cast<const ReturnStatement &>(statement);
-			return ret.value && expressionMutatesAggregate(*ret.value, ctx, info);
+			arraySize = infoIt->second.arraySize;
 		}
-		case Statement::Kind::Break:
-		case Statement::Kind::Continue:
-		case Statement::Kind::Discard:
-			return false;
 	}
-	return false;
-}
 
-bool ConverterImpl::expressionMutatesAggregate(
-    const Expression &expression, MethodAnalysisContext &ctx, const AggregateInfo &info) const
-{
-	switch (expression.kind)
+	if (typeName.empty())
 	{
-		case Expression::Kind::Literal:
-			return false;
-		case Expression::Kind::ArrayLiteral:
+		context.out << "{";
+	}
+	else
+	{
+		context.out << typeToGLSL(typeName);
+		if (arraySize)
 		{
-			const auto &literal = static_cast<const ArrayLiteralExpression &>(expression);
-			for (const std::unique_ptr<Expression> &element : literal.elements)
-			{
-				if (element && expressionMutatesAggregate(*element, ctx, info))
-				{
-					return true;
-				}
-			}
-			return false;
+			context.out << "[" << *arraySize << "]";
 		}
-		case Expression::Kind::Identifier:
-			return false;
-		case Expression::Kind::Unary:
+		else
 		{
-			const auto &unary = static_cast<const UnaryExpression &>(expression);
-			if (unary.op == UnaryOperator::PreIncrement || unary.op == UnaryOperator::PreDecrement)
-			{
-				if (unary.operand && expressionRefersToField(*unary.operand, ctx, info))
-				{
-					return true;
-				}
-			}
-			return unary.operand && expressionMutatesAggregate(*unary.operand, ctx, info);
+			context.out << "[]";
 		}
-		case Expression::Kind::Binary:
+		context.out << "(";
+	}
+	for (std::size_t i = 0; i < literal.elements.size(); ++i)
+	{
+		if (i > 0)
 		{
-			const auto &binary = static_cast<const BinaryExpression &>(expression);
-			return (binary.left && expressionMutatesAggregate(*binary.left, ctx, info)) ||
-			       (binary.right && expressionMutatesAggregate(*binary.right, ctx, info));
+			context.out << ", ";
 		}
-		case Expression::Kind::Assignment:
+		if (literal.elements[i])
 		{
-			const auto &assign = static_cast<const AssignmentExpression &>(expression);
-			if (assign.target && expressionRefersToField(*assign.target, ctx, info))
-			{
-				return true;
-			}
-			return assign.value && expressionMutatesAggregate(*assign.value, ctx, info);
+			emitExpression(context, *literal.elements[i]);
 		}
-		case Expression::Kind::Conditional:
+	}
+	context.out << (typeName.empty() ? "}" : ")");
+}
+
+void ConverterImpl::emitIdentifier(EmissionContext &context, const IdentifierExpression &identifier) const
+{
+	if (identifier.name.parts.size() == 1)
+	{
+		const std::string &simple = identifier.name.parts.front().content;
+		if (!context.thisAliasStack.empty() && simple == "this")
 		{
-			const auto &conditional = static_cast<const ConditionalExpression &>(expression);
-			return (conditional.condition && expressionMutatesAggregate(*conditional.condition, ctx, info)) ||
-			       (conditional.thenBranch && expressionMutatesAggregate(*conditional.thenBranch, ctx, info)) ||
-			       (conditional.elseBranch && expressionMutatesAggregate(*conditional.elseBranch, ctx, info));
+			context.out << context.thisAliasStack.back();
+			return;
 		}
-		case Expression::Kind::Call:
+
+		if (context.currentMethodAggregate && !context.currentMethodSelfName.empty())
 		{
-			const auto &call = static_cast<const CallExpression &>(expression);
-			if (call.callee && expressionMutatesAggregate(*call.callee, ctx, info))
+			if (simple == context.currentMethodSelfName)
 			{
-				return true;
+				context.out << context.currentMethodSelfName;
+				return;
 			}
-			for (const std::unique_ptr<Expression> &arg : call.arguments)
+			const std::string sanitizedField = sanitizeIdentifier(simple);
+			const std::unordered_set<std::string> &fields = context.currentMethodAggregate->fieldNames;
+			if (context.currentMethodParameters.find(simple) == context.currentMethodParameters.end() &&
+			    fields.find(sanitizedField) != fields.end() && !context.isMethodLocalName(simple))
 			{
-				if (arg && expressionMutatesAggregate(*arg, ctx, info))
-				{
-					return true;
-				}
+				context.out << context.currentMethodSelfName << "." << sanitizedField;
+				return;
 			}
-			return false;
-		}
-		case Expression::Kind::MemberAccess:
-		{
-			const auto &member = static_cast<const MemberExpression &>(expression);
-			return member.object && expressionMutatesAggregate(*member.object, ctx, info);
 		}
-		case Expression::Kind::IndexAccess:
+	}
+	context.out << remapIdentifier(context, identifier.name);
+}
+
+void ConverterImpl::emitUnary(EmissionContext &context, const UnaryExpression &unary) const
+{
+	switch (unary.op)
+	{
+		case UnaryOperator::Positive:
+			context.out << "+";
+			break;
+		case UnaryOperator::Negate:
+			context.out << "-";
+			break;
+		case UnaryOperator::LogicalNot:
+			context.out << "!";
+			break;
+		case UnaryOperator::BitwiseNot:
+			context.out << "~";
+			break;
+		case UnaryOperator::PreIncrement:
+			context.out << "++";
+			break;
+		case UnaryOperator::PreDecrement:
+			context.out << "--";
+			break;
+	}
+	emitExpression(context, *unary.operand);
+}
+
+void ConverterImpl::emitBinary(EmissionContext &context, const BinaryExpression &binary) const
+{
+	if (const std::vector<const Expression *> factors = matrixChainFactors(binary); !factors.empty())
+	{
+		for (std::size_t i = 0; i + 1 < factors.size(); ++i)
 		{
-			const auto &index = static_cast<const IndexExpression &>(expression);
-			return (index.object && expressionMutatesAggregate(*index.object, ctx, info)) ||
-			       (index.index && expressionMutatesAggregate(*index.index, ctx, info));
+			context.out << "(";
+			emitExpression(context, *factors[i]);
+			context.out << " * ";
 		}
-		case Expression::Kind::Postfix:
+		emitExpression(context, *factors.back());
+		context.out << std::string(factors.size() - 1, ')');
+		return;
+	}
+
+	context.out << "(";
+	emitExpression(context, *binary.left);
+	context.out << " " << binaryOperatorSymbol(binary.op) << " ";
+	emitExpression(context, *binary.right);
+	context.out << ")";
+}
+
+// Factors of a product of matrices applied to a vector, such as ((projection * view) * model) * position, when it
+// holds at least two matrices. GLSL evaluates the chain left to right as matrix-matrix products; nested to the right,
+// every product is a matrix-vector one. Nothing when the expression is not such a chain or reassociation is off.
+std::vector<const Expression *> ConverterImpl::matrixChainFactors(const BinaryExpression &binary) const
+{
+	const auto typeNameOf = [&](const Expression &expression) {
+		const auto it = expressionInfo.find(&expression);
+		return it != expressionInfo.end() ? it->second.typeName : std::string{};
+	};
+	if (!input.options.reassociateMatrices || binary.op != BinaryOperator::Multiply ||
+	    !isFloatVectorTypeName(typeNameOf(binary)) || !isMatrixTypeName(typeNameOf(*binary.left)))
+	{
+		return {};
+	}
+
+	std::vector<const Expression *> factors;
+	const std::function<void(const Expression &)> collect = [&](const Expression &expression) {
+		const auto *product =
+		    expression.kind == Expression::Kind::Binary ? static_cast<const BinaryExpression *>(&expression) : nullptr;
+		// A product folded to a constant or held in a derived block member is already a single matrix.
+		if (product && product->op == BinaryOperator::Multiply && isMatrixTypeName(typeNameOf(*product)) &&
+		    !foldedExpressions.count(product) && !hoistedExpressions.count(product))
 		{
-			const auto &postfix = static_cast<const PostfixExpression &>(expression);
-			if (postfix.operand && expressionRefersToField(*postfix.operand, ctx, info))
-			{
-				return true;
-			}
-			return postfix.operand && expressionMutatesAggregate(*postfix.operand, ctx, info);
+			collect(*product->left);
+			collect(*product->right);
+			return;
 		}
+		factors.push_back(&expression);
+	};
+	collect(*binary.left);
+	if (factors.size() < 2)
+	{
+		return {};
 	}
-	return false;
+	factors.push_back(binary.right.get());
+	return factors;
 }
 
-bool ConverterImpl::expressionRefersToField(
-    const Expression &expression, MethodAnalysisContext &ctx, const AggregateInfo &info) const
+void ConverterImpl::emitAssignment(EmissionContext &context, const AssignmentExpression &assignment) const
 {
-	switch (expression.kind)
+	emitExpression(context, *assignment.target);
+	context.out << " " << assignmentOperatorSymbol(assignment.op) << " ";
+	emitExpression(context, *assignment.value);
+}
+
+void ConverterImpl::emitConditional(EmissionContext &context, const ConditionalExpression &conditional) const
+{
+	context.out << "(";
+	emitExpression(context, *conditional.condition);
+	context.out << " ? ";
+	emitExpression(context, *conditional.thenBranch);
+	context.out << " : ";
+	emitExpression(context, *conditional.elseBranch);
+	context.out << ")";
+}
+
+void ConverterImpl::emitCall(EmissionContext &context, const CallExpression &call) const
+{
+	if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
 	{
-		case Expression::Kind::Identifier:
+		const std::string method = safeTokenContent(member->member);
+		auto infoIt = expressionInfo.find(member->object.get());
+		const std::string objectType = (infoIt != expressionInfo.end()) ? infoIt->second.typeName : std::string{};
+		if (objectType == "Texture" && method == "getPixel" && !call.arguments.empty())
 		{
-			const auto &identifier = static_cast<const IdentifierExpression &>(expression);
-			if (identifier.name.parts.size() != 1)
-			{
-				return false;
-			}
-			const std::string simple = safeTokenContent(identifier.name.parts.front());
-			if (ctx.isShadowed(simple))
-			{
-				return false;
-			}
-			return info.fieldNames.find(sanitizeIdentifier(simple)) != info.fieldNames.end();
+			context.out << "texture(";
+			emitExpression(context, *member->object);
+			context.out << ", ";
+			emitExpression(context, *call.arguments.front());
+			context.out << ")";
+			return;
 		}
-		case Expression::Kind::MemberAccess:
+
+		if (emitBuiltinMemberCall(context, *member, call))
 		{
-			const auto &member = static_cast<const MemberExpression &>(expression);
-			if (!member.object)
-			{
-				return false;
-			}
-			const auto *objectIdentifier = dynamic_cast<const IdentifierExpression *>(member.object.get());
-			if (!objectIdentifier || objectIdentifier->name.parts.size() != 1)
+			return;
+		}
+
+		if (emitUserMethodCall(context, *member, call))
+		{
+			return;
+		}
+	}
+
+	if (const auto *identifier = dynamic_cast<const IdentifierExpression *>(call.callee.get()))
+	{
+		if (emitImplicitSelfCall(context, *identifier, call))
+		{
+			return;
+		}
+
+		const std::string name = joinName(identifier->name);
+		std::string callee = convertLuminaType(name);
+		if (callee == name)
+		{
+			callee = remapIdentifier(context, identifier->name);
+		}
+		const std::vector<const Expression *> arguments = constructorArguments(context, *identifier, call);
+		context.out << callee << "(";
+		for (std::size_t i = 0; i < arguments.size(); ++i)
+		{
+			if (i > 0)
 			{
-				return false;
+				context.out << ", ";
 			}
-			const std::string objectName = safeTokenContent(objectIdentifier->name.parts.front());
-			if (objectName != "this")
+			emitExpression(context, *arguments[i]);
+		}
+		context.out << ")";
+		return;
+	}
+
+	if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
+	{
+		emitExpression(context, *member->object);
+		context.out << "." << safeTokenContent(member->member) << "(";
+		for (std::size_t i = 0; i < call.arguments.size(); ++i)
+		{
+			if (i > 0)
 			{
-				return false;
+				context.out << ", ";
 			}
-			return info.fieldNames.find(sanitizeIdentifier(safeTokenContent(member.member))) != info.fieldNames.end();
+			emitExpression(context, *call.arguments[i]);
 		}
-		default:
-			return false;
+		context.out << ")";
 	}
 }
 
-void ConverterImpl::emitInterface(std::ostringstream &oss, const std::vector<StageIO> &entries, const char *qualifier) const
+std::optional<BuiltinCall> ConverterImpl::builtinMemberCall(
+    const MemberExpression &member, std::size_t argumentCount) const
 {
-	for (const StageIO &entry : entries)
+	const std::string method = safeTokenContent(member.member);
+	auto infoIt = expressionInfo.find(member.object.get());
+	if (infoIt == expressionInfo.end())
 	{
-		oss << "layout(location = " << entry.location << ") ";
-		if (entry.flat)
+		return std::nullopt;
+	}
+
+	const std::string &objectType = infoIt->second.typeName;
+	if (isFloatTypeName(objectType))
+	{
+		return floatBuiltinCall(method, argumentCount);
+	}
+	if (isFloatVectorTypeName(objectType))
+	{
+		return vectorBuiltinCall(objectType, method, argumentCount);
+	}
+	return std::nullopt;
+}
+
+bool ConverterImpl::emitBuiltinMemberCall(
+    EmissionContext &context, const MemberExpression &member, const CallExpression &call) const
+{
+	const std::optional<BuiltinCall> builtin = builtinMemberCall(member, call.arguments.size());
+	if (!builtin)
+	{
+		return false;
+	}
+
+	context.out << builtin->function << "(";
+	bool first = true;
+	const auto separate = [&context, &first]() {
+		if (!first)
 		{
-			oss << "flat ";
+			context.out << ", ";
 		}
-		oss << qualifier << " " << typeToGLSL(entry.type) << " " << entry.name << ";\n";
+		first = false;
+	};
+	if (!builtin->objectLast)
+	{
+		separate();
+		emitExpression(context, *member.object);
 	}
-	if (!entries.empty())
+	for (const std::unique_ptr<Expression> &argument : call.arguments)
+	{
+		separate();
+		if (argument)
+		{
+			emitExpression(context, *argument);
+		}
+	}
+	if (builtin->objectLast)
 	{
-		oss << "\n";
+		separate();
+		emitExpression(context, *member.object);
 	}
+	context.out << builtin->trailing << ")";
+	return true;
 }
 
-void ConverterImpl::emitStage(std::ostringstream &oss, const StageFunctionInstruction *stage, Stage stageKind) const
+void ConverterImpl::emitMember(EmissionContext &context, const MemberExpression &member) const
 {
-	if (!stage || !stage->body)
+	if (emitSSBOArraySizeAccess(context, member))
 	{
-		oss << "void main()\n{\n}\n";
 		return;
 	}
-
-	const auto nsIt = stageNamespaces.find(stage);
-	if (nsIt != stageNamespaces.end())
+	emitExpression(context, *member.object);
+	context.out << "." << safeTokenContent(member.member);
+}
+
+void ConverterImpl::emitIndex(EmissionContext &context, const IndexExpression &index) const
+{
+	emitExpression(context, *index.object);
+	context.out << "[";
+	emitExpression(context, *index.index);
+	context.out << "]";
+}
+
+void ConverterImpl::emitPostfix(EmissionContext &context, const PostfixExpression &postfix) const
+{
+	emitExpression(context, *postfix.operand);
+	context.out << ((postfix.op == PostfixOperator::Increment) ? "++" : "--");
+}
+
+bool ConverterImpl::emitSSBOArraySizeAccess(EmissionContext &context, const MemberExpression &member) const
+{
+	if (safeTokenContent(member.member) != "size")
+	{
+		return false;
+	}
+	if (!member.object)
 	{
-		pushEmissionNamespace(nsIt->second);
+		return false;
 	}
 
-	oss << "void main()\n{\n";
-	if (stageKind == Stage::VertexPass)
+	auto infoIt = expressionInfo.find(member.object.get());
+	if (infoIt == expressionInfo.end())
 	{
-		writeIndent(oss, 1);
-		oss << "triangleIndex = uint(gl_VertexID / 3);\n";
+		return false;
 	}
-	emitBlockStatement(oss, *stage->body, 1);
-	oss << "}\n";
-
-	if (nsIt != stageNamespaces.end())
+	if (!infoIt->second.isArray || infoIt->second.hasArraySize)
 	{
-		popEmissionNamespace();
+		return false;
 	}
-}
 
-void ConverterImpl::emitBlockStatement(std::ostringstream &oss, const BlockStatement &block, int indent) const
-{
-	if (currentMethodAggregate)
+	std::string blockName;
+	std::string arrayName;
+
+	if (const auto *arrayIdentifier = dynamic_cast<const IdentifierExpression *>(member.object.get()))
 	{
-		methodLocalNameStack.emplace_back();
+		if (!context.currentMethodAggregate || !context.currentMethodAggregate->isSSBO ||
+		    (context.currentMethodAggregate->kind != AggregateInstruction::Kind::ConstantBlock &&
+		        context.currentMethodAggregate->kind != AggregateInstruction::Kind::AttributeBlock))
+		{
+			return false;
+		}
+		if (arrayIdentifier->name.parts.size() != 1)
+		{
+			return false;
+		}
+		if (context.currentMethodSelfName.empty())
+		{
+			return false;
+		}
+		const std::string simple = safeTokenContent(arrayIdentifier->name.parts.front());
+		const std::string sanitizedField = sanitizeIdentifier(simple);
+		const std::unordered_set<std::string> &fields = context.currentMethodAggregate->fieldNames;
+		if (fields.find(sanitizedField) == fields.end())
+		{
+			return false;
+		}
+		blockName = context.currentMethodSelfName;
+		arrayName = sanitizedField;
 	}
-	for (const std::unique_ptr<Statement> &statement : block.statements)
+	else if (const auto *arrayMember = dynamic_cast<const MemberExpression *>(member.object.get()))
 	{
-		if (statement)
+		if (!arrayMember->object)
+		{
+			return false;
+		}
+		const auto *rootIdentifier = dynamic_cast<const IdentifierExpression *>(arrayMember->object.get());
+		if (!rootIdentifier)
+		{
+			return false;
+		}
+		auto aggregateKey = resolveAggregateQualifiedName(context, rootIdentifier->name);
+		if (!aggregateKey)
 		{
-			emitStatement(oss, *statement, indent);
+			return false;
+		}
+		const AggregateInfo *aggregate = findAggregateInfo(*aggregateKey);
+		if (!aggregate || !aggregate->isSSBO ||
+		    (aggregate->kind != AggregateInstruction::Kind::ConstantBlock &&
+		        aggregate->kind != AggregateInstruction::Kind::AttributeBlock))
+		{
+			return false;
 		}
+		blockName = remapIdentifier(context, rootIdentifier->name);
+		arrayName = sanitizeIdentifier(safeTokenContent(arrayMember->member));
 	}
-	if (currentMethodAggregate)
+
+	if (blockName.empty() || arrayName.empty())
 	{
-		methodLocalNameStack.pop_back();
+		return false;
 	}
+
+	context.out << blockName << ".spk_" << blockName << "_" << arrayName << "_size";
+	return true;
 }
 
-void ConverterImpl::emitStatement(std::ostringstream &oss, const Statement &statement, int indent) const
+std::string ConverterImpl::typeToGLSL(const TypeName &type) const
 {
-	switch (statement.kind)
+	return sanitizeIdentifier(convertLuminaType(joinName(type.name)));
+}
+
+std::string ConverterImpl::typeToGLSL(const std::string &typeName) const
+{
+	return sanitizeIdentifier(convertLuminaType(typeName));
+}
+
+bool ConverterImpl::aggregateHasUnsizedArray(const AggregateInstruction &aggregate) const
+{
+	for (const std::unique_ptr<StructMember> &member : aggregate.members)
 	{
-		case Statement::Kind::Block:
+		if (!member || member->kind != StructMember::Kind::Field)
 		{
-			writeIndent(oss, indent);
-			oss << "{\n";
-			emitBlockStatement(oss, static_cast<const BlockStatement &>(statement), indent + 1);
-			writeIndent(oss, indent);
-			oss << "}\n";
-			break;
+			continue;
 		}
-		case Statement::Kind::Expression:
+
+		const auto &field = static_cast<const FieldMember &>(*member);
+		for (const VariableDeclarator &declarator : field.declaration.declarators)
 		{
-			const auto &expr = static_cast<const ExpressionStatement &>(statement);
-			if (expr.expression)
+			if (declarator.hasArraySuffix && !declarator.hasArraySize)
 			{
-				writeIndent(oss, indent);
-				oss << emitExpression(*expr.expression) << ";\n";
+				return true;
 			}
-			break;
 		}
-		case Statement::Kind::Variable:
-			emitVariableStatement(oss, static_cast<const VariableStatement &>(statement), indent);
-			break;
-		case Statement::Kind::If:
-			emitIfStatement(oss, static_cast<const IfStatement &>(statement), indent);
-			break;
-		case Statement::Kind::While:
-			emitWhileStatement(oss, static_cast<const WhileStatement &>(statement), indent);
-			break;
-		case Statement::Kind::DoWhile:
-			emitDoWhileStatement(oss, static_cast<const DoWhileStatement &>(statement), indent);
-			break;
-		case Statement::Kind::For:
-			emitForStatement(oss, static_cast<const ForStatement &>(statement), indent);
-			break;
-		case Statement::Kind::Return:
-			emitReturnStatement(oss, static_cast<const ReturnStatement &>(statement), indent);
-			break;
-		case Statement::Kind::Break:
-			writeIndent(oss, indent);
-			oss << "break;\n";
-			break;
-		case Statement::Kind::Continue:
-			writeIndent(oss, indent);
-			oss << "continue;\n";
-			break;
-		case Statement::Kind::Discard:
-			writeIndent(oss, indent);
-			oss << "discard;\n";
-			break;
-		default:
-			break;
 	}
+	return false;
 }
 
-void ConverterImpl::emitVariableStatement(std::ostringstream &oss, const VariableStatement &statement, int indent) const
+std::string ConverterImpl::aggregateTypeName(const AggregateInfo &info) const
 {
-	const std::string type = typeToGLSL(statement.declaration.type);
-	for (const VariableDeclarator &declarator : statement.declaration.declarators)
+	return info.glslTypeName;
+}
+
+void ConverterImpl::emitMethodHelper(
+    EmissionContext &context, const AggregateInfo &info, const MethodHelper &helper) const
+{
+	if (!helper.node || !helper.node->body)
 	{
-		const std::string originalName = safeTokenContent(declarator.name);
-		const std::string varName = sanitizeIdentifier(originalName);
-		writeIndent(oss, indent);
-		oss << type << " " << varName;
-		if (declarator.hasArraySuffix && declarator.arraySize)
+		return;
+	}
+
+	context.out << typeToGLSL(helper.node->returnType) << " " << helper.helperName << "(";
+	bool first = true;
+	const bool isStructAggregate = info.kind == AggregateInstruction::Kind::Struct;
+	const bool needsSelfParameter = isStructAggregate;
+	const std::string aggregateType = aggregateTypeName(info);
+	if (needsSelfParameter)
+	{
+		if (!helper.isConst)
 		{
-			oss << "[" << emitExpression(*declarator.arraySize) << "]";
+			context.out << "inout ";
 		}
-		else if (declarator.hasArraySuffix)
+		else
 		{
-			oss << "[]";
+			context.out << "const ";
 		}
-		if (declarator.initializer)
+		context.out << aggregateType << " " << kMethodSelfName;
+		first = false;
+	}
+	for (const Parameter &param : helper.node->parameters)
+	{
+		if (!first)
 		{
-			oss << " = " << emitExpression(*declarator.initializer);
+			context.out << ", ";
 		}
-		oss << ";\n";
-
-		if (currentMethodAggregate && !methodLocalNameStack.empty())
+		if (param.isReference)
+		{
+			context.out << "inout ";
+		}
+		else if (param.type.isConst)
 		{
-			methodLocalNameStack.back().insert(originalName);
+			context.out << "const ";
 		}
+		context.out << typeToGLSL(param.type) << " " << parameterName(param.name);
+		first = false;
 	}
+	context.out << ")\n{\n";
+	context.currentMethodAggregate = &info;
+	context.currentMethodParameters.clear();
+	context.methodLocalNameStack.clear();
+	context.currentMethodSelfName = needsSelfParameter ? std::string(kMethodSelfName) : info.glslInstanceName;
+	context.currentMethodUsesSelfParameter = needsSelfParameter;
+	for (const Parameter &param : helper.node->parameters)
+	{
+		context.currentMethodParameters.insert(safeTokenContent(param.name));
+	}
+	context.thisAliasStack.push_back(context.currentMethodSelfName);
+	context.pushNamespace(info.namespacePath);
+	context.out.indent();
+	emitBlockStatement(context, *helper.node->body);
+	context.out.dedent();
+	context.popNamespace();
+	context.thisAliasStack.pop_back();
+	context.methodLocalNameStack.clear();
+	context.currentMethodParameters.clear();
+	context.currentMethodAggregate = nullptr;
+	context.currentMethodSelfName.clear();
+	context.currentMethodUsesSelfParameter = false;
+	context.out << "}\n\n";
 }
 
-void ConverterImpl::emitIfStatement(std::ostringstream &oss, const IfStatement &statement, int indent) const
+bool ConverterImpl::emitUserMethodCall(
+    EmissionContext &context, const MemberExpression &member, const CallExpression &call) const
 {
-	writeIndent(oss, indent);
-	oss << "if (" << emitExpression(*statement.condition) << ")\n";
-	emitStatement(oss, *statement.thenBranch, indent + 1);
-	if (statement.elseBranch)
+	auto infoIt = expressionInfo.find(member.object.get());
+	if (infoIt == expressionInfo.end())
 	{
-		writeIndent(oss, indent);
-		oss << "else\n";
-		emitStatement(oss, *statement.elseBranch, indent + 1);
+		return false;
 	}
-}
 
-void ConverterImpl::emitWhileStatement(std::ostringstream &oss, const WhileStatement &statement, int indent) const
-{
-	writeIndent(oss, indent);
-	oss << "while (" << emitExpression(*statement.condition) << ")\n";
-	emitStatement(oss, *statement.body, indent + 1);
-}
+	const std::string objectType = infoIt->second.typeName;
+	const std::string methodName = safeTokenContent(member.member);
+	auto typeIt = methodCallHelpers.find(objectType);
+	if (typeIt == methodCallHelpers.end())
+	{
+		return false;
+	}
+	auto helperIt = typeIt->second.find(methodName);
+	if (helperIt == typeIt->second.end())
+	{
+		return false;
+	}
 
-void ConverterImpl::emitDoWhileStatement(std::ostringstream &oss, const DoWhileStatement &statement, int indent) const
-{
-	writeIndent(oss, indent);
-	oss << "do\n";
-	emitStatement(oss, *statement.body, indent + 1);
-	writeIndent(oss, indent);
-	oss << "while (" << emitExpression(*statement.condition) << ");\n";
-}
+	const AggregateInfo *aggregateInfo = findAggregateInfo(objectType);
+	const bool needsSelfArgument =
+	    !aggregateInfo || aggregateInfo->kind == AggregateInstruction::Kind::Struct;
 
-void ConverterImpl::emitForStatement(std::ostringstream &oss, const ForStatement &statement, int indent) const
-{
-	writeIndent(oss, indent);
-	oss << "for (";
-	if (statement.initializer)
+	context.out << helperIt->second.helperName << "(";
+	bool first = true;
+	if (needsSelfArgument)
 	{
-		if (statement.initializer->kind == Statement::Kind::Variable)
-		{
-			const auto &var = static_cast<const VariableStatement &>(*statement.initializer);
-			if (!var.declaration.declarators.empty())
-			{
-				const VariableDeclarator &decl = var.declaration.declarators.front();
-				oss << typeToGLSL(var.declaration.type) << " " << safeTokenContent(decl.name);
-				if (decl.initializer)
-				{
-					oss << " = " << emitExpression(*decl.initializer);
-				}
-			}
-		}
-		else if (statement.initializer->kind == Statement::Kind::Expression)
+		emitExpression(context, *member.object);
+		first = false;
+	}
+	for (const std::unique_ptr<Expression> &argument : call.arguments)
+	{
+		if (!first)
 		{
-			const auto &expr = static_cast<const ExpressionStatement &>(*statement.initializer);
-			if (expr.expression)
-			{
-				oss << emitExpression(*expr.expression);
-			}
+			context.out << ", ";
 		}
+		emitExpression(context, *argument);
+		first = false;
 	}
-	oss << "; ";
-	if (statement.condition)
+	context.out << ")";
+	return true;
+}
+
+bool ConverterImpl::emitImplicitSelfCall(
+    EmissionContext &context, const IdentifierExpression &identifier, const CallExpression &call) const
+{
+	if (!context.currentMethodAggregate || identifier.name.parts.size() != 1)
 	{
-		oss << emitExpression(*statement.condition);
+		return false;
 	}
-	oss << "; ";
-	if (statement.increment)
+
+	const std::string methodName = identifier.name.parts.front().content;
+	auto typeIt = methodCallHelpers.find(context.currentMethodAggregate->qualifiedName);
+	if (typeIt == methodCallHelpers.end())
 	{
-		oss << emitExpression(*statement.increment);
+		return false;
 	}
-	oss << ")\n";
-	emitStatement(oss, *statement.body, indent + 1);
-}
-
-void ConverterImpl::emitReturnStatement(std::ostringstream &oss, const ReturnStatement &statement, int indent) const
-{
-	writeIndent(oss, indent);
-	oss << "return";
-	if (statement.value)
+	auto helperIt = typeIt->second.find(methodName);
+	if (helperIt == typeIt->second.end())
 	{
-		oss << " " << emitExpression(*statement.value);
+		return false;
 	}
-	oss << ";\n";
-}
 
-std::string ConverterImpl::emitExpression(const Expression &expression) const
-{
-	switch (expression.kind)
+	context.out << helperIt->second.helperName << "(";
+	bool first = true;
+	if (context.currentMethodUsesSelfParameter && !context.currentMethodSelfName.empty())
 	{
-		case Expression::Kind::Literal:
-			return emitLiteral(static_cast<const LiteralExpression &>(expression));
-		case Expression::Kind::ArrayLiteral:
-			return emitArrayLiteral(static_cast<const ArrayLiteralExpression &>(expression));
-		case Expression::Kind::Identifier:
-			return emitIdentifier(static_cast<const IdentifierExpression &>(expression));
-		case Expression::Kind::Unary:
-			return emitUnary(static_cast<const UnaryExpression &>(expression));
-		case Expression::Kind::Binary:
-			return emitBinary(static_cast<const BinaryExpression &>(expression));
-		case Expression::Kind::Assignment:
-			return emitAssignment(static_cast<const AssignmentExpression &>(expression));
-		case Expression::Kind::Conditional:
-			return emitConditional(static_cast<const ConditionalExpression &>(expression));
-		case Expression::Kind::Call:
-			return emitCall(static_cast<const CallExpression &>(expression));
-		case Expression::Kind::MemberAccess:
-			return emitMember(static_cast<const MemberExpression &>(expression));
-		case Expression::Kind::IndexAccess:
-			return emitIndex(static_cast<const IndexExpression &>(expression));
-		case Expression::Kind::Postfix:
-			return emitPostfix(static_cast<const PostfixExpression &>(expression));
+		context.out << context.currentMethodSelfName;
+		first = false;
+	}
+	for (const std::unique_ptr<Expression> &argument : call.arguments)
+	{
+		if (!first)
+		{
+			context.out << ", ";
+		}
+		emitExpression(context, *argument);
+		first = false;
 	}
-	return {};
+	context.out << ")";
+	return true;
 }
 
-std::string ConverterImpl::emitLiteral(const LiteralExpression &literal) const
+struct ConverterImpl::IrLoweringContext
 {
-	return literal.literal.content;
-}
+	IrLoweringContext(EmissionContext &p_emission, IrModule &p_module, IrFunction &p_function,
+	    const std::unordered_set<std::string> &p_inputs, const std::unordered_set<std::string> &p_outputs)
+	    : emission(p_emission),
+	      module(p_module),
+	      function(p_function),
+	      builder(p_module, p_function.body),
+	      inputs(p_inputs),
+	      outputs(p_outputs)
+	{
+		scopes.emplace_back();
+	}
 
-std::string ConverterImpl::emitArrayLiteral(const ArrayLiteralExpression &literal) const
-{
-	std::ostringstream oss;
-	std::string typeName;
-	std::optional<std::size_t> arraySize;
-	auto infoIt = expressionInfo.find(&literal);
-	if (infoIt != expressionInfo.end())
+	IrVariable *addLocal(const std::string &rawName, const IrType *type, IrVariable::Storage storage)
 	{
-		typeName = infoIt->second.typeName;
-		if (infoIt->second.hasArraySize && infoIt->second.arraySize)
-		{
-			arraySize = infoIt->second.arraySize;
-		}
+		auto variable = std::make_unique<IrVariable>();
+		variable->storage = storage;
+		variable->name = sanitizeIdentifier(rawName);
+		variable->type = type;
+		IrVariable *result = variable.get();
+		function.variables.push_back(std::move(variable));
+		scopes.back()[rawName] = result;
+		return result;
 	}
 
-	if (typeName.empty())
+	IrVariable *findLocal(const std::string &rawName) const
 	{
-		oss << "{";
-		for (std::size_t i = 0; i < literal.elements.size(); ++i)
+		for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
 		{
-			if (i > 0)
-			{
-				oss << ", ";
-			}
-			if (literal.elements[i])
+			if (const auto found = it->find(rawName); found != it->end())
 			{
-				oss << emitExpression(*literal.elements[i]);
+				return found->second;
 			}
 		}
-		oss << "}";
-		return oss.str();
+		return nullptr;
 	}
 
-	oss << typeToGLSL(typeName);
-	if (arraySize)
+	EmissionContext &emission;
+	IrModule &module;
+	IrFunction &function;
+	IrBuilder builder;
+	// GLSL names of the stage's in and out variables.
+	const std::unordered_set<std::string> &inputs;
+	const std::unordered_set<std::string> &outputs;
+	std::vector<std::unordered_map<std::string, IrVariable *>> scopes;
+};
+
+void ConverterImpl::lowerStageToIr(EmissionContext &context, const StageFunctionInstruction *stage, Stage stageKind,
+    const std::vector<StageIO> &inputs, const std::vector<StageIO> &outputs, const StageUsage &usage) const
+{
+	PassTimer timer("IR lowering");
+	context.irModule = std::make_unique<IrModule>();
+	IrModule &module = *context.irModule;
+	std::unordered_set<std::string> inputNames;
+	std::unordered_set<std::string> outputNames;
+	for (const StageIO &entry : inputs)
 	{
-		oss << "[" << *arraySize << "]";
+		inputNames.insert(entry.name);
 	}
-	else
+	for (const StageIO &entry : outputs)
 	{
-		oss << "[]";
+		outputNames.insert(entry.name);
 	}
-	oss << "(";
-	for (std::size_t i = 0; i < literal.elements.size(); ++i)
+
+	const auto lower = [&](const std::string &name, const std::string &returnType,
+	                       const std::vector<Parameter> &parameters, const BlockStatement &body,
+	                       const std::vector<std::string> &ns, std::optional<Stage> stageMain) -> const IrFunction * {
+		auto function = std::make_unique<IrFunction>();
+		function->name = name;
+		function->returnType = module.types.get(returnType);
+		IrLoweringContext ctx(context, module, *function, inputNames, outputNames);
+		context.pushNamespace(ns);
+		const bool lowered = lowerFunctionBody(ctx, parameters, body, stageMain);
+		context.popNamespace();
+		if (!lowered)
+		{
+			return nullptr;
+		}
+		module.functions.push_back(std::move(function));
+		return module.functions.back().get();
+	};
+
+	static const std::vector<std::string> kGlobalNamespace;
+	for (const FunctionInstruction *function : functions)
 	{
-		if (i > 0)
+		if (!function || !function->body || usage.functions.find(function) == usage.functions.end())
 		{
-			oss << ", ";
+			continue;
 		}
-		if (literal.elements[i])
+		const auto nameIt = functionNames.find(function);
+		if (nameIt == functionNames.end())
+		{
+			continue;
+		}
+		const auto nsIt = functionNamespaces.find(function);
+		const IrFunction *lowered = lower(nameIt->second, typeToGLSL(function->returnType), function->parameters,
+		    *function->body, nsIt != functionNamespaces.end() ? nsIt->second : kGlobalNamespace, std::nullopt);
+		if (lowered)
 		{
-			oss << emitExpression(*literal.elements[i]);
+			context.irFunctions.emplace(function, lowered);
 		}
 	}
-	oss << ")";
-	return oss.str();
+
+	if (stage && stage->body)
+	{
+		const auto nsIt = stageNamespaces.find(stage);
+		context.dropsDeadVaryingWrites = stageKind == Stage::VertexPass;
+		context.irStage = lower("main", "void", {}, *stage->body,
+		    nsIt != stageNamespaces.end() ? nsIt->second : kGlobalNamespace, stageKind);
+		context.dropsDeadVaryingWrites = false;
+	}
 }
 
-std::string ConverterImpl::emitIdentifier(const IdentifierExpression &identifier) const
+bool ConverterImpl::lowerFunctionBody(IrLoweringContext &ctx, const std::vector<Parameter> &parameters,
+    const BlockStatement &body, std::optional<Stage> stageMain) const
 {
-	if (identifier.name.parts.size() == 1)
+	IrBuilder &builder = ctx.builder;
+	try
 	{
-		const std::string simple = identifier.name.parts.front().content;
-		if (!thisAliasStack.empty() && simple == "this")
+		for (const Parameter &parameter : parameters)
 		{
-			return thisAliasStack.back();
+			IrVariable *variable = ctx.addLocal(safeTokenContent(parameter.name),
+			    ctx.module.types.get(typeToGLSL(parameter.type)), IrVariable::Storage::Parameter);
+			variable->isReference = parameter.isReference;
+			variable->isConst = parameter.type.isConst;
+			variable->readOnly = parameter.type.isConst && !parameter.isReference;
+			ctx.function.parameters.push_back(variable);
 		}
 
-		if (currentMethodAggregate && !currentMethodSelfName.empty())
+		const bool vertexMain = stageMain == Stage::VertexPass;
+		if (stageMain)
 		{
-			if (simple == currentMethodSelfName)
+			const IrType *intType = ctx.module.types.get("int");
+			const IrType *uintType = ctx.module.types.get("uint");
+			for (const BuiltinCopy &copy : vertexMain ? vertexBuiltinCopies : fragmentBuiltinCopies)
 			{
-				return currentMethodSelfName;
+				IrVariable *source = ctx.module.global(copy.source, IrVariable::Storage::Input, intType, true);
+				IrVariable *target = ctx.module.global(copy.name,
+				    ctx.outputs.count(copy.name) != 0 ? IrVariable::Storage::Output : IrVariable::Storage::Global,
+				    uintType, false);
+				IrInstruction *value = builder.load(builder.address(*source, intType));
+				if (copy.divisor != 1)
+				{
+					value = builder.binary(BinaryOperator::Divide, intType, value,
+					    builder.constant(intType, std::to_string(copy.divisor)));
+				}
+				IrInstruction *index = builder.append(IrOpcode::Construct, uintType, {value});
+				index->text = "uint";
+				builder.store(builder.address(*target, uintType), index);
 			}
-			const std::string sanitizedField = sanitizeIdentifier(simple);
-			if (currentMethodParameters.find(simple) == currentMethodParameters.end() &&
-			    currentMethodAggregate->fieldNames.find(sanitizedField) != currentMethodAggregate->fieldNames.end() &&
-			    !isMethodLocalName(simple))
+		}
+
+		for (const std::unique_ptr<Statement> &statement : body.statements)
+		{
+			if (statement)
 			{
-				return currentMethodSelfName + "." + sanitizedField;
+				lowerStatement(ctx, *statement);
 			}
 		}
-	}
-	return remapIdentifier(identifier.name);
-}
 
-std::string ConverterImpl::emitUnary(const UnaryExpression &unary) const
-{
-	std::string op;
-	switch (unary.op)
+		if (vertexMain)
+		{
+			for (std::size_t i = 0; i < movedVaryings.size(); ++i)
+			{
+				const IrType *type = irExpressionType(ctx, *movedSources[i]);
+				IrInstruction *value = lowerExpression(ctx, *movedSources[i]);
+				IrVariable *varying =
+				    ctx.module.global(movedVaryings[i].varying.name, IrVariable::Storage::Output, type, false);
+				builder.store(builder.address(*varying, type), value);
+			}
+		}
+	} catch (const IrUnsupported &)
 	{
-		case UnaryOperator::Positive:
-			op = "+";
-			break;
-		case UnaryOperator::Negate:
-			op = "-";
-			break;
-		case UnaryOperator::LogicalNot:
-			op = "!";
-			break;
-		case UnaryOperator::BitwiseNot:
-			op = "~";
-			break;
-		case UnaryOperator::PreIncrement:
-			op = "++";
-			break;
-		case UnaryOperator::PreDecrement:
-			op = "--";
-			break;
+		return false;
 	}
-	return op + emitExpression(*unary.operand);
-}
-
-std::string ConverterImpl::emitBinary(const BinaryExpression &binary) const
-{
-	std::string leftExpr = emitExpression(*binary.left);
-	std::string rightExpr = emitExpression(*binary.right);
-
-	return "(" + leftExpr + " " + binaryOperatorSymbol(binary.op) + " " + rightExpr + ")";
-}
-
-std::string ConverterImpl::emitAssignment(const AssignmentExpression &assignment) const
-{
-	return emitExpression(*assignment.target) + " " + assignmentOperatorSymbol(assignment.op) + " " +
-	       emitExpression(*assignment.value);
-}
-
-std::string ConverterImpl::emitConditional(const ConditionalExpression &conditional) const
-{
-	return "(" + emitExpression(*conditional.condition) + " ? " + emitExpression(*conditional.thenBranch) + " : " +
-	       emitExpression(*conditional.elseBranch) + ")";
+	return true;
 }
 
-std::string ConverterImpl::emitCall(const CallExpression &call) const
+void ConverterImpl::lowerStatement(IrLoweringContext &ctx, const Statement &statement) const
 {
-	if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
+	IrBuilder &builder = ctx.builder;
+	switch (statement.kind)
 	{
-		const std::string method = safeTokenContent(member->member);
-		auto infoIt = expressionInfo.find(member->object.get());
-		const std::string objectType = (infoIt != expressionInfo.end()) ? infoIt->second.typeName : std::string{};
-		if (objectType == "Texture" && method == "getPixel" && !call.arguments.empty())
+		case Statement::Kind::Block:
 		{
-			return "texture(" + emitExpression(*member->object) + ", " + emitExpression(*call.arguments.front()) + ")";
+			IrInstruction *scope = builder.structured(IrOpcode::Scope, 1);
+			lowerStatementInto(ctx, *scope->blocks[0], statement);
+			break;
 		}
-
-		if (std::optional<std::string> builtin = emitBuiltinMemberCall(*member, call))
+		case Statement::Kind::Expression:
 		{
-			return *builtin;
+			const auto &expr = static_cast<const ExpressionStatement &>(statement);
+			if (!expr.expression)
+			{
+				break;
+			}
+			// Only the value of a write to a dead varying is kept, for its side effects.
+			const Expression *value = nullptr;
+			const IdentifierExpression *target = ctx.emission.dropsDeadVaryingWrites
+			                                         ? statementWriteTarget(*expr.expression, &value)
+			                                         : nullptr;
+			if (target && droppedVaryings.count(joinName(target->name)) != 0)
+			{
+				if (value)
+				{
+					lowerExpression(ctx, *value);
+				}
+				break;
+			}
+			lowerExpression(ctx, *expr.expression);
+			break;
 		}
-
-		if (std::optional<std::string> userCall = emitUserMethodCall(*member, call))
+		case Statement::Kind::Variable:
+			lowerVariableStatement(ctx, static_cast<const VariableStatement &>(statement));
+			break;
+		case Statement::Kind::If:
 		{
-			return *userCall;
+			const auto &ifStatement = static_cast<const IfStatement &>(statement);
+			IrInstruction *condition = lowerExpression(ctx, *ifStatement.condition);
+			IrInstruction *branch = builder.structured(IrOpcode::If, 2, {condition});
+			lowerStatementInto(ctx, *branch->blocks[0], *ifStatement.thenBranch);
+			if (ifStatement.elseBranch)
+			{
+				lowerStatementInto(ctx, *branch->blocks[1], *ifStatement.elseBranch);
+			}
+			break;
 		}
-	}
-
-	if (const auto *identifier = dynamic_cast<const IdentifierExpression *>(call.callee.get()))
-	{
-		if (std::optional<std::string> implicit = emitImplicitSelfCall(*identifier, call))
+		case Statement::Kind::While:
 		{
-			return *implicit;
+			const auto &whileStatement = static_cast<const WhileStatement &>(statement);
+			lowerLoop(ctx, whileStatement.condition.get(), *whileStatement.body, nullptr, false);
+			break;
 		}
-
-		const std::string name = joinName(identifier->name);
-		std::string callee = convertLuminaType(name);
-		if (callee == name)
+		case Statement::Kind::DoWhile:
 		{
-			callee = remapIdentifier(identifier->name);
+			const auto &doStatement = static_cast<const DoWhileStatement &>(statement);
+			lowerLoop(ctx, doStatement.condition.get(), *doStatement.body, nullptr, true);
+			break;
 		}
-		std::ostringstream oss;
-		oss << callee << "(";
-		for (std::size_t i = 0; i < call.arguments.size(); ++i)
+		case Statement::Kind::For:
 		{
-			if (i > 0)
+			// The initializer's variables live in a scope around the loop.
+			const auto &forStatement = static_cast<const ForStatement &>(statement);
+			IrInstruction *scope = builder.structured(IrOpcode::Scope, 1);
+			IrBlock &outer = builder.block();
+			builder.setBlock(*scope->blocks[0]);
+			ctx.scopes.emplace_back();
+			if (forStatement.initializer)
 			{
-				oss << ", ";
+				lowerStatement(ctx, *forStatement.initializer);
 			}
-			oss << emitExpression(*call.arguments[i]);
+			lowerLoop(ctx, forStatement.condition.get(), *forStatement.body, forStatement.increment.get(), false);
+			ctx.scopes.pop_back();
+			builder.setBlock(outer);
+			break;
 		}
-		oss << ")";
-		return oss.str();
-	}
-
-	if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
-	{
-		std::ostringstream oss;
-		oss << emitExpression(*member->object) << "." << safeTokenContent(member->member) << "(";
-		for (std::size_t i = 0; i < call.arguments.size(); ++i)
+		case Statement::Kind::Return:
 		{
-			if (i > 0)
+			const auto &ret = static_cast<const ReturnStatement &>(statement);
+			std::vector<IrInstruction *> operands;
+			if (ret.value)
 			{
-				oss << ", ";
+				operands.push_back(lowerExpression(ctx, *ret.value));
 			}
-			oss << emitExpression(*call.arguments[i]);
+			builder.structured(IrOpcode::Return, 0, std::move(operands));
+			break;
 		}
-		oss << ")";
-		return oss.str();
+		case Statement::Kind::Break:
+			builder.structured(IrOpcode::Break, 0);
+			break;
+		case Statement::Kind::Continue:
+			builder.structured(IrOpcode::Continue, 0);
+			break;
+		case Statement::Kind::Discard:
+			builder.structured(IrOpcode::Discard, 0);
+			break;
 	}
-
-	return {};
 }
 
-std::optional<std::string> ConverterImpl::emitBuiltinMemberCall(
-    const MemberExpression &member, const CallExpression &call) const
+void ConverterImpl::lowerStatementInto(IrLoweringContext &ctx, IrBlock &block, const Statement &statement) const
 {
-	const std::string method = safeTokenContent(member.member);
-	auto infoIt = expressionInfo.find(member.object.get());
-	if (infoIt == expressionInfo.end())
-	{
-		return std::nullopt;
-	}
-
-	const std::string objectType = infoIt->second.typeName;
-	const std::string objectExpr = emitExpression(*member.object);
-	std::vector<std::string> arguments;
-	arguments.reserve(call.arguments.size());
-	for (const std::unique_ptr<Expression> &argument : call.arguments)
+	IrBlock &outer = ctx.builder.block();
+	ctx.builder.setBlock(block);
+	ctx.scopes.emplace_back();
+	if (statement.kind == Statement::Kind::Block)
 	{
-		if (argument)
-		{
-			arguments.push_back(emitExpression(*argument));
-		}
-		else
+		for (const std::unique_ptr<Statement> &nested : static_cast<const BlockStatement &>(statement).statements)
 		{
-			arguments.emplace_back();
+			if (nested)
+			{
+				lowerStatement(ctx, *nested);
+			}
 		}
 	}
-
-	if (isFloatTypeName(objectType))
-	{
-		return emitFloatBuiltinCall(method, objectExpr, arguments);
-	}
-
-	if (isFloatVectorTypeName(objectType))
+	else
 	{
-		return emitVectorBuiltinCall(objectType, method, objectExpr, arguments);
+		lowerStatement(ctx, statement);
 	}
-
-	return std::nullopt;
+	ctx.scopes.pop_back();
+	ctx.builder.setBlock(outer);
 }
 
-std::optional<std::string> ConverterImpl::emitFloatBuiltinCall(
-    const std::string &method, const std::string &objectExpr, const std::vector<std::string> &arguments) const
+void ConverterImpl::lowerVariableStatement(IrLoweringContext &ctx, const VariableStatement &statement) const
 {
-	const auto hasArgs = [&](std::size_t expected) { return arguments.size() == expected; };
-
-	auto wrap = [&](const std::string &name) { return name + "(" + objectExpr + ")"; };
-
-	if (method == "abs" || method == "sign" || method == "floor" || method == "ceil" || method == "fract" ||
-	    method == "exp" || method == "log" || method == "exp2" || method == "log2" || method == "sqrt" ||
-	    method == "inversesqrt" || method == "sin" || method == "cos" || method == "tan" || method == "asin" ||
-	    method == "acos" || method == "atan")
+	const std::string type = typeToGLSL(statement.declaration.type);
+	for (const VariableDeclarator &declarator : statement.declaration.declarators)
 	{
-		if (hasArgs(0))
+		std::optional<std::size_t> arraySize;
+		if (declarator.hasArraySuffix && declarator.arraySize)
 		{
-			return wrap(method);
+			const auto *literal = dynamic_cast<const LiteralExpression *>(declarator.arraySize.get());
+			const std::string digits = literal ? literal->literal.content : std::string{};
+			if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos)
+			{
+				throw IrUnsupported{};
+			}
+			arraySize = std::stoul(digits);
 		}
-		return std::nullopt;
-	}
-
-	if ((method == "mod" || method == "min" || method == "max" || method == "pow") && hasArgs(1))
-	{
-		return method + "(" + objectExpr + ", " + arguments[0] + ")";
-	}
 
-	if (method == "clamp" && hasArgs(2))
-	{
-		return "clamp(" + objectExpr + ", " + arguments[0] + ", " + arguments[1] + ")";
-	}
-
-	if (method == "mix" && hasArgs(2))
-	{
-		return "mix(" + objectExpr + ", " + arguments[0] + ", " + arguments[1] + ")";
+		std::vector<IrInstruction *> operands;
+		if (declarator.initializer)
+		{
+			operands.push_back(lowerExpression(ctx, *declarator.initializer));
+		}
+		IrVariable *variable = ctx.addLocal(safeTokenContent(declarator.name),
+		    ctx.module.types.get(type, declarator.hasArraySuffix, arraySize), IrVariable::Storage::Local);
+		// Only the declaration writes a const local, and every read comes after it.
+		variable->readOnly = statement.declaration.type.isConst;
+		IrInstruction *declare = ctx.builder.append(IrOpcode::Declare, ctx.builder.voidType(), std::move(operands));
+		declare->variable = variable;
 	}
+}
 
-	if (method == "step" && hasArgs(1))
+void ConverterImpl::lowerLoop(IrLoweringContext &ctx, const Expression *condition, const Statement &body,
+    const Expression *increment, bool isPostTest) const
+{
+	IrBuilder &builder = ctx.builder;
+	IrInstruction *loop = builder.structured(IrOpcode::Loop, 3);
+	loop->isPostTest = isPostTest;
+	IrBlock &outer = builder.block();
+	lowerStatementInto(ctx, *loop->blocks[1], body);
+	if (condition)
 	{
-		return "step(" + arguments[0] + ", " + objectExpr + ")";
+		builder.setBlock(*loop->blocks[0]);
+		IrInstruction *value = lowerExpression(ctx, *condition);
+		builder.append(IrOpcode::BreakUnless, builder.voidType(), {value});
 	}
-
-	if (method == "smoothstep" && hasArgs(2))
+	if (increment)
 	{
-		return "smoothstep(" + arguments[0] + ", " + arguments[1] + ", " + objectExpr + ")";
+		builder.setBlock(*loop->blocks[2]);
+		lowerExpression(ctx, *increment);
 	}
-
-	return std::nullopt;
+	builder.setBlock(outer);
 }
 
-std::optional<std::string> ConverterImpl::emitVectorBuiltinCall(
-    const std::string &typeName,
-    const std::string &method,
-    const std::string &objectExpr,
-    const std::vector<std::string> &arguments) const
+IrInstruction *ConverterImpl::lowerExpression(IrLoweringContext &ctx, const Expression &expression) const
 {
-	const auto hasArgs = [&](std::size_t expected) { return arguments.size() == expected; };
-
-	if (method == "dot" && hasArgs(1))
-	{
-		return "dot(" + objectExpr + ", " + arguments[0] + ")";
-	}
-	if (method == "length" && hasArgs(0))
-	{
-		return "length(" + objectExpr + ")";
-	}
-	if (method == "distance" && hasArgs(1))
-	{
-		return "distance(" + objectExpr + ", " + arguments[0] + ")";
-	}
-	if (method == "normalize" && hasArgs(0))
-	{
-		return "normalize(" + objectExpr + ")";
-	}
-	if (method == "cross" && typeName == "Vector3" && hasArgs(1))
-	{
-		return "cross(" + objectExpr + ", " + arguments[0] + ")";
-	}
-	if (method == "reflect" && hasArgs(1))
-	{
-		return "reflect(" + objectExpr + ", " + arguments[0] + ")";
-	}
-	if ((method == "abs" || method == "floor" || method == "ceil" || method == "fract" || method == "exp" ||
-	        method == "log" || method == "exp2" || method == "log2" || method == "sqrt" || method == "inversesqrt" ||
-	        method == "sin" || method == "cos" || method == "tan" || method == "asin" || method == "acos" ||
-	        method == "atan") &&
-	    hasArgs(0))
+	IrBuilder &builder = ctx.builder;
+	if (const auto folded = foldedExpressions.find(&expression); folded != foldedExpressions.end())
 	{
-		return method + "(" + objectExpr + ")";
+		return builder.constant(irExpressionType(ctx, expression), folded->second.glsl);
 	}
-	if ((method == "mod" || method == "min" || method == "max" || method == "pow") && hasArgs(1))
+	if (const auto hoisted = hoistedExpressions.find(&expression); hoisted != hoistedExpressions.end())
 	{
-		return method + "(" + objectExpr + ", " + arguments[0] + ")";
+		const DerivedBlockField &field = derivedFields[hoisted->second];
+		const AggregateInfo &block = *findAggregateInfo(field.block);
+		IrVariable *variable = ctx.module.global(
+		    block.glslInstanceName, IrVariable::Storage::Block, ctx.module.types.get(block.glslTypeName), true);
+		return builder.load(builder.address(*variable, irExpressionType(ctx, expression), {IrAccess{field.name}}));
 	}
-	if (method == "clamp" && hasArgs(2))
+	if (const auto moved = movedExpressions.find(&expression);
+	    ctx.emission.readsMovedVaryings && moved != movedExpressions.end())
 	{
-		return "clamp(" + objectExpr + ", " + arguments[0] + ", " + arguments[1] + ")";
+		const IrType *type = irExpressionType(ctx, expression);
+		IrVariable *variable =
+		    ctx.module.global(movedVaryings[moved->second].varying.name, IrVariable::Storage::Input, type, true);
+		return builder.load(builder.address(*variable, type));
 	}
-	if (method == "lerp" && hasArgs(2))
+	const auto increment = [&](const Expression &operand, bool isPostfix, bool isDecrement) {
+		IrInstruction *address = lowerAddress(ctx, operand);
+		if (!address)
+		{
+			throw IrUnsupported{};
+		}
+		IrInstruction *instruction = builder.append(IrOpcode::Increment, address->type, {address});
+		instruction->isPostfix = isPostfix;
+		instruction->isDecrement = isDecrement;
+		return instruction;
+	};
+
+	switch (expression.kind)
 	{
-		return "mix(" + objectExpr + ", " + arguments[0] + ", " + arguments[1] + ")";
+		case Expression::Kind::Literal:
+			return builder.constant(
+			    irExpressionType(ctx, expression), static_cast<const LiteralExpression &>(expression).literal.content);
+		case Expression::Kind::ArrayLiteral:
+		{
+			const auto &literal = static_cast<const ArrayLiteralExpression &>(expression);
+			const auto infoIt = expressionInfo.find(&literal);
+			if (infoIt == expressionInfo.end() || infoIt->second.typeName.empty())
+			{
+				throw IrUnsupported{};
+			}
+			const std::optional<std::size_t> size =
+			    infoIt->second.hasArraySize ? infoIt->second.arraySize : std::optional<std::size_t>{};
+			std::vector<IrInstruction *> elements;
+			for (const std::unique_ptr<Expression> &element : literal.elements)
+			{
+				if (!element)
+				{
+					throw IrUnsupported{};
+				}
+				elements.push_back(lowerExpression(ctx, *element));
+			}
+			const IrType *type = ctx.module.types.get(typeToGLSL(infoIt->second.typeName), true, size);
+			IrInstruction *construct = builder.append(IrOpcode::Construct, type, std::move(elements));
+			construct->text = type->spelling();
+			return construct;
+		}
+		case Expression::Kind::Identifier:
+			return builder.load(lowerAddress(ctx, expression));
+		case Expression::Kind::Unary:
+		{
+			const auto &unary = static_cast<const UnaryExpression &>(expression);
+			if (unary.op == UnaryOperator::PreIncrement || unary.op == UnaryOperator::PreDecrement)
+			{
+				return increment(*unary.operand, false, unary.op == UnaryOperator::PreDecrement);
+			}
+			IrInstruction *operand = lowerExpression(ctx, *unary.operand);
+			IrInstruction *instruction = builder.append(IrOpcode::Unary, irExpressionType(ctx, expression), {operand});
+			instruction->unaryOperator = unary.op;
+			return instruction;
+		}
+		case Expression::Kind::Binary:
+		{
+			const auto &binary = static_cast<const BinaryExpression &>(expression);
+			// Both sides of a Binary are evaluated, so a right side that short-circuiting may skip must be pure.
+			if ((binary.op == BinaryOperator::LogicalAnd || binary.op == BinaryOperator::LogicalOr) &&
+			    !isPureExpression(ctx.emission, *binary.right))
+			{
+				return lowerOpaque(ctx, expression);
+			}
+			if (const std::vector<const Expression *> factors = matrixChainFactors(binary); !factors.empty())
+			{
+				// Lumina matrices are square, so every partial product has the type of the whole chain.
+				std::vector<IrInstruction *> values;
+				for (const Expression *factor : factors)
+				{
+					values.push_back(lowerExpression(ctx, *factor));
+				}
+				IrInstruction *product = values.back();
+				for (std::size_t i = values.size() - 1; i-- > 0;)
+				{
+					product = builder.binary(BinaryOperator::Multiply, irExpressionType(ctx, expression), values[i], product);
+				}
+				return product;
+			}
+			IrInstruction *left = lowerExpression(ctx, *binary.left);
+			IrInstruction *right = lowerExpression(ctx, *binary.right);
+			return builder.binary(binary.op, irExpressionType(ctx, expression), left, right);
+		}
+		case Expression::Kind::Assignment:
+			return lowerAssignment(ctx, static_cast<const AssignmentExpression &>(expression));
+		case Expression::Kind::Conditional:
+		{
+			const auto &conditional = static_cast<const ConditionalExpression &>(expression);
+			if (!isPureExpression(ctx.emission, *conditional.thenBranch) ||
+			    !isPureExpression(ctx.emission, *conditional.elseBranch))
+			{
+				return lowerOpaque(ctx, expression);
+			}
+			IrInstruction *condition = lowerExpression(ctx, *conditional.condition);
+			IrInstruction *thenValue = lowerExpression(ctx, *conditional.thenBranch);
+			IrInstruction *elseValue = lowerExpression(ctx, *conditional.elseBranch);
+			return builder.append(
+			    IrOpcode::Select, irExpressionType(ctx, expression), {condition, thenValue, elseValue});
+		}
+		case Expression::Kind::Call:
+			return lowerCall(ctx, static_cast<const CallExpression &>(expression));
+		case Expression::Kind::MemberAccess:
+		{
+			const auto &member = static_cast<const MemberExpression &>(expression);
+			if (IrInstruction *address = lowerAddress(ctx, expression))
+			{
+				return builder.load(address);
+			}
+			const auto infoIt = expressionInfo.find(member.object.get());
+			if (safeTokenContent(member.member) == "size" && infoIt != expressionInfo.end() &&
+			    infoIt->second.isArray && !infoIt->second.hasArraySize)
+			{
+				return lowerOpaque(ctx, expression);
+			}
+			IrInstruction *object = lowerExpression(ctx, *member.object);
+			IrInstruction *extract = builder.append(IrOpcode::Extract, irExpressionType(ctx, expression), {object});
+			extract->accesses.push_back(IrAccess{safeTokenContent(member.member)});
+			return extract;
+		}
+		case Expression::Kind::IndexAccess:
+		{
+			const auto &index = static_cast<const IndexExpression &>(expression);
+			if (IrInstruction *address = lowerAddress(ctx, expression))
+			{
+				return builder.load(address);
+			}
+			IrInstruction *object = lowerExpression(ctx, *index.object);
+			IrInstruction *position = lowerExpression(ctx, *index.index);
+			IrInstruction *extract =
+			    builder.append(IrOpcode::Extract, irExpressionType(ctx, expression), {object, position});
+			extract->accesses.push_back(IrAccess{{}, true});
+			return extract;
+		}
+		case Expression::Kind::Postfix:
+		{
+			const auto &postfix = static_cast<const PostfixExpression &>(expression);
+			return increment(*postfix.operand, true, postfix.op == PostfixOperator::Decrement);
+		}
 	}
-	if (method == "step" && hasArgs(1))
+	throw IrUnsupported{};
+}
+
+IrInstruction *ConverterImpl::lowerAddress(IrLoweringContext &ctx, const Expression &expression) const
+{
+	// Walks the access chain down to the variable it starts from.
+	std::vector<const Expression *> chain;
+	const Expression *root = &expression;
+	while (root->kind == Expression::Kind::MemberAccess || root->kind == Expression::Kind::IndexAccess)
 	{
-		return "step(" + arguments[0] + ", " + objectExpr + ")";
+		if (root->kind == Expression::Kind::MemberAccess)
+		{
+			const auto &member = static_cast<const MemberExpression &>(*root);
+			const auto infoIt = expressionInfo.find(member.object.get());
+			if (safeTokenContent(member.member) == "size" && infoIt != expressionInfo.end() &&
+			    infoIt->second.isArray && !infoIt->second.hasArraySize)
+			{
+				return nullptr;
+			}
+			chain.push_back(root);
+			root = member.object.get();
+		}
+		else
+		{
+			chain.push_back(root);
+			root = static_cast<const IndexExpression &>(*root).object.get();
+		}
 	}
-	if (method == "smoothstep" && hasArgs(2))
+	if (root->kind != Expression::Kind::Identifier)
 	{
-		return "smoothstep(" + arguments[0] + ", " + arguments[1] + ", " + objectExpr + ")";
+		return nullptr;
 	}
-	if (method == "saturate" && isColorTypeName(typeName) && hasArgs(0))
+
+	IrVariable *variable = irVariable(ctx, static_cast<const IdentifierExpression &>(*root));
+	std::vector<IrAccess> accesses;
+	std::vector<IrInstruction *> indices;
+	for (auto it = chain.rbegin(); it != chain.rend(); ++it)
 	{
-		return "clamp(" + objectExpr + ", 0.0, 1.0)";
+		if ((*it)->kind == Expression::Kind::MemberAccess)
+		{
+			accesses.push_back(IrAccess{safeTokenContent(static_cast<const MemberExpression &>(**it).member)});
+		}
+		else
+		{
+			accesses.push_back(IrAccess{{}, true});
+			indices.push_back(lowerExpression(ctx, *static_cast<const IndexExpression &>(**it).index));
+		}
 	}
-
-	return std::nullopt;
+	const IrType *type = chain.empty() ? variable->type : irExpressionType(ctx, expression);
+	return ctx.builder.address(*variable, type, std::move(accesses), std::move(indices));
 }
 
-std::string ConverterImpl::emitMember(const MemberExpression &member) const
+IrInstruction *ConverterImpl::lowerArgument(IrLoweringContext &ctx, const Expression &expression) const
 {
-	if (std::optional<std::string> sizeAccess = emitSSBOArraySizeAccess(member))
+	// Places are passed as addresses, which inout parameters need.
+	if (IrInstruction *address = lowerAddress(ctx, expression))
 	{
-		return *sizeAccess;
+		return address;
 	}
-	return emitExpression(*member.object) + "." + safeTokenContent(member.member);
-}
-
-std::string ConverterImpl::emitIndex(const IndexExpression &index) const
-{
-	return emitExpression(*index.object) + "[" + emitExpression(*index.index) + "]";
-}
-
-std::string ConverterImpl::emitPostfix(const PostfixExpression &postfix) const
-{
-	const std::string op = (postfix.op == PostfixOperator::Increment) ? "++" : "--";
-	return emitExpression(*postfix.operand) + op;
+	return lowerExpression(ctx, expression);
 }
 
-std::optional<std::string> ConverterImpl::emitSSBOArraySizeAccess(const MemberExpression &member) const
+IrInstruction *ConverterImpl::lowerAssignment(IrLoweringContext &ctx, const AssignmentExpression &assignment) const
 {
-	if (safeTokenContent(member.member) != "size")
-	{
-		return std::nullopt;
-	}
-	if (!member.object)
-	{
-		return std::nullopt;
-	}
-
-	auto infoIt = expressionInfo.find(member.object.get());
-	if (infoIt == expressionInfo.end())
+	IrInstruction *address = lowerAddress(ctx, *assignment.target);
+	if (!address)
 	{
-		return std::nullopt;
+		throw IrUnsupported{};
 	}
-	if (!infoIt->second.isArray || infoIt->second.hasArraySize)
+	IrInstruction *value = lowerExpression(ctx, *assignment.value);
+	if (const std::optional<BinaryOperator> op = compoundAssignmentOperator(assignment.op))
 	{
-		return std::nullopt;
+		value = ctx.builder.binary(*op, address->type, ctx.builder.load(address), value);
 	}
+	ctx.builder.store(address, value);
+	return value;
+}
 
-	std::string blockName;
-	std::string arrayName;
+IrInstruction *ConverterImpl::lowerCall(IrLoweringContext &ctx, const CallExpression &call) const
+{
+	IrBuilder &builder = ctx.builder;
+	const IrType *type = irExpressionType(ctx, call);
+	const auto append = [&](IrOpcode opcode, std::string text, std::vector<IrInstruction *> operands) {
+		IrInstruction *instruction = builder.append(opcode, type, std::move(operands));
+		instruction->text = std::move(text);
+		return instruction;
+	};
 
-	if (const auto *arrayIdentifier = dynamic_cast<const IdentifierExpression *>(member.object.get()))
+	if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
 	{
-		if (!currentMethodAggregate || !currentMethodAggregate->isSSBO ||
-		    (currentMethodAggregate->kind != AggregateInstruction::Kind::ConstantBlock &&
-		        currentMethodAggregate->kind != AggregateInstruction::Kind::AttributeBlock))
-		{
-			return std::nullopt;
-		}
-		if (arrayIdentifier->name.parts.size() != 1)
-		{
-			return std::nullopt;
-		}
-		if (currentMethodSelfName.empty())
-		{
-			return std::nullopt;
-		}
-		const std::string simple = safeTokenContent(arrayIdentifier->name.parts.front());
-		const std::string sanitizedField = sanitizeIdentifier(simple);
-		if (currentMethodAggregate->fieldNames.find(sanitizedField) == currentMethodAggregate->fieldNames.end())
+		const std::string method = safeTokenContent(member->member);
+		const auto infoIt = expressionInfo.find(member->object.get());
+		const std::string objectType = (infoIt != expressionInfo.end()) ? infoIt->second.typeName : std::string{};
+		if (objectType == "Texture" && method == "getPixel" && !call.arguments.empty())
 		{
-			return std::nullopt;
+			IrInstruction *texture = lowerAddress(ctx, *member->object);
+			if (!texture)
+			{
+				throw IrUnsupported{};
+			}
+			return append(IrOpcode::CallBuiltin, "texture", {texture, lowerExpression(ctx, *call.arguments.front())});
 		}
-		blockName = currentMethodSelfName;
-		arrayName = sanitizedField;
-	}
-	else if (const auto *arrayMember = dynamic_cast<const MemberExpression *>(member.object.get()))
-	{
-		if (!arrayMember->object)
+
+		std::optional<BuiltinCall> builtin;
+		if (isFloatTypeName(objectType))
 		{
-			return std::nullopt;
+			builtin = floatBuiltinCall(method, call.arguments.size());
 		}
-		const auto *rootIdentifier = dynamic_cast<const IdentifierExpression *>(arrayMember->object.get());
-		if (!rootIdentifier)
+		else if (isFloatVectorTypeName(objectType))
 		{
-			return std::nullopt;
+			builtin = vectorBuiltinCall(objectType, method, call.arguments.size());
 		}
-		auto aggregateKey = resolveAggregateQualifiedName(rootIdentifier->name);
-		if (!aggregateKey)
+		if (builtin)
 		{
-			return std::nullopt;
+			std::vector<IrInstruction *> operands;
+			if (!builtin->objectLast)
+			{
+				operands.push_back(lowerExpression(ctx, *member->object));
+			}
+			for (const std::unique_ptr<Expression> &argument : call.arguments)
+			{
+				operands.push_back(lowerExpression(ctx, *argument));
+			}
+			if (builtin->objectLast)
+			{
+				operands.push_back(lowerExpression(ctx, *member->object));
+			}
+			std::istringstream trailing(builtin->trailing);
+			for (std::string constant; std::getline(trailing, constant, ',');)
+			{
+				constant.erase(0, constant.find_first_not_of(' '));
+				if (!constant.empty())
+				{
+					operands.push_back(builder.constant(ctx.module.types.get("float"), constant));
+				}
+			}
+			return append(IrOpcode::CallBuiltin, builtin->function, std::move(operands));
 		}
-		const AggregateInfo *aggregate = findAggregateInfo(*aggregateKey);
-		if (!aggregate || !aggregate->isSSBO ||
-		    (aggregate->kind != AggregateInstruction::Kind::ConstantBlock &&
-		        aggregate->kind != AggregateInstruction::Kind::AttributeBlock))
+
+		if (const auto typeIt = methodCallHelpers.find(objectType); typeIt != methodCallHelpers.end())
 		{
-			return std::nullopt;
+			if (const auto helperIt = typeIt->second.find(method); helperIt != typeIt->second.end())
+			{
+				const AggregateInfo *aggregate = findAggregateInfo(objectType);
+				std::vector<IrInstruction *> operands;
+				if (!aggregate || aggregate->kind == AggregateInstruction::Kind::Struct)
+				{
+					operands.push_back(lowerArgument(ctx, *member->object));
+				}
+				for (const std::unique_ptr<Expression> &argument : call.arguments)
+				{
+					operands.push_back(lowerArgument(ctx, *argument));
+				}
+				return append(IrOpcode::Call, helperIt->second.helperName, std::move(operands));
+			}
 		}
-		blockName = remapIdentifier(rootIdentifier->name);
-		arrayName = sanitizeIdentifier(safeTokenContent(arrayMember->member));
+		return lowerOpaque(ctx, call);
 	}
 
-	if (blockName.empty() || arrayName.empty())
+	if (const auto *identifier = dynamic_cast<const IdentifierExpression *>(call.callee.get()))
 	{
-		return std::nullopt;
+		const std::string name = joinName(identifier->name);
+		const std::string builtinType = convertLuminaType(name);
+		const std::string callee = builtinType != name ? builtinType : remapIdentifier(ctx.emission, identifier->name);
+		const bool isConstructor = builtinType != name || name == "float" || name == "int" || name == "uint" ||
+		                           name == "bool" ||
+		                           resolveAggregateQualifiedName(ctx.emission, identifier->name).has_value();
+		const bool isBuiltin = identifier->name.parts.size() == 1 && callee == name && isBuiltinFunctionName(name);
+		std::vector<IrInstruction *> operands;
+		for (const Expression *argument : constructorArguments(ctx.emission, *identifier, call))
+		{
+			operands.push_back(
+			    (isConstructor || isBuiltin) ? lowerExpression(ctx, *argument) : lowerArgument(ctx, *argument));
+		}
+		const IrOpcode opcode = isConstructor ? IrOpcode::Construct : isBuiltin ? IrOpcode::CallBuiltin : IrOpcode::Call;
+		return append(opcode, callee, std::move(operands));
 	}
 
-	const std::string sizeName = "spk_" + blockName + "_" + arrayName + "_size";
-	return blockName + "." + sizeName;
-}
-
-std::string ConverterImpl::typeToGLSL(const TypeName &type) const
-{
-	return sanitizeIdentifier(convertLuminaType(joinName(type.name)));
+	return lowerOpaque(ctx, call);
 }
 
-std::string ConverterImpl::typeToGLSL(const std::string &typeName) const
+IrInstruction *ConverterImpl::lowerOpaque(IrLoweringContext &ctx, const Expression &expression) const
 {
-	return sanitizeIdentifier(convertLuminaType(typeName));
+	EmissionContext scratch;
+	scratch.namespaceStack = ctx.emission.namespaceStack;
+	emitExpression(scratch, expression);
+	IrInstruction *opaque = ctx.builder.append(IrOpcode::Opaque, irExpressionType(ctx, expression));
+	opaque->text = std::move(scratch.out).str();
+	return opaque;
 }
 
-bool ConverterImpl::aggregateHasUnsizedArray(const AggregateInstruction &aggregate) const
+IrVariable *ConverterImpl::irVariable(IrLoweringContext &ctx, const IdentifierExpression &identifier) const
 {
-	for (const std::unique_ptr<StructMember> &member : aggregate.members)
+	if (identifier.name.parts.size() == 1)
 	{
-		if (!member || member->kind != StructMember::Kind::Field)
+		if (IrVariable *local = ctx.findLocal(safeTokenContent(identifier.name.parts.front())))
 		{
-			continue;
+			return local;
 		}
+	}
 
-		const auto &field = static_cast<const FieldMember &>(*member);
-		for (const VariableDeclarator &declarator : field.declaration.declarators)
-		{
-			if (declarator.hasArraySuffix && !declarator.hasArraySize)
-			{
-				return true;
-			}
-		}
+	const std::string name = remapIdentifier(ctx.emission, identifier.name);
+	if (const auto it = ctx.module.globalLookup.find(name); it != ctx.module.globalLookup.end())
+	{
+		return it->second;
+	}
+	const auto infoIt = expressionInfo.find(&identifier);
+	if (infoIt == expressionInfo.end())
+	{
+		throw IrUnsupported{};
 	}
-	return false;
-}
 
-std::string ConverterImpl::aggregateTypeName(const AggregateInfo &info) const
-{
-	return info.glslTypeName;
+	IrVariable::Storage storage = IrVariable::Storage::Global;
+	bool readOnly = infoIt->second.isConst;
+	const std::optional<std::string> aggregate = resolveAggregateQualifiedName(ctx.emission, identifier.name);
+	const AggregateInfo *block = aggregate ? findAggregateInfo(*aggregate) : nullptr;
+	if (infoIt->second.typeName == "Texture")
+	{
+		storage = IrVariable::Storage::Texture;
+		readOnly = true;
+	}
+	else if (block && block->kind != AggregateInstruction::Kind::Struct)
+	{
+		storage = IrVariable::Storage::Block;
+		readOnly = !block->isSSBO;
+	}
+	else if (ctx.inputs.count(name) != 0 || (name.rfind("gl_", 0) == 0 && name != "gl_Position"))
+	{
+		storage = IrVariable::Storage::Input;
+		readOnly = true;
+	}
+	else if (ctx.outputs.count(name) != 0 || name == "gl_Position")
+	{
+		storage = IrVariable::Storage::Output;
+		readOnly = false;
+	}
+	return ctx.module.global(name, storage, irExpressionType(ctx, identifier), readOnly);
 }
 
-void ConverterImpl::emitMethodHelper(std::ostringstream &oss, const AggregateInfo &info, const MethodHelper &helper) const
+const IrType *ConverterImpl::irExpressionType(IrLoweringContext &ctx, const Expression &expression) const
 {
-	if (!helper.node || !helper.node->body)
+	const auto infoIt = expressionInfo.find(&expression);
+	if (infoIt == expressionInfo.end() || infoIt->second.typeName.empty())
 	{
-		return;
+		throw IrUnsupported{};
 	}
+	const SemanticParseResult::ExpressionInfo &info = infoIt->second;
+	return ctx.module.types.get(
+	    typeToGLSL(info.typeName), info.isArray, info.hasArraySize ? info.arraySize : std::optional<std::size_t>{});
+}
 
-	oss << typeToGLSL(helper.node->returnType) << " " << helper.helperName << "(";
-	bool first = true;
-	const bool isStructAggregate = info.kind == AggregateInstruction::Kind::Struct;
-	const bool needsSelfParameter = isStructAggregate;
-	const std::string aggregateType = aggregateTypeName(info);
-	if (needsSelfParameter)
+bool ConverterImpl::isPureExpression(const EmissionContext &context, const Expression &expression) const
+{
+	const auto pure = [&](const std::unique_ptr<Expression> &child) {
+		return child && isPureExpression(context, *child);
+	};
+	switch (expression.kind)
 	{
-		if (!helper.isConst)
+		case Expression::Kind::Literal:
+		case Expression::Kind::Identifier:
+			return true;
+		case Expression::Kind::ArrayLiteral:
 		{
-			oss << "inout ";
+			const auto &literal = static_cast<const ArrayLiteralExpression &>(expression);
+			return std::all_of(literal.elements.begin(), literal.elements.end(), pure);
 		}
-		else
+		case Expression::Kind::Unary:
 		{
-			oss << "const ";
+			const auto &unary = static_cast<const UnaryExpression &>(expression);
+			return unary.op != UnaryOperator::PreIncrement && unary.op != UnaryOperator::PreDecrement &&
+			       pure(unary.operand);
 		}
-		oss << aggregateType << " " << kMethodSelfName;
-		first = false;
-	}
-	for (const Parameter &param : helper.node->parameters)
-	{
-		if (!first)
+		case Expression::Kind::Binary:
 		{
-			oss << ", ";
+			const auto &binary = static_cast<const BinaryExpression &>(expression);
+			return pure(binary.left) && pure(binary.right);
 		}
-		if (param.isReference)
+		case Expression::Kind::Conditional:
 		{
-			oss << "inout ";
+			const auto &conditional = static_cast<const ConditionalExpression &>(expression);
+			return pure(conditional.condition) && pure(conditional.thenBranch) && pure(conditional.elseBranch);
 		}
-		else if (param.type.isConst)
+		case Expression::Kind::Call:
+		{
+			// Constructors and builtins; user functions and methods may write anything.
+			const auto &call = static_cast<const CallExpression &>(expression);
+			if (!std::all_of(call.arguments.begin(), call.arguments.end(), pure))
+			{
+				return false;
+			}
+			if (const auto *member = dynamic_cast<const MemberExpression *>(call.callee.get()))
+			{
+				const auto infoIt = expressionInfo.find(member->object.get());
+				if (infoIt == expressionInfo.end() || !pure(member->object))
+				{
+					return false;
+				}
+				const std::string &objectType = infoIt->second.typeName;
+				const std::string method = safeTokenContent(member->member);
+				return (objectType == "Texture" && method == "getPixel") ||
+				       (isFloatTypeName(objectType) && floatBuiltinCall(method, call.arguments.size())) ||
+				       (isFloatVectorTypeName(objectType) &&
+				           vectorBuiltinCall(objectType, method, call.arguments.size()));
+			}
+			if (const auto *identifier = dynamic_cast<const IdentifierExpression *>(call.callee.get()))
+			{
+				const std::string name = joinName(identifier->name);
+				return convertLuminaType(name) != name || name == "float" || name == "int" || name == "uint" ||
+				       name == "bool" || resolveAggregateQualifiedName(context, identifier->name).has_value() ||
+				       (identifier->name.parts.size() == 1 && isBuiltinFunctionName(name) &&
+				           remapIdentifier(context, identifier->name) == name);
+			}
+			return false;
+		}
+		case Expression::Kind::MemberAccess:
+			return pure(static_cast<const MemberExpression &>(expression).object);
+		case Expression::Kind::IndexAccess:
 		{
-			oss << "const ";
+			const auto &index = static_cast<const IndexExpression &>(expression);
+			return pure(index.object) && pure(index.index);
 		}
-		oss << typeToGLSL(param.type) << " " << parameterName(param.name);
-		first = false;
-	}
-	oss << ")\n{\n";
-	currentMethodAggregate = &info;
-	currentMethodParameters.clear();
-	methodLocalNameStack.clear();
-	currentMethodSelfName = needsSelfParameter ? std::string(kMethodSelfName) : info.glslInstanceName;
-	currentMethodUsesSelfParameter = needsSelfParameter;
-	for (const Parameter &param : helper.node->parameters)
-	{
-		currentMethodParameters.insert(safeTokenContent(param.name));
+		case Expression::Kind::Assignment:
+		case Expression::Kind::Postfix:
+			return false;
 	}
-	thisAliasStack.push_back(currentMethodSelfName);
-	pushEmissionNamespace(info.namespacePath);
-	emitBlockStatement(oss, *helper.node->body, 1);
-	popEmissionNamespace();
-	thisAliasStack.pop_back();
-	methodLocalNameStack.clear();
-	currentMethodParameters.clear();
-	currentMethodAggregate = nullptr;
-	currentMethodSelfName.clear();
-	currentMethodUsesSelfParameter = false;
-	oss << "}\n\n";
+	return false;
 }
 
-std::optional<std::string> ConverterImpl::emitUserMethodCall(const MemberExpression &member, const CallExpression &call) const
+std::string ConverterImpl::emitStageSource(const StageFunctionInstruction *stage, Stage stageKind,
+    const std::vector<StageIO> &inputs, const std::vector<StageIO> &outputs, const StageUsage &usage,
+    std::string &irDump) const
 {
-	auto infoIt = expressionInfo.find(member.object.get());
-	if (infoIt == expressionInfo.end())
-	{
-		return std::nullopt;
-	}
-
-	const std::string objectType = infoIt->second.typeName;
-	const std::string methodName = safeTokenContent(member.member);
-	auto typeIt = methodCallHelpers.find(objectType);
-	if (typeIt == methodCallHelpers.end())
-	{
-		return std::nullopt;
-	}
-	auto helperIt = typeIt->second.find(methodName);
-	if (helperIt == typeIt->second.end())
-	{
-		return std::nullopt;
+	TraceSpan span("codegen", "convert", stageKind == Stage::VertexPass ? "VertexPass" : "FragmentPass");
+	EmissionContext context;
+	context.readsMovedVaryings = stageKind == Stage::FragmentPass;
+	if (input.options.useIr)
+	{
+		lowerStageToIr(context, stage, stageKind, inputs, outputs, usage);
+		const std::vector<std::string> report = defaultIrPipeline().run(*context.irModule);
+		if (input.options.debug)
+		{
+			std::ostringstream dump;
+			printIr(*context.irModule, dump);
+			for (const std::string &remark : report)
+			{
+				dump << "; " << remark << "\n";
+			}
+			irDump = dump.str();
+		}
 	}
-
-	const AggregateInfo *aggregateInfo = findAggregateInfo(objectType);
-	const bool needsSelfArgument =
-	    !aggregateInfo || aggregateInfo->kind == AggregateInstruction::Kind::Struct;
-
-	std::ostringstream oss;
-	oss << helperIt->second.helperName << "(";
-	bool first = true;
-	if (needsSelfArgument)
+	context.out << "#version 450 core\n"
+	            << "#extension GL_NV_uniform_buffer_std430_layout : enable\n\n";
+	emitInterface(context, inputs, "in");
+	emitInterface(context, outputs, "out");
+	if (stageKind == Stage::VertexPass && !privateVaryings.empty())
 	{
-		oss << emitExpression(*member.object);
-		first = false;
+		for (const StageIO &varying : privateVaryings)
+		{
+			context.out << typeToGLSL(varying.type) << " " << varying.name << ";\n";
+		}
+		context.out << "\n";
 	}
-	for (const std::unique_ptr<Expression> &argument : call.arguments)
+	if (stageKind == Stage::FragmentPass && !fragmentBuiltinCopies.empty())
 	{
-		if (!first)
+		for (const BuiltinCopy &copy : fragmentBuiltinCopies)
 		{
-			oss << ", ";
+			context.out << "uint " << copy.name << ";\n";
 		}
-		oss << emitExpression(*argument);
-		first = false;
+		context.out << "\n";
 	}
-	oss << ")";
-	return oss.str();
+	emitCommon(context, usage);
+	emitStage(context, stage, stageKind);
+	return std::move(context.out).str();
 }
 
-std::optional<std::string> ConverterImpl::emitImplicitSelfCall(const IdentifierExpression &identifier, const CallExpression &call) const
+ShaderSources ConverterImpl::run()
 {
-	if (!currentMethodAggregate || identifier.name.parts.size() != 1)
-	{
-		return std::nullopt;
-	}
+	const bool parallel =
+	    expressionInfo.size() >= kParallelEmissionThreshold && std::thread::hardware_concurrency() > 1;
 
-	const std::string methodName = identifier.name.parts.front().content;
-	auto typeIt = methodCallHelpers.find(currentMethodAggregate->qualifiedName);
-	if (typeIt == methodCallHelpers.end())
 	{
-		return std::nullopt;
+		PassTimer foldingTimer("constant folding");
+		foldConstants();
 	}
-	auto helperIt = typeIt->second.find(methodName);
-	if (helperIt == typeIt->second.end())
+	if (input.options.hoistUniformExpressions)
 	{
-		return std::nullopt;
+		PassTimer hoistingTimer("uniform expression hoisting");
+		hoistUniformExpressions();
 	}
-
-	std::ostringstream oss;
-	oss << helperIt->second.helperName << "(";
-	bool first = true;
-	if (currentMethodUsesSelfParameter && !currentMethodSelfName.empty())
+	if (input.options.moveAffineToVertex)
 	{
-		oss << currentMethodSelfName;
-		first = false;
+		PassTimer motionTimer("fragment-to-vertex motion");
+		moveAffineExpressionsToVertex();
 	}
-	for (const std::unique_ptr<Expression> &argument : call.arguments)
 	{
-		if (!first)
+		PassTimer livenessTimer("varying liveness");
+		std::vector<StageIO> varyings = stageVaryings;
+		for (const MovedVarying &moved : movedVaryings)
 		{
-			oss << ", ";
+			varyings.push_back(moved.varying);
 		}
-		oss << emitExpression(*argument);
-		first = false;
+		eliminateDeadVaryings(varyings);
 	}
-	oss << ")";
-	return oss.str();
-}
-
-ShaderSources ConverterImpl::run()
-{
-	ShaderSources sources;
-	const StageUsage vertexUsage = collectStageUsage(vertexStage);
-	const StageUsage fragmentUsage = collectStageUsage(fragmentStage);
-
+	if (input.options.packVaryings)
+	{
+		PassTimer packingTimer("varying packing");
+		packVaryings();
+	}
+	for (MovedVarying &moved : movedVaryings)
 	{
-		std::ostringstream vertex;
-		vertex << "#version 450 core\n"
-		       << "#extension GL_NV_uniform_buffer_std430_layout : enable\n\n";
-		emitInterface(vertex, input.vertexInputs, "in");
-		emitInterface(vertex, input.stageVaryings, "out");
-		emitCommon(vertex, vertexUsage);
-		emitStage(vertex, vertexStage, Stage::VertexPass);
-		sources.vertex = vertex.str();
+		for (const StageIO &varying : liveVaryings)
+		{
+			if (varying.name == moved.varying.name)
+			{
+				moved.varying = varying;
+			}
+		}
 	}
 
+	StageUsage vertexUsage;
+	StageUsage fragmentUsage;
 	{
-		std::ostringstream fragment;
-		fragment << "#version 450 core\n"
-		         << "#extension GL_NV_uniform_buffer_std430_layout : enable\n\n";
-		emitInterface(fragment, input.stageVaryings, "in");
-		emitInterface(fragment, input.fragmentOutputs, "out");
-		emitCommon(fragment, fragmentUsage);
-		emitStage(fragment, fragmentStage, Stage::FragmentPass);
-		sources.fragment = fragment.str();
+		PassTimer usageTimer("stage usage collection");
+		runStageTasks(
+		    parallel,
+		    [&]() { vertexUsage = collectStageUsage(vertexStage); },
+		    [&]() { fragmentUsage = collectStageUsage(fragmentStage); });
 	}
 
+	PassTimer emissionTimer("GLSL emission");
+	ShaderSources sources;
+	runStageTasks(
+	    parallel,
+	    [&]() {
+		    sources.vertex = emitStageSource(
+		        vertexStage, Stage::VertexPass, input.vertexInputs, liveVaryings, vertexUsage, sources.vertexIr);
+	    },
+	    [&]() {
+		    sources.fragment = emitStageSource(fragmentStage, Stage::FragmentPass, liveVaryings, input.fragmentOutputs,
+		        fragmentUsage, sources.fragmentIr);
+	    });
+	sources.derivedFields = derivedFields;
+	sources.movedVaryings = movedVaryings;
+	sources.varyings = liveVaryings;
 	return sources;
 }
 
@@ -0,0 +1,104 @@
+#include "pass_timing.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counting allocator behind lumina_bench, and behind --time-passes when Lumina is built with
+// LUMINA_COUNT_ALLOCATIONS. Each block stores its size in front of the user bytes, so deletes can be accounted
+// without relying on sized deallocation. Over-aligned allocations keep the default allocator. Never part of
+// lumina_core: embedders keep their own operator new.
+namespace
+{
+	constexpr std::size_t kAllocationHeader = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+	void *countedAllocate(std::size_t size) noexcept
+	{
+		void *block = std::malloc(size + kAllocationHeader);
+		if (!block)
+		{
+			return nullptr;
+		}
+		*static_cast<std::size_t *>(block) = size;
+		recordAllocation(size);
+		return static_cast<char *>(block) + kAllocationHeader;
+	}
+
+	void countedFree(void *pointer) noexcept
+	{
+		if (!pointer)
+		{
+			return;
+		}
+		char *block = static_cast<char *>(pointer) - kAllocationHeader;
+		recordDeallocation(*reinterpret_cast<std::size_t *>(block));
+		std::free(block);
+	}
+
+	void *countedAllocateOrThrow(std::size_t size)
+	{
+		while (true)
+		{
+			if (void *pointer = countedAllocate(size == 0 ? 1 : size))
+			{
+				return pointer;
+			}
+			std::new_handler handler = std::get_new_handler();
+			if (!handler)
+			{
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+}
+
+void *operator new(std::size_t p_size)
+{
+	return countedAllocateOrThrow(p_size);
+}
+
+void *operator new[](std::size_t p_size)
+{
+	return countedAllocateOrThrow(p_size);
+}
+
+void *operator new(std::size_t p_size, const std::nothrow_t &) noexcept
+{
+	return countedAllocate(p_size == 0 ? 1 : p_size);
+}
+
+void *operator new[](std::size_t p_size, const std::nothrow_t &) noexcept
+{
+	return countedAllocate(p_size == 0 ? 1 : p_size);
+}
+
+void operator delete(void *p_pointer) noexcept
+{
+	countedFree(p_pointer);
+}
+
+void operator delete[](void *p_pointer) noexcept
+{
+	countedFree(p_pointer);
+}
+
+void operator delete(void *p_pointer, std::size_t) noexcept
+{
+	countedFree(p_pointer);
+}
+
+void operator delete[](void *p_pointer, std::size_t) noexcept
+{
+	countedFree(p_pointer);
+}
+
+void operator delete(void *p_pointer, const std::nothrow_t &) noexcept
+{
+	countedFree(p_pointer);
+}
+
+void operator delete[](void *p_pointer, const std::nothrow_t &) noexcept
+{
+	countedFree(p_pointer);
+}
@@ -0,0 +1,424 @@
+#include "cpp_header_emitter.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	struct BuiltinShape
+	{
+		const char *component = "float";
+		int columns = 0;
+		int rows = 1;
+	};
+
+	std::optional<BuiltinShape> builtinShape(const std::string &typeName)
+	{
+		if (typeName == "float")
+		{
+			return BuiltinShape{"float", 0, 1};
+		}
+		if (typeName == "int")
+		{
+			return BuiltinShape{"std::int32_t", 0, 1};
+		}
+		if (typeName == "uint" || typeName == "bool")
+		{
+			return BuiltinShape{"std::uint32_t", 0, 1};
+		}
+		if (typeName == "Color")
+		{
+			return BuiltinShape{"float", 0, 4};
+		}
+
+		if (typeName.rfind("Vector", 0) == 0 && typeName.size() >= 7 &&
+		    std::isdigit(static_cast<unsigned char>(typeName[6])))
+		{
+			const int components = typeName[6] - '0';
+			const std::string suffix = typeName.substr(7);
+			if (components < 2 || components > 4)
+			{
+				return std::nullopt;
+			}
+			if (suffix.empty())
+			{
+				return BuiltinShape{"float", 0, components};
+			}
+			if (suffix == "Int")
+			{
+				return BuiltinShape{"std::int32_t", 0, components};
+			}
+			if (suffix == "UInt")
+			{
+				return BuiltinShape{"std::uint32_t", 0, components};
+			}
+			return std::nullopt;
+		}
+
+		if (typeName.rfind("Matrix", 0) == 0)
+		{
+			const std::size_t xPos = typeName.find('x', 6);
+			if (xPos == std::string::npos || xPos == 6 || xPos + 1 >= typeName.size())
+			{
+				return std::nullopt;
+			}
+			const std::string columns = typeName.substr(6, xPos - 6);
+			const std::string rows = typeName.substr(xPos + 1);
+			const auto isNumber = [](const std::string &text) {
+				return std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+			};
+			if (!isNumber(columns) || !isNumber(rows))
+			{
+				return std::nullopt;
+			}
+			return BuiltinShape{"float", std::stoi(columns), std::stoi(rows)};
+		}
+
+		return std::nullopt;
+	}
+
+	bool isCppKeyword(const std::string &name)
+	{
+		static const std::unordered_set<std::string> kKeywords = {"alignas", "alignof", "and", "asm", "auto",
+		    "bitand", "bitor", "bool", "break", "case", "catch", "char", "class", "compl", "concept", "const",
+		    "consteval", "constexpr", "constinit", "const_cast", "continue", "decltype", "default", "delete", "do",
+		    "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for",
+		    "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not",
+		    "nullptr", "operator", "or", "private", "protected", "public", "register", "reinterpret_cast",
+		    "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct",
+		    "switch", "template", "this", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+		    "unsigned", "using", "virtual", "void", "volatile", "while", "xor"};
+		return kKeywords.count(name) > 0;
+	}
+
+	std::string cppIdentifier(const std::string &name)
+	{
+		std::string result;
+		result.reserve(name.size());
+		for (std::size_t i = 0; i < name.size(); ++i)
+		{
+			const char c = name[i];
+			if (c == ':' && i + 1 < name.size() && name[i + 1] == ':')
+			{
+				result.push_back('_');
+				++i;
+			}
+			else if (std::isalnum(static_cast<unsigned char>(c)) || c == '_')
+			{
+				result.push_back(c);
+			}
+			else
+			{
+				result.push_back('_');
+			}
+		}
+		if (result.empty() || std::isdigit(static_cast<unsigned char>(result[0])))
+		{
+			result.insert(result.begin(), '_');
+		}
+		if (isCppKeyword(result))
+		{
+			result.push_back('_');
+		}
+		return result;
+	}
+
+	class HeaderWriter
+	{
+	public:
+		explicit HeaderWriter(const ShaderArtifact &artifact) : artifact(artifact)
+		{
+			for (const StructDefinition &structure : artifact.structures)
+			{
+				structLookup.emplace(structure.name, &structure);
+			}
+		}
+
+		std::string write(const std::string &namespaceName)
+		{
+			oss << "// Generated by Lumina. Do not edit.\n";
+			oss << "#pragma once\n\n";
+			oss << "#include <cstddef>\n";
+			oss << "#include <cstdint>\n\n";
+			oss << "namespace " << namespaceName << "\n{\n";
+
+			for (const StructDefinition &structure : artifact.structures)
+			{
+				writeStructRecursive(structure);
+			}
+			for (const BlockDefinition &block : artifact.constants)
+			{
+				writeBlock(block, "constant");
+			}
+			for (const BlockDefinition &block : artifact.attributes)
+			{
+				writeBlock(block, "attribute");
+			}
+
+			oss << "}\n";
+			return oss.str();
+		}
+
+	private:
+		const ShaderArtifact &artifact;
+		std::unordered_map<std::string, const StructDefinition *> structLookup;
+		std::unordered_set<std::string> writtenStructs;
+		std::unordered_set<std::string> pendingStructs;
+		std::ostringstream oss;
+		bool firstDeclaration = true;
+
+		void beginDeclaration()
+		{
+			if (!firstDeclaration)
+			{
+				oss << "\n";
+			}
+			firstDeclaration = false;
+		}
+
+		const StructDefinition *findStruct(const std::string &typeName) const
+		{
+			const auto it = structLookup.find(typeName);
+			return it == structLookup.end() ? nullptr : it->second;
+		}
+
+		// Only types that were written before can be named; anything else falls back to raw bytes.
+		const StructDefinition *usableStruct(const std::string &typeName) const
+		{
+			const StructDefinition *structure = findStruct(typeName);
+			return (structure && writtenStructs.count(structure->name) > 0) ? structure : nullptr;
+		}
+
+		void writeStructRecursive(const StructDefinition &structure)
+		{
+			if (writtenStructs.count(structure.name) > 0 || !pendingStructs.insert(structure.name).second)
+			{
+				return;
+			}
+
+			// Nested struct types have to be complete before they are used as members.
+			visitDependencies(structure.members);
+			pendingStructs.erase(structure.name);
+
+			if (structure.size <= 0)
+			{
+				beginDeclaration();
+				oss << "\t// struct " << structure.name << " has no data and is not mirrored.\n";
+				return;
+			}
+
+			const std::string typeName = cppIdentifier(structure.name);
+			beginDeclaration();
+			if (typeName != structure.name)
+			{
+				oss << "\t// struct " << structure.name << "\n";
+			}
+			writeRecord(typeName, structure.members, structure.size, {});
+			writtenStructs.insert(structure.name);
+		}
+
+		void visitDependencies(const std::vector<BlockMember> &members)
+		{
+			for (const BlockMember &member : members)
+			{
+				if (const StructDefinition *dependency = findStruct(member.typeName))
+				{
+					writeStructRecursive(*dependency);
+				}
+			}
+		}
+
+		void writeBlock(const BlockDefinition &block, const char *scope)
+		{
+			visitDependencies(block.members);
+			if (block.dynamicArray)
+			{
+				if (const StructDefinition *dependency = findStruct(block.dynamicArray->typeName))
+				{
+					writeStructRecursive(*dependency);
+				}
+			}
+
+			const std::string typeName = cppIdentifier(block.name);
+			beginDeclaration();
+			if (block.size <= 0)
+			{
+				oss << "\t// " << scope << " " << block.type << " " << block.name << " has no data and is not mirrored.\n";
+				return;
+			}
+
+			std::vector<std::string> constants;
+			if (block.dynamicArray)
+			{
+				constants.push_back("dynamicArrayOffset = " + std::to_string(block.dynamicArray->offset));
+				constants.push_back("dynamicArrayStride = " + std::to_string(block.dynamicArray->elementStride));
+			}
+
+			oss << "\t// " << scope << " " << block.type << " " << block.name << "\n";
+			writeRecord(typeName, block.members, block.size, constants);
+
+			if (block.dynamicArray)
+			{
+				writeDynamicArrayElement(typeName, *block.dynamicArray);
+			}
+		}
+
+		void writeDynamicArrayElement(const std::string &blockTypeName, const DynamicArrayLayout &layout)
+		{
+			const std::string elementTypeName = blockTypeName + "_" + cppIdentifier(layout.name) + "Element";
+			if (layout.elementStride <= 0)
+			{
+				return;
+			}
+
+			oss << "\n";
+			const StructDefinition *structure = usableStruct(layout.typeName);
+			if (structure && structure->size == layout.elementStride)
+			{
+				oss << "\tusing " << elementTypeName << " = " << cppIdentifier(structure->name) << ";\n";
+				oss << "\tstatic_assert(sizeof(" << elementTypeName << ") == " << layout.elementStride << ");\n";
+				return;
+			}
+
+			BlockMember value;
+			value.name = "value";
+			value.typeName = layout.typeName;
+			value.offset = 0;
+			value.size = structure ? structure->size : layout.elementStride;
+			writeRecord(elementTypeName, {value}, layout.elementStride, {});
+		}
+
+		void writeRecord(const std::string &typeName,
+		    const std::vector<BlockMember> &members,
+		    int size,
+		    const std::vector<std::string> &constants)
+		{
+			std::vector<std::pair<std::string, int>> checkedOffsets;
+			int cursor = 0;
+			int paddingIndex = 0;
+
+			const auto writePadding = [&](int bytes) {
+				oss << "\t\tstd::uint8_t _padding" << paddingIndex++ << "[" << bytes << "];\n";
+			};
+
+			oss << "\tstruct " << typeName << "\n\t{\n";
+			for (const std::string &constant : constants)
+			{
+				oss << "\t\tstatic constexpr std::size_t " << constant << ";\n";
+			}
+
+			for (const BlockMember &member : members)
+			{
+				if (member.size <= 0 || member.offset < cursor)
+				{
+					continue;
+				}
+				if (member.offset > cursor)
+				{
+					writePadding(member.offset - cursor);
+				}
+
+				const std::string fieldName = cppIdentifier(member.name);
+				const std::optional<std::string> declaration = declareMember(member, fieldName);
+				if (!member.derivedExpression.empty())
+				{
+					oss << "\t\t// Computed by the host: " << member.derivedExpression << "\n";
+				}
+				if (declaration)
+				{
+					oss << "\t\t" << *declaration << ";\n";
+					checkedOffsets.emplace_back(fieldName, member.offset);
+				}
+				else
+				{
+					oss << "\t\t// " << member.name << " (" << member.typeName << ") has no host equivalent.\n";
+					writePadding(member.size);
+				}
+				cursor = member.offset + member.size;
+			}
+
+			if (size > cursor)
+			{
+				writePadding(size - cursor);
+			}
+			oss << "\t};\n";
+
+			oss << "\tstatic_assert(sizeof(" << typeName << ") == " << size << ");\n";
+			for (const auto &[fieldName, offset] : checkedOffsets)
+			{
+				oss << "\tstatic_assert(offsetof(" << typeName << ", " << fieldName << ") == " << offset << ");\n";
+			}
+		}
+
+		std::optional<std::string> declareMember(const BlockMember &member, const std::string &fieldName) const
+		{
+			const bool isArray = member.kind == "Array";
+			const int count = isArray ? member.elementCount : 1;
+			const int stride = isArray ? member.elementSize : member.size;
+			if (count <= 0 || stride <= 0)
+			{
+				return std::nullopt;
+			}
+			const std::string extent = isArray ? "[" + std::to_string(count) + "]" : "";
+
+			if (const StructDefinition *structure = usableStruct(member.typeName))
+			{
+				if (structure->size != stride)
+				{
+					return std::nullopt;
+				}
+				return cppIdentifier(structure->name) + " " + fieldName + extent;
+			}
+
+			const std::optional<BuiltinShape> shape = builtinShape(member.typeName);
+			if (!shape || stride % 4 != 0)
+			{
+				return std::nullopt;
+			}
+
+			std::string declaration = std::string(shape->component) + " " + fieldName + extent;
+			if (shape->columns > 0)
+			{
+				// Matrices are stored as padded columns.
+				if (stride % (shape->columns * 4) != 0)
+				{
+					return std::nullopt;
+				}
+				return declaration + "[" + std::to_string(shape->columns) + "][" +
+				       std::to_string(stride / shape->columns / 4) + "]";
+			}
+
+			// Array elements carry their stride padding; single values leave it to the following member.
+			const int lanes = isArray ? stride / 4 : shape->rows;
+			if (lanes < shape->rows)
+			{
+				return std::nullopt;
+			}
+			if (lanes > 1)
+			{
+				declaration += "[" + std::to_string(lanes) + "]";
+			}
+			return declaration;
+		}
+	};
+}
+
+CppHeaderEmitter::CppHeaderEmitter(std::string p_namespaceName) : m_namespaceName(std::move(p_namespaceName)) {}
+
+std::string CppHeaderEmitter::operator()(const ShaderArtifact &p_artifact) const
+{
+	HeaderWriter writer(p_artifact);
+	return writer.write(m_namespaceName);
+}
+
+std::string CppHeaderEmitter::namespaceFor(const std::filesystem::path &p_source)
+{
+	return "lumina::" + cppIdentifier(p_source.stem().string());
+}
@@ -0,0 +1,921 @@
+#include "ir.hpp"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace
+{
+	struct ScalarSpelling
+	{
+		const char *name;
+		IrScalar scalar;
+	};
+
+	constexpr ScalarSpelling kScalars[] = {
+	    {"float", IrScalar::Float}, {"int", IrScalar::Int}, {"uint", IrScalar::UInt}, {"bool", IrScalar::Bool}};
+
+	constexpr ScalarSpelling kVectorPrefixes[] = {
+	    {"vec", IrScalar::Float}, {"ivec", IrScalar::Int}, {"uvec", IrScalar::UInt}, {"bvec", IrScalar::Bool}};
+
+	bool isDimension(char c)
+	{
+		return c >= '2' && c <= '4';
+	}
+
+	void classify(IrType &type)
+	{
+		const std::string &glsl = type.glsl;
+		if (glsl == "void")
+		{
+			type.kind = IrType::Kind::Void;
+			return;
+		}
+		if (glsl == "Texture" || glsl == "sampler2D")
+		{
+			type.kind = IrType::Kind::Texture;
+			return;
+		}
+		for (const ScalarSpelling &scalar : kScalars)
+		{
+			if (glsl == scalar.name)
+			{
+				type.kind = IrType::Kind::Scalar;
+				type.scalar = scalar.scalar;
+				return;
+			}
+		}
+		for (const ScalarSpelling &prefix : kVectorPrefixes)
+		{
+			const std::string_view name = prefix.name;
+			if (glsl.size() == name.size() + 1 && glsl.compare(0, name.size(), name) == 0 && isDimension(glsl.back()))
+			{
+				type.kind = IrType::Kind::Vector;
+				type.scalar = prefix.scalar;
+				type.columns = glsl.back() - '0';
+				return;
+			}
+		}
+		// matN and matCxR.
+		if (glsl.size() >= 4 && glsl.compare(0, 3, "mat") == 0 && isDimension(glsl[3]))
+		{
+			if (glsl.size() == 4 || (glsl.size() == 6 && glsl[4] == 'x' && isDimension(glsl[5])))
+			{
+				type.kind = IrType::Kind::Matrix;
+				type.scalar = IrScalar::Float;
+				type.columns = glsl[3] - '0';
+				type.rows = glsl.size() == 4 ? type.columns : glsl[5] - '0';
+				return;
+			}
+		}
+		type.kind = IrType::Kind::Aggregate;
+	}
+
+	std::string variableName(const IrVariable &variable)
+	{
+		const bool module = variable.storage != IrVariable::Storage::Local &&
+		                    variable.storage != IrVariable::Storage::Parameter;
+		return (module ? "@" : "$") + variable.name;
+	}
+
+	const char *storageName(IrVariable::Storage storage)
+	{
+		switch (storage)
+		{
+			case IrVariable::Storage::Local:
+				return "local";
+			case IrVariable::Storage::Parameter:
+				return "parameter";
+			case IrVariable::Storage::Input:
+				return "input";
+			case IrVariable::Storage::Output:
+				return "output";
+			case IrVariable::Storage::Global:
+				return "global";
+			case IrVariable::Storage::Block:
+				return "block";
+			case IrVariable::Storage::Texture:
+				return "texture";
+		}
+		return "global";
+	}
+
+	const char *opcodeName(IrOpcode opcode)
+	{
+		switch (opcode)
+		{
+			case IrOpcode::Constant:
+				return "constant";
+			case IrOpcode::Address:
+				return "address";
+			case IrOpcode::Unary:
+				return "unary";
+			case IrOpcode::Binary:
+				return "binary";
+			case IrOpcode::Select:
+				return "select";
+			case IrOpcode::Construct:
+				return "construct";
+			case IrOpcode::Extract:
+				return "extract";
+			case IrOpcode::CallBuiltin:
+				return "call_builtin";
+			case IrOpcode::Load:
+				return "load";
+			case IrOpcode::Store:
+				return "store";
+			case IrOpcode::Declare:
+				return "declare";
+			case IrOpcode::Increment:
+				return "increment";
+			case IrOpcode::Call:
+				return "call";
+			case IrOpcode::Opaque:
+				return "opaque";
+			case IrOpcode::Scope:
+				return "scope";
+			case IrOpcode::If:
+				return "if";
+			case IrOpcode::Loop:
+				return "loop";
+			case IrOpcode::BreakUnless:
+				return "break_unless";
+			case IrOpcode::Return:
+				return "return";
+			case IrOpcode::Break:
+				return "break";
+			case IrOpcode::Continue:
+				return "continue";
+			case IrOpcode::Discard:
+				return "discard";
+		}
+		return "?";
+	}
+
+	std::size_t expectedBlockCount(IrOpcode opcode)
+	{
+		switch (opcode)
+		{
+			case IrOpcode::Scope:
+				return 1;
+			case IrOpcode::If:
+				return 2;
+			case IrOpcode::Loop:
+				return 3;
+			default:
+				return 0;
+		}
+	}
+
+	void addUnique(std::vector<const IrVariable *> &variables, const IrVariable *variable)
+	{
+		if (std::find(variables.begin(), variables.end(), variable) == variables.end())
+		{
+			variables.push_back(variable);
+		}
+	}
+
+	bool anyGlobal(const std::vector<const IrVariable *> &variables)
+	{
+		return std::any_of(variables.begin(), variables.end(), [](const IrVariable *variable) {
+			return variable->storage != IrVariable::Storage::Local &&
+			       variable->storage != IrVariable::Storage::Parameter;
+		});
+	}
+
+	bool intersects(const std::vector<const IrVariable *> &left, const std::vector<const IrVariable *> &right)
+	{
+		for (const IrVariable *variable : left)
+		{
+			if (std::find(right.begin(), right.end(), variable) != right.end())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const IrVariable *addressRoot(const IrInstruction *address)
+	{
+		return (address && address->opcode == IrOpcode::Address) ? address->variable : nullptr;
+	}
+
+	void addRead(IrMemoryEffects &effects, const IrInstruction *address)
+	{
+		if (const IrVariable *root = addressRoot(address); root && !root->readOnly)
+		{
+			addUnique(effects.reads, root);
+		}
+	}
+
+	void addWrite(IrMemoryEffects &effects, const IrInstruction *address)
+	{
+		if (const IrVariable *root = addressRoot(address))
+		{
+			addUnique(effects.writes, root);
+		}
+	}
+
+	class IrPrinter
+	{
+	public:
+		explicit IrPrinter(std::ostream &stream) : m_stream(stream) {}
+
+		void printFunction(const IrFunction &function)
+		{
+			m_ids.clear();
+			m_stream << "function " << function.returnType->spelling() << " " << function.name << "(";
+			for (std::size_t i = 0; i < function.parameters.size(); ++i)
+			{
+				const IrVariable &parameter = *function.parameters[i];
+				m_stream << (i > 0 ? ", " : "") << (parameter.isReference ? "inout " : "")
+				         << parameter.type->spelling() << " " << variableName(parameter);
+			}
+			m_stream << ")\n";
+			printBlock(function.body, 0);
+			m_stream << "\n";
+		}
+
+	private:
+		void indent(int depth)
+		{
+			for (int i = 0; i < depth; ++i)
+			{
+				m_stream << '\t';
+			}
+		}
+
+		std::string value(const IrInstruction *instruction)
+		{
+			const auto it = m_ids.find(instruction);
+			return it == m_ids.end() ? std::string("%?") : "%" + std::to_string(it->second);
+		}
+
+		std::string operandList(const IrInstruction &instruction, std::size_t first = 0)
+		{
+			std::string list;
+			for (std::size_t i = first; i < instruction.operands.size(); ++i)
+			{
+				list += (i > first ? ", " : "") + value(instruction.operands[i]);
+			}
+			return list;
+		}
+
+		std::string accessPath(const IrInstruction &instruction, std::size_t firstIndexOperand)
+		{
+			std::string path;
+			std::size_t index = firstIndexOperand;
+			for (const IrAccess &access : instruction.accesses)
+			{
+				if (access.isIndex)
+				{
+					path += "[" + (index < instruction.operands.size() ? value(instruction.operands[index]) : "?") + "]";
+					++index;
+				}
+				else
+				{
+					path += "." + access.member;
+				}
+			}
+			return path;
+		}
+
+		void printBlock(const IrBlock &block, int depth)
+		{
+			indent(depth);
+			m_stream << "{\n";
+			for (const std::unique_ptr<IrInstruction> &instruction : block.instructions)
+			{
+				printInstruction(*instruction, depth + 1);
+			}
+			indent(depth);
+			m_stream << "}\n";
+		}
+
+		void printInstruction(const IrInstruction &instruction, int depth)
+		{
+			indent(depth);
+			if (instruction.producesValue())
+			{
+				const std::size_t id = m_ids.size();
+				m_ids[&instruction] = id;
+				m_stream << "%" << id << " = ";
+			}
+			m_stream << opcodeName(instruction.opcode);
+
+			switch (instruction.opcode)
+			{
+				case IrOpcode::Constant:
+					m_stream << " " << instruction.text;
+					break;
+				case IrOpcode::Address:
+					m_stream << " " << variableName(*instruction.variable) << accessPath(instruction, 0);
+					break;
+				case IrOpcode::Unary:
+					m_stream << " " << irUnarySymbol(instruction.unaryOperator) << value(instruction.operands[0]);
+					break;
+				case IrOpcode::Binary:
+					m_stream << " " << value(instruction.operands[0]) << " " << irBinarySymbol(instruction.binaryOperator)
+					         << " " << value(instruction.operands[1]);
+					break;
+				case IrOpcode::Extract:
+					m_stream << " " << value(instruction.operands[0]) << accessPath(instruction, 1);
+					break;
+				case IrOpcode::Construct:
+				case IrOpcode::CallBuiltin:
+				case IrOpcode::Call:
+					m_stream << " " << instruction.text << "(" << operandList(instruction) << ")";
+					break;
+				case IrOpcode::Declare:
+					m_stream << " " << variableName(*instruction.variable) << " : " << instruction.variable->type->spelling();
+					if (!instruction.operands.empty())
+					{
+						m_stream << " = " << value(instruction.operands[0]);
+					}
+					break;
+				case IrOpcode::Increment:
+				{
+					const char *symbol = instruction.isDecrement ? "--" : "++";
+					m_stream << " " << (instruction.isPostfix ? "" : symbol) << value(instruction.operands[0])
+					         << (instruction.isPostfix ? symbol : "");
+					break;
+				}
+				case IrOpcode::Opaque:
+					m_stream << " \"" << instruction.text << "\"";
+					break;
+				case IrOpcode::Loop:
+					m_stream << (instruction.isPostTest ? " post-test" : " pre-test");
+					break;
+				default:
+					if (!instruction.operands.empty())
+					{
+						m_stream << " " << operandList(instruction);
+					}
+					break;
+			}
+			if (instruction.producesValue())
+			{
+				m_stream << " : " << instruction.type->spelling();
+			}
+			m_stream << "\n";
+
+			static constexpr const char *kLoopBlocks[] = {"header", "body", "continue"};
+			for (std::size_t i = 0; i < instruction.blocks.size(); ++i)
+			{
+				if (instruction.opcode == IrOpcode::Loop || (instruction.opcode == IrOpcode::If && i > 0))
+				{
+					indent(depth);
+					m_stream << (instruction.opcode == IrOpcode::Loop ? kLoopBlocks[i] : "else") << "\n";
+				}
+				printBlock(*instruction.blocks[i], depth);
+			}
+		}
+
+		std::ostream &m_stream;
+		std::unordered_map<const IrInstruction *, std::size_t> m_ids;
+	};
+
+	class IrVerifier
+	{
+	public:
+		void verifyFunction(const IrFunction &function)
+		{
+			m_function = &function;
+			if (!function.returnType)
+			{
+				fail("has no return type");
+			}
+			verifyBlock(function.body, false);
+		}
+
+	private:
+		[[noreturn]] void fail(const std::string &message) const
+		{
+			throw std::runtime_error("malformed IR in function '" + m_function->name + "': " + message);
+		}
+
+		void verifyBlock(const IrBlock &block, bool isLoopHeader)
+		{
+			std::vector<const IrInstruction *> definedHere;
+			for (const std::unique_ptr<IrInstruction> &instruction : block.instructions)
+			{
+				if (!instruction)
+				{
+					fail("null instruction");
+				}
+				verifyInstruction(*instruction, isLoopHeader);
+				m_defined.insert(instruction.get());
+				definedHere.push_back(instruction.get());
+			}
+			for (const IrInstruction *instruction : definedHere)
+			{
+				m_defined.erase(instruction);
+			}
+		}
+
+		void verifyInstruction(const IrInstruction &instruction, bool isLoopHeader)
+		{
+			const char *name = opcodeName(instruction.opcode);
+			if (!instruction.type)
+			{
+				fail(std::string(name) + " has no type");
+			}
+			for (const IrInstruction *operand : instruction.operands)
+			{
+				if (!operand || m_defined.find(operand) == m_defined.end())
+				{
+					fail(std::string("an operand of ") + name + " is not defined before it");
+				}
+				if (!operand->producesValue())
+				{
+					fail(std::string("an operand of ") + name + " produces no value");
+				}
+			}
+			if (instruction.blocks.size() != expectedBlockCount(instruction.opcode))
+			{
+				fail(std::string(name) + " owns the wrong number of blocks");
+			}
+
+			const auto indexCount = static_cast<std::size_t>(std::count_if(instruction.accesses.begin(),
+			    instruction.accesses.end(), [](const IrAccess &access) { return access.isIndex; }));
+			const auto requireAddress = [&](std::size_t operand) {
+				if (instruction.operands.size() <= operand || instruction.operands[operand]->opcode != IrOpcode::Address)
+				{
+					fail(std::string(name) + " does not go through an address");
+				}
+			};
+			switch (instruction.opcode)
+			{
+				case IrOpcode::Address:
+					if (!instruction.variable || instruction.operands.size() != indexCount)
+					{
+						fail("address without a root or with mismatched indices");
+					}
+					break;
+				case IrOpcode::Extract:
+					if (instruction.operands.size() != indexCount + 1)
+					{
+						fail("extract with mismatched indices");
+					}
+					break;
+				case IrOpcode::Load:
+				case IrOpcode::Increment:
+					requireAddress(0);
+					break;
+				case IrOpcode::Store:
+					requireAddress(0);
+					if (instruction.operands.size() != 2)
+					{
+						fail("store without a value");
+					}
+					break;
+				case IrOpcode::Declare:
+					if (!instruction.variable || instruction.operands.size() > 1)
+					{
+						fail("malformed declare");
+					}
+					break;
+				case IrOpcode::BreakUnless:
+					if (!isLoopHeader || instruction.operands.size() != 1)
+					{
+						fail("break_unless outside of a loop header");
+					}
+					break;
+				default:
+					break;
+			}
+
+			for (std::size_t i = 0; i < instruction.blocks.size(); ++i)
+			{
+				verifyBlock(*instruction.blocks[i], instruction.opcode == IrOpcode::Loop && i == 0);
+			}
+		}
+
+		const IrFunction *m_function = nullptr;
+		std::unordered_set<const IrInstruction *> m_defined;
+	};
+}
+
+std::string IrType::spelling() const
+{
+	if (!isArray)
+	{
+		return glsl;
+	}
+	return glsl + "[" + (arraySize ? std::to_string(*arraySize) : std::string()) + "]";
+}
+
+const IrType *IrTypeTable::get(const std::string &p_glsl, bool p_isArray, std::optional<std::size_t> p_arraySize)
+{
+	IrType candidate;
+	candidate.glsl = p_glsl;
+	candidate.isArray = p_isArray;
+	candidate.arraySize = p_isArray ? p_arraySize : std::nullopt;
+	std::string key = candidate.spelling();
+
+	auto it = m_types.find(key);
+	if (it == m_types.end())
+	{
+		classify(candidate);
+		it = m_types.emplace(std::move(key), std::make_unique<IrType>(std::move(candidate))).first;
+	}
+	return it->second.get();
+}
+
+IrVariable *IrModule::global(
+    const std::string &p_name, IrVariable::Storage p_storage, const IrType *p_type, bool p_readOnly)
+{
+	auto it = globalLookup.find(p_name);
+	if (it != globalLookup.end())
+	{
+		return it->second;
+	}
+	auto variable = std::make_unique<IrVariable>();
+	variable->storage = p_storage;
+	variable->name = p_name;
+	variable->type = p_type;
+	variable->readOnly = p_readOnly;
+	IrVariable *result = variable.get();
+	globals.push_back(std::move(variable));
+	globalLookup.emplace(p_name, result);
+	return result;
+}
+
+IrInstruction *IrBuilder::append(IrOpcode p_opcode, const IrType *p_type, std::vector<IrInstruction *> p_operands)
+{
+	auto instruction = std::make_unique<IrInstruction>();
+	instruction->opcode = p_opcode;
+	instruction->type = p_type;
+	instruction->operands = std::move(p_operands);
+	IrInstruction *result = instruction.get();
+	m_block->instructions.push_back(std::move(instruction));
+	return result;
+}
+
+IrInstruction *IrBuilder::constant(const IrType *p_type, std::string p_text)
+{
+	IrInstruction *instruction = append(IrOpcode::Constant, p_type);
+	instruction->text = std::move(p_text);
+	return instruction;
+}
+
+IrInstruction *IrBuilder::address(IrVariable &p_variable, const IrType *p_type, std::vector<IrAccess> p_accesses,
+    std::vector<IrInstruction *> p_indices)
+{
+	IrInstruction *instruction = append(IrOpcode::Address, p_type, std::move(p_indices));
+	instruction->variable = &p_variable;
+	instruction->accesses = std::move(p_accesses);
+	return instruction;
+}
+
+IrInstruction *IrBuilder::load(IrInstruction *p_address)
+{
+	return append(IrOpcode::Load, p_address->type, {p_address});
+}
+
+void IrBuilder::store(IrInstruction *p_address, IrInstruction *p_value)
+{
+	append(IrOpcode::Store, voidType(), {p_address, p_value});
+}
+
+IrInstruction *IrBuilder::binary(
+    BinaryOperator p_operator, const IrType *p_type, IrInstruction *p_left, IrInstruction *p_right)
+{
+	IrInstruction *instruction = append(IrOpcode::Binary, p_type, {p_left, p_right});
+	instruction->binaryOperator = p_operator;
+	return instruction;
+}
+
+IrInstruction *IrBuilder::structured(IrOpcode p_opcode, std::size_t p_blockCount, std::vector<IrInstruction *> p_operands)
+{
+	IrInstruction *instruction = append(p_opcode, voidType(), std::move(p_operands));
+	for (std::size_t i = 0; i < p_blockCount; ++i)
+	{
+		instruction->blocks.push_back(std::make_unique<IrBlock>());
+	}
+	return instruction;
+}
+
+void IrMemoryEffects::merge(const IrMemoryEffects &p_other)
+{
+	readsAnything = readsAnything || p_other.readsAnything;
+	writesAnything = writesAnything || p_other.writesAnything;
+	readsGlobals = readsGlobals || p_other.readsGlobals;
+	writesGlobals = writesGlobals || p_other.writesGlobals;
+	exits = exits || p_other.exits;
+	for (const IrVariable *variable : p_other.reads)
+	{
+		addUnique(reads, variable);
+	}
+	for (const IrVariable *variable : p_other.writes)
+	{
+		addUnique(writes, variable);
+	}
+}
+
+bool IrMemoryEffects::conflictsWith(const IrMemoryEffects &p_other) const
+{
+	// Writes must neither move past a point where the code may leave, nor past accesses to what they write.
+	if ((exits && p_other.hasWrites()) || (p_other.exits && hasWrites()))
+	{
+		return true;
+	}
+	const auto writeConflicts = [](const IrMemoryEffects &writer, const IrMemoryEffects &other) {
+		if (!writer.hasWrites())
+		{
+			return false;
+		}
+		if (writer.writesAnything)
+		{
+			return other.readsAnything || other.writesAnything || other.readsGlobals || other.writesGlobals ||
+			       !other.reads.empty() || !other.writes.empty();
+		}
+		if (other.readsAnything || other.writesAnything)
+		{
+			return true;
+		}
+		if (writer.writesGlobals &&
+		    (other.readsGlobals || other.writesGlobals || anyGlobal(other.reads) || anyGlobal(other.writes)))
+		{
+			return true;
+		}
+		if ((other.readsGlobals || other.writesGlobals) && anyGlobal(writer.writes))
+		{
+			return true;
+		}
+		return intersects(writer.writes, other.reads) || intersects(writer.writes, other.writes);
+	};
+	return writeConflicts(*this, p_other) || writeConflicts(p_other, *this);
+}
+
+IrMemoryEffects irMemoryEffects(const IrInstruction &p_instruction)
+{
+	IrMemoryEffects effects;
+	switch (p_instruction.opcode)
+	{
+		case IrOpcode::Load:
+			addRead(effects, p_instruction.operands[0]);
+			break;
+		case IrOpcode::Store:
+			addWrite(effects, p_instruction.operands[0]);
+			break;
+		case IrOpcode::Declare:
+			addUnique(effects.writes, p_instruction.variable);
+			break;
+		case IrOpcode::Increment:
+			addRead(effects, p_instruction.operands[0]);
+			addWrite(effects, p_instruction.operands[0]);
+			break;
+		case IrOpcode::CallBuiltin:
+			for (const IrInstruction *operand : p_instruction.operands)
+			{
+				addRead(effects, operand);
+			}
+			break;
+		case IrOpcode::Call:
+			// Arguments are copied in and out, so the callee only reaches module-level variables and the places
+			// passed to it.
+			effects.readsGlobals = true;
+			effects.writesGlobals = true;
+			for (const IrInstruction *operand : p_instruction.operands)
+			{
+				addRead(effects, operand);
+				addWrite(effects, operand);
+			}
+			break;
+		case IrOpcode::Opaque:
+			effects.readsAnything = true;
+			effects.writesAnything = true;
+			break;
+		case IrOpcode::Return:
+		case IrOpcode::Break:
+		case IrOpcode::Continue:
+		case IrOpcode::Discard:
+		case IrOpcode::BreakUnless:
+			effects.exits = true;
+			break;
+		case IrOpcode::Scope:
+		case IrOpcode::If:
+		case IrOpcode::Loop:
+			for (const std::unique_ptr<IrBlock> &block : p_instruction.blocks)
+			{
+				irForEachInstruction(*block, [&](const IrInstruction &nested) {
+					if (nested.blocks.empty())
+					{
+						effects.merge(irMemoryEffects(nested));
+					}
+				});
+			}
+			break;
+		default:
+			break;
+	}
+	return effects;
+}
+
+bool irIsRemovable(const IrInstruction &p_instruction)
+{
+	switch (p_instruction.opcode)
+	{
+		case IrOpcode::Constant:
+		case IrOpcode::Address:
+		case IrOpcode::Unary:
+		case IrOpcode::Binary:
+		case IrOpcode::Select:
+		case IrOpcode::Construct:
+		case IrOpcode::Extract:
+		case IrOpcode::CallBuiltin:
+		case IrOpcode::Load:
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool irIsTerminator(const IrInstruction &p_instruction)
+{
+	return p_instruction.opcode == IrOpcode::Return || p_instruction.opcode == IrOpcode::Break ||
+	       p_instruction.opcode == IrOpcode::Continue || p_instruction.opcode == IrOpcode::Discard;
+}
+
+void irForEachInstruction(IrBlock &p_block, const std::function<void(IrInstruction &)> &p_visitor)
+{
+	for (const std::unique_ptr<IrInstruction> &instruction : p_block.instructions)
+	{
+		p_visitor(*instruction);
+		for (const std::unique_ptr<IrBlock> &nested : instruction->blocks)
+		{
+			irForEachInstruction(*nested, p_visitor);
+		}
+	}
+}
+
+void irForEachInstruction(const IrBlock &p_block, const std::function<void(const IrInstruction &)> &p_visitor)
+{
+	for (const std::unique_ptr<IrInstruction> &instruction : p_block.instructions)
+	{
+		p_visitor(*instruction);
+		for (const std::unique_ptr<IrBlock> &nested : instruction->blocks)
+		{
+			irForEachInstruction(static_cast<const IrBlock &>(*nested), p_visitor);
+		}
+	}
+}
+
+std::unordered_map<const IrInstruction *, std::size_t> irUseCounts(const IrFunction &p_function)
+{
+	std::unordered_map<const IrInstruction *, std::size_t> counts;
+	irForEachInstruction(p_function.body, [&](const IrInstruction &instruction) {
+		for (const IrInstruction *operand : instruction.operands)
+		{
+			++counts[operand];
+		}
+	});
+	return counts;
+}
+
+void irReplaceAllUses(IrFunction &p_function, const IrInstruction *p_from, IrInstruction *p_to)
+{
+	irForEachInstruction(p_function.body, [&](IrInstruction &instruction) {
+		std::replace(instruction.operands.begin(), instruction.operands.end(), const_cast<IrInstruction *>(p_from), p_to);
+	});
+}
+
+const char *irBinarySymbol(BinaryOperator p_operator)
+{
+	switch (p_operator)
+	{
+		case BinaryOperator::Add:
+			return "+";
+		case BinaryOperator::Subtract:
+			return "-";
+		case BinaryOperator::Multiply:
+			return "*";
+		case BinaryOperator::Divide:
+			return "/";
+		case BinaryOperator::Modulo:
+			return "%";
+		case BinaryOperator::Less:
+			return "<";
+		case BinaryOperator::LessEqual:
+			return "<=";
+		case BinaryOperator::Greater:
+			return ">";
+		case BinaryOperator::GreaterEqual:
+			return ">=";
+		case BinaryOperator::Equal:
+			return "==";
+		case BinaryOperator::NotEqual:
+			return "!=";
+		case BinaryOperator::LogicalAnd:
+			return "&&";
+		case BinaryOperator::LogicalOr:
+			return "||";
+		case BinaryOperator::BitwiseAnd:
+			return "&";
+		case BinaryOperator::BitwiseOr:
+			return "|";
+		case BinaryOperator::BitwiseXor:
+			return "^";
+		case BinaryOperator::ShiftLeft:
+			return "<<";
+		case BinaryOperator::ShiftRight:
+			return ">>";
+	}
+	return "?";
+}
+
+const char *irUnarySymbol(UnaryOperator p_operator)
+{
+	switch (p_operator)
+	{
+		case UnaryOperator::Positive:
+			return "+";
+		case UnaryOperator::Negate:
+			return "-";
+		case UnaryOperator::LogicalNot:
+			return "!";
+		case UnaryOperator::BitwiseNot:
+			return "~";
+		case UnaryOperator::PreIncrement:
+			return "++";
+		case UnaryOperator::PreDecrement:
+			return "--";
+	}
+	return "?";
+}
+
+std::string irExpressionText(const IrInstruction &p_value)
+{
+	const auto accesses = [&](std::size_t firstIndexOperand) {
+		std::string text;
+		std::size_t index = firstIndexOperand;
+		for (const IrAccess &access : p_value.accesses)
+		{
+			text += access.isIndex ? "[" + irExpressionText(*p_value.operands[index++]) + "]" : "." + access.member;
+		}
+		return text;
+	};
+	const auto arguments = [&]() {
+		std::string text = p_value.text + "(";
+		for (std::size_t i = 0; i < p_value.operands.size(); ++i)
+		{
+			text += (i > 0 ? ", " : "") + irExpressionText(*p_value.operands[i]);
+		}
+		return text + ")";
+	};
+
+	switch (p_value.opcode)
+	{
+		case IrOpcode::Constant:
+		case IrOpcode::Opaque:
+			return p_value.text;
+		case IrOpcode::Address:
+			return p_value.variable->name + accesses(0);
+		case IrOpcode::Load:
+			return irExpressionText(*p_value.operands[0]);
+		case IrOpcode::Unary:
+			return irUnarySymbol(p_value.unaryOperator) + irExpressionText(*p_value.operands[0]);
+		case IrOpcode::Binary:
+			return "(" + irExpressionText(*p_value.operands[0]) + " " + irBinarySymbol(p_value.binaryOperator) + " " +
+			       irExpressionText(*p_value.operands[1]) + ")";
+		case IrOpcode::Select:
+			return "(" + irExpressionText(*p_value.operands[0]) + " ? " + irExpressionText(*p_value.operands[1]) +
+			       " : " + irExpressionText(*p_value.operands[2]) + ")";
+		case IrOpcode::Construct:
+		case IrOpcode::CallBuiltin:
+		case IrOpcode::Call:
+			return arguments();
+		case IrOpcode::Extract:
+			return irExpressionText(*p_value.operands[0]) + accesses(1);
+		default:
+			return "?";
+	}
+}
+
+void printIr(const IrModule &p_module, std::ostream &p_stream)
+{
+	for (const std::unique_ptr<IrVariable> &variable : p_module.globals)
+	{
+		p_stream << storageName(variable->storage) << " " << variable->type->spelling() << " "
+		         << variableName(*variable) << (variable->readOnly ? " readonly" : "") << "\n";
+	}
+	if (!p_module.globals.empty())
+	{
+		p_stream << "\n";
+	}
+	IrPrinter printer(p_stream);
+	for (const std::unique_ptr<IrFunction> &function : p_module.functions)
+	{
+		printer.printFunction(*function);
+	}
+}
+
+void verifyIr(const IrModule &p_module)
+{
+	for (const std::unique_ptr<IrFunction> &function : p_module.functions)
+	{
+		IrVerifier().verifyFunction(*function);
+	}
+}
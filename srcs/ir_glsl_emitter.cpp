@@ -0,0 +1,678 @@
+#include "ir_glsl_emitter.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+	struct Location
+	{
+		const IrBlock *block = nullptr;
+		std::size_t position = 0;
+	};
+
+	class IrGlslWriter
+	{
+	public:
+		IrGlslWriter(const IrFunction &function, CodeWriter &out) : m_function(function), m_out(out) {}
+
+		void emit()
+		{
+			m_uses = irUseCounts(m_function);
+			indexBlock(m_function.body);
+
+			m_out << m_function.returnType->spelling() << " " << m_function.name << "(";
+			for (std::size_t i = 0; i < m_function.parameters.size(); ++i)
+			{
+				const IrVariable &parameter = *m_function.parameters[i];
+				if (i > 0)
+				{
+					m_out << ", ";
+				}
+				if (parameter.isReference)
+				{
+					m_out << "inout ";
+				}
+				else if (parameter.isConst)
+				{
+					m_out << "const ";
+				}
+				m_out << parameter.type->spelling() << " " << parameter.name;
+			}
+			m_out << ")\n";
+			emitBraced(m_function.body);
+		}
+
+	private:
+		void indexBlock(const IrBlock &block)
+		{
+			for (std::size_t i = 0; i < block.instructions.size(); ++i)
+			{
+				const IrInstruction &instruction = *block.instructions[i];
+				m_locations[&instruction] = {&block, i};
+				for (const IrInstruction *operand : instruction.operands)
+				{
+					m_users[operand] = &instruction;
+				}
+				for (const std::unique_ptr<IrBlock> &nested : instruction.blocks)
+				{
+					indexBlock(*nested);
+				}
+			}
+		}
+
+		std::size_t uses(const IrInstruction *instruction) const
+		{
+			const auto it = m_uses.find(instruction);
+			return it == m_uses.end() ? 0 : it->second;
+		}
+
+		bool inBlock(const IrInstruction *instruction, const IrBlock &block) const
+		{
+			const auto it = m_locations.find(instruction);
+			return it != m_locations.end() && it->second.block == &block;
+		}
+
+		// Decides which values of the block are written inside their user. A candidate stays inline only while no
+		// instruction written between it and its user, as a statement of its own, has conflicting memory effects.
+		void planBlock(const IrBlock &block)
+		{
+			const std::size_t count = block.instructions.size();
+			std::vector<bool> inlined(count, false);
+			std::vector<std::size_t> userPosition(count, 0);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const IrInstruction &instruction = *block.instructions[i];
+				if (!instruction.producesValue())
+				{
+					continue;
+				}
+				if (instruction.opcode == IrOpcode::Constant || instruction.opcode == IrOpcode::Address)
+				{
+					inlined[i] = true;
+					continue;
+				}
+				const auto user = m_users.find(&instruction);
+				if (uses(&instruction) == 1 && user != m_users.end() && inBlock(user->second, block))
+				{
+					inlined[i] = true;
+					userPosition[i] = m_locations.at(user->second).position;
+				}
+			}
+
+			// Addresses are always written where they are used. When that is more than one place, or another block,
+			// their indices must be computed once, beforehand.
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const IrInstruction &instruction = *block.instructions[i];
+				if (instruction.opcode != IrOpcode::Address)
+				{
+					continue;
+				}
+				const auto user = m_users.find(&instruction);
+				const bool local = uses(&instruction) == 1 && user != m_users.end() && inBlock(user->second, block);
+				if (local)
+				{
+					userPosition[i] = m_locations.at(user->second).position;
+					continue;
+				}
+				for (const IrInstruction *operand : instruction.operands)
+				{
+					if (operand->opcode != IrOpcode::Constant && inBlock(operand, block))
+					{
+						inlined[m_locations.at(operand).position] = false;
+					}
+				}
+				userPosition[i] = 0;
+			}
+
+			// Everything between a value and its user runs before it once inlined: statements with their whole
+			// expression, inlined values with their own effects, since they may end up next to it in the same tree.
+			std::vector<IrMemoryEffects> own(count);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				own[i] = irMemoryEffects(*block.instructions[i]);
+			}
+			std::vector<IrMemoryEffects> effects(count);
+			for (bool changed = true; changed;)
+			{
+				changed = false;
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					const IrInstruction &instruction = *block.instructions[i];
+					effects[i] = own[i];
+					for (const IrInstruction *operand : instruction.operands)
+					{
+						if (inBlock(operand, block))
+						{
+							const std::size_t position = m_locations.at(operand).position;
+							if (inlined[position])
+							{
+								effects[i].merge(effects[position]);
+							}
+						}
+					}
+				}
+
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					if (!inlined[i] || userPosition[i] == 0 || effects[i].empty())
+					{
+						continue;
+					}
+					for (std::size_t between = i + 1; between < userPosition[i]; ++between)
+					{
+						if (effects[i].conflictsWith(inlined[between] ? own[between] : effects[between]))
+						{
+							inlined[i] = false;
+							changed = true;
+							break;
+						}
+					}
+				}
+			}
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (inlined[i])
+				{
+					m_inlined.insert(block.instructions[i].get());
+				}
+			}
+		}
+
+		bool isInlined(const IrInstruction &instruction) const
+		{
+			return m_inlined.count(&instruction) != 0;
+		}
+
+		// Whether the instruction is written as a statement that only evaluates an expression, which a for header
+		// can hold.
+		bool isExpressionStatement(const IrInstruction &instruction) const
+		{
+			switch (instruction.opcode)
+			{
+				case IrOpcode::Store:
+					return true;
+				case IrOpcode::Increment:
+				case IrOpcode::Call:
+				case IrOpcode::Opaque:
+				case IrOpcode::CallBuiltin:
+					return uses(&instruction) == 0;
+				default:
+					return irIsRemovable(instruction) && uses(&instruction) == 0;
+			}
+		}
+
+		std::vector<const IrInstruction *> statementsOf(const IrBlock &block) const
+		{
+			std::vector<const IrInstruction *> statements;
+			for (const std::unique_ptr<IrInstruction> &instruction : block.instructions)
+			{
+				if (!isInlined(*instruction) && !(irIsRemovable(*instruction) && uses(instruction.get()) == 0))
+				{
+					statements.push_back(instruction.get());
+				}
+			}
+			return statements;
+		}
+
+		bool expressionsOnly(const std::vector<const IrInstruction *> &statements) const
+		{
+			for (const IrInstruction *statement : statements)
+			{
+				if (!isExpressionStatement(*statement))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void emitBraced(const IrBlock &block)
+		{
+			m_out << "{\n";
+			m_out.indent();
+			emitBlock(block);
+			m_out.dedent();
+			m_out << "}\n";
+		}
+
+		void emitBlock(const IrBlock &block)
+		{
+			planBlock(block);
+			for (const std::unique_ptr<IrInstruction> &instruction : block.instructions)
+			{
+				if (!isInlined(*instruction))
+				{
+					emitStatement(*instruction);
+				}
+			}
+		}
+
+		void emitStatement(const IrInstruction &instruction)
+		{
+			if (instruction.producesValue())
+			{
+				if (uses(&instruction) == 0)
+				{
+					if (!irIsRemovable(instruction))
+					{
+						emitExpression(instruction);
+						m_out << ";\n";
+					}
+					return;
+				}
+				if (instruction.type->kind == IrType::Kind::Texture)
+				{
+					throw std::runtime_error("cannot hold a texture in a temporary of function '" + m_function.name + "'");
+				}
+				const std::string name = "_t" + std::to_string(m_names.size());
+				declare(*instruction.type, name);
+				m_out << " = ";
+				emitExpression(instruction);
+				m_out << ";\n";
+				m_names.emplace(&instruction, name);
+				return;
+			}
+
+			switch (instruction.opcode)
+			{
+				case IrOpcode::Store:
+					emitExpressionStatement(instruction);
+					m_out << ";\n";
+					break;
+				case IrOpcode::Declare:
+					emitDeclare(instruction);
+					m_out << ";\n";
+					break;
+				case IrOpcode::Scope:
+					emitScope(instruction);
+					break;
+				case IrOpcode::If:
+					emitIf(instruction);
+					break;
+				case IrOpcode::Loop:
+					emitLoop(instruction);
+					break;
+				case IrOpcode::BreakUnless:
+					m_out << "if (";
+					emitNegated(*instruction.operands[0]);
+					m_out << ")\n{\n";
+					m_out.indent();
+					m_out << "break;\n";
+					m_out.dedent();
+					m_out << "}\n";
+					break;
+				case IrOpcode::Return:
+					m_out << "return";
+					if (!instruction.operands.empty())
+					{
+						m_out << " ";
+						emitExpression(*instruction.operands[0]);
+					}
+					m_out << ";\n";
+					break;
+				case IrOpcode::Break:
+					m_out << "break;\n";
+					break;
+				case IrOpcode::Continue:
+					m_out << "continue;\n";
+					break;
+				case IrOpcode::Discard:
+					m_out << "discard;\n";
+					break;
+				default:
+					emitExpression(instruction);
+					m_out << ";\n";
+					break;
+			}
+		}
+
+		void emitIf(const IrInstruction &instruction)
+		{
+			m_out << "if (";
+			emitExpression(*instruction.operands[0]);
+			m_out << ")\n";
+			emitBraced(*instruction.blocks[0]);
+			const IrBlock &otherwise = *instruction.blocks[1];
+			if (otherwise.instructions.empty())
+			{
+				return;
+			}
+			// An else block holding nothing but another if, once its condition is inlined, is an else-if chain.
+			planBlock(otherwise);
+			const std::vector<const IrInstruction *> statements = statementsOf(otherwise);
+			if (statements.size() == 1 && statements.front()->opcode == IrOpcode::If)
+			{
+				m_out << "else ";
+				emitIf(*statements.front());
+				return;
+			}
+			m_out << "else\n";
+			emitBraced(otherwise);
+		}
+
+		void declare(const IrType &type, const std::string &name)
+		{
+			m_out << type.glsl << " " << name;
+			if (type.isArray)
+			{
+				m_out << "[";
+				if (type.arraySize)
+				{
+					m_out << *type.arraySize;
+				}
+				m_out << "]";
+			}
+		}
+
+		void emitDeclare(const IrInstruction &instruction)
+		{
+			declare(*instruction.variable->type, instruction.variable->name);
+			if (!instruction.operands.empty())
+			{
+				m_out << " = ";
+				emitExpression(*instruction.operands[0]);
+			}
+		}
+
+		void emitExpressionStatement(const IrInstruction &instruction)
+		{
+			if (instruction.opcode == IrOpcode::Store)
+			{
+				emitExpression(*instruction.operands[0]);
+				m_out << " = ";
+				emitExpression(*instruction.operands[1]);
+				return;
+			}
+			emitExpression(instruction);
+		}
+
+		void emitExpressionList(const std::vector<const IrInstruction *> &statements)
+		{
+			for (std::size_t i = 0; i < statements.size(); ++i)
+			{
+				if (i > 0)
+				{
+					m_out << ", ";
+				}
+				emitExpressionStatement(*statements[i]);
+			}
+		}
+
+		// A scope holding a loop and what its for header initializes is written back as a single for loop.
+		void emitScope(const IrInstruction &scope)
+		{
+			const IrBlock &body = *scope.blocks[0];
+			if (!body.instructions.empty() && body.instructions.back()->opcode == IrOpcode::Loop)
+			{
+				planBlock(body);
+				std::vector<const IrInstruction *> initializers = statementsOf(body);
+				initializers.pop_back();
+				const bool singleDeclaration =
+				    initializers.size() == 1 && initializers.front()->opcode == IrOpcode::Declare;
+				const IrInstruction &loop = *body.instructions.back();
+				if ((singleDeclaration || expressionsOnly(initializers)) && !loop.isPostTest && compactLoop(loop))
+				{
+					m_out << "for (";
+					if (singleDeclaration)
+					{
+						emitDeclare(*initializers.front());
+					}
+					else
+					{
+						emitExpressionList(initializers);
+					}
+					emitLoopHeader(loop);
+					return;
+				}
+			}
+			emitBraced(body);
+		}
+
+		// Whether the loop's condition and continue block fit in a while or for header.
+		bool compactLoop(const IrInstruction &loop)
+		{
+			planBlock(*loop.blocks[0]);
+			planBlock(*loop.blocks[2]);
+			const std::vector<const IrInstruction *> header = statementsOf(*loop.blocks[0]);
+			const bool conditionOnly =
+			    header.empty() || (header.size() == 1 && header.front()->opcode == IrOpcode::BreakUnless);
+			return conditionOnly && expressionsOnly(statementsOf(*loop.blocks[2]));
+		}
+
+		// Writes "; condition; continue)" and the body of a compact pre-test loop.
+		void emitLoopHeader(const IrInstruction &loop)
+		{
+			const std::vector<const IrInstruction *> header = statementsOf(*loop.blocks[0]);
+			m_out << "; ";
+			if (!header.empty())
+			{
+				emitExpression(*header.front()->operands[0]);
+			}
+			m_out << "; ";
+			emitExpressionList(statementsOf(*loop.blocks[2]));
+			m_out << ")\n";
+			emitBraced(*loop.blocks[1]);
+		}
+
+		void emitLoop(const IrInstruction &loop)
+		{
+			const IrBlock &header = *loop.blocks[0];
+			const IrBlock &body = *loop.blocks[1];
+			const IrBlock &continuation = *loop.blocks[2];
+			if (compactLoop(loop))
+			{
+				const std::vector<const IrInstruction *> condition = statementsOf(header);
+				if (loop.isPostTest && continuation.instructions.empty() && !condition.empty())
+				{
+					m_out << "do\n";
+					emitBraced(body);
+					m_out << "while (";
+					emitExpression(*condition.front()->operands[0]);
+					m_out << ");\n";
+					return;
+				}
+				if (!loop.isPostTest && statementsOf(continuation).empty() && !condition.empty())
+				{
+					m_out << "while (";
+					emitExpression(*condition.front()->operands[0]);
+					m_out << ")\n";
+					emitBraced(body);
+					return;
+				}
+				if (!loop.isPostTest)
+				{
+					m_out << "for (";
+					emitLoopHeader(loop);
+					return;
+				}
+			}
+
+			// The header or the continue block needs statements of its own. A flag skips the continue block, and the
+			// header of a post-test loop, on the first iteration; continue jumps to the flag update, so they still
+			// run before every later iteration.
+			const bool needsFlag = loop.isPostTest || !continuation.instructions.empty();
+			const std::string flag = "_t" + std::to_string(m_names.size());
+			if (needsFlag)
+			{
+				m_names.emplace(&loop, flag);
+				m_out << "for (bool " << flag << " = true; ; " << flag << " = false)\n";
+			}
+			else
+			{
+				m_out << "while (true)\n";
+			}
+			m_out << "{\n";
+			m_out.indent();
+			if (needsFlag)
+			{
+				m_out << "if (!" << flag << ")\n{\n";
+				m_out.indent();
+				emitBlock(continuation);
+				if (loop.isPostTest)
+				{
+					emitBlock(header);
+				}
+				m_out.dedent();
+				m_out << "}\n";
+			}
+			if (!loop.isPostTest)
+			{
+				emitBlock(header);
+			}
+			emitBlock(body);
+			m_out.dedent();
+			m_out << "}\n";
+		}
+
+		void emitNegated(const IrInstruction &value)
+		{
+			const bool parenthesized = !m_names.count(&value) &&
+			                           (value.opcode == IrOpcode::Binary || value.opcode == IrOpcode::Select);
+			m_out << (parenthesized ? "!" : "!(");
+			emitExpression(value);
+			if (!parenthesized)
+			{
+				m_out << ")";
+			}
+		}
+
+		// Operands written before a postfix or after a prefix operator get parentheses unless they bind tighter.
+		void emitTight(const IrInstruction &value)
+		{
+			const bool wrap = !m_names.count(&value) &&
+			                  (value.opcode == IrOpcode::Unary || value.opcode == IrOpcode::Increment ||
+			                      value.opcode == IrOpcode::Opaque);
+			if (wrap)
+			{
+				m_out << "(";
+			}
+			emitExpression(value);
+			if (wrap)
+			{
+				m_out << ")";
+			}
+		}
+
+		void emitAccesses(const IrInstruction &instruction, std::size_t firstIndexOperand)
+		{
+			std::size_t index = firstIndexOperand;
+			for (const IrAccess &access : instruction.accesses)
+			{
+				if (access.isIndex)
+				{
+					m_out << "[";
+					emitExpression(*instruction.operands[index++]);
+					m_out << "]";
+				}
+				else
+				{
+					m_out << "." << access.member;
+				}
+			}
+		}
+
+		void emitArguments(const IrInstruction &instruction)
+		{
+			m_out << instruction.text << "(";
+			for (std::size_t i = 0; i < instruction.operands.size(); ++i)
+			{
+				if (i > 0)
+				{
+					m_out << ", ";
+				}
+				emitExpression(*instruction.operands[i]);
+			}
+			m_out << ")";
+		}
+
+		void emitExpression(const IrInstruction &value)
+		{
+			if (const auto it = m_names.find(&value); it != m_names.end())
+			{
+				m_out << it->second;
+				return;
+			}
+
+			switch (value.opcode)
+			{
+				case IrOpcode::Constant:
+				case IrOpcode::Opaque:
+					m_out << value.text;
+					break;
+				case IrOpcode::Address:
+					m_out << value.variable->name;
+					emitAccesses(value, 0);
+					break;
+				case IrOpcode::Load:
+					emitExpression(*value.operands[0]);
+					break;
+				case IrOpcode::Unary:
+					m_out << irUnarySymbol(value.unaryOperator);
+					emitTight(*value.operands[0]);
+					break;
+				case IrOpcode::Binary:
+					m_out << "(";
+					emitExpression(*value.operands[0]);
+					m_out << " " << irBinarySymbol(value.binaryOperator) << " ";
+					emitExpression(*value.operands[1]);
+					m_out << ")";
+					break;
+				case IrOpcode::Select:
+					m_out << "(";
+					emitExpression(*value.operands[0]);
+					m_out << " ? ";
+					emitExpression(*value.operands[1]);
+					m_out << " : ";
+					emitExpression(*value.operands[2]);
+					m_out << ")";
+					break;
+				case IrOpcode::Construct:
+				case IrOpcode::CallBuiltin:
+				case IrOpcode::Call:
+					emitArguments(value);
+					break;
+				case IrOpcode::Extract:
+					emitTight(*value.operands[0]);
+					emitAccesses(value, 1);
+					break;
+				case IrOpcode::Increment:
+				{
+					const char *symbol = value.isDecrement ? "--" : "++";
+					if (!value.isPostfix)
+					{
+						m_out << symbol;
+					}
+					emitExpression(*value.operands[0]);
+					if (value.isPostfix)
+					{
+						m_out << symbol;
+					}
+					break;
+				}
+				default:
+					throw std::runtime_error("instruction without a value used as an expression in function '" +
+					                         m_function.name + "'");
+			}
+		}
+
+		const IrFunction &m_function;
+		CodeWriter &m_out;
+		std::unordered_map<const IrInstruction *, std::size_t> m_uses;
+		// The user of values with a single use.
+		std::unordered_map<const IrInstruction *, const IrInstruction *> m_users;
+		std::unordered_map<const IrInstruction *, Location> m_locations;
+		std::unordered_set<const IrInstruction *> m_inlined;
+		std::unordered_map<const IrInstruction *, std::string> m_names;
+	};
+}
+
+void emitIrFunction(const IrFunction &p_function, CodeWriter &p_out)
+{
+	IrGlslWriter(p_function, p_out).emit();
+}
@@ -0,0 +1,435 @@
+#include "ir_passes.hpp"
+
+#include "pass_timing.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace
+{
+	using UseCounts = std::unordered_map<const IrInstruction *, std::size_t>;
+
+	// Walks the block backwards so a value is only examined once everything after it had its chance to go.
+	bool eliminateInBlock(IrBlock &block, UseCounts &uses, std::size_t &removedCount)
+	{
+		bool changed = false;
+		std::vector<std::unique_ptr<IrInstruction>> &instructions = block.instructions;
+
+		const auto terminator = std::find_if(instructions.begin(), instructions.end(),
+		    [](const std::unique_ptr<IrInstruction> &instruction) { return irIsTerminator(*instruction); });
+		if (terminator != instructions.end() && terminator + 1 != instructions.end())
+		{
+			// What follows a terminator never runs, so nothing that runs can use it. The use counts of its operands
+			// go stale until the next round recounts them.
+			removedCount += static_cast<std::size_t>(instructions.end() - (terminator + 1));
+			instructions.erase(terminator + 1, instructions.end());
+			changed = true;
+		}
+
+		std::vector<bool> removed(instructions.size(), false);
+		for (std::size_t i = instructions.size(); i-- > 0;)
+		{
+			IrInstruction &instruction = *instructions[i];
+			for (const std::unique_ptr<IrBlock> &nested : instruction.blocks)
+			{
+				changed = eliminateInBlock(*nested, uses, removedCount) || changed;
+			}
+			if (!irIsRemovable(instruction) || uses[&instruction] != 0)
+			{
+				continue;
+			}
+			for (const IrInstruction *operand : instruction.operands)
+			{
+				--uses[operand];
+			}
+			removed[i] = true;
+			++removedCount;
+			changed = true;
+		}
+
+		std::size_t index = 0;
+		instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+		                       [&](const std::unique_ptr<IrInstruction> &) { return removed[index++]; }),
+		    instructions.end());
+		return changed;
+	}
+
+	// Drops the declarations of and stores to locals nothing reads, leaving the values they held unused.
+	bool removeUnreadLocals(IrFunction &function, std::size_t &removedCount)
+	{
+		std::unordered_set<const IrVariable *> unread;
+		for (const std::unique_ptr<IrVariable> &variable : function.variables)
+		{
+			if (variable->storage == IrVariable::Storage::Local)
+			{
+				unread.insert(variable.get());
+			}
+		}
+		bool readsAnything = false;
+		irForEachInstruction(static_cast<const IrBlock &>(function.body), [&](const IrInstruction &instruction) {
+			readsAnything = readsAnything || instruction.opcode == IrOpcode::Opaque;
+			for (std::size_t i = 0; i < instruction.operands.size(); ++i)
+			{
+				const IrInstruction *operand = instruction.operands[i];
+				if (operand->opcode == IrOpcode::Address && !(instruction.opcode == IrOpcode::Store && i == 0))
+				{
+					unread.erase(operand->variable);
+				}
+			}
+		});
+		if (readsAnything || unread.empty())
+		{
+			return false;
+		}
+
+		bool changed = false;
+		const std::function<void(IrBlock &)> visit = [&](IrBlock &block) {
+			std::vector<std::unique_ptr<IrInstruction>> &instructions = block.instructions;
+			const auto end = std::remove_if(
+			    instructions.begin(), instructions.end(), [&](const std::unique_ptr<IrInstruction> &instruction) {
+				    const IrVariable *variable = instruction->opcode == IrOpcode::Declare ? instruction->variable
+				                                 : instruction->opcode == IrOpcode::Store ? instruction->operands[0]->variable
+				                                                                          : nullptr;
+				    return variable && unread.count(variable) != 0;
+			    });
+			removedCount += static_cast<std::size_t>(instructions.end() - end);
+			changed = changed || end != instructions.end();
+			instructions.erase(end, instructions.end());
+			for (const std::unique_ptr<IrInstruction> &instruction : instructions)
+			{
+				for (const std::unique_ptr<IrBlock> &nested : instruction->blocks)
+				{
+					visit(*nested);
+				}
+			}
+		};
+		visit(function.body);
+		return changed;
+	}
+
+	// Value numbering over the dominator tree, which structured control flow makes explicit: an instruction
+	// dominates what follows it in its block and everything nested there. Values are keyed by what they compute
+	// from the numbers of their operands; loads also by the version of each variable they read, bumped by every
+	// write that may reach it.
+	class ValueNumbering
+	{
+	public:
+		explicit ValueNumbering(IrFunction &function) : m_function(function) {}
+
+		bool run(std::vector<std::string> &remarks)
+		{
+			visitBlock(m_function.body);
+			for (const IrInstruction *leader : m_reusedOrder)
+			{
+				const std::size_t reuses = m_reuseCounts.at(leader);
+				remarks.push_back(m_function.name + ": " + irExpressionText(*leader) + " computed once instead of " +
+				                  std::to_string(reuses + 1) + " times");
+			}
+			return !m_replacements.empty();
+		}
+
+	private:
+		static bool isCommutative(const IrInstruction &instruction)
+		{
+			switch (instruction.binaryOperator)
+			{
+				case BinaryOperator::Add:
+				case BinaryOperator::Equal:
+				case BinaryOperator::NotEqual:
+				case BinaryOperator::BitwiseAnd:
+				case BinaryOperator::BitwiseOr:
+				case BinaryOperator::BitwiseXor:
+					return true;
+				case BinaryOperator::Multiply:
+					// Matrix products depend on the order of their operands.
+					return instruction.operands[0]->type->kind != IrType::Kind::Matrix &&
+					       instruction.operands[1]->type->kind != IrType::Kind::Matrix;
+				default:
+					return false;
+			}
+		}
+
+		// Held in a temporary when reused. Constants, addresses, loads of a whole variable and reads of memory the
+		// GPU serves directly are as cheap to write again, and textures cannot be held at all.
+		static bool isWorthReusing(const IrInstruction &instruction)
+		{
+			if (instruction.type->kind == IrType::Kind::Texture)
+			{
+				return false;
+			}
+			switch (instruction.opcode)
+			{
+				case IrOpcode::Constant:
+				case IrOpcode::Address:
+					return false;
+				case IrOpcode::Load:
+				{
+					// DataBlock, uniform and input reads come straight from memory the GPU keeps them in, so a copy
+					// in a local only adds register pressure.
+					const IrInstruction &address = *instruction.operands[0];
+					const IrVariable::Storage storage = address.variable->storage;
+					return !address.accesses.empty() && storage != IrVariable::Storage::Block &&
+					       storage != IrVariable::Storage::Input && !address.variable->readOnly;
+				}
+				default:
+					return true;
+			}
+		}
+
+		static void appendNumber(std::string &key, std::uintptr_t value)
+		{
+			key += std::to_string(value);
+			key += ',';
+		}
+
+		const IrInstruction *numberOf(const IrInstruction *instruction) const
+		{
+			const auto it = m_numbers.find(instruction);
+			return it == m_numbers.end() ? instruction : it->second;
+		}
+
+		bool isGlobal(const IrVariable *variable) const
+		{
+			return variable->storage != IrVariable::Storage::Local &&
+			       variable->storage != IrVariable::Storage::Parameter;
+		}
+
+		// Nothing for instructions that are not numbered: those with effects other than reads, or a value of their
+		// own.
+		std::optional<std::string> keyOf(const IrInstruction &instruction) const
+		{
+			if (!instruction.producesValue() || !irIsRemovable(instruction))
+			{
+				return std::nullopt;
+			}
+			const IrMemoryEffects effects = irMemoryEffects(instruction);
+			if (effects.readsAnything || effects.readsGlobals || effects.hasWrites() || effects.exits)
+			{
+				return std::nullopt;
+			}
+
+			std::string key;
+			appendNumber(key, static_cast<std::uintptr_t>(instruction.opcode));
+			appendNumber(key, reinterpret_cast<std::uintptr_t>(instruction.type));
+			appendNumber(key, reinterpret_cast<std::uintptr_t>(instruction.variable));
+			appendNumber(key, static_cast<std::uintptr_t>(instruction.binaryOperator));
+			appendNumber(key, static_cast<std::uintptr_t>(instruction.unaryOperator));
+			std::vector<const IrInstruction *> operands;
+			for (const IrInstruction *operand : instruction.operands)
+			{
+				operands.push_back(numberOf(operand));
+			}
+			if (instruction.opcode == IrOpcode::Binary && isCommutative(instruction) && operands[1] < operands[0])
+			{
+				std::swap(operands[0], operands[1]);
+			}
+			for (const IrInstruction *operand : operands)
+			{
+				appendNumber(key, reinterpret_cast<std::uintptr_t>(operand));
+			}
+			for (const IrVariable *variable : effects.reads)
+			{
+				const auto version = m_versions.find(variable);
+				appendNumber(key, version == m_versions.end() ? 0 : version->second);
+				appendNumber(key, isGlobal(variable) ? m_globalsVersion : 0);
+			}
+			appendNumber(key, effects.reads.empty() ? 0 : m_anythingVersion);
+			for (const IrAccess &access : instruction.accesses)
+			{
+				key += access.isIndex ? "[]" : "." + access.member;
+			}
+			key += '|';
+			key += instruction.text;
+			return key;
+		}
+
+		void applyWrites(const IrMemoryEffects &effects)
+		{
+			for (const IrVariable *variable : effects.writes)
+			{
+				++m_versions[variable];
+			}
+			if (effects.writesGlobals)
+			{
+				++m_globalsVersion;
+			}
+			if (effects.writesAnything)
+			{
+				++m_anythingVersion;
+			}
+		}
+
+		void visitBlock(IrBlock &block)
+		{
+			std::vector<std::string> defined;
+			for (const std::unique_ptr<IrInstruction> &instruction : block.instructions)
+			{
+				visitInstruction(*instruction, defined);
+			}
+			for (const std::string &key : defined)
+			{
+				m_available.erase(key);
+			}
+		}
+
+		void visitInstruction(IrInstruction &instruction, std::vector<std::string> &defined)
+		{
+			std::vector<const IrInstruction *> replacedOperands;
+			for (IrInstruction *&operand : instruction.operands)
+			{
+				if (const auto it = m_replacements.find(operand); it != m_replacements.end())
+				{
+					replacedOperands.push_back(operand);
+					operand = it->second;
+				}
+			}
+
+			if (!instruction.blocks.empty())
+			{
+				// A loop runs its blocks again after everything they write, so what they read must already differ
+				// from before the loop on their first pass.
+				const IrMemoryEffects effects = irMemoryEffects(instruction);
+				if (instruction.opcode == IrOpcode::Loop)
+				{
+					applyWrites(effects);
+				}
+				for (const std::unique_ptr<IrBlock> &nested : instruction.blocks)
+				{
+					visitBlock(*nested);
+				}
+				applyWrites(effects);
+				return;
+			}
+
+			if (const std::optional<std::string> key = keyOf(instruction))
+			{
+				const auto [it, inserted] = m_available.emplace(*key, &instruction);
+				if (inserted)
+				{
+					defined.push_back(*key);
+				}
+				else
+				{
+					IrInstruction *leader = it->second;
+					m_numbers[&instruction] = numberOf(leader);
+					if (isWorthReusing(instruction))
+					{
+						m_replacements[&instruction] = leader;
+						applyWrites(irMemoryEffects(instruction));
+						return;
+					}
+				}
+			}
+			for (const IrInstruction *operand : replacedOperands)
+			{
+				report(operand);
+			}
+			applyWrites(irMemoryEffects(instruction));
+		}
+
+		// Only duplicates that are not themselves part of a larger duplicate are reported.
+		void report(const IrInstruction *duplicate)
+		{
+			if (!m_reported.insert(duplicate).second)
+			{
+				return;
+			}
+			const IrInstruction *leader = m_replacements.at(duplicate);
+			if (m_reuseCounts[leader]++ == 0)
+			{
+				m_reusedOrder.push_back(leader);
+			}
+		}
+
+		IrFunction &m_function;
+		// Values available at the current point, by key.
+		std::unordered_map<std::string, IrInstruction *> m_available;
+		// The earlier instruction computing the same value, for each numbered duplicate.
+		std::unordered_map<const IrInstruction *, const IrInstruction *> m_numbers;
+		std::unordered_map<const IrInstruction *, IrInstruction *> m_replacements;
+		std::unordered_map<const IrVariable *, std::size_t> m_versions;
+		std::size_t m_globalsVersion = 0;
+		std::size_t m_anythingVersion = 0;
+		std::unordered_set<const IrInstruction *> m_reported;
+		std::unordered_map<const IrInstruction *, std::size_t> m_reuseCounts;
+		std::vector<const IrInstruction *> m_reusedOrder;
+	};
+}
+
+void IrPassManager::add(const char *p_name, IrFunctionPass p_pass)
+{
+	m_passes.push_back({p_name, std::move(p_pass)});
+}
+
+std::vector<std::string> IrPassManager::run(IrModule &p_module) const
+{
+	std::vector<std::string> report;
+	for (const Entry &entry : m_passes)
+	{
+		bool changed = false;
+		{
+			PassTimer timer(entry.name);
+			for (const std::unique_ptr<IrFunction> &function : p_module.functions)
+			{
+				std::vector<std::string> remarks;
+				changed = entry.pass(*function, remarks) || changed;
+				for (const std::string &remark : remarks)
+				{
+					report.push_back(std::string(entry.name) + ": " + remark);
+				}
+			}
+		}
+		if (changed)
+		{
+			verifyIr(p_module);
+		}
+	}
+	return report;
+}
+
+bool IrCommonSubexpressionElimination::operator()(IrFunction &p_function, std::vector<std::string> &p_remarks) const
+{
+	return ValueNumbering(p_function).run(p_remarks);
+}
+
+bool IrDeadCodeElimination::operator()(IrFunction &p_function, std::vector<std::string> &p_remarks) const
+{
+	std::size_t removedCount = 0;
+	bool changed = false;
+	bool progress = true;
+	while (progress)
+	{
+		progress = false;
+		UseCounts uses = irUseCounts(p_function);
+		// Dropping a block's tail can leave values of enclosing blocks unused.
+		while (eliminateInBlock(p_function.body, uses, removedCount))
+		{
+			progress = true;
+			uses = irUseCounts(p_function);
+		}
+		// Dropping unused loads can leave a local only ever written, and dropping its stores can free their values.
+		if (removeUnreadLocals(p_function, removedCount))
+		{
+			progress = true;
+		}
+		changed = changed || progress;
+	}
+	if (removedCount != 0)
+	{
+		p_remarks.push_back(p_function.name + ": removed " + std::to_string(removedCount) + " instructions");
+	}
+	return changed;
+}
+
+IrPassManager defaultIrPipeline()
+{
+	IrPassManager manager;
+	manager.add("common subexpression elimination", IrCommonSubexpressionElimination());
+	manager.add("dead code elimination", IrDeadCodeElimination());
+	return manager;
+}
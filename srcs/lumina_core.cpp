@@ -0,0 +1,69 @@
+#include "lumina_core.hpp"
+
+#include "file_io.hpp"
+#include "pipeline.hpp"
+#include "source_manager.hpp"
+#include "tokenizer.hpp"
+
+#include <exception>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+CompileResult compileFromMemory(
+    std::string_view p_source, const VirtualFiles &p_virtualFiles, const InMemoryCompileOptions &p_options)
+{
+	CompileResult result;
+	std::ostringstream log;
+	{
+		DiagnosticScope scope(log, &result.diagnostics);
+		try
+		{
+			const IncludeReader reader = [&](const std::filesystem::path &path) -> std::optional<std::string> {
+				if (const auto it = p_virtualFiles.find(path.generic_string()); it != p_virtualFiles.end())
+				{
+					return it->second;
+				}
+				if (p_options.readFile)
+				{
+					if (std::optional<std::string> contents = p_options.readFile(path))
+					{
+						return contents;
+					}
+				}
+				std::error_code ec;
+				if (p_options.diskFallback && std::filesystem::is_regular_file(path, ec))
+				{
+					return readFile(path);
+				}
+				return std::nullopt;
+			};
+
+			std::vector<std::filesystem::path> includeDirectories = p_options.includeDirectories;
+			if (p_options.diskFallback)
+			{
+				for (std::filesystem::path &directory : SourceManager::getIncludeDirectories())
+				{
+					includeDirectories.push_back(std::move(directory));
+				}
+			}
+
+			std::vector<Token> tokens = Tokenizer()(p_options.origin, p_source);
+			PrecompilationParser precompilationParser(std::move(includeDirectories), reader);
+			precompilationParser(tokens);
+
+			ShaderArtifact artifact;
+			if (compileTokens(std::move(tokens), p_options.compile, log, artifact) == 0)
+			{
+				result.artifact = std::move(artifact);
+			}
+		} catch (const std::exception &e)
+		{
+			// Lexing and preprocessing failures carry their location in the message.
+			log << "error: " << e.what() << "\n";
+			result.diagnostics.push_back(Diagnostic{{}, 0, 0, e.what()});
+		}
+	}
+	result.log = log.str();
+	return result;
+}
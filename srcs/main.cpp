@@ -1,786 +1,289 @@
-#include "compiler.hpp"
-#include "parser.hpp"
-#include "semantic_parser.hpp"
-#include "source_manager.hpp"
+#include "compile_server.hpp"
+#include "pass_timing.hpp"
+#include "pipeline.hpp"
 #include "token.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
 
 #include <algorithm>
-#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 namespace
 {
-	std::string safeTokenContent(const Token &token)
-	{
-		return token.content.empty() ? "<anonymous>" : token.content;
-	}
+	// More workers than this only add threads contending for the same caches.
+	constexpr std::size_t kMaxWorkerCount = 1024;
 
-	std::string formatName(const Name &name)
+	// One job per line: `<input> <output> [<header.hpp>]`. Blank lines and lines starting with '#' are skipped,
+	// and relative paths are resolved against the manifest's directory.
+	std::vector<CompileJob> readBatchManifest(const std::filesystem::path &path)
 	{
-		if (name.parts.empty())
+		std::ifstream file(path);
+		if (!file)
 		{
-			return "<anonymous>";
+			throw std::runtime_error("cannot open batch manifest: " + path.string());
 		}
 
-		std::string text;
-		for (std::size_t i = 0; i < name.parts.size(); ++i)
-		{
-			if (i > 0)
-			{
-				text += "::";
-			}
-			text += safeTokenContent(name.parts[i]);
-		}
-		return text;
-	}
-
-	std::string stageToString(Stage stage)
-	{
-		switch (stage)
-		{
-			case Stage::Input:
-				return "Input";
-			case Stage::VertexPass:
-				return "VertexPass";
-			case Stage::FragmentPass:
-				return "FragmentPass";
-			case Stage::Output:
-				return "Output";
-		}
-		return "UnknownStage";
-	}
-
-	std::string indentString(std::size_t indent);
-	std::string expressionToString(const Expression &expression);
-	void printStatementSummary(const Statement &statement, std::size_t indent);
-	void printBlockSummary(const BlockStatement &block, std::size_t indent);
-
-	std::string aggregateKindToString(AggregateInstruction::Kind kind)
-	{
-		switch (kind)
-		{
-			case AggregateInstruction::Kind::Struct:
-				return "Struct";
-			case AggregateInstruction::Kind::AttributeBlock:
-				return "DataBlock(attribute)";
-			case AggregateInstruction::Kind::ConstantBlock:
-				return "DataBlock(constant)";
-		}
-		return "Aggregate";
-	}
-
-	std::string formatTypeName(const TypeName &type)
-	{
-		std::string text;
-		if (type.isConst)
-		{
-			text += "const ";
-		}
-		text += formatName(type.name);
-		return text;
-	}
-
-	std::string formatParameter(const Parameter &parameter)
-	{
-		std::string text = formatTypeName(parameter.type);
-		if (parameter.isReference)
-		{
-			text += " &";
-		}
-		text += " ";
-		text += safeTokenContent(parameter.name);
-		return text;
-	}
+		const std::filesystem::path baseDirectory = path.parent_path();
+		const auto resolve = [&](const std::string &field) {
+			const std::filesystem::path entry(field);
+			return entry.is_absolute() ? entry : baseDirectory / entry;
+		};
 
-	std::string formatParameters(const std::vector<Parameter> &parameters)
-	{
-		std::ostringstream oss;
-		for (std::size_t i = 0; i < parameters.size(); ++i)
+		std::vector<CompileJob> jobs;
+		std::string line;
+		std::size_t lineNumber = 0;
+		while (std::getline(file, line))
 		{
-			if (i > 0)
+			++lineNumber;
+			const std::size_t first = line.find_first_not_of(" \t\r");
+			if (first == std::string::npos || line[first] == '#')
 			{
-				oss << ", ";
+				continue;
 			}
-			oss << formatParameter(parameters[i]);
-		}
-		return oss.str();
-	}
 
-	std::string formatVariableDeclarator(const VariableDeclarator &declarator, bool verbose = false)
-	{
-		std::string text;
-		if (declarator.isReference)
-		{
-			text += "& ";
-		}
-		text += safeTokenContent(declarator.name);
-		if (declarator.hasArraySuffix)
-		{
-			text += "[";
-			if (declarator.arraySize)
+			std::vector<std::string> fields;
+			try
 			{
-				text += expressionToString(*declarator.arraySize);
-			}
-			else
-			{
-				text += verbose ? "<dynamic>" : "dynamic";
-			}
-			text += "]";
-		}
-		if (declarator.initializer)
-		{
-			text += " = ";
-			if (verbose && declarator.initializer)
+				fields = splitQuotedFields(line);
+			} catch (const std::exception &e)
 			{
-				text += expressionToString(*declarator.initializer);
+				throw std::runtime_error(path.string() + ":" + std::to_string(lineNumber) + ": " + e.what());
 			}
-			else
+			if (fields.size() < 2 || fields.size() > 3)
 			{
-				text += "<expr>";
+				throw std::runtime_error(path.string() + ":" + std::to_string(lineNumber) +
+				                         ": expected '<input> <output> [<header.hpp>]'");
 			}
-		}
-		if (declarator.hasTextureBinding)
-		{
-			text += " as ";
-			text += (declarator.textureBindingScope == TextureBindingScope::Attribute) ? "attribute" : "constant";
-		}
-		return text;
-	}
 
-	std::string formatDeclarators(const std::vector<VariableDeclarator> &declarators, bool verbose = false)
-	{
-		std::ostringstream oss;
-		for (std::size_t i = 0; i < declarators.size(); ++i)
-		{
-			if (i > 0)
+			CompileJob job;
+			job.inputPath = resolve(fields[0]);
+			job.outputPath = resolve(fields[1]);
+			if (fields.size() == 3)
 			{
-				oss << ", ";
+				job.cppHeaderPath = resolve(fields[2]);
 			}
-			oss << formatVariableDeclarator(declarators[i], verbose);
+			jobs.push_back(std::move(job));
 		}
-		return oss.str();
+		return jobs;
 	}
 
-	std::string assignmentOperatorToString(AssignmentOperator op)
+	// Compiles every job on a pool of workers sharing the process-wide source caches. Each job's diagnostics are
+	// buffered and printed in one piece once it finishes. Returns 0, or the exit code of the first failed job.
+	int compileBatch(const std::vector<CompileJob> &jobs, const CompileOptions &options, std::size_t workerCount)
 	{
-		switch (op)
-		{
-			case AssignmentOperator::Assign:
-				return "=";
-			case AssignmentOperator::AddAssign:
-				return "+=";
-			case AssignmentOperator::SubtractAssign:
-				return "-=";
-			case AssignmentOperator::MultiplyAssign:
-				return "*=";
-			case AssignmentOperator::DivideAssign:
-				return "/=";
-			case AssignmentOperator::ModuloAssign:
-				return "%=";
-			case AssignmentOperator::BitwiseAndAssign:
-				return "&=";
-			case AssignmentOperator::BitwiseOrAssign:
-				return "|=";
-			case AssignmentOperator::BitwiseXorAssign:
-				return "^=";
-			case AssignmentOperator::ShiftLeftAssign:
-				return "<<=";
-			case AssignmentOperator::ShiftRightAssign:
-				return ">>=";
-		}
-		return "=";
-	}
+		std::vector<int> statuses(jobs.size(), 0);
+		std::atomic<std::size_t> nextJob{0};
+		std::mutex outputMutex;
 
-	std::string binaryOperatorToString(BinaryOperator op)
-	{
-		switch (op)
-		{
-			case BinaryOperator::Add:
-				return "+";
-			case BinaryOperator::Subtract:
-				return "-";
-			case BinaryOperator::Multiply:
-				return "*";
-			case BinaryOperator::Divide:
-				return "/";
-			case BinaryOperator::Modulo:
-				return "%";
-			case BinaryOperator::Less:
-				return "<";
-			case BinaryOperator::LessEqual:
-				return "<=";
-			case BinaryOperator::Greater:
-				return ">";
-			case BinaryOperator::GreaterEqual:
-				return ">=";
-			case BinaryOperator::Equal:
-				return "==";
-			case BinaryOperator::NotEqual:
-				return "!=";
-			case BinaryOperator::LogicalAnd:
-				return "&&";
-			case BinaryOperator::LogicalOr:
-				return "||";
-			case BinaryOperator::BitwiseAnd:
-				return "&";
-			case BinaryOperator::BitwiseOr:
-				return "|";
-			case BinaryOperator::BitwiseXor:
-				return "^";
-			case BinaryOperator::ShiftLeft:
-				return "<<";
-			case BinaryOperator::ShiftRight:
-				return ">>";
-		}
-		return "?";
-	}
+		const auto worker = [&](std::size_t workerIndex) {
+			nameTraceThread("worker " + std::to_string(workerIndex));
+			for (std::size_t index = nextJob++; index < jobs.size(); index = nextJob++)
+			{
+				std::ostringstream log;
+				{
+					DiagnosticScope diagnostics(log);
+					TraceSpan span("batch", "compile");
+					span.setFile(jobs[index].inputPath);
+					statuses[index] = compileShader(jobs[index], options, log, log);
+				}
 
-	std::string unaryOperatorToString(UnaryOperator op)
-	{
-		switch (op)
-		{
-			case UnaryOperator::Positive:
-				return "+";
-			case UnaryOperator::Negate:
-				return "-";
-			case UnaryOperator::LogicalNot:
-				return "!";
-			case UnaryOperator::BitwiseNot:
-				return "~";
-			case UnaryOperator::PreIncrement:
-				return "++";
-			case UnaryOperator::PreDecrement:
-				return "--";
-		}
-		return "";
-	}
+				std::lock_guard lock(outputMutex);
+				std::cout << log.str() << std::flush;
+			}
+		};
 
-	std::string postfixOperatorToString(PostfixOperator op)
-	{
-		switch (op)
+		workerCount = std::clamp<std::size_t>(workerCount, 1, std::max<std::size_t>(jobs.size(), 1));
+		std::vector<std::thread> threads;
+		threads.reserve(workerCount - 1);
+		for (std::size_t i = 1; i < workerCount; ++i)
 		{
-			case PostfixOperator::Increment:
-				return "++";
-			case PostfixOperator::Decrement:
-				return "--";
+			threads.emplace_back(worker, i);
 		}
-		return "";
-	}
-
-	std::string expressionToString(const Expression &expression)
-	{
-		switch (expression.kind)
+		worker(0);
+		for (std::thread &thread : threads)
 		{
-			case Expression::Kind::Literal:
-			{
-				const auto &literal = static_cast<const LiteralExpression &>(expression);
-				return literal.literal.content.empty() ? "<literal>" : literal.literal.content;
-			}
-			case Expression::Kind::ArrayLiteral:
-			{
-				const auto &literal = static_cast<const ArrayLiteralExpression &>(expression);
-				std::string text = "{";
-				for (std::size_t i = 0; i < literal.elements.size(); ++i)
-				{
-					if (i > 0)
-					{
-						text += ", ";
-					}
-					text += literal.elements[i] ? expressionToString(*literal.elements[i]) : "<expr>";
-				}
-				text += "}";
-				return text;
-			}
-			case Expression::Kind::Identifier:
-			{
-				const auto &identifier = static_cast<const IdentifierExpression &>(expression);
-				return formatName(identifier.name);
-			}
-			case Expression::Kind::Unary:
-			{
-				const auto &unary = static_cast<const UnaryExpression &>(expression);
-				const std::string operand =
-				    unary.operand ? expressionToString(*unary.operand) : std::string("<expr>");
-				const std::string op = unaryOperatorToString(unary.op);
-				if (unary.op == UnaryOperator::PreIncrement || unary.op == UnaryOperator::PreDecrement ||
-				    unary.op == UnaryOperator::Positive || unary.op == UnaryOperator::Negate ||
-				    unary.op == UnaryOperator::LogicalNot || unary.op == UnaryOperator::BitwiseNot)
-				{
-					return op + operand;
-				}
-				return operand;
-			}
-			case Expression::Kind::Binary:
-			{
-				const auto &binary = static_cast<const BinaryExpression &>(expression);
-				const std::string left = binary.left ? expressionToString(*binary.left) : "<lhs>";
-				const std::string right = binary.right ? expressionToString(*binary.right) : "<rhs>";
-				return left + " " + binaryOperatorToString(binary.op) + " " + right;
-			}
-			case Expression::Kind::Assignment:
-			{
-				const auto &assignExpr = static_cast<const AssignmentExpression &>(expression);
-				const std::string target = assignExpr.target ? expressionToString(*assignExpr.target) : "<target>";
-				const std::string value = assignExpr.value ? expressionToString(*assignExpr.value) : "<value>";
-				return target + " " + assignmentOperatorToString(assignExpr.op) + " " + value;
-			}
-			case Expression::Kind::Conditional:
-			{
-				const auto &cond = static_cast<const ConditionalExpression &>(expression);
-				const std::string c = cond.condition ? expressionToString(*cond.condition) : "<cond>";
-				const std::string t = cond.thenBranch ? expressionToString(*cond.thenBranch) : "<then>";
-				const std::string e = cond.elseBranch ? expressionToString(*cond.elseBranch) : "<else>";
-				return c + " ? " + t + " : " + e;
-			}
-			case Expression::Kind::Call:
-			{
-				const auto &call = static_cast<const CallExpression &>(expression);
-				std::string text = call.callee ? expressionToString(*call.callee) : "<callee>";
-				text += "(";
-				for (std::size_t i = 0; i < call.arguments.size(); ++i)
-				{
-					if (i > 0)
-					{
-						text += ", ";
-					}
-					text += call.arguments[i] ? expressionToString(*call.arguments[i]) : "<arg>";
-				}
-				text += ")";
-				return text;
-			}
-			case Expression::Kind::MemberAccess:
-			{
-				const auto &member = static_cast<const MemberExpression &>(expression);
-				const std::string object = member.object ? expressionToString(*member.object) : "<object>";
-				return object + "." + safeTokenContent(member.member);
-			}
-			case Expression::Kind::IndexAccess:
-			{
-				const auto &index = static_cast<const IndexExpression &>(expression);
-				const std::string object = index.object ? expressionToString(*index.object) : "<object>";
-				const std::string idx = index.index ? expressionToString(*index.index) : "<index>";
-				return object + "[" + idx + "]";
-			}
-			case Expression::Kind::Postfix:
-			{
-				const auto &postfix = static_cast<const PostfixExpression &>(expression);
-				const std::string operand =
-				    postfix.operand ? expressionToString(*postfix.operand) : std::string("<expr>");
-				return operand + postfixOperatorToString(postfix.op);
-			}
+			thread.join();
 		}
 
-		return "<expr>";
-	}
-
-	void printStatementSummary(const Statement &statement, std::size_t indent)
-	{
-		const std::string pad = indentString(indent);
-		switch (statement.kind)
+		int exitStatus = 0;
+		std::size_t failed = 0;
+		for (std::size_t i = 0; i < jobs.size(); ++i)
 		{
-			case Statement::Kind::Block:
+			if (statuses[i] == 0)
 			{
-				const auto &block = static_cast<const BlockStatement &>(statement);
-				printBlockSummary(block, indent);
-				break;
-			}
-			case Statement::Kind::Expression:
-			{
-				const auto &exprStmt = static_cast<const ExpressionStatement &>(statement);
-				if (exprStmt.expression)
-				{
-					std::cout << pad << expressionToString(*exprStmt.expression) << '\n';
-				}
-				else
-				{
-					std::cout << pad << "(expression)\n";
-				}
-				break;
-			}
-			case Statement::Kind::Variable:
-			{
-				const auto &varStmt = static_cast<const VariableStatement &>(statement);
-				std::cout << pad << formatTypeName(varStmt.declaration.type) << " "
-				          << formatDeclarators(varStmt.declaration.declarators, true) << ";\n";
-				break;
-			}
-			case Statement::Kind::If:
-			{
-				const auto &ifStmt = static_cast<const IfStatement &>(statement);
-				const std::string cond =
-				    ifStmt.condition ? expressionToString(*ifStmt.condition) : std::string("<cond>");
-				std::cout << pad << "if (" << cond << ")\n";
-				if (ifStmt.thenBranch)
-				{
-					printStatementSummary(*ifStmt.thenBranch, indent + 2);
-				}
-				else
-				{
-					std::cout << indentString(indent + 2) << "(missing then-branch)\n";
-				}
-				if (ifStmt.elseBranch)
-				{
-					std::cout << pad << "else\n";
-					printStatementSummary(*ifStmt.elseBranch, indent + 2);
-				}
-				break;
-			}
-			case Statement::Kind::While:
-			{
-				const auto &whileStmt = static_cast<const WhileStatement &>(statement);
-				const std::string cond =
-				    whileStmt.condition ? expressionToString(*whileStmt.condition) : std::string("<cond>");
-				std::cout << pad << "while (" << cond << ")\n";
-				if (whileStmt.body)
-				{
-					printStatementSummary(*whileStmt.body, indent + 2);
-				}
-				break;
-			}
-			case Statement::Kind::DoWhile:
-			{
-				const auto &doWhile = static_cast<const DoWhileStatement &>(statement);
-				std::cout << pad << "do\n";
-				if (doWhile.body)
-				{
-					printStatementSummary(*doWhile.body, indent + 2);
-				}
-				const std::string cond =
-				    doWhile.condition ? expressionToString(*doWhile.condition) : std::string("<cond>");
-				std::cout << pad << "while (" << cond << ");\n";
-				break;
-			}
-			case Statement::Kind::For:
-			{
-				const auto &forStmt = static_cast<const ForStatement &>(statement);
-				std::cout << pad << "for\n";
-				if (forStmt.initializer)
-				{
-					std::cout << indentString(indent + 2) << "initializer:\n";
-					printStatementSummary(*forStmt.initializer, indent + 4);
-				}
-				else
-				{
-					std::cout << indentString(indent + 2) << "initializer: (none)\n";
-				}
-				if (forStmt.condition)
-				{
-					std::cout << indentString(indent + 2)
-					          << "condition: " << expressionToString(*forStmt.condition) << '\n';
-				}
-				else
-				{
-					std::cout << indentString(indent + 2) << "condition: (none)\n";
-				}
-				if (forStmt.increment)
-				{
-					std::cout << indentString(indent + 2)
-					          << "increment: " << expressionToString(*forStmt.increment) << '\n';
-				}
-				else
-				{
-					std::cout << indentString(indent + 2) << "increment: (none)\n";
-				}
-				if (forStmt.body)
-				{
-					printStatementSummary(*forStmt.body, indent + 2);
-				}
-				break;
+				continue;
 			}
-			case Statement::Kind::Return:
+			++failed;
+			if (exitStatus == 0)
 			{
-				const auto &ret = static_cast<const ReturnStatement &>(statement);
-				if (ret.value)
-				{
-					std::cout << pad << "return " << expressionToString(*ret.value) << '\n';
-				}
-				else
-				{
-					std::cout << pad << "return\n";
-				}
-				break;
+				exitStatus = statuses[i];
 			}
-			case Statement::Kind::Break:
-				std::cout << pad << "break\n";
-				break;
-			case Statement::Kind::Continue:
-				std::cout << pad << "continue\n";
-				break;
-			case Statement::Kind::Discard:
-				std::cout << pad << "discard\n";
-				break;
+			std::cerr << "failed (exit " << statuses[i] << "): " << jobs[i].inputPath.string() << "\n";
 		}
+		std::cout << "Batch complete: " << (jobs.size() - failed) << " succeeded, " << failed << " failed\n";
+		return exitStatus;
 	}
 
-	void printBlockSummary(const BlockStatement &block, std::size_t indent)
+	int compileSingle(const CompileJob &job, CompileOptions options, std::optional<std::string_view> timePassesFormat)
 	{
-		const std::string pad = indentString(indent);
-		std::cout << pad << "{\n";
-		if (block.statements.empty())
+		if (!timePassesFormat)
 		{
-			std::cout << indentString(indent + 2) << "(empty)\n";
+			return compileShader(job, options, std::cout, std::cerr);
 		}
-		else
-		{
-			for (const std::unique_ptr<Statement> &statement : block.statements)
-			{
-				if (statement)
-				{
-					printStatementSummary(*statement, indent + 2);
-				}
-			}
-		}
-		std::cout << pad << "}\n";
-	}
 
-	void printOptionalBody(const BlockStatement *body, std::size_t indent)
-	{
-		if (body)
+		// Measured runs always compile: a compile cache hit would skip the stages being measured.
+		options.useCompileCache = false;
+		PassTimingReport report;
+#if !defined(LUMINA_COUNT_ALLOCATIONS)
+		report.countsAllocations = false;
+#endif
+		int status = 0;
 		{
-			printBlockSummary(*body, indent);
+			PassTimingScope scope(report);
+			status = compileShader(job, options, std::cout, std::cerr);
 		}
-		else
+		if (*timePassesFormat == "json")
 		{
-			std::cout << indentString(indent) << "(no body)\n";
+			report.printJson(std::cerr);
 		}
-	}
-
-	std::string operatorSymbolToString(const Token &symbol)
-	{
-		if (symbol.type == Token::Type::LeftBracket)
+		else
 		{
-			return "[]";
+			report.printTable(std::cerr);
 		}
-		return symbol.content;
-	}
-
-	std::string indentString(std::size_t indent)
-	{
-		return std::string(indent, ' ');
+		return status;
 	}
+}
 
-	void printStructMember(const StructMember &member, std::size_t indent);
-	void printInstruction(const Instruction &instruction, std::size_t indent);
-
-	void printTokens(const std::vector<Token> &tokens)
+int main(int argc, char **argv)
+{
+	try
 	{
-		using Row = std::array<std::string, 5>;
-		const Row headers = {"File name", "Line", "Column", "Type", "Content"};
-		std::array<std::size_t, headers.size()> widths;
-
-		for (std::size_t i = 0; i < headers.size(); ++i)
-		{
-			widths[i] = headers[i].size();
-		}
-
-		std::vector<Row> rows;
-		rows.reserve(tokens.size());
-
-		for (const Token &token : tokens)
+		CompileOptions options;
+		std::optional<std::filesystem::path> cppHeaderPath;
+		std::optional<std::filesystem::path> batchManifest;
+		std::optional<std::filesystem::path> serverSocket;
+		std::optional<std::filesystem::path> tracePath;
+		bool server = false;
+		std::optional<std::string_view> timePassesFormat;
+		std::size_t workerCount = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::string_view> positionalArgs;
+		for (int i = 1; i < argc; ++i)
 		{
-			Row row = {token.origin.string(),
-			    std::to_string(token.start.line + 1),
-			    std::to_string(token.start.column + 1),
-			    std::string(tokenTypeToString(token.type)),
-			    token.content};
-
-			for (std::size_t i = 0; i < row.size(); ++i)
+			const std::string_view arg = argv[i];
+			if (arg == "-d" || arg == "--debug")
 			{
-				widths[i] = std::max(widths[i], row[i].size());
+				options.debug = true;
+				continue;
 			}
 
-			rows.emplace_back(std::move(row));
-		}
-
-		const auto printRow = [&](const Row &row) {
-			for (std::size_t i = 0; i < row.size(); ++i)
+			if (arg == "--reorder-members")
 			{
-				const std::size_t padding = widths[i] - row[i].size();
-				std::cout << "| " << row[i] << std::string(padding, ' ') << ' ';
+				options.reorderMembers = true;
+				continue;
 			}
-			std::cout << "|\n";
-		};
 
-		const auto printSeparator = [&]() {
-			std::size_t totalWidth = 1;
-			for (std::size_t width : widths)
+			if (arg == "--ir")
 			{
-				totalWidth += width + 3;
+				options.useIr = true;
+				continue;
 			}
-			std::cout << std::string(totalWidth, '-') << '\n';
-		};
-
-		printRow(headers);
-		printSeparator();
-		for (const Row &row : rows)
-		{
-			printRow(row);
-		}
-		std::cout << std::flush;
-	}
 
-	void printStructMember(const StructMember &member, std::size_t indent)
-	{
-		const std::string pad = indentString(indent);
-		switch (member.kind)
-		{
-			case StructMember::Kind::Field:
-			{
-				const auto &field = static_cast<const FieldMember &>(member);
-				std::cout << pad << "* Field " << formatTypeName(field.declaration.type) << " : "
-				          << formatDeclarators(field.declaration.declarators) << "\n";
-				break;
-			}
-			case StructMember::Kind::Method:
+			if (arg == "--no-matrix-reassociation")
 			{
-				const auto &method = static_cast<const MethodMember &>(member);
-				std::cout << pad << "* Method " << safeTokenContent(method.name) << "("
-				          << formatParameters(method.parameters) << ") -> " << formatTypeName(method.returnType);
-				if (method.returnsReference)
-				{
-					std::cout << " &";
-				}
-				if (method.isConst)
-				{
-					std::cout << " const";
-				}
-				std::cout << "\n";
-				printOptionalBody(method.body.get(), indent + 2);
-				break;
+				options.reassociateMatrices = false;
+				continue;
 			}
-			case StructMember::Kind::Constructor:
+
+			if (arg == "--hoist-uniform-expressions")
 			{
-				const auto &ctor = static_cast<const ConstructorMember &>(member);
-				std::cout << pad << "* Constructor(" << formatParameters(ctor.parameters) << ")\n";
-				printOptionalBody(ctor.body.get(), indent + 2);
-				break;
+				options.hoistUniformExpressions = true;
+				continue;
 			}
-			case StructMember::Kind::Operator:
+
+			if (arg == "--move-to-vertex")
 			{
-				const auto &op = static_cast<const OperatorMember &>(member);
-				std::cout << pad << "* Operator " << operatorSymbolToString(op.symbol) << "("
-				          << formatParameters(op.parameters) << ") -> " << formatTypeName(op.returnType);
-				if (op.returnsReference)
-				{
-					std::cout << " &";
-				}
-				std::cout << "\n";
-				printOptionalBody(op.body.get(), indent + 2);
-				break;
+				options.moveAffineToVertex = true;
+				continue;
 			}
-		}
-	}
 
-	void printInstruction(const Instruction &instruction, std::size_t indent)
-	{
-		const std::string pad = indentString(indent);
-		switch (instruction.type)
-		{
-			case Instruction::Type::Pipeline:
+			if (arg == "--triangle-index-from-vertex")
 			{
-				const auto &pipeline = static_cast<const PipelineInstruction &>(instruction);
-				std::cout << pad << "- Pipeline " << stageToString(pipeline.source) << " -> "
-				          << stageToString(pipeline.destination) << " : " << formatTypeName(pipeline.payloadType) << " "
-				          << safeTokenContent(pipeline.variable) << "\n";
-				break;
+				options.triangleIndexFromVertex = true;
+				continue;
 			}
-			case Instruction::Type::Variable:
+
+			if (arg == "--pack-varyings")
 			{
-				const auto &variable = static_cast<const VariableInstruction &>(instruction);
-				std::cout << pad << "- Variable " << formatTypeName(variable.declaration.type) << " : "
-				          << formatDeclarators(variable.declaration.declarators) << "\n";
-				break;
+				options.packVaryings = true;
+				continue;
 			}
-			case Instruction::Type::Function:
+
+			if (arg == "--format")
 			{
-				const auto &function = static_cast<const FunctionInstruction &>(instruction);
-				std::cout << pad << "- Function " << formatTypeName(function.returnType);
-				if (function.returnsReference)
+				const std::string_view format = (i + 1 < argc) ? std::string_view(argv[++i]) : std::string_view{};
+				if (format != "json" && format != "binary")
 				{
-					std::cout << " &";
+					std::cerr << "--format expects 'json' or 'binary'\n";
+					return 2;
 				}
-				std::cout << " " << safeTokenContent(function.name) << "("
-				          << formatParameters(function.parameters) << ")\n";
-				printOptionalBody(function.body.get(), indent + 2);
-				break;
+				options.binaryOutput = format == "binary";
+				continue;
 			}
-			case Instruction::Type::StageFunction:
+
+			if (arg == "--time-passes" || arg == "--time-passes=json")
 			{
-				const auto &stageFunction = static_cast<const StageFunctionInstruction &>(instruction);
-				std::cout << pad << "- Stage " << stageToString(stageFunction.stage) << "("
-				          << formatParameters(stageFunction.parameters) << ")\n";
-				printOptionalBody(stageFunction.body.get(), indent + 2);
-				break;
+				timePassesFormat = arg == "--time-passes" ? "table" : "json";
+				continue;
 			}
-			case Instruction::Type::Aggregate:
+
+			if (arg == "--server")
 			{
-				const auto &aggregate = static_cast<const AggregateInstruction &>(instruction);
-				std::cout << pad << "- " << aggregateKindToString(aggregate.kind) << " "
-				          << safeTokenContent(aggregate.name) << "\n";
-				for (const std::unique_ptr<StructMember> &member : aggregate.members)
-				{
-					if (member)
-					{
-						printStructMember(*member, indent + 2);
-					}
-				}
-				break;
+				server = true;
+				continue;
 			}
-			case Instruction::Type::Namespace:
+
+			if (arg == "--emit-cpp-header" || arg == "--batch" || arg == "--socket" || arg == "--trace")
 			{
-				const auto &ns = static_cast<const NamespaceInstruction &>(instruction);
-				std::cout << pad << "- Namespace " << safeTokenContent(ns.name) << "\n";
-				for (const std::unique_ptr<Instruction> &child : ns.instructions)
+				if (i + 1 >= argc)
 				{
-					if (child)
-					{
-						printInstruction(*child, indent + 2);
-					}
+					std::cerr << "missing path after '" << arg << "'\n";
+					return 2;
 				}
-				break;
-			}
-		}
-	}
-
-	void printInstructions(const std::vector<std::unique_ptr<Instruction>> &instructions)
-	{
-		if (instructions.empty())
-		{
-			std::cout << "\nNo parsed instructions.\n";
-			return;
-		}
-
-		std::cout << "\nParsed instructions:\n";
-		for (const std::unique_ptr<Instruction> &instruction : instructions)
-		{
-			if (instruction)
-			{
-				printInstruction(*instruction, 0);
+				std::optional<std::filesystem::path> &target = arg == "--batch"    ? batchManifest
+				                                               : arg == "--socket" ? serverSocket
+				                                               : arg == "--trace"  ? tracePath
+				                                                                   : cppHeaderPath;
+				target = std::filesystem::path(argv[++i]);
+				continue;
 			}
-		}
-		std::cout << std::flush;
-	}
-}
 
-int main(int argc, char **argv)
-{
-	try
-	{
-		bool debug = false;
-		std::vector<std::string_view> positionalArgs;
-		for (int i = 1; i < argc; ++i)
-		{
-			const std::string_view arg = argv[i];
-			if (arg == "-d" || arg == "--debug")
+			if (arg == "-j" || arg == "--jobs")
 			{
-				debug = true;
+				const std::string_view value = (i + 1 < argc) ? std::string_view(argv[++i]) : std::string_view{};
+				std::size_t count = 0;
+				const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), count);
+				if (value.empty() || error != std::errc() || end != value.data() + value.size() || count == 0 ||
+				    count > kMaxWorkerCount)
+				{
+					std::cerr << "invalid value for '" << arg << "': expected a worker count from 1 to "
+					          << kMaxWorkerCount << "\n";
+					return 2;
+				}
+				workerCount = count;
 				continue;
 			}
 
@@ -793,83 +296,90 @@ int main(int argc, char **argv)
 			positionalArgs.push_back(arg);
 		}
 
-		if (positionalArgs.size() != 2)
+		if (serverSocket && !server)
 		{
-			std::cerr << "usage: lumina-compiler [-d|--debug] <input.lumina> <output.glsl>\n";
+			std::cerr << "--socket requires --server\n";
 			return 2;
 		}
 
-		const std::filesystem::path inputPath(positionalArgs[0]);
-		const std::filesystem::path outputPath(positionalArgs[1]);
-
-		resetErrorCount();
-		constexpr int kStageErrorExit = 5;
-
-		const auto abortOnErrors = [&](const char *stage, int previousCount) {
-			if (getErrorCount() > previousCount)
-			{
-				std::cerr << "Compilation aborted after " << stage << " due to errors.\n";
-				return true;
-			}
-			return false;
-		};
-
-		// 1) Retrieve tokens
-		const int lexingErrors = getErrorCount();
-		std::vector<Token> tokens = SourceManager::loadFile(inputPath);
-		if (abortOnErrors("lexing", lexingErrors))
+		if (timePassesFormat && (server || batchManifest))
 		{
-			return kStageErrorExit;
+			std::cerr << "--time-passes is only available when compiling a single file\n";
+			return 2;
 		}
 
-		if (debug)
+		if (server)
 		{
-			printTokens(tokens);
+			if (!positionalArgs.empty() || cppHeaderPath || batchManifest || options.debug || tracePath)
+			{
+				std::cerr << "--server reads its inputs from requests and cannot be combined with --batch, "
+				             "--emit-cpp-header, --debug or --trace\n";
+				return 2;
+			}
+			const CompileServer compileServer(options);
+			if (serverSocket)
+			{
+				return compileServer.listen(*serverSocket);
+			}
+			std::ios::sync_with_stdio(false);
+			compileServer.serve(std::cin, std::cout);
+			return 0;
 		}
 
-		// 2) Parse instruction syntaxically
-		Parser parser;
-		const int parseErrors = getErrorCount();
-		std::vector<std::unique_ptr<Instruction>> raw = parser(std::move(tokens));
-		if (abortOnErrors("syntax analysis", parseErrors))
+		if (batchManifest)
 		{
-			return kStageErrorExit;
+			if (!positionalArgs.empty() || cppHeaderPath || options.debug)
+			{
+				std::cerr << "--batch takes its inputs, outputs and headers from the manifest and cannot be combined "
+				             "with --debug\n";
+				return 2;
+			}
 		}
-
-		if (debug)
+		else if (positionalArgs.size() != 2)
 		{
-			printInstructions(raw);
+			std::cerr << "usage: lumina-compiler [-d|--debug] [--reorder-members] [--ir] [--no-matrix-reassociation] "
+			             "[--hoist-uniform-expressions] [--move-to-vertex] [--triangle-index-from-vertex] "
+			             "[--pack-varyings] [--format json|binary] [--emit-cpp-header <header.hpp>] "
+			             "[--time-passes[=json]] [--trace <trace.json>] <input.lumina> <output>\n"
+			             "       lumina-compiler [--reorder-members] [--ir] [--no-matrix-reassociation] "
+			             "[--hoist-uniform-expressions] [--move-to-vertex] [--triangle-index-from-vertex] "
+			             "[--pack-varyings] [--format json|binary] [-j <workers>] [--trace <trace.json>] "
+			             "--batch <manifest>\n"
+			             "       lumina-compiler [--reorder-members] [--ir] [--no-matrix-reassociation] "
+			             "[--hoist-uniform-expressions] [--move-to-vertex] [--triangle-index-from-vertex] "
+			             "[--pack-varyings] [--format json|binary] --server [--socket <path>]\n";
+			return 2;
 		}
 
-		// 3) Semantic checks
-		SemanticParser sema;
-		const int semanticErrors = getErrorCount();
-		SemanticParseResult semantic = sema(std::move(raw));
-		if (abortOnErrors("semantic analysis", semanticErrors))
+		// Traced runs always compile, so the trace shows every stage rather than a cache hit.
+		std::optional<TraceSession> trace;
+		if (tracePath)
 		{
-			return kStageErrorExit;
+			options.useCompileCache = false;
+			trace.emplace();
+			nameTraceThread("main");
 		}
 
-		// 4) Codegen
-		Compiler codegen(debug);
-		std::string glsl = codegen(semantic);
-
-		// 5) Output
-		std::ofstream out(outputPath, std::ios::binary);
-		if (!out)
+		int status = 0;
+		if (batchManifest)
 		{
-			std::cerr << "cannot open output: " << outputPath.string() << "\n";
-			return 3;
+			status = compileBatch(readBatchManifest(*batchManifest), options, workerCount);
 		}
-		out.write(glsl.data(), static_cast<std::streamsize>(glsl.size()));
-		if (!out)
+		else
 		{
-			std::cerr << "write failed: " << outputPath.string() << "\n";
-			return 4;
+			CompileJob job;
+			job.inputPath = std::filesystem::path(positionalArgs[0]);
+			job.outputPath = std::filesystem::path(positionalArgs[1]);
+			job.cppHeaderPath = cppHeaderPath;
+			status = compileSingle(job, options, timePassesFormat);
 		}
 
-		std::cout << "Compilation complete: " << outputPath.string() << "\n";
-		return 0;
+		if (trace && !trace->writeFile(*tracePath))
+		{
+			std::cerr << "cannot write trace: " << tracePath->string() << "\n";
+			return status != 0 ? status : 4;
+		}
+		return status;
 	} catch (const std::exception &e)
 	{
 		std::cerr << "error: " << e.what() << "\n";
@@ -0,0 +1,76 @@
+#include "output_sink.hpp"
+
+#include <charconv>
+#include <cstring>
+
+void OutputSink::write(const char *p_data, std::size_t p_size)
+{
+	if (p_size >= m_buffer.size())
+	{
+		// Large chunks (GLSL sources, string pools) skip the buffer entirely.
+		flush();
+		commit(p_data, p_size);
+		return;
+	}
+
+	if (m_used + p_size > m_buffer.size())
+	{
+		flush();
+	}
+	std::memcpy(m_buffer.data() + m_used, p_data, p_size);
+	m_used += p_size;
+}
+
+void OutputSink::flush()
+{
+	if (m_used > 0)
+	{
+		commit(m_buffer.data(), m_used);
+		m_used = 0;
+	}
+}
+
+void OutputSink::writeInteger(long long p_value)
+{
+	char digits[24];
+	const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), p_value);
+	write(digits, static_cast<std::size_t>(result.ptr - digits));
+}
+
+FileOutputSink::FileOutputSink(const std::filesystem::path &p_path)
+{
+	// OutputSink already buffers; a second buffer in the stream would only add a copy.
+	m_stream.rdbuf()->pubsetbuf(nullptr, 0);
+	m_stream.open(p_path, std::ios::binary);
+}
+
+FileOutputSink::~FileOutputSink()
+{
+	if (m_stream.is_open())
+	{
+		close();
+	}
+}
+
+bool FileOutputSink::isOpen() const
+{
+	return m_stream.is_open();
+}
+
+bool FileOutputSink::close()
+{
+	flush();
+	m_stream.close();
+	return !m_failed && !m_stream.fail();
+}
+
+void FileOutputSink::commit(const char *p_data, std::size_t p_size)
+{
+	if (m_failed || !m_stream.is_open())
+	{
+		m_failed = true;
+		return;
+	}
+	m_stream.write(p_data, static_cast<std::streamsize>(p_size));
+	m_failed = !m_stream;
+}
@@ -1,6 +1,8 @@
 
 #include "parser.hpp"
 
+#include "trace.hpp"
+
 #include <algorithm>
 #include <initializer_list>
 #include <string>
@@ -158,8 +160,13 @@ std::vector<Parser::Impl::InstructionPtr> Parser::Impl::parse(std::vector<Token>
         }
 
         const std::size_t startIndex = current;
+        TraceSpan span("parse", "parse");
         if (InstructionPtr instruction = parseInstruction())
         {
+            if (span.active())
+            {
+                span.setDetail(traceName(*instruction));
+            }
             instructions.push_back(std::move(instruction));
         }
 
@@ -0,0 +1,289 @@
+#include "pass_timing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <ostream>
+
+namespace
+{
+	// Allocations are only counted while at least one report is being collected.
+	std::atomic<int> g_activeScopes{0};
+	std::atomic<std::uint64_t> g_allocations{0};
+	std::atomic<std::int64_t> g_liveBytes{0};
+	std::atomic<std::int64_t> g_peakBytes{0};
+
+	thread_local PassTimingReport *t_report = nullptr;
+	thread_local std::size_t t_parent = PassTiming::kNoParent;
+
+	double wallSeconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double cpuSeconds()
+	{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+		timespec now{};
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+		return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1e-9;
+#else
+		return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+	}
+
+	void raisePeak(std::int64_t live)
+	{
+		std::int64_t peak = g_peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void writeJsonString(std::ostream &stream, const std::string &text)
+	{
+		stream << '"';
+		for (const char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				stream << '\\';
+			}
+			stream << c;
+		}
+		stream << '"';
+	}
+}
+
+void PassTimingReport::printTable(std::ostream &p_stream) const
+{
+	std::size_t nameWidth = 4;
+	for (const PassTiming &pass : passes)
+	{
+		nameWidth = std::max(nameWidth, pass.depth * 2 + pass.name.size());
+	}
+
+	const std::ios::fmtflags flags = p_stream.flags();
+	p_stream << std::left << std::setw(static_cast<int>(nameWidth)) << "Pass" << std::right << std::setw(8) << "Calls"
+	         << std::setw(12) << "Wall ms" << std::setw(12) << "CPU ms";
+	if (countsAllocations)
+	{
+		p_stream << std::setw(12) << "Allocs" << std::setw(12) << "Peak KiB";
+	}
+	p_stream << '\n';
+
+	double totalWall = 0.0;
+	double totalCpu = 0.0;
+	std::uint64_t totalAllocations = 0;
+	std::uint64_t totalPeak = 0;
+	p_stream << std::fixed << std::setprecision(3);
+	for (const PassTiming &pass : passes)
+	{
+		p_stream << std::left << std::setw(static_cast<int>(nameWidth)) << (std::string(pass.depth * 2, ' ') + pass.name)
+		         << std::right << std::setw(8) << pass.calls << std::setw(12) << pass.wallSeconds * 1000.0
+		         << std::setw(12) << pass.cpuSeconds * 1000.0;
+		if (countsAllocations)
+		{
+			p_stream << std::setw(12) << pass.allocations << std::setw(12) << std::setprecision(1)
+			         << static_cast<double>(pass.peakBytes) / 1024.0 << std::setprecision(3);
+		}
+		p_stream << '\n';
+		if (pass.parent == PassTiming::kNoParent)
+		{
+			totalWall += pass.wallSeconds;
+			totalCpu += pass.cpuSeconds;
+			totalAllocations += pass.allocations;
+			totalPeak = std::max(totalPeak, pass.peakBytes);
+		}
+	}
+	p_stream << std::left << std::setw(static_cast<int>(nameWidth)) << "total" << std::right << std::setw(8) << ""
+	         << std::setw(12) << totalWall * 1000.0 << std::setw(12) << totalCpu * 1000.0;
+	if (countsAllocations)
+	{
+		p_stream << std::setw(12) << totalAllocations << std::setw(12) << std::setprecision(1)
+		         << static_cast<double>(totalPeak) / 1024.0;
+	}
+	p_stream << '\n';
+	p_stream.flags(flags);
+}
+
+void PassTimingReport::printJson(std::ostream &p_stream) const
+{
+	p_stream << "{\"passes\":[";
+	for (std::size_t i = 0; i < passes.size(); ++i)
+	{
+		const PassTiming &pass = passes[i];
+		p_stream << (i == 0 ? "" : ",") << "{\"name\":";
+		writeJsonString(p_stream, pass.name);
+		p_stream << ",\"parent\":";
+		if (pass.parent == PassTiming::kNoParent)
+		{
+			p_stream << "null";
+		}
+		else
+		{
+			p_stream << pass.parent;
+		}
+		p_stream << ",\"calls\":" << pass.calls << ",\"wallMs\":" << pass.wallSeconds * 1000.0
+		         << ",\"cpuMs\":" << pass.cpuSeconds * 1000.0;
+		if (countsAllocations)
+		{
+			p_stream << ",\"allocations\":" << pass.allocations << ",\"peakBytes\":" << pass.peakBytes;
+		}
+		p_stream << '}';
+	}
+	p_stream << "]}\n";
+}
+
+PassTimingScope::PassTimingScope(PassTimingReport &p_report)
+{
+	t_report = &p_report;
+	t_parent = PassTiming::kNoParent;
+	++g_activeScopes;
+}
+
+PassTimingScope::~PassTimingScope()
+{
+	--g_activeScopes;
+	t_report = nullptr;
+	t_parent = PassTiming::kNoParent;
+}
+
+PassTimingHandoff::PassTimingHandoff() : m_target(t_report), m_parent(t_parent) {}
+
+PassTimingHandoff::Scope::Scope(PassTimingHandoff &p_handoff) : m_active(p_handoff.m_target != nullptr)
+{
+	if (m_active)
+	{
+		t_report = &p_handoff.m_helperReport;
+		t_parent = PassTiming::kNoParent;
+		++g_activeScopes;
+	}
+}
+
+PassTimingHandoff::Scope::~Scope()
+{
+	if (m_active)
+	{
+		--g_activeScopes;
+		t_report = nullptr;
+		t_parent = PassTiming::kNoParent;
+	}
+}
+
+void PassTimingHandoff::merge()
+{
+	if (!m_target)
+	{
+		return;
+	}
+
+	// Parents always come before their children, so each one is already mapped when a child needs it.
+	std::vector<std::size_t> mapped;
+	mapped.reserve(m_helperReport.passes.size());
+	std::vector<PassTiming> &passes = m_target->passes;
+	for (const PassTiming &helperPass : m_helperReport.passes)
+	{
+		const std::size_t parent = helperPass.parent == PassTiming::kNoParent ? m_parent : mapped[helperPass.parent];
+		const auto existing = std::find_if(passes.begin(), passes.end(),
+		    [&](const PassTiming &pass) { return pass.parent == parent && pass.name == helperPass.name; });
+		std::size_t index = static_cast<std::size_t>(existing - passes.begin());
+		if (existing == passes.end())
+		{
+			PassTiming pass;
+			pass.name = helperPass.name;
+			pass.parent = parent;
+			pass.depth = parent == PassTiming::kNoParent ? 0 : passes[parent].depth + 1;
+			passes.push_back(std::move(pass));
+		}
+
+		PassTiming &pass = passes[index];
+		pass.calls += helperPass.calls;
+		pass.wallSeconds += helperPass.wallSeconds;
+		pass.cpuSeconds += helperPass.cpuSeconds;
+		pass.allocations += helperPass.allocations;
+		pass.peakBytes = std::max(pass.peakBytes, helperPass.peakBytes);
+		mapped.push_back(index);
+	}
+	m_helperReport.passes.clear();
+}
+
+PassTimer::PassTimer(const char *p_name) : m_span("pass", p_name), m_report(t_report)
+{
+	if (!m_report)
+	{
+		return;
+	}
+
+	std::vector<PassTiming> &passes = m_report->passes;
+	const auto existing = std::find_if(passes.begin(), passes.end(),
+	    [&](const PassTiming &pass) { return pass.parent == t_parent && pass.name == p_name; });
+	if (existing != passes.end())
+	{
+		m_index = static_cast<std::size_t>(existing - passes.begin());
+	}
+	else
+	{
+		PassTiming pass;
+		pass.name = p_name;
+		pass.parent = t_parent;
+		pass.depth = t_parent == PassTiming::kNoParent ? 0 : passes[t_parent].depth + 1;
+		m_index = passes.size();
+		passes.push_back(std::move(pass));
+	}
+
+	m_previousParent = t_parent;
+	t_parent = m_index;
+
+	m_allocationsStart = g_allocations.load(std::memory_order_relaxed);
+	m_liveStart = g_liveBytes.load(std::memory_order_relaxed);
+	// The pass measures its own peak from the current level; the outer one is restored when it ends.
+	m_outerPeak = g_peakBytes.exchange(m_liveStart, std::memory_order_relaxed);
+	m_cpuStart = cpuSeconds();
+	m_wallStart = wallSeconds();
+}
+
+PassTimer::~PassTimer()
+{
+	if (!m_report)
+	{
+		return;
+	}
+
+	const double wallEnd = wallSeconds();
+	const double cpuEnd = cpuSeconds();
+	const std::int64_t peak = g_peakBytes.load(std::memory_order_relaxed);
+
+	PassTiming &pass = m_report->passes[m_index];
+	++pass.calls;
+	pass.wallSeconds += wallEnd - m_wallStart;
+	pass.cpuSeconds += cpuEnd - m_cpuStart;
+	pass.allocations += g_allocations.load(std::memory_order_relaxed) - m_allocationsStart;
+	const std::int64_t peakAboveStart = std::max<std::int64_t>(0, peak - m_liveStart);
+	pass.peakBytes = std::max(pass.peakBytes, static_cast<std::uint64_t>(peakAboveStart));
+
+	raisePeak(m_outerPeak);
+	t_parent = m_previousParent;
+}
+
+void recordAllocation(std::size_t p_bytes)
+{
+	if (g_activeScopes.load(std::memory_order_relaxed) == 0)
+	{
+		return;
+	}
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	raisePeak(g_liveBytes.fetch_add(static_cast<std::int64_t>(p_bytes), std::memory_order_relaxed) +
+	          static_cast<std::int64_t>(p_bytes));
+}
+
+void recordDeallocation(std::size_t p_bytes)
+{
+	if (g_activeScopes.load(std::memory_order_relaxed) == 0)
+	{
+		return;
+	}
+	g_liveBytes.fetch_sub(static_cast<std::int64_t>(p_bytes), std::memory_order_relaxed);
+}
@@ -0,0 +1,288 @@
+#include "pipeline.hpp"
+
+#include "binary_artifact_writer.hpp"
+#include "compile_cache.hpp"
+#include "compiler.hpp"
+#include "cpp_header_emitter.hpp"
+#include "debug_printer.hpp"
+#include "output_sink.hpp"
+#include "parser.hpp"
+#include "pass_timing.hpp"
+#include "semantic_parser.hpp"
+#include "source_manager.hpp"
+
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <utility>
+
+namespace
+{
+	// Returns 0 on success, or the exit code to report.
+	int writeOutputFile(const std::filesystem::path &path, const std::string &content, std::ostream &err)
+	{
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+		{
+			err << "cannot open output: " << path.string() << "\n";
+			return 3;
+		}
+		out.write(content.data(), static_cast<std::streamsize>(content.size()));
+		if (!out)
+		{
+			err << "write failed: " << path.string() << "\n";
+			return 4;
+		}
+		return 0;
+	}
+
+	void writeArtifact(const ShaderArtifact &artifact, bool binary, OutputSink &sink)
+	{
+		if (binary)
+		{
+			BinaryArtifactWriter()(artifact, sink);
+		}
+		else
+		{
+			Compiler::emitJson(artifact, sink);
+		}
+	}
+
+	int writeArtifactFile(const std::filesystem::path &path, const ShaderArtifact &artifact, bool binary, std::ostream &err)
+	{
+		FileOutputSink out(path);
+		if (!out.isOpen())
+		{
+			err << "cannot open output: " << path.string() << "\n";
+			return 3;
+		}
+		writeArtifact(artifact, binary, out);
+		if (!out.close())
+		{
+			err << "write failed: " << path.string() << "\n";
+			return 4;
+		}
+		return 0;
+	}
+
+	void printMemberReorders(const ShaderArtifact &artifact, std::ostream &out)
+	{
+		out << "Member reordering:\n";
+		for (const MemberReorderReport &report : artifact.memberReorders)
+		{
+			out << "  " << report.name << ": " << report.declaredSize << " -> " << report.reorderedSize << " bytes ("
+			    << (report.declaredSize - report.reorderedSize) << " saved)\n";
+		}
+	}
+
+	void printDerivedFields(const ShaderArtifact &artifact, std::ostream &out)
+	{
+		out << "Uniform expression hoisting:\n";
+		for (const DerivedBlockField &field : artifact.derivedFields)
+		{
+			out << "  " << field.block << "." << field.name << " = " << field.expression << "\n";
+		}
+	}
+
+	void printMovedVaryings(const ShaderArtifact &artifact, std::ostream &out)
+	{
+		out << "Fragment-to-vertex motion:\n";
+		for (const MovedVarying &moved : artifact.movedVaryings)
+		{
+			out << "  " << moved.varying.name << " (location " << moved.varying.location;
+			if (moved.varying.component != 0)
+			{
+				out << ", component " << moved.varying.component;
+			}
+			out << ") = " << moved.expression << "\n";
+		}
+	}
+
+	bool abortOnErrors(const char *stage, int previousCount, std::ostream &err)
+	{
+		if (getErrorCount() > previousCount)
+		{
+			err << "Compilation aborted after " << stage << " due to errors.\n";
+			return true;
+		}
+		return false;
+	}
+}
+
+int compileTokens(
+    std::vector<Token> p_tokens, const CompileOptions &p_options, std::ostream &p_err, ShaderArtifact &p_artifact)
+{
+	// 2) Parse instruction syntaxically
+	Parser parser;
+	const int parseErrors = getErrorCount();
+	std::vector<std::unique_ptr<Instruction>> raw;
+	{
+		PassTimer timer("syntax analysis");
+		raw = parser(std::move(p_tokens));
+	}
+	if (abortOnErrors("syntax analysis", parseErrors, p_err))
+	{
+		return kStageErrorExit;
+	}
+
+	if (p_options.debug)
+	{
+		printInstructions(raw);
+	}
+
+	// 3) Semantic checks
+	SemanticParser sema;
+	const int semanticErrors = getErrorCount();
+	SemanticParseResult semantic;
+	{
+		PassTimer timer("semantic analysis");
+		semantic = sema(std::move(raw));
+	}
+	if (abortOnErrors("semantic analysis", semanticErrors, p_err))
+	{
+		return kStageErrorExit;
+	}
+
+	// 4) Codegen
+	Compiler codegen(p_options);
+	PassTimer timer("code generation");
+	p_artifact = codegen.compile(semantic);
+	diagnosticStream() << compileReport(p_artifact, p_options);
+	return 0;
+}
+
+std::string compileReport(const ShaderArtifact &p_artifact, const CompileOptions &p_options)
+{
+	std::ostringstream report;
+	if (p_options.reorderMembers)
+	{
+		printMemberReorders(p_artifact, report);
+	}
+	if (p_options.hoistUniformExpressions)
+	{
+		printDerivedFields(p_artifact, report);
+	}
+	if (p_options.moveAffineToVertex)
+	{
+		printMovedVaryings(p_artifact, report);
+	}
+	return report.str();
+}
+
+int compileShader(const CompileJob &p_job, const CompileOptions &p_options, std::ostream &p_out, std::ostream &p_err)
+{
+	try
+	{
+		resetErrorCount();
+
+		// 1) Retrieve tokens
+		const int lexingErrors = getErrorCount();
+		std::vector<Token> tokens;
+		{
+			PassTimer timer("lexing");
+			tokens = *SourceManager::loadFile(p_job.inputPath);
+		}
+		if (abortOnErrors("lexing", lexingErrors, p_err))
+		{
+			return kStageErrorExit;
+		}
+
+		if (p_options.debug)
+		{
+			printTokens(tokens);
+		}
+
+		// A cache hit replays the stored outputs and report and skips every later stage. Debug runs always compile.
+		std::optional<CompileCache> cache;
+		std::string cacheKey;
+		const char *kind = artifactKind(p_options);
+		const std::string headerNamespace = CppHeaderEmitter::namespaceFor(p_job.inputPath);
+		if (const std::optional<std::filesystem::path> cacheDirectory = CompileCache::directoryFromEnvironment();
+		    cacheDirectory && p_options.useCompileCache && !p_options.debug)
+		{
+			cache.emplace(*cacheDirectory);
+			cacheKey = CompileCache::computeKey(tokens,
+			    cacheConfiguration(p_options, p_job.cppHeaderPath ? std::optional(headerNamespace) : std::nullopt));
+
+			const std::optional<std::string> report = cache->loadContent(cacheKey, kReportKind);
+			const bool hit = report && cache->restore(cacheKey, kind, p_job.outputPath) &&
+			                 (!p_job.cppHeaderPath || cache->restore(cacheKey, "hpp", *p_job.cppHeaderPath));
+			if (hit)
+			{
+				diagnosticStream() << *report;
+				p_out << "Compilation complete (cached): " << p_job.outputPath.string() << "\n";
+				return 0;
+			}
+		}
+
+		ShaderArtifact artifact;
+		if (const int status = compileTokens(std::move(tokens), p_options, p_err, artifact); status != 0)
+		{
+			return status;
+		}
+
+		// 5) Output
+		PassTimer outputTimer("output");
+		if (const int status = writeArtifactFile(p_job.outputPath, artifact, p_options.binaryOutput, p_err); status != 0)
+		{
+			return status;
+		}
+
+		if (p_job.cppHeaderPath)
+		{
+			CppHeaderEmitter headerEmitter(headerNamespace);
+			if (const int status = writeOutputFile(*p_job.cppHeaderPath, headerEmitter(artifact), p_err); status != 0)
+			{
+				return status;
+			}
+		}
+
+		if (cache)
+		{
+			cache->storeContent(cacheKey, kReportKind, compileReport(artifact, p_options));
+			cache->store(cacheKey, kind, p_job.outputPath);
+			if (p_job.cppHeaderPath)
+			{
+				cache->store(cacheKey, "hpp", *p_job.cppHeaderPath);
+			}
+		}
+
+		p_out << "Compilation complete: " << p_job.outputPath.string() << "\n";
+		return 0;
+	} catch (const std::exception &e)
+	{
+		p_err << "error: " << e.what() << "\n";
+		return 1;
+	}
+}
+
+const char *artifactKind(const CompileOptions &p_options)
+{
+	return p_options.binaryOutput ? "lmna" : "json";
+}
+
+std::string cacheConfiguration(const CompileOptions &p_options, const std::optional<std::string> &p_headerNamespace)
+{
+	std::string configuration = std::string("format=") + artifactKind(p_options);
+	configuration += p_options.reorderMembers ? ";reorder-members" : "";
+	configuration += p_options.useIr ? ";ir" : "";
+	configuration += p_options.reassociateMatrices ? "" : ";no-matrix-reassociation";
+	configuration += p_options.hoistUniformExpressions ? ";hoist-uniform-expressions" : "";
+	configuration += p_options.moveAffineToVertex ? ";move-to-vertex" : "";
+	configuration += p_options.triangleIndexFromVertex ? ";triangle-index-from-vertex" : "";
+	configuration += p_options.packVaryings ? ";pack-varyings" : "";
+	configuration += p_headerNamespace ? ";cpp-header=" + *p_headerNamespace : "";
+	return configuration;
+}
+
+std::string serializeArtifact(const ShaderArtifact &p_artifact, const CompileOptions &p_options)
+{
+	std::string result;
+	{
+		StringOutputSink sink(result);
+		writeArtifact(p_artifact, p_options.binaryOutput, sink);
+	}
+	return result;
+}
@@ -1,9 +1,12 @@
 #include "precompilation_parser.hpp"
 
+#include "pass_timing.hpp"
+#include "source_manager.hpp"
 #include "tokenizer.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 
-#include <algorithm>
+#include <memory>
 #include <sstream>
 #include <optional>
 #include <stdexcept>
@@ -11,6 +14,7 @@
 #include <string_view>
 #include <system_error>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -19,6 +23,8 @@ namespace
 	struct Macro
 	{
 		std::vector<Token> replacement;
+		// Set while the macro is on the expansion stack, so recursion is caught without scanning the stack.
+		bool expanding = false;
 	};
 
 	using MacroTable = std::unordered_map<std::string, Macro>;
@@ -27,7 +33,12 @@ namespace
 	{
 		MacroTable macros;
 		std::vector<std::string> macroExpansionStack;
-		std::vector<std::filesystem::path> includeStack;
+		// Files being expanded and files seen so far, by native path, for constant-time lookups on deep or wide
+		// include graphs.
+		std::unordered_set<std::filesystem::path::string_type> activeIncludes;
+		std::unordered_set<std::filesystem::path::string_type> seenIncludes;
+		std::vector<std::filesystem::path> includedFiles;
+		const IncludeReader *includeReader = nullptr;
 	};
 
 	std::string makeErrorPrefix(const Token &token)
@@ -51,8 +62,8 @@ namespace
 			return;
 		}
 
-		if (std::find(state.macroExpansionStack.begin(), state.macroExpansionStack.end(), token.content) !=
-		    state.macroExpansionStack.end())
+		Macro &macro = macroIt->second;
+		if (macro.expanding)
 		{
 			std::ostringstream oss;
 			oss << makeErrorPrefix(token) << "Recursive macro expansion of '" << token.content << "'";
@@ -72,11 +83,20 @@ namespace
 			throw std::runtime_error(oss.str());
 		}
 
+		// Only outermost expansions are timed, so nested ones are not counted twice.
+		std::optional<PassTimer> timer;
+		if (state.macroExpansionStack.empty())
+		{
+			timer.emplace("macro expansion");
+		}
+
 		state.macroExpansionStack.push_back(token.content);
-		for (const Token &macroToken : macroIt->second.replacement)
+		macro.expanding = true;
+		for (const Token &macroToken : macro.replacement)
 		{
 			appendWithExpansion(macroToken, out, state);
 		}
+		macro.expanding = false;
 		state.macroExpansionStack.pop_back();
 	}
 
@@ -270,6 +290,55 @@ namespace
 		throw std::runtime_error(makeErrorPrefix(operand) + "Cannot find include file '" + rawText + "'");
 	}
 
+	struct VirtualInclude
+	{
+		std::filesystem::path path;
+		std::string contents;
+	};
+
+	VirtualInclude resolveVirtualInclude(
+	    const Token &operand, const std::vector<std::filesystem::path> &includeDirs, const IncludeReader &reader)
+	{
+		const std::string rawText = decodeIncludeOperand(operand);
+		if (rawText.empty())
+		{
+			throw std::runtime_error(makeErrorPrefix(operand) + "#include target cannot be empty");
+		}
+
+		const std::filesystem::path requested(rawText);
+		std::vector<std::filesystem::path> candidates;
+		if (requested.is_absolute())
+		{
+			candidates.push_back(requested);
+		}
+		else
+		{
+			// Virtual sources often have bare names, so an empty directory still resolves next to them.
+			candidates.push_back(operand.origin.parent_path() / requested);
+			for (const std::vector<std::filesystem::path> *dirs : {&includeDirs, &systemPathDirectories()})
+			{
+				for (const std::filesystem::path &dir : *dirs)
+				{
+					if (!dir.empty())
+					{
+						candidates.push_back(dir / requested);
+					}
+				}
+			}
+		}
+
+		for (const std::filesystem::path &candidate : candidates)
+		{
+			const std::filesystem::path normalized = candidate.lexically_normal();
+			if (std::optional<std::string> contents = reader(normalized))
+			{
+				return VirtualInclude{normalized, std::move(*contents)};
+			}
+		}
+
+		throw std::runtime_error(makeErrorPrefix(operand) + "Cannot find include file '" + rawText + "'");
+	}
+
 	void processTokens(const std::vector<Token> &tokens, std::vector<Token> &out, PreprocessorState &state,
 	    const std::vector<std::filesystem::path> &includeDirs);
 
@@ -290,30 +359,49 @@ namespace
 			throw std::runtime_error(makeErrorPrefix(operandToken) + "Expected file literal in #include");
 		}
 
-		const std::filesystem::path resolved = resolveIncludePath(operandToken, includeDirs);
+		// Timed separately from the recursive expansion of the included tokens below.
+		std::optional<PassTimer> resolutionTimer(std::in_place, "include resolution");
+		std::optional<VirtualInclude> virtualInclude;
+		if (state.includeReader)
+		{
+			virtualInclude = resolveVirtualInclude(operandToken, includeDirs, *state.includeReader);
+		}
+		const std::filesystem::path resolved =
+		    virtualInclude ? virtualInclude->path : resolveIncludePath(operandToken, includeDirs);
 
-		if (std::find(state.includeStack.begin(), state.includeStack.end(), resolved) != state.includeStack.end())
+		if (state.activeIncludes.contains(resolved.native()))
 		{
 			std::ostringstream oss;
 			oss << makeErrorPrefix(operandToken) << "Recursive include detected for '" << resolved.string() << "'";
 			throw std::runtime_error(oss.str());
 		}
 
-		Tokenizer tokenizer;
-		std::vector<Token> includedTokens;
+		std::shared_ptr<const std::vector<Token>> includedTokens;
 		try
 		{
-			includedTokens = tokenizer(resolved);
+			includedTokens = virtualInclude
+			                     ? std::make_shared<const std::vector<Token>>(Tokenizer()(resolved, virtualInclude->contents))
+			                     : SourceManager::loadIncludedTokens(resolved);
 		}
 		catch (const std::exception &e)
 		{
 			throw std::runtime_error(makeErrorPrefix(operandToken) + "Failed to include '" + resolved.string() +
 			                         "': " + e.what());
 		}
+		resolutionTimer.reset();
 
-		state.includeStack.push_back(resolved);
-		processTokens(includedTokens, out, state, includeDirs);
-		state.includeStack.pop_back();
+		if (state.seenIncludes.insert(resolved.native()).second)
+		{
+			state.includedFiles.push_back(resolved);
+		}
+
+		state.activeIncludes.insert(resolved.native());
+		{
+			TraceSpan span("lexing", "preprocess");
+			span.setFile(resolved);
+			processTokens(*includedTokens, out, state, includeDirs);
+		}
+		state.activeIncludes.erase(resolved.native());
 
 		size_t nextIndex = hashIndex + 3;
 		while (nextIndex < tokens.size())
@@ -369,14 +457,22 @@ PrecompilationParser::PrecompilationParser(std::vector<std::filesystem::path> p_
 {
 }
 
+PrecompilationParser::PrecompilationParser(
+    std::vector<std::filesystem::path> p_includeDirs, IncludeReader p_includeReader)
+    : m_includeDirectories(std::move(p_includeDirs)), m_includeReader(std::move(p_includeReader))
+{
+}
+
 void PrecompilationParser::operator()(std::vector<Token> &p_rawTokens)
 {
+	m_includedFiles.clear();
 	if (p_rawTokens.empty())
 	{
 		return;
 	}
 
 	PreprocessorState state;
+	state.includeReader = m_includeReader ? &m_includeReader : nullptr;
 	std::vector<Token> processed;
 	processed.reserve(p_rawTokens.size());
 
@@ -391,4 +487,10 @@ void PrecompilationParser::operator()(std::vector<Token> &p_rawTokens)
 	}
 
 	p_rawTokens = std::move(processed);
+	m_includedFiles = std::move(state.includedFiles);
+}
+
+const std::vector<std::filesystem::path> &PrecompilationParser::includedFiles() const
+{
+	return m_includedFiles;
 }
@@ -1,5 +1,7 @@
 #include "semantic_parser.hpp"
 
+#include "trace.hpp"
+
 #include <array>
 #include <cctype>
 #include <cstddef>
@@ -850,10 +852,24 @@ int componentIndex(char component)
 		State state;
 		std::unordered_map<const Expression *, SemanticParseResult::ExpressionInfo> expressionInfo;
 
+		// Overload sets at least this large are looked up by parameter types instead of scanned on every call.
+		static constexpr std::size_t kIndexedOverloadThreshold = 8;
+
+		struct OverloadIndex
+		{
+			std::size_t indexedCount = 0;
+			// First overload declared with each exact parameter list.
+			std::unordered_map<std::string, std::size_t> firstByParameters;
+		};
+
+		// Keyed by the overload vector, which stays in place inside its map for the whole analysis.
+		std::unordered_map<const std::vector<FunctionSignature> *, OverloadIndex> overloadIndices;
+
 		SemanticParseResult operator()(std::vector<std::unique_ptr<Instruction>> instructions)
 		{
 			state = State{};
 			expressionInfo.clear();
+			overloadIndices.clear();
 			resetStageBuiltins();
 			registerBuiltinAggregates();
 
@@ -869,6 +885,11 @@ int componentIndex(char component)
 			{
 				if (instruction)
 				{
+					TraceSpan span("semantic", "analyze");
+					if (span.active())
+					{
+						span.setDetail(traceName(*instruction));
+					}
 					analyzeInstruction(*instruction);
 				}
 			}
@@ -2022,7 +2043,7 @@ int componentIndex(char component)
                                 auto field = context.aggregate->fields.find(name.parts.front().content);
                                 if (field != context.aggregate->fields.end())
                                 {
-                                        static Symbol temp;
+                                        thread_local Symbol temp;
                                         temp.token = field->second.nameToken;
                                         temp.type = field->second.type;
                                         if (context.methodConst && !context.inConstructor)
@@ -2662,9 +2683,11 @@ int componentIndex(char component)
                                 return {};
                         }
 
-                        const Token &binaryToken = tokenOrFallback(
-                            binary.operatorToken,
-                            binary.left ? expressionToken(*binary.left, context.ownerToken) : context.ownerToken);
+                        // The fallback walks the whole left spine, so it is only looked up when actually needed.
+                        const Token &binaryToken =
+                            !binary.operatorToken.content.empty() ? binary.operatorToken
+                            : binary.left                         ? expressionToken(*binary.left, context.ownerToken)
+                                                                  : context.ownerToken;
                         bool operatorErrorReported = false;
                         if (auto userOperator =
                                 tryResolveUserOperator(binary.op, left, right, binaryToken, operatorErrorReported))
@@ -3303,18 +3326,18 @@ int componentIndex(char component)
                         const auto signatures = collectFunctionSignatures(qualifiedName);
                         if (!signatures.empty())
                         {
-                                std::cout << "  Expected overloads:\n";
+                                diagnosticStream() << "  Expected overloads:\n";
                                 for (const std::string &sig : signatures)
                                 {
-                                        std::cout << "    " << sig << '\n';
+                                        diagnosticStream() << "    " << sig << '\n';
                                 }
                         }
                         else
                         {
-                                std::cout << "  No overloads were defined for '" << qualifiedName << "'\n";
+                                diagnosticStream() << "  No overloads were defined for '" << qualifiedName << "'\n";
                         }
 
-                        std::cout << "  Provided: " << formatArgumentTypes(arguments, context) << '\n';
+                        diagnosticStream() << "  Provided: " << formatArgumentTypes(arguments, context) << '\n';
                         return {};
                 }
 
@@ -3867,25 +3890,78 @@ int componentIndex(char component)
                         return resolveCall(methodName, methodIt->second, arguments, context, member.member, objectConst);
                 }
 
-                TypedValue resolveCall(const std::string &name, const std::vector<FunctionSignature> &overloads,
-                    const std::vector<std::unique_ptr<Expression>> &arguments, FunctionContext &context, const Token &token,
-                    bool objectIsConst = false)
+                // Parameter list with const and reference stripped, matching what typeAssignable compares.
+                static std::string parameterKey(const std::vector<TypeInfo> &types)
                 {
-                        std::vector<TypedValue> argumentTypes;
-                        argumentTypes.reserve(arguments.size());
-                        for (const std::unique_ptr<Expression> &argument : arguments)
+                        std::string key;
+                        for (const TypeInfo &type : types)
                         {
-                                if (argument)
+                                key += type.name;
+                                if (type.isArray)
                                 {
-                                        argumentTypes.push_back(evaluateExpression(*argument, context, false));
+                                        key += type.hasArraySize ? "[" : "[?";
+                                        key += type.arraySize ? std::to_string(*type.arraySize) : std::string();
+                                        key += ']';
                                 }
-                                else
+                                key += ',';
+                        }
+                        return key;
+                }
+
+                // Resolves a call on a large overload set without scanning it. Arguments that are not int-like
+                // convert to nothing, so the first compatible overload is the first one with exactly their types.
+                // Returns nothing when the scan must decide: small sets, numeric or invalid arguments, or a
+                // candidate rejected for constness or an lvalue reference.
+                std::optional<const FunctionSignature *> findIndexedOverload(const std::vector<FunctionSignature> &overloads,
+                    const std::vector<TypedValue> &argumentTypes, bool objectIsConst)
+                {
+                        if (overloads.size() < kIndexedOverloadThreshold)
+                        {
+                                return std::nullopt;
+                        }
+                        std::vector<TypeInfo> arguments;
+                        arguments.reserve(argumentTypes.size());
+                        for (const TypedValue &argument : argumentTypes)
+                        {
+                                if (!argument.type.valid() || isIntLikeTypeName(argument.type.name) ||
+                                    isUIntLikeTypeName(argument.type.name))
                                 {
-                                        argumentTypes.push_back({});
+                                        return std::nullopt;
                                 }
+                                arguments.push_back(argument.type);
+                        }
+
+                        OverloadIndex &index = overloadIndices[&overloads];
+                        for (; index.indexedCount < overloads.size(); ++index.indexedCount)
+                        {
+                                index.firstByParameters.try_emplace(
+                                    parameterKey(overloads[index.indexedCount].parameters), index.indexedCount);
                         }
 
-                        const FunctionSignature *match = nullptr;
+                        const auto it = index.firstByParameters.find(parameterKey(arguments));
+                        if (it == index.firstByParameters.end())
+                        {
+                                return nullptr;
+                        }
+                        const FunctionSignature &candidate = overloads[it->second];
+                        if (candidate.isMethod && objectIsConst && !candidate.isConstMethod)
+                        {
+                                return std::nullopt;
+                        }
+                        for (std::size_t i = 0; i < candidate.parameters.size(); ++i)
+                        {
+                                if (candidate.parameters[i].isReference && !argumentTypes[i].isLValue)
+                                {
+                                        return std::nullopt;
+                                }
+                        }
+                        return &candidate;
+                }
+
+                // First overload, in declaration order, that accepts the arguments.
+                const FunctionSignature *scanOverloads(const std::vector<FunctionSignature> &overloads,
+                    const std::vector<TypedValue> &argumentTypes, bool objectIsConst)
+                {
                         for (const FunctionSignature &signature : overloads)
                         {
                                 if (signature.parameters.size() != argumentTypes.size())
@@ -3921,10 +3997,34 @@ int componentIndex(char component)
 
                                 if (compatible)
                                 {
-                                        match = &signature;
-                                        break;
+                                        return &signature;
                                 }
                         }
+                        return nullptr;
+                }
+
+                TypedValue resolveCall(const std::string &name, const std::vector<FunctionSignature> &overloads,
+                    const std::vector<std::unique_ptr<Expression>> &arguments, FunctionContext &context, const Token &token,
+                    bool objectIsConst = false)
+                {
+                        std::vector<TypedValue> argumentTypes;
+                        argumentTypes.reserve(arguments.size());
+                        for (const std::unique_ptr<Expression> &argument : arguments)
+                        {
+                                if (argument)
+                                {
+                                        argumentTypes.push_back(evaluateExpression(*argument, context, false));
+                                }
+                                else
+                                {
+                                        argumentTypes.push_back({});
+                                }
+                        }
+
+                        const std::optional<const FunctionSignature *> indexed =
+                            findIndexedOverload(overloads, argumentTypes, objectIsConst);
+                        const FunctionSignature *match =
+                            indexed ? *indexed : scanOverloads(overloads, argumentTypes, objectIsConst);
 
 		if (!match)
 		{
@@ -3969,18 +4069,18 @@ int componentIndex(char component)
 
 			 if (!candidates.empty())
 			 {
-				 std::cout << "  Expected overloads:\n";
+				 diagnosticStream() << "  Expected overloads:\n";
 				 for (const std::string &candidate : candidates)
 				 {
-					 std::cout << "    " << candidate << '\n';
+					 diagnosticStream() << "    " << candidate << '\n';
 				 }
 			 }
 			 else
 			 {
-				 std::cout << "  No overloads were defined for '" << name << "'\n";
+				 diagnosticStream() << "  No overloads were defined for '" << name << "'\n";
 			 }
 
-			 std::cout << "  Provided: " << provided.str() << '\n';
+			 diagnosticStream() << "  Provided: " << provided.str() << '\n';
 			 return {};
 		}
 
@@ -1,16 +1,109 @@
 #include "source_manager.hpp"
 
+#include "pass_timing.hpp"
 #include "precompilation_parser.hpp"
 #include "tokenizer.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
 #include <system_error>
 #include <unordered_map>
+#include <utility>
 
 namespace
 {
-	std::unordered_map<std::filesystem::path, std::vector<Token>> alreadyLoadedFile;
-	std::vector<std::filesystem::path> includeDirectories = readPathListFromEnv("LUMINA_INCLUDE_PATH");
+	constexpr std::size_t kDefaultCacheCapacity = 256u * 1024u * 1024u;
+
+	struct FileStamp
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type writeTime;
+		std::uintmax_t size = 0;
+		bool valid = false;
+	};
+
+	struct LoadedFile
+	{
+		std::shared_ptr<const std::vector<Token>> tokens;
+		std::vector<FileStamp> stamps;
+		std::size_t footprint = 0;
+	};
+
+	// A loaded or included file in the least-recently-used order, by the key of its map.
+	struct LruSlot
+	{
+		std::filesystem::path path;
+		bool included = false;
+	};
+
+	using LruList = std::list<LruSlot>;
+
+	struct CacheEntry
+	{
+		std::shared_future<std::shared_ptr<const LoadedFile>> pending;
+		std::shared_ptr<const LoadedFile> loaded;
+		// Valid once loaded is set.
+		LruList::iterator lruPosition;
+	};
+
+	struct IncludedFile
+	{
+		std::shared_ptr<const std::vector<Token>> tokens;
+		FileStamp stamp;
+		std::size_t footprint = 0;
+		LruList::iterator lruPosition;
+	};
+
+	std::size_t readCapacityFromEnv();
+
+	struct SourceCache
+	{
+		SourceCache() : capacity(readCapacityFromEnv()) {}
+
+		// Guards both maps and the order. Their footprints add up to totalBytes.
+		std::shared_mutex mutex;
+		std::unordered_map<std::filesystem::path, std::shared_ptr<CacheEntry>> entries;
+		std::unordered_map<std::filesystem::path, std::shared_ptr<IncludedFile>> includedFiles;
+		std::size_t totalBytes = 0;
+		std::size_t capacity;
+		// Every loaded entry and included file, least recently used first. Holders of the shared lock move a
+		// slot to the back under lruMutex; holders of the exclusive lock need no more.
+		LruList lru;
+		std::mutex lruMutex;
+
+		std::shared_mutex includeMutex;
+		std::vector<std::filesystem::path> includeDirectories = readPathListFromEnv("LUMINA_INCLUDE_PATH");
+	};
+
+	std::size_t readCapacityFromEnv()
+	{
+		const std::optional<std::string> value = readEnvironmentVariable("LUMINA_SOURCE_CACHE_BYTES");
+		if (!value || value->empty())
+		{
+			return kDefaultCacheCapacity;
+		}
+
+		try
+		{
+			return static_cast<std::size_t>(std::stoull(*value));
+		} catch (const std::exception &)
+		{
+			return kDefaultCacheCapacity;
+		}
+	}
+
+	SourceCache &cache()
+	{
+		static SourceCache instance;
+		return instance;
+	}
 
 	std::filesystem::path normalizePath(const std::filesystem::path &input)
 	{
@@ -22,37 +115,279 @@ namespace
 		}
 		return normalized.empty() ? input : normalized;
 	}
+
+	FileStamp stampFile(const std::filesystem::path &path)
+	{
+		FileStamp stamp;
+		stamp.path = path;
+
+		std::error_code timeError;
+		std::error_code sizeError;
+		stamp.writeTime = std::filesystem::last_write_time(path, timeError);
+		stamp.size = std::filesystem::file_size(path, sizeError);
+		stamp.valid = !timeError && !sizeError;
+		return stamp;
+	}
+
+	bool isFresh(const LoadedFile &file)
+	{
+		for (const FileStamp &stamp : file.stamps)
+		{
+			const FileStamp current = stampFile(stamp.path);
+			if (!stamp.valid || !current.valid || current.writeTime != stamp.writeTime || current.size != stamp.size)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::size_t estimateFootprint(const std::vector<Token> &tokens)
+	{
+		std::size_t bytes = tokens.capacity() * sizeof(Token);
+		for (const Token &token : tokens)
+		{
+			bytes += token.content.capacity();
+			bytes += token.origin.native().capacity() * sizeof(std::filesystem::path::value_type);
+		}
+		return bytes;
+	}
+
+	std::shared_ptr<const LoadedFile> tokenizeFile(
+	    const std::filesystem::path &path, const std::vector<std::filesystem::path> &includeDirectories)
+	{
+		// Stamp before reading so an edit racing with the load invalidates the entry instead of hiding.
+		std::vector<FileStamp> stamps;
+		stamps.push_back(stampFile(path));
+
+		std::vector<Token> tokens;
+		{
+			PassTimer timer("tokenize");
+			timer.setTraceFile(path);
+			tokens = Tokenizer()(path);
+		}
+
+		PrecompilationParser precompilationParser(includeDirectories);
+		{
+			PassTimer timer("preprocess");
+			timer.setTraceFile(path);
+			precompilationParser(tokens);
+		}
+
+		for (const std::filesystem::path &included : precompilationParser.includedFiles())
+		{
+			stamps.push_back(stampFile(included));
+		}
+
+		auto file = std::make_shared<LoadedFile>();
+		file->footprint = estimateFootprint(tokens);
+		file->tokens = std::make_shared<const std::vector<Token>>(std::move(tokens));
+		file->stamps = std::move(stamps);
+		return file;
+	}
+
+	// Must be called with at least the shared cache lock held, on a slot that is in the order.
+	void touch(SourceCache &state, LruList::iterator position)
+	{
+		std::lock_guard lock(state.lruMutex);
+		state.lru.splice(state.lru.end(), state.lru, position);
+	}
+
+	// Must be called with the cache mutex held exclusively. Evicts least recently used files first; keepNewest spares
+	// the file just added even when it alone exceeds the capacity.
+	void evictLocked(SourceCache &state, bool keepNewest)
+	{
+		if (state.capacity == 0)
+		{
+			return;
+		}
+
+		while (state.totalBytes > state.capacity && state.lru.size() > (keepNewest ? 1u : 0u))
+		{
+			const LruSlot &victim = state.lru.front();
+			if (victim.included)
+			{
+				const auto it = state.includedFiles.find(victim.path);
+				state.totalBytes -= it->second->footprint;
+				state.includedFiles.erase(it);
+			}
+			else
+			{
+				const auto it = state.entries.find(victim.path);
+				state.totalBytes -= it->second->loaded->footprint;
+				state.entries.erase(it);
+			}
+			state.lru.pop_front();
+		}
+	}
+
+	// Must be called with the cache mutex held exclusively.
+	void eraseLocked(SourceCache &state, const std::filesystem::path &path, const CacheEntry *expected)
+	{
+		const auto it = state.entries.find(path);
+		if (it == state.entries.end() || it->second.get() != expected)
+		{
+			return;
+		}
+		if (it->second->loaded)
+		{
+			state.totalBytes -= it->second->loaded->footprint;
+			state.lru.erase(it->second->lruPosition);
+		}
+		state.entries.erase(it);
+	}
 }
 
-const std::vector<Token> &SourceManager::loadFile(const std::filesystem::path &p_path)
+std::shared_ptr<const std::vector<Token>> SourceManager::loadFile(const std::filesystem::path &p_path)
 {
 	const std::filesystem::path normalized = normalizePath(p_path);
+	SourceCache &state = cache();
 
-	auto it = alreadyLoadedFile.find(normalized);
-	if (it == alreadyLoadedFile.end())
+	while (true)
 	{
-		Tokenizer tokenizer;
-		std::vector<Token> tokens = tokenizer(normalized);
+		std::shared_ptr<CacheEntry> entry;
+		std::shared_ptr<const LoadedFile> loaded;
+		std::shared_future<std::shared_ptr<const LoadedFile>> pending;
+		{
+			std::shared_lock lock(state.mutex);
+			const auto it = state.entries.find(normalized);
+			if (it != state.entries.end())
+			{
+				entry = it->second;
+				loaded = entry->loaded;
+				pending = entry->pending;
+				if (loaded)
+				{
+					touch(state, entry->lruPosition);
+				}
+			}
+		}
 
-		PrecompilationParser precompilationParser(includeDirectories);
-		precompilationParser(tokens);
+		if (entry && loaded)
+		{
+			if (isFresh(*loaded))
+			{
+				return loaded->tokens;
+			}
+
+			std::unique_lock lock(state.mutex);
+			eraseLocked(state, normalized, entry.get());
+			continue;
+		}
+
+		if (entry)
+		{
+			// Another thread is tokenizing this file: share its result (or its failure).
+			return pending.get()->tokens;
+		}
+
+		auto created = std::make_shared<CacheEntry>();
+		std::promise<std::shared_ptr<const LoadedFile>> promise;
+		created->pending = promise.get_future().share();
+		{
+			std::unique_lock lock(state.mutex);
+			if (!state.entries.emplace(normalized, created).second)
+			{
+				continue;
+			}
+		}
+
+		try
+		{
+			std::shared_ptr<const LoadedFile> file = tokenizeFile(normalized, getIncludeDirectories());
+			{
+				std::unique_lock lock(state.mutex);
+				const auto it = state.entries.find(normalized);
+				if (it != state.entries.end() && it->second == created)
+				{
+					created->loaded = file;
+					created->lruPosition = state.lru.insert(state.lru.end(), LruSlot{normalized, false});
+					state.totalBytes += file->footprint;
+					evictLocked(state, true);
+				}
+			}
+			promise.set_value(file);
+			return file->tokens;
+		} catch (...)
+		{
+			{
+				std::unique_lock lock(state.mutex);
+				eraseLocked(state, normalized, created.get());
+			}
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+	}
+}
+
+std::vector<Token> SourceManager::loadSource(const std::filesystem::path &p_origin, std::string_view p_source)
+{
+	Tokenizer tokenizer;
+	std::vector<Token> tokens = tokenizer(p_origin, p_source);
 
-		it = alreadyLoadedFile.emplace(normalized, std::move(tokens)).first;
+	PrecompilationParser precompilationParser(getIncludeDirectories());
+	precompilationParser(tokens);
+	return tokens;
+}
+
+std::shared_ptr<const std::vector<Token>> SourceManager::loadIncludedTokens(const std::filesystem::path &p_path)
+{
+	SourceCache &state = cache();
+	const FileStamp current = stampFile(p_path);
+	if (current.valid)
+	{
+		std::shared_lock lock(state.mutex);
+		const auto it = state.includedFiles.find(p_path);
+		if (it != state.includedFiles.end() && it->second->stamp.writeTime == current.writeTime &&
+		    it->second->stamp.size == current.size)
+		{
+			touch(state, it->second->lruPosition);
+			return it->second->tokens;
+		}
 	}
 
-	return it->second;
+	// Two threads missing together both tokenize; the second insert simply replaces an identical entry.
+	TraceSpan span("lexing", "tokenize");
+	span.setFile(p_path);
+	Tokenizer tokenizer;
+	auto tokens = std::make_shared<const std::vector<Token>>(tokenizer(p_path));
+	if (current.valid)
+	{
+		auto file = std::make_shared<IncludedFile>();
+		file->tokens = tokens;
+		file->stamp = current;
+		file->footprint = estimateFootprint(*tokens);
+
+		std::unique_lock lock(state.mutex);
+		std::shared_ptr<IncludedFile> &slot = state.includedFiles[p_path];
+		if (slot)
+		{
+			state.totalBytes -= slot->footprint;
+			state.lru.erase(slot->lruPosition);
+		}
+		file->lruPosition = state.lru.insert(state.lru.end(), LruSlot{p_path, true});
+		state.totalBytes += file->footprint;
+		slot = file;
+		evictLocked(state, true);
+	}
+	return tokens;
 }
 
 void SourceManager::setIncludeDirectories(std::vector<std::filesystem::path> p_dirs)
 {
-	includeDirectories.clear();
-	for (std::filesystem::path &dir : p_dirs)
+	SourceCache &state = cache();
 	{
-		if (!dir.empty())
+		std::unique_lock lock(state.includeMutex);
+		state.includeDirectories.clear();
+		for (std::filesystem::path &dir : p_dirs)
 		{
-			includeDirectories.push_back(dir);
+			if (!dir.empty())
+			{
+				state.includeDirectories.push_back(dir);
+			}
 		}
 	}
+	clearCache();
 }
 
 void SourceManager::addIncludeDirectory(const std::filesystem::path &p_dir)
@@ -61,10 +396,59 @@ void SourceManager::addIncludeDirectory(const std::filesystem::path &p_dir)
 	{
 		return;
 	}
-	includeDirectories.push_back(p_dir);
+
+	SourceCache &state = cache();
+	{
+		std::unique_lock lock(state.includeMutex);
+		state.includeDirectories.push_back(p_dir);
+	}
+	clearCache();
 }
 
-const std::vector<std::filesystem::path> &SourceManager::getIncludeDirectories()
+std::vector<std::filesystem::path> SourceManager::getIncludeDirectories()
 {
-	return includeDirectories;
+	SourceCache &state = cache();
+	std::shared_lock lock(state.includeMutex);
+	return state.includeDirectories;
+}
+
+void SourceManager::setCacheCapacity(std::size_t p_bytes)
+{
+	SourceCache &state = cache();
+	std::unique_lock lock(state.mutex);
+	state.capacity = p_bytes;
+	evictLocked(state, false);
+}
+
+std::size_t SourceManager::getCacheCapacity()
+{
+	SourceCache &state = cache();
+	std::shared_lock lock(state.mutex);
+	return state.capacity;
+}
+
+void SourceManager::clearCache()
+{
+	SourceCache &state = cache();
+	std::unique_lock lock(state.mutex);
+	for (const auto &[path, file] : state.includedFiles)
+	{
+		state.totalBytes -= file->footprint;
+		state.lru.erase(file->lruPosition);
+	}
+	state.includedFiles.clear();
+	for (auto it = state.entries.begin(); it != state.entries.end();)
+	{
+		// In-flight loads keep their slot so concurrent callers still share one tokenization.
+		if (it->second->loaded)
+		{
+			state.totalBytes -= it->second->loaded->footprint;
+			state.lru.erase(it->second->lruPosition);
+			it = state.entries.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
 }
@@ -1,31 +1,55 @@
 #include "token.hpp"
 
 #include <algorithm>
-#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <string_view>
+#include <system_error>
+#include <unordered_map>
 #include <vector>
 
 namespace
 {
-	std::atomic<int> g_errorCount = 0;
-}
+	thread_local int t_errorCount = 0;
+	thread_local std::ostream *t_diagnosticStream = nullptr;
+	thread_local std::vector<Diagnostic> *t_diagnosticRecords = nullptr;
 
-void emitError(const std::string &p_message, const Token &p_token)
-{
-	++g_errorCount;
+	struct SourceLines
+	{
+		std::filesystem::file_time_type writeTime;
+		std::uintmax_t size = 0;
+		std::vector<std::string> lines;
+	};
 
-	const std::size_t lineNumber = p_token.start.line;
-	std::cout << p_token.origin.string() << ":" << lineNumber << " : " << p_message << '\n';
+	constexpr std::size_t kCachedSourceFiles = 16;
+
+	// Lines of the files errors were reported in, so a file with many errors is read once instead of once per
+	// error. Entries are dropped when the file's size or write time changes. Returns nullptr for unreadable files.
+	const std::vector<std::string> *sourceLines(const std::filesystem::path &path)
+	{
+		std::error_code error;
+		const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+		const std::uintmax_t size = error ? 0 : std::filesystem::file_size(path, error);
+		if (error)
+		{
+			return nullptr;
+		}
+
+		thread_local std::unordered_map<std::filesystem::path::string_type, SourceLines> cache;
+		const auto it = cache.find(path.native());
+		if (it != cache.end() && it->second.writeTime == writeTime && it->second.size == size)
+		{
+			return &it->second.lines;
+		}
 
-	const auto loadLines = [](const std::filesystem::path &path, std::vector<std::string> &out) {
 		std::ifstream file(path);
 		if (!file)
 		{
-			return false;
+			return nullptr;
 		}
 
+		SourceLines entry{writeTime, size, {}};
 		std::string line;
 		while (std::getline(file, line))
 		{
@@ -33,13 +57,30 @@ void emitError(const std::string &p_message, const Token &p_token)
 			{
 				line.pop_back();
 			}
-			out.emplace_back(std::move(line));
+			entry.lines.emplace_back(std::move(line));
 		}
-		return true;
-	};
 
-	std::vector<std::string> fileLines;
-	const bool hasFile = loadLines(p_token.origin, fileLines);
+		if (cache.size() >= kCachedSourceFiles)
+		{
+			cache.clear();
+		}
+		return &(cache[path.native()] = std::move(entry)).lines;
+	}
+}
+
+void emitError(const std::string &p_message, const Token &p_token)
+{
+	++t_errorCount;
+	if (t_diagnosticRecords)
+	{
+		t_diagnosticRecords->push_back(Diagnostic{p_token.origin, p_token.start.line, p_token.start.column + 1, p_message});
+	}
+
+	std::ostream &out = diagnosticStream();
+	const std::size_t lineNumber = p_token.start.line;
+	out << p_token.origin.string() << ":" << lineNumber << " : " << p_message << '\n';
+
+	const std::vector<std::string> *cachedLines = sourceLines(p_token.origin);
 	const auto zeroBasedLine = [](std::size_t line) {
 		return (line > 0) ? (line - 1) : static_cast<std::size_t>(0);
 	};
@@ -47,13 +88,14 @@ void emitError(const std::string &p_message, const Token &p_token)
 	const size_t startLine = zeroBasedLine(p_token.start.line);
 	const size_t endLine = zeroBasedLine(p_token.end.line);
 
-	if (hasFile && startLine < fileLines.size())
+	if (cachedLines && startLine < cachedLines->size())
 	{
+		const std::vector<std::string> &fileLines = *cachedLines;
 		const size_t lastLine = std::min(endLine, fileLines.size() - 1);
 		for (size_t lineIndex = startLine; lineIndex <= lastLine; ++lineIndex)
 		{
 			const std::string &line = fileLines[lineIndex];
-			std::cout << line << '\n';
+			out << line << '\n';
 
 			size_t indicatorStart = (lineIndex == startLine) ? p_token.start.column : 0;
 			size_t indicatorEnd = (lineIndex == endLine) ? p_token.end.column : line.size();
@@ -78,14 +120,14 @@ void emitError(const std::string &p_message, const Token &p_token)
 				prefix.push_back((ch == '\t') ? '\t' : ' ');
 			}
 
-			std::cout << prefix << std::string(caretCount, '^') << '\n';
+			out << prefix << std::string(caretCount, '^') << '\n';
 		}
 		return;
 	}
 
 	if (p_token.content.empty())
 	{
-		std::cout << '\n';
+		out << '\n';
 		return;
 	}
 
@@ -105,13 +147,13 @@ void emitError(const std::string &p_message, const Token &p_token)
 
 		std::string_view line = src.substr(lineBegin, lineEnd - lineBegin);
 
-		std::cout << line << '\n';
+		out << line << '\n';
 
 		const size_t indicatorStart = (i == 0) ? p_token.start.column : 0;
 		const size_t indicatorEnd = (i == nbLines - 1) ? p_token.end.column : line.size();
 		const size_t caretCount = std::max<std::size_t>(1, (indicatorEnd > indicatorStart) ? (indicatorEnd - indicatorStart) : 0);
 
-		std::cout << std::string(indicatorStart, ' ') << std::string(caretCount, '^') << '\n';
+		out << std::string(indicatorStart, ' ') << std::string(caretCount, '^') << '\n';
 
 		if (nl == std::string_view::npos)
 		{
@@ -123,12 +165,32 @@ void emitError(const std::string &p_message, const Token &p_token)
 
 void resetErrorCount()
 {
-	g_errorCount.store(0, std::memory_order_relaxed);
+	t_errorCount = 0;
 }
 
 int getErrorCount()
 {
-	return g_errorCount.load(std::memory_order_relaxed);
+	return t_errorCount;
+}
+
+std::ostream &diagnosticStream()
+{
+	return t_diagnosticStream ? *t_diagnosticStream : std::cout;
+}
+
+DiagnosticScope::DiagnosticScope(std::ostream &p_stream, std::vector<Diagnostic> *p_records) :
+    m_previousStream(t_diagnosticStream), m_previousRecords(t_diagnosticRecords), m_previousCount(t_errorCount)
+{
+	t_diagnosticStream = &p_stream;
+	t_diagnosticRecords = p_records;
+	t_errorCount = 0;
+}
+
+DiagnosticScope::~DiagnosticScope()
+{
+	t_diagnosticStream = m_previousStream;
+	t_diagnosticRecords = m_previousRecords;
+	t_errorCount = m_previousCount;
 }
 
 std::string_view tokenTypeToString(Token::Type p_type)
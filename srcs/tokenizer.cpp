@@ -289,275 +289,285 @@ namespace
 
 		return makeToken(origin, ctx, begin, Token::Type::HeaderLiteral, startLoc);
 	}
-}
-
-Tokenizer::Tokenizer() = default;
-
-std::vector<Token> Tokenizer::operator()(const std::filesystem::path &p_path) const
-{
-	std::string sanitized = normalizeLineEndings(readFile(p_path));
-	ScanContext ctx(sanitized);
-
-	std::vector<Token> tokens;
-	tokens.reserve(sanitized.empty() ? 0 : sanitized.size() / 4 + 8);
 
-	while (true)
+	std::vector<Token> tokenizeSource(const std::filesystem::path &origin, std::string source)
 	{
-		skipTrivia(ctx, p_path);
-		if (ctx.eof())
-		{
-			break;
-		}
+		const std::string sanitized = normalizeLineEndings(std::move(source));
+		ScanContext ctx(sanitized);
 
-		const char ch = ctx.peek();
+		std::vector<Token> tokens;
+		tokens.reserve(sanitized.empty() ? 0 : sanitized.size() / 4 + 8);
 
-		if (isIdentifierStart(ch))
+		while (true)
 		{
-			tokens.emplace_back(lexIdentifier(p_path, ctx));
-			continue;
-		}
-		if (isDigit(ch) || (ch == '.' && isDigit(ctx.peek(1))))
-		{
-			tokens.emplace_back(lexNumber(p_path, ctx, ch == '.'));
-			continue;
-		}
+			skipTrivia(ctx, origin);
+			if (ctx.eof())
+			{
+				break;
+			}
 
-		const Token::Location startLoc = makeLocation(ctx.cursor);
-		const std::size_t tokenStart = ctx.cursor.offset;
-		Token::Type tokenType = Token::Type::EndOfFile;
+			const char ch = ctx.peek();
 
-		switch (ch)
-		{
-			case '#':
-				ctx.advance();
-				tokenType = Token::Type::Hash;
-				break;
-			case '"':
-				tokens.emplace_back(lexString(p_path, ctx));
+			if (isIdentifierStart(ch))
+			{
+				tokens.emplace_back(lexIdentifier(origin, ctx));
 				continue;
-			case '<':
-				if (!tokens.empty() && tokens.back().type == Token::Type::KeywordInclude)
-				{
-					tokens.emplace_back(lexHeader(p_path, ctx));
+			}
+			if (isDigit(ch) || (ch == '.' && isDigit(ctx.peek(1))))
+			{
+				tokens.emplace_back(lexNumber(origin, ctx, ch == '.'));
+				continue;
+			}
+
+			const Token::Location startLoc = makeLocation(ctx.cursor);
+			const std::size_t tokenStart = ctx.cursor.offset;
+			Token::Type tokenType = Token::Type::EndOfFile;
+
+			switch (ch)
+			{
+				case '#':
+					ctx.advance();
+					tokenType = Token::Type::Hash;
+					break;
+				case '"':
+					tokens.emplace_back(lexString(origin, ctx));
 					continue;
-				}
-				ctx.advance();
-				tokenType = Token::Type::Less;
-				if (ctx.peek() == '<')
-				{
+				case '<':
+					if (!tokens.empty() && tokens.back().type == Token::Type::KeywordInclude)
+					{
+						tokens.emplace_back(lexHeader(origin, ctx));
+						continue;
+					}
 					ctx.advance();
-					tokenType = Token::Type::ShiftLeft;
-					if (ctx.peek() == '=')
+					tokenType = Token::Type::Less;
+					if (ctx.peek() == '<')
 					{
 						ctx.advance();
-						tokenType = Token::Type::ShiftLeftEqual;
+						tokenType = Token::Type::ShiftLeft;
+						if (ctx.peek() == '=')
+						{
+							ctx.advance();
+							tokenType = Token::Type::ShiftLeftEqual;
+						}
 					}
-				}
-				else if (ctx.peek() == '=')
-				{
-					ctx.advance();
-					tokenType = Token::Type::LessEqual;
-				}
-				break;
-			case '>':
-				ctx.advance();
-				tokenType = Token::Type::Greater;
-				if (ctx.peek() == '>')
-				{
+					else if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::LessEqual;
+					}
+					break;
+				case '>':
 					ctx.advance();
-					tokenType = Token::Type::ShiftRight;
-					if (ctx.peek() == '=')
+					tokenType = Token::Type::Greater;
+					if (ctx.peek() == '>')
 					{
 						ctx.advance();
-						tokenType = Token::Type::ShiftRightEqual;
+						tokenType = Token::Type::ShiftRight;
+						if (ctx.peek() == '=')
+						{
+							ctx.advance();
+							tokenType = Token::Type::ShiftRightEqual;
+						}
 					}
-				}
-				else if (ctx.peek() == '=')
-				{
+					else if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::GreaterEqual;
+					}
+					break;
+				case '(':
 					ctx.advance();
-					tokenType = Token::Type::GreaterEqual;
-				}
-				break;
-			case '(':
-				ctx.advance();
-				tokenType = Token::Type::LeftParen;
-				break;
-			case ')':
-				ctx.advance();
-				tokenType = Token::Type::RightParen;
-				break;
-			case '{':
-				ctx.advance();
-				tokenType = Token::Type::LeftBrace;
-				break;
-			case '}':
-				ctx.advance();
-				tokenType = Token::Type::RightBrace;
-				break;
-			case '[':
-				ctx.advance();
-				tokenType = Token::Type::LeftBracket;
-				break;
-			case ']':
-				ctx.advance();
-				tokenType = Token::Type::RightBracket;
-				break;
-			case ';':
-				ctx.advance();
-				tokenType = Token::Type::Semicolon;
-				break;
-			case ',':
-				ctx.advance();
-				tokenType = Token::Type::Comma;
-				break;
-			case '.':
-				ctx.advance();
-				tokenType = Token::Type::Dot;
-				break;
-			case ':':
-				ctx.advance();
-				tokenType = Token::Type::Colon;
-				if (ctx.peek() == ':')
-				{
+					tokenType = Token::Type::LeftParen;
+					break;
+				case ')':
 					ctx.advance();
-					tokenType = Token::Type::DoubleColon;
-				}
-				break;
-			case '+':
-				ctx.advance();
-				tokenType = Token::Type::Plus;
-				if (ctx.peek() == '+')
-				{
+					tokenType = Token::Type::RightParen;
+					break;
+				case '{':
 					ctx.advance();
-					tokenType = Token::Type::PlusPlus;
-				}
-				else if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::LeftBrace;
+					break;
+				case '}':
 					ctx.advance();
-					tokenType = Token::Type::PlusEqual;
-				}
-				break;
-			case '-':
-				ctx.advance();
-				tokenType = Token::Type::Minus;
-				if (ctx.peek() == '>')
-				{
+					tokenType = Token::Type::RightBrace;
+					break;
+				case '[':
 					ctx.advance();
-					tokenType = Token::Type::Arrow;
-				}
-				else if (ctx.peek() == '-')
-				{
+					tokenType = Token::Type::LeftBracket;
+					break;
+				case ']':
 					ctx.advance();
-					tokenType = Token::Type::MinusMinus;
-				}
-				else if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::RightBracket;
+					break;
+				case ';':
 					ctx.advance();
-					tokenType = Token::Type::MinusEqual;
-				}
-				break;
-			case '*':
-				ctx.advance();
-				tokenType = Token::Type::Star;
-				if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Semicolon;
+					break;
+				case ',':
 					ctx.advance();
-					tokenType = Token::Type::StarEqual;
-				}
-				break;
-			case '/':
-				ctx.advance();
-				tokenType = Token::Type::Slash;
-				if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Comma;
+					break;
+				case '.':
 					ctx.advance();
-					tokenType = Token::Type::SlashEqual;
-				}
-				break;
-			case '%':
-				ctx.advance();
-				tokenType = Token::Type::Percent;
-				if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Dot;
+					break;
+				case ':':
 					ctx.advance();
-					tokenType = Token::Type::PercentEqual;
-				}
-				break;
-			case '!':
-				ctx.advance();
-				tokenType = Token::Type::Bang;
-				if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Colon;
+					if (ctx.peek() == ':')
+					{
+						ctx.advance();
+						tokenType = Token::Type::DoubleColon;
+					}
+					break;
+				case '+':
 					ctx.advance();
-					tokenType = Token::Type::BangEqual;
-				}
-				break;
-			case '=':
-				ctx.advance();
-				tokenType = Token::Type::Assign;
-				if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Plus;
+					if (ctx.peek() == '+')
+					{
+						ctx.advance();
+						tokenType = Token::Type::PlusPlus;
+					}
+					else if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::PlusEqual;
+					}
+					break;
+				case '-':
 					ctx.advance();
-					tokenType = Token::Type::Equal;
-				}
-				break;
-			case '&':
-				ctx.advance();
-				tokenType = Token::Type::Ampersand;
-				if (ctx.peek() == '&')
-				{
+					tokenType = Token::Type::Minus;
+					if (ctx.peek() == '>')
+					{
+						ctx.advance();
+						tokenType = Token::Type::Arrow;
+					}
+					else if (ctx.peek() == '-')
+					{
+						ctx.advance();
+						tokenType = Token::Type::MinusMinus;
+					}
+					else if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::MinusEqual;
+					}
+					break;
+				case '*':
 					ctx.advance();
-					tokenType = Token::Type::AmpersandAmpersand;
-				}
-				else if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Star;
+					if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::StarEqual;
+					}
+					break;
+				case '/':
 					ctx.advance();
-					tokenType = Token::Type::AmpersandEqual;
-				}
-				break;
-			case '|':
-				ctx.advance();
-				tokenType = Token::Type::Pipe;
-				if (ctx.peek() == '|')
-				{
+					tokenType = Token::Type::Slash;
+					if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::SlashEqual;
+					}
+					break;
+				case '%':
 					ctx.advance();
-					tokenType = Token::Type::PipePipe;
-				}
-				else if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Percent;
+					if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::PercentEqual;
+					}
+					break;
+				case '!':
 					ctx.advance();
-					tokenType = Token::Type::PipeEqual;
-				}
-				break;
-			case '^':
-				ctx.advance();
-				tokenType = Token::Type::Caret;
-				if (ctx.peek() == '=')
-				{
+					tokenType = Token::Type::Bang;
+					if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::BangEqual;
+					}
+					break;
+				case '=':
 					ctx.advance();
-					tokenType = Token::Type::CaretEqual;
-				}
-				break;
-			case '?':
-				ctx.advance();
-				tokenType = Token::Type::Question;
-				break;
-			case '~':
-				ctx.advance();
-				tokenType = Token::Type::Tilde;
-				break;
-			default:
-				throwTokenizerError(p_path, ctx.cursor, "Unexpected character '" + std::string(1, ch) + "'");
+					tokenType = Token::Type::Assign;
+					if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::Equal;
+					}
+					break;
+				case '&':
+					ctx.advance();
+					tokenType = Token::Type::Ampersand;
+					if (ctx.peek() == '&')
+					{
+						ctx.advance();
+						tokenType = Token::Type::AmpersandAmpersand;
+					}
+					else if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::AmpersandEqual;
+					}
+					break;
+				case '|':
+					ctx.advance();
+					tokenType = Token::Type::Pipe;
+					if (ctx.peek() == '|')
+					{
+						ctx.advance();
+						tokenType = Token::Type::PipePipe;
+					}
+					else if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::PipeEqual;
+					}
+					break;
+				case '^':
+					ctx.advance();
+					tokenType = Token::Type::Caret;
+					if (ctx.peek() == '=')
+					{
+						ctx.advance();
+						tokenType = Token::Type::CaretEqual;
+					}
+					break;
+				case '?':
+					ctx.advance();
+					tokenType = Token::Type::Question;
+					break;
+				case '~':
+					ctx.advance();
+					tokenType = Token::Type::Tilde;
+					break;
+				default:
+					throwTokenizerError(origin, ctx.cursor, "Unexpected character '" + std::string(1, ch) + "'");
+			}
+
+			tokens.emplace_back(makeToken(origin, ctx, tokenStart, tokenType, startLoc));
 		}
 
-		tokens.emplace_back(makeToken(p_path, ctx, tokenStart, tokenType, startLoc));
+		Token eof;
+		eof.origin = origin;
+		eof.type = Token::Type::EndOfFile;
+		eof.start = eof.end = makeLocation(ctx.cursor);
+		tokens.emplace_back(std::move(eof));
+
+		return tokens;
 	}
+}
 
-	Token eof;
-	eof.origin = p_path;
-	eof.type = Token::Type::EndOfFile;
-	eof.start = eof.end = makeLocation(ctx.cursor);
-	tokens.emplace_back(std::move(eof));
+Tokenizer::Tokenizer() = default;
+
+std::vector<Token> Tokenizer::operator()(const std::filesystem::path &p_path) const
+{
+	return tokenizeSource(p_path, readFile(p_path));
+}
 
-	return tokens;
+std::vector<Token> Tokenizer::operator()(const std::filesystem::path &p_origin, std::string_view p_source) const
+{
+	return tokenizeSource(p_origin, std::string(p_source));
 }
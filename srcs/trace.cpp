@@ -0,0 +1,220 @@
+#include "trace.hpp"
+
+#include "ast.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <utility>
+
+namespace
+{
+	std::atomic<TraceSession *> g_session{nullptr};
+	std::atomic<std::size_t> g_nextThread{0};
+
+	std::size_t currentThread()
+	{
+		thread_local const std::size_t thread = g_nextThread++;
+		return thread;
+	}
+
+	double nowMicroseconds()
+	{
+		static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+	}
+
+	void writeJsonString(std::ostream &stream, std::string_view text)
+	{
+		stream << '"';
+		for (const char c : text)
+		{
+			switch (c)
+			{
+				case '"':
+					stream << "\\\"";
+					break;
+				case '\\':
+					stream << "\\\\";
+					break;
+				case '\n':
+					stream << "\\n";
+					break;
+				case '\t':
+					stream << "\\t";
+					break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+					{
+						char escaped[8];
+						std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+						stream << escaped;
+					}
+					else
+					{
+						stream << c;
+					}
+					break;
+			}
+		}
+		stream << '"';
+	}
+
+	std::string stageName(Stage stage)
+	{
+		switch (stage)
+		{
+			case Stage::Input:
+				return "Input";
+			case Stage::VertexPass:
+				return "VertexPass";
+			case Stage::FragmentPass:
+				return "FragmentPass";
+			case Stage::Output:
+				return "Output";
+		}
+		return "?";
+	}
+}
+
+TraceSession::TraceSession()
+{
+	nowMicroseconds();
+	g_session.store(this, std::memory_order_release);
+}
+
+TraceSession::~TraceSession()
+{
+	TraceSession *expected = this;
+	g_session.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+}
+
+void TraceSession::write(std::ostream &p_stream) const
+{
+	std::lock_guard lock(m_mutex);
+	p_stream << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto &[thread, name] : m_threadNames)
+	{
+		p_stream << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+		         << ",\"args\":{\"name\":";
+		writeJsonString(p_stream, name);
+		p_stream << "}}";
+		first = false;
+	}
+
+	char timing[64];
+	for (const Event &event : m_events)
+	{
+		p_stream << (first ? "\n" : ",\n") << "{\"name\":";
+		writeJsonString(p_stream, event.name);
+		std::snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f", event.startMicroseconds,
+		    event.durationMicroseconds);
+		p_stream << ",\"cat\":\"" << event.category << "\",\"ph\":\"X\"," << timing << ",\"pid\":1,\"tid\":"
+		         << event.thread << '}';
+		first = false;
+	}
+	p_stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool TraceSession::writeFile(const std::filesystem::path &p_path) const
+{
+	std::ofstream file(p_path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+	write(file);
+	file.close();
+	return !file.fail();
+}
+
+TraceSpan::TraceSpan(const char *p_category, std::string_view p_name, std::string_view p_detail) :
+    m_session(g_session.load(std::memory_order_acquire)), m_category(p_category)
+{
+	if (!m_session)
+	{
+		return;
+	}
+	m_name = p_name;
+	setDetail(p_detail);
+	m_start = nowMicroseconds();
+}
+
+TraceSpan::~TraceSpan()
+{
+	if (!m_session)
+	{
+		return;
+	}
+	const double end = nowMicroseconds();
+	const std::size_t thread = currentThread();
+	std::lock_guard lock(m_session->m_mutex);
+	m_session->m_events.push_back(TraceSession::Event{std::move(m_name), m_category, m_start, end - m_start, thread});
+}
+
+void TraceSpan::setDetail(std::string_view p_detail)
+{
+	if (!m_session || p_detail.empty())
+	{
+		return;
+	}
+	m_name += ' ';
+	m_name += p_detail;
+}
+
+void TraceSpan::setFile(const std::filesystem::path &p_file)
+{
+	if (m_session)
+	{
+		setDetail(p_file.generic_string());
+	}
+}
+
+void nameTraceThread(std::string_view p_name)
+{
+	TraceSession *session = g_session.load(std::memory_order_acquire);
+	if (!session)
+	{
+		return;
+	}
+	const std::size_t thread = currentThread();
+	std::lock_guard lock(session->m_mutex);
+	session->m_threadNames[thread] = std::string(p_name);
+}
+
+std::string traceName(const Instruction &p_instruction)
+{
+	switch (p_instruction.type)
+	{
+		case Instruction::Type::Pipeline:
+		{
+			const auto &pipeline = static_cast<const PipelineInstruction &>(p_instruction);
+			return "pipeline " + stageName(pipeline.source) + " -> " + stageName(pipeline.destination) + " " +
+			       pipeline.variable.content;
+		}
+		case Instruction::Type::Variable:
+		{
+			const auto &variable = static_cast<const VariableInstruction &>(p_instruction);
+			const auto &declarators = variable.declaration.declarators;
+			return "variable " + (declarators.empty() ? std::string() : declarators.front().name.content);
+		}
+		case Instruction::Type::Function:
+			return "function " + static_cast<const FunctionInstruction &>(p_instruction).name.content;
+		case Instruction::Type::StageFunction:
+			return stageName(static_cast<const StageFunctionInstruction &>(p_instruction).stage) + "()";
+		case Instruction::Type::Aggregate:
+		{
+			const auto &aggregate = static_cast<const AggregateInstruction &>(p_instruction);
+			const char *kind = aggregate.kind == AggregateInstruction::Kind::Struct           ? "struct "
+			                   : aggregate.kind == AggregateInstruction::Kind::AttributeBlock ? "AttributeBlock "
+			                                                                                  : "ConstantBlock ";
+			return kind + aggregate.name.content;
+		}
+		case Instruction::Type::Namespace:
+			return "namespace " + static_cast<const NamespaceInstruction &>(p_instruction).name.content;
+	}
+	return "instruction";
+}
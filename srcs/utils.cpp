@@ -3,6 +3,7 @@
 #include <cctype>
 #include <cstdlib>
 #include <filesystem>
+#include <stdexcept>
 #include <unordered_map>
 
 std::string normalizeLineEndings(std::string input)
@@ -166,35 +167,36 @@ std::vector<std::filesystem::path> splitPathList(const std::string &p_list)
 	return result;
 }
 
-std::vector<std::filesystem::path> readPathListFromEnv(const char *p_envName)
+std::optional<std::string> readEnvironmentVariable(const char *p_envName)
 {
 	if (p_envName == nullptr)
 	{
-		return {};
+		return std::nullopt;
 	}
 
-	auto fetchEnv = [](const char *name) -> std::optional<std::string> {
 #if defined(_WIN32)
-		char *buffer = nullptr;
-		size_t length = 0;
-		if (_dupenv_s(&buffer, &length, name) != 0 || buffer == nullptr)
-		{
-			return std::nullopt;
-		}
-		std::string value(buffer, (length > 0) ? length - 1 : 0);
-		free(buffer);
-		return value;
+	char *buffer = nullptr;
+	size_t length = 0;
+	if (_dupenv_s(&buffer, &length, p_envName) != 0 || buffer == nullptr)
+	{
+		return std::nullopt;
+	}
+	std::string value(buffer, (length > 0) ? length - 1 : 0);
+	free(buffer);
+	return value;
 #else
-		const char *raw = std::getenv(name);
-		if (raw == nullptr)
-		{
-			return std::nullopt;
-		}
-		return std::string(raw);
+	const char *raw = std::getenv(p_envName);
+	if (raw == nullptr)
+	{
+		return std::nullopt;
+	}
+	return std::string(raw);
 #endif
-	};
+}
 
-	const std::optional<std::string> value = fetchEnv(p_envName);
+std::vector<std::filesystem::path> readPathListFromEnv(const char *p_envName)
+{
+	const std::optional<std::string> value = readEnvironmentVariable(p_envName);
 	if (!value || value->empty())
 	{
 		return {};
@@ -202,3 +204,40 @@ std::vector<std::filesystem::path> readPathListFromEnv(const char *p_envName)
 
 	return splitPathList(*value);
 }
+
+std::vector<std::string> splitQuotedFields(std::string_view p_line)
+{
+	std::vector<std::string> fields;
+	std::size_t index = 0;
+	while (index < p_line.size())
+	{
+		if (std::isspace(static_cast<unsigned char>(p_line[index])))
+		{
+			++index;
+			continue;
+		}
+
+		std::string field;
+		if (p_line[index] == '"')
+		{
+			const std::size_t close = p_line.find('"', index + 1);
+			if (close == std::string_view::npos)
+			{
+				throw std::runtime_error("unterminated quote");
+			}
+			field = std::string(p_line.substr(index + 1, close - index - 1));
+			index = close + 1;
+		}
+		else
+		{
+			const std::size_t begin = index;
+			while (index < p_line.size() && !std::isspace(static_cast<unsigned char>(p_line[index])))
+			{
+				++index;
+			}
+			field = std::string(p_line.substr(begin, index - begin));
+		}
+		fields.push_back(std::move(field));
+	}
+	return fields;
+}
@@ -0,0 +1,31 @@
+# Compiles INPUT with LUMINA and FLAGS into OUTPUT and fails when OUTPUT differs from EXPECTED.
+# Run by the golden tests in tests/CMakeLists.txt.
+separate_arguments(FLAGS)
+
+# A warm compile cache would hide a changed pass
+unset(ENV{LUMINA_CACHE_DIR})
+
+get_filename_component(OUTPUT_DIR ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+execute_process(
+    COMMAND ${LUMINA} ${FLAGS} ${INPUT} ${OUTPUT}
+    RESULT_VARIABLE LUMINA_RESULT
+    OUTPUT_VARIABLE LUMINA_OUTPUT
+    ERROR_VARIABLE LUMINA_OUTPUT
+)
+if(NOT LUMINA_RESULT EQUAL 0)
+    message(FATAL_ERROR "Lumina failed on ${INPUT}:\n${LUMINA_OUTPUT}")
+endif()
+
+if(DEFINED ENV{LUMINA_UPDATE_GOLDEN})
+    execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${OUTPUT} ${EXPECTED})
+    return()
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+    RESULT_VARIABLE COMPARE_RESULT
+)
+if(NOT COMPARE_RESULT EQUAL 0)
+    message(FATAL_ERROR "${OUTPUT} differs from ${EXPECTED}:\n${LUMINA_OUTPUT}")
+endif()